@@ -0,0 +1,186 @@
+"""
+Benchmarks of the individual encoding and decoding paths, for both the C extension and the pure
+Python implementation.
+
+Every data set is generated from a fixed seed, so runs on different machines (or before and after
+a change) measure exactly the same input. The size of each encoded payload is recorded in the
+``extra_info`` of its benchmarks, which ends up in the output of ``--benchmark-json`` along with
+the timings.
+"""
+
+from __future__ import annotations
+
+import random
+import string
+from array import array
+from collections import namedtuple
+from datetime import datetime, timedelta, timezone
+from decimal import Decimal
+from io import BytesIO
+from operator import attrgetter
+from uuid import UUID
+
+import pytest
+
+from cbor2 import _decoder, _encoder
+
+try:
+    import _cbor2
+except ModuleNotFoundError:
+    _cbor2 = None
+
+#: the seed every data set is generated from
+SEED = 20241009
+
+Implementation = namedtuple("Implementation", "name,dumps,loads,load")
+Case = namedtuple("Case", "name,value,encode_options,decode_options")
+
+implementations = [Implementation("python", _encoder.dumps, _decoder.loads, _decoder.load)]
+if _cbor2 is not None:
+    implementations.insert(0, Implementation("c", _cbor2.dumps, _cbor2.loads, _cbor2.load))
+
+
+def small_scalars(rng: random.Random) -> list[object]:
+    choices = [
+        lambda: rng.randint(0, 23),
+        lambda: rng.randint(-1000, 1000),
+        lambda: rng.random() < 0.5,
+        lambda: None,
+        lambda: round(rng.uniform(-100, 100), 2),
+    ]
+    return [rng.choice(choices)() for _ in range(10000)]
+
+
+def big_ints(rng: random.Random) -> list[int]:
+    return [rng.getrandbits(rng.randint(65, 512)) for _ in range(2000)]
+
+
+def long_strings(rng: random.Random) -> list[str]:
+    alphabet = string.ascii_letters + string.digits + " äöüàéèñ€→中文字"
+    return ["".join(rng.choices(alphabet, k=10000)) for _ in range(50)]
+
+
+def long_bytestrings(rng: random.Random) -> list[bytes]:
+    return [rng.randbytes(100_000) for _ in range(20)]
+
+
+def float_array(rng: random.Random) -> list[float]:
+    return [rng.uniform(-1e6, 1e6) for _ in range(100_000)]
+
+
+def int_array(rng: random.Random) -> list[int]:
+    return [rng.randint(-(2**40), 2**40) for _ in range(100_000)]
+
+
+def typed_array(rng: random.Random) -> array[float]:
+    return array("d", (rng.random() for _ in range(100_000)))
+
+
+def deep_nesting(rng: random.Random) -> list[object]:
+    value: list[object] = [rng.randint(0, 100)]
+    for _ in range(100):
+        value = [value, {"next": value[-1]} if rng.random() < 0.5 else rng.randint(0, 100)]
+    return value
+
+
+def records(rng: random.Random) -> list[dict[str, object]]:
+    return [
+        {
+            "id": i,
+            "name": "".join(rng.choices(string.ascii_lowercase, k=12)),
+            "email": "".join(rng.choices(string.ascii_lowercase, k=8)) + "@example.com",
+            "active": rng.random() < 0.9,
+            "score": rng.uniform(0, 100),
+            "tags": rng.sample(["admin", "staff", "guest", "beta", "ops"], 2),
+            "parent": rng.randint(0, i) if i else None,
+        }
+        for i in range(5000)
+    ]
+
+
+def canonical_floats(rng: random.Random) -> list[float]:
+    # sensor-style readings: most fit in half or single precision
+    return [
+        rng.choice([rng.randint(-2000, 2000) / 8, round(rng.uniform(-50, 50), 1)])
+        for _ in range(100_000)
+    ]
+
+
+def shared_values(rng: random.Random) -> list[object]:
+    pool = [{"id": i, "values": [rng.random() for _ in range(5)]} for i in range(100)]
+    return [rng.choice(pool) for _ in range(5000)]
+
+
+def repeated_strings(rng: random.Random) -> list[str]:
+    pool = ["".join(rng.choices(string.ascii_letters, k=rng.randint(4, 40))) for _ in range(200)]
+    return [rng.choice(pool) for _ in range(20000)]
+
+
+def datetimes(rng: random.Random) -> list[datetime]:
+    start = datetime(2000, 1, 1, tzinfo=timezone.utc)
+    return [start + timedelta(seconds=rng.randint(0, 10**9)) for _ in range(10000)]
+
+
+def decimals(rng: random.Random) -> list[Decimal]:
+    return [
+        Decimal(rng.randint(-(10**12), 10**12)).scaleb(-rng.randint(0, 8)) for _ in range(10000)
+    ]
+
+
+def uuids(rng: random.Random) -> list[UUID]:
+    return [UUID(int=rng.getrandbits(128), version=4) for _ in range(10000)]
+
+
+cases = [
+    Case("small scalars", small_scalars, {}, {}),
+    Case("big ints", big_ints, {}, {}),
+    Case("long strings", long_strings, {}, {}),
+    Case("long bytestrings", long_bytestrings, {}, {}),
+    Case("float array", float_array, {}, {}),
+    Case("int array", int_array, {}, {}),
+    Case("typed array", typed_array, {}, {}),
+    Case("deep nesting", deep_nesting, {}, {}),
+    Case("records", records, {}, {}),
+    Case("canonical records", records, {"canonical": True}, {}),
+    Case("canonical floats", canonical_floats, {"canonical": True}, {}),
+    Case("value sharing", shared_values, {"value_sharing": True}, {}),
+    Case("string referencing", repeated_strings, {"string_referencing": True}, {}),
+    Case("datetimes", datetimes, {}, {}),
+    Case("decimals", decimals, {}, {}),
+    Case("uuids", uuids, {}, {}),
+]
+
+# Generate each data set once, up front, so that it isn't part of any timing
+values = {case.name: case.value(random.Random(SEED)) for case in cases}
+
+
+def pytest_generate_tests(metafunc):
+    if "implementation" in metafunc.fixturenames:
+        metafunc.parametrize("implementation", implementations, ids=attrgetter("name"))
+    if "case" in metafunc.fixturenames:
+        metafunc.parametrize("case", cases, ids=attrgetter("name"))
+
+
+@pytest.mark.benchmark(group="encode")
+def test_encode(implementation, case, benchmark):
+    value = values[case.name]
+    benchmark.extra_info["size"] = len(implementation.dumps(value, **case.encode_options))
+    benchmark(implementation.dumps, value, **case.encode_options)
+
+
+@pytest.mark.benchmark(group="decode bytes")
+def test_decode(implementation, case, benchmark):
+    payload = implementation.dumps(values[case.name], **case.encode_options)
+    benchmark.extra_info["size"] = len(payload)
+    benchmark(implementation.loads, payload, **case.decode_options)
+
+
+@pytest.mark.benchmark(group="decode stream")
+def test_decode_stream(implementation, case, benchmark):
+    payload = implementation.dumps(values[case.name], **case.encode_options)
+    benchmark.extra_info["size"] = len(payload)
+
+    def load():
+        return implementation.load(BytesIO(payload), **case.decode_options)
+
+    benchmark(load)
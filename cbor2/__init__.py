@@ -1,11 +1,21 @@
 from typing import Any
 
 from ._decoder import CBORDecoder as CBORDecoder
+from ._decoder import IncrementalDecoder as IncrementalDecoder
+from ._decoder import LazyArray as LazyArray
+from ._decoder import LazyMap as LazyMap
+from ._decoder import extract as extract
 from ._decoder import load as load
+from ._decoder import load_sequence as load_sequence
 from ._decoder import loads as loads
+from ._decoder import loads_lazy as loads_lazy
+from ._decoder import loads_sequence as loads_sequence
+from ._decoder import loads_sequence_parallel as loads_sequence_parallel
 from ._encoder import CBOREncoder as CBOREncoder
 from ._encoder import dump as dump
+from ._encoder import dump_sequence as dump_sequence
 from ._encoder import dumps as dumps
+from ._encoder import dumps_sequence as dumps_sequence
 from ._encoder import shareable_encoder as shareable_encoder
 from ._types import CBORDecodeEOF as CBORDecodeEOF
 from ._types import CBORDecodeError as CBORDecodeError
@@ -14,6 +24,7 @@ from ._types import CBOREncodeError as CBOREncodeError
 from ._types import CBOREncodeTypeError as CBOREncodeTypeError
 from ._types import CBOREncodeValueError as CBOREncodeValueError
 from ._types import CBORError as CBORError
+from ._types import CBORRaw as CBORRaw
 from ._types import CBORSimpleValue as CBORSimpleValue
 from ._types import CBORTag as CBORTag
 from ._types import FrozenDict as FrozenDict
@@ -38,11 +49,12 @@ else:
     # overall performance as it's a one-off initialization cost).
     def _init_cbor2() -> None:
         from collections import OrderedDict
+        from collections.abc import Mapping, Sequence
 
         import _cbor2
 
         from ._encoder import canonical_encoders, default_encoders
-        from ._types import CBORSimpleValue, CBORTag, undefined
+        from ._types import CBORRaw, CBORSimpleValue, CBORTag, undefined
 
         _cbor2.default_encoders = OrderedDict(
             [
@@ -50,6 +62,8 @@ else:
                     (
                         _cbor2.CBORSimpleValue
                         if type_ is CBORSimpleValue
+                        else _cbor2.CBORRaw
+                        if type_ is CBORRaw
                         else _cbor2.CBORTag
                         if type_ is CBORTag
                         else type(_cbor2.undefined)
@@ -67,6 +81,8 @@ else:
                     (
                         _cbor2.CBORSimpleValue
                         if type_ is CBORSimpleValue
+                        else _cbor2.CBORRaw
+                        if type_ is CBORRaw
                         else _cbor2.CBORTag
                         if type_ is CBORTag
                         else type(_cbor2.undefined)
@@ -79,5 +95,8 @@ else:
             ]
         )
 
+        Sequence.register(_cbor2.LazyArray)
+        Mapping.register(_cbor2.LazyMap)
+
     _init_cbor2()
     del _init_cbor2
@@ -1,17 +1,20 @@
 from __future__ import annotations
 
+import os
 import re
 import struct
 import sys
 from codecs import getincrementaldecoder
-from collections.abc import Callable, Mapping, Sequence
+from collections.abc import Callable, Collection, Iterator, Mapping, Sequence
+from dataclasses import fields, is_dataclass
 from datetime import date, datetime, timedelta, timezone
 from io import BytesIO
-from typing import IO, TYPE_CHECKING, Any, TypeVar, cast, overload
+from typing import IO, TYPE_CHECKING, Any, NoReturn, TypeVar, cast, overload
 
 from ._types import (
     CBORDecodeEOF,
     CBORDecodeValueError,
+    CBORRaw,
     CBORSimpleValue,
     CBORTag,
     FrozenDict,
@@ -20,6 +23,7 @@ from ._types import (
 )
 
 if TYPE_CHECKING:
+    from array import array
     from decimal import Decimal
     from email.message import Message
     from fractions import Fraction
@@ -33,6 +37,13 @@ timestamp_re = re.compile(
     r"^(\d{4})-(\d\d)-(\d\d)T(\d\d):(\d\d):(\d\d)" r"(?:\.(\d{1,6})\d*)?(?:Z|([+-])(\d\d):(\d\d))$"
 )
 incremental_utf8_decoder = getincrementaldecoder("utf-8")
+_missing = object()
+
+#: the maximum number of distinct map keys each decoder keeps in its key cache
+KEY_CACHE_SIZE = 256
+
+#: the least input :func:`loads_sequence_parallel` gives each thread to decode
+PARALLEL_CHUNK_SIZE = 65536
 
 
 class CBORDecoder:
@@ -44,7 +55,16 @@ class CBORDecoder:
     and use the class.
 
     When the class is constructed manually, the main entry points are
-    :meth:`decode` and :meth:`decode_from_bytes`.
+    :meth:`decode` and :meth:`decode_from_bytes`. Iterating over the decoder decodes
+    successive values until the input is exhausted, treating it as a CBOR sequence
+    (:rfc:`8742`).
+
+    A decoder may be reused for any number of values. Shared values decoded earlier
+    remain available to shared references until :meth:`reset` is called, which also
+    allows switching to a new *fp* without constructing a new decoder.
+
+    When :attr:`record_type` is set, each value decoded by :meth:`decode` or by
+    iteration must be a map, which is decoded straight into an instance of that class.
 
     .. _CBOR: https://cbor.io/
     """
@@ -56,13 +76,32 @@ class CBORDecoder:
         "_shareables",
         "_fp",
         "_fp_read",
+        "_fp_buffer",
         "_immutable",
         "_str_errors",
         "_stringref_namespace",
+        "_record_type",
+        "_record_fields",
+        "_key_cache",
+        "_int_cache_size",
+        "_int_cache",
+        "_raw_tags",
+        "_raw_keys",
+        "_memoryview_size",
+        "_max_items",
+        "_max_length",
+        "_max_allocation",
+        "_limited",
+        "_tracking",
+        "_stats",
+        "_depth",
+        "_items",
+        "_allocated",
     )
 
     _fp: IO[bytes]
     _fp_read: Callable[[int], bytes]
+    _int_cache: dict[int, int]
 
     def __init__(
         self,
@@ -70,6 +109,17 @@ class CBORDecoder:
         tag_hook: Callable[[CBORDecoder, CBORTag], Any] | None = None,
         object_hook: Callable[[CBORDecoder, dict[Any, Any]], Any] | None = None,
         str_errors: Literal["strict", "error", "replace"] = "strict",
+        read_size: int | None = None,
+        record_type: type | None = None,
+        cache_keys: bool = True,
+        int_cache_size: int = 1024,
+        raw_tags: Collection[int] | None = None,
+        raw_keys: Collection[Any] | None = None,
+        memoryview_size: int | None = None,
+        max_items: int | None = None,
+        max_length: int | None = None,
+        max_allocation: int | None = None,
+        collect_stats: bool = False,
     ):
         """
         :param fp:
@@ -88,14 +138,82 @@ class CBORDecoder:
         :param str_errors:
             determines how to handle unicode decoding errors (see the `Error Handlers`_
             section in the standard library documentation for details)
+        :param read_size:
+            the minimum number of bytes the C extension requests from ``fp.read()`` at a
+            time, buffering whatever hasn't been decoded yet (a seekable ``fp`` is moved
+            back to just after what was decoded at the end of every call; see
+            :meth:`release_read_ahead`); the pure Python decoder always reads exactly what
+            it needs
+        :param record_type:
+            a dataclass or named tuple class; if given, each value decoded by
+            :meth:`decode` or by iteration must be a map, and is constructed directly as
+            an instance of this class with the map's values passed as keyword arguments
+            (the values of keys that aren't fields of the class are skipped)
+        :param cache_keys:
+            if ``True``, short string map keys are looked up in a small cache kept for
+            the lifetime of the decoder, so that keys repeated across maps and across
+            values are decoded as the same :class:`str` object instead of a new string
+            each time (it isn't interned)
+        :param int_cache_size:
+            integers from ``-int_cache_size`` to ``int_cache_size - 1`` (outside the -5
+            to 256 that Python always shares) are kept for the lifetime of the decoder
+            once decoded, and repeated values are returned as the same :class:`int`
+            object; 0 disables the cache
+        :param raw_tags:
+            a collection of tag numbers; tags with these numbers are returned as
+            :class:`.CBORRaw` objects holding their encoded form (including the tag
+            itself) instead of being decoded
+        :param raw_keys:
+            a collection of map keys; the values of these keys are returned as
+            :class:`.CBORRaw` objects holding their encoded form instead of being
+            decoded
+        :param memoryview_size:
+            if ``fp`` supports the buffer protocol (an :class:`mmap.mmap`, for instance),
+            bytestrings at least this long are returned as read-only :class:`memoryview`
+            slices of it instead of being copied; ``None`` (the default) always copies
+            them
+        :param max_items:
+            the most data items (counting every key, value and tag, at any depth) that
+            each value decoded may contain, or ``None`` for no limit
+        :param max_length:
+            the most items an array, or entries a map, may have, or ``None`` for no
+            limit; definite lengths are checked before anything is allocated
+        :param max_allocation:
+            the most bytes each value decoded may have allocated for it, counting the
+            length of every string and bytestring, 8 bytes for each array item and 16
+            for each map entry, or ``None`` for no limit. Exceeding any of the limits
+            raises :exc:`.CBORDecodeValueError`
+        :param collect_stats:
+            if ``True``, the decoder keeps counters of what it has done, which are
+            available from :attr:`stats`
 
         .. _Error Handlers: https://docs.python.org/3/library/codecs.html#error-handlers
 
         """
+        if read_size is not None and (not isinstance(read_size, int) or read_size < 1):
+            raise ValueError(
+                f"invalid read_size value {read_size!r} (must be a positive integer or None)"
+            )
+
+        self._key_cache: dict[bytes, str] | None = None
+        self._stats: dict[str, Any] | None = None
+        self._max_items = self._max_length = self._max_allocation = None
+        self._limited = self._tracking = False
+        self._depth = self._items = self._allocated = 0
         self.fp = fp
         self.tag_hook = tag_hook
         self.object_hook = object_hook
         self.str_errors = str_errors
+        self.record_type = record_type
+        self.cache_keys = cache_keys
+        self.int_cache_size = int_cache_size
+        self.raw_tags = raw_tags
+        self.raw_keys = raw_keys
+        self.memoryview_size = memoryview_size
+        self.max_items = max_items
+        self.max_length = max_length
+        self.max_allocation = max_allocation
+        self.collect_stats = collect_stats
         self._share_index: int | None = None
         self._shareables: list[object] = []
         self._stringref_namespace: list[str | bytes] | None = None
@@ -123,7 +241,15 @@ class CBORDecoder:
             raise ValueError("fp object has no read method")
         else:
             self._fp = value
-            self._fp_read = value.read
+            self._fp_read = value.read if self._stats is None else self._counted_read
+            # An fp exposing its content through the buffer protocol (such as an mmap)
+            # can have bytestrings returned as views of it; see memoryview_size
+            try:
+                memoryview(value).release()
+            except (TypeError, ValueError):
+                self._fp_buffer = False
+            else:
+                self._fp_buffer = hasattr(value, "tell") and hasattr(value, "seek")
 
     @property
     def tag_hook(self) -> Callable[[CBORDecoder, CBORTag], Any] | None:
@@ -155,12 +281,289 @@ class CBORDecoder:
     def str_errors(self, value: Literal["strict", "error", "replace"]) -> None:
         if value in ("strict", "error", "replace"):
             self._str_errors = value
+            # Cached keys were decoded under the old error mode
+            if self._key_cache:
+                self._key_cache.clear()
         else:
             raise ValueError(
                 f"invalid str_errors value {value!r} (must be one of 'strict', "
                 "'error', or 'replace')"
             )
 
+    @property
+    def cache_keys(self) -> bool:
+        return self._key_cache is not None
+
+    @cache_keys.setter
+    def cache_keys(self, value: bool) -> None:
+        if not value:
+            self._key_cache = None
+        elif self._key_cache is None:
+            self._key_cache = {}
+
+    @property
+    def int_cache_size(self) -> int:
+        return self._int_cache_size
+
+    @int_cache_size.setter
+    def int_cache_size(self, value: int) -> None:
+        if not isinstance(value, int) or value < 0:
+            raise ValueError(
+                f"invalid int_cache_size value {value!r} (must be a non-negative integer)"
+            )
+
+        self._int_cache_size = value
+        self._int_cache = {}
+
+    @property
+    def memoryview_size(self) -> int | None:
+        return self._memoryview_size
+
+    @memoryview_size.setter
+    def memoryview_size(self, value: int | None) -> None:
+        if value is not None and (not isinstance(value, int) or value < 0):
+            raise ValueError(
+                f"invalid memoryview_size value {value!r} (must be a non-negative integer "
+                "or None)"
+            )
+
+        self._memoryview_size = value
+
+    def _check_limit(self, name: str, value: int | None) -> int | None:
+        if value is not None and (not isinstance(value, int) or value < 0):
+            raise ValueError(
+                f"invalid {name} value {value!r} (must be a non-negative integer or None)"
+            )
+
+        return value
+
+    def _update_tracking(self) -> None:
+        self._limited = (
+            self._max_items is not None
+            or self._max_length is not None
+            or self._max_allocation is not None
+        )
+        self._tracking = self._limited or self._stats is not None
+
+    @property
+    def max_items(self) -> int | None:
+        return self._max_items
+
+    @max_items.setter
+    def max_items(self, value: int | None) -> None:
+        self._max_items = self._check_limit("max_items", value)
+        self._update_tracking()
+
+    @property
+    def max_length(self) -> int | None:
+        return self._max_length
+
+    @max_length.setter
+    def max_length(self, value: int | None) -> None:
+        self._max_length = self._check_limit("max_length", value)
+        self._update_tracking()
+
+    @property
+    def max_allocation(self) -> int | None:
+        return self._max_allocation
+
+    @max_allocation.setter
+    def max_allocation(self, value: int | None) -> None:
+        self._max_allocation = self._check_limit("max_allocation", value)
+        self._update_tracking()
+
+    @property
+    def collect_stats(self) -> bool:
+        return self._stats is not None
+
+    @collect_stats.setter
+    def collect_stats(self, value: bool) -> None:
+        # Counting starts afresh each time it's enabled
+        if value:
+            self._stats = {
+                "bytes_read": 0,
+                "read_calls": 0,
+                "items": [0] * 8,
+                "tag_hook_calls": 0,
+                "object_hook_calls": 0,
+                "max_depth": 0,
+            }
+            self._fp_read = self._counted_read
+        else:
+            self._stats = None
+            self._fp_read = self._fp.read
+
+        self._update_tracking()
+
+    @property
+    def stats(self) -> dict[str, Any] | None:
+        """
+        The counters kept while :attr:`collect_stats` is enabled, or ``None``:
+
+        * ``bytes_read``: the input consumed
+        * ``read_calls``: the calls made to ``fp.read()``
+        * ``items``: the data items decoded, as a tuple of the count of each major type
+        * ``tag_hook_calls`` and ``object_hook_calls``: the calls made to the hooks
+        * ``max_depth``: the deepest nesting of arrays, maps and tags decoded, counting
+          the innermost one itself (as :meth:`scan` does), so ``[[]]`` has a depth of 2
+
+        The pure Python decoder reads exactly what it needs when it needs it, so it
+        makes many more calls to ``fp.read()`` than the C extension does.
+        """
+        if self._stats is None:
+            return None
+
+        return {**self._stats, "items": tuple(self._stats["items"])}
+
+    def _counted_read(self, amount: int) -> bytes:
+        # fp.read(), counted in the statistics
+        data = self._fp.read(amount)
+        stats = cast("dict[str, Any]", self._stats)
+        stats["read_calls"] += 1
+        stats["bytes_read"] += len(data)
+        return data
+
+    def _count_item(self, initial_byte: int) -> None:
+        # Count the item whose initial byte has just been read, nested in
+        # self._depth - 1 arrays, maps and tags. Like scan(), max_depth is the
+        # nesting of the deepest array, map or tag, counting itself
+        if initial_byte == 0xFF:
+            return  # a break code ends an item rather than being one
+
+        if self._stats is not None:
+            self._stats["items"][initial_byte >> 5] += 1
+            depth = self._depth if 0x80 <= initial_byte < 0xE0 else self._depth - 1
+            if depth > self._stats["max_depth"]:
+                self._stats["max_depth"] = depth
+
+        if self._max_items is not None:
+            self._items += 1
+            if self._items > self._max_items:
+                self._raise_too_many_items()
+
+    def _raise_too_many_items(self) -> NoReturn:
+        raise CBORDecodeValueError(f"maximum number of items ({self._max_items}) exceeded")
+
+    def _charge_allocation(self, count: int, size: int = 1) -> None:
+        # Charge count times size bytes to the allocation of the current value; see
+        # max_allocation
+        if self._max_allocation is not None:
+            if count > (self._max_allocation - self._allocated) // size:
+                raise CBORDecodeValueError(
+                    f"maximum allocation ({self._max_allocation} bytes) exceeded"
+                )
+
+            self._allocated += count * size
+
+    def _check_container(self, length: int, is_map: bool) -> None:
+        # Check an array of length items (or map of length entries) against the limits
+        # before decoding any of it; its items are counted as they're decoded, but
+        # there's no point starting on more than could fit
+        if self._max_length is not None and length > self._max_length:
+            raise CBORDecodeValueError(
+                f"{'map' if is_map else 'array'} length {length} exceeds max_length "
+                f"({self._max_length})"
+            )
+
+        if self._max_items is not None and length > (self._max_items - self._items) // (
+            2 if is_map else 1
+        ):
+            self._raise_too_many_items()
+
+        self._charge_allocation(length, 16 if is_map else 8)
+
+    def _check_indefinite(self, length: int, is_map: bool) -> None:
+        # Check an indefinite length array (or map) that's about to reach length items
+        # (or entries) against the limits
+        if self._max_length is not None and length > self._max_length:
+            raise CBORDecodeValueError(
+                f"{'map' if is_map else 'array'} length exceeds max_length "
+                f"({self._max_length})"
+            )
+
+        self._charge_allocation(1, 16 if is_map else 8)
+
+    def _track(self, initial_byte: int, decoder: Callable[[int], Any]) -> Any:
+        # Decode an item with decoder() while tracking, counting it and, for a
+        # top-level value, starting the value's limits afresh
+        if not self._depth:
+            self._items = self._allocated = 0
+
+        self._depth += 1
+        try:
+            self._count_item(initial_byte)
+            return decoder(initial_byte)
+        finally:
+            self._depth -= 1
+
+    def _decode_major(self, initial_byte: int) -> Any:
+        return major_decoders[initial_byte >> 5](self, initial_byte & 31)
+
+    @property
+    def raw_tags(self) -> frozenset[int] | None:
+        return self._raw_tags
+
+    @raw_tags.setter
+    def raw_tags(self, value: Collection[int] | None) -> None:
+        if value is None:
+            self._raw_tags = None
+            return
+
+        try:
+            tags: frozenset[int] | None = frozenset(value)
+        except TypeError:
+            tags = None
+
+        if tags is None or not all(isinstance(tag, int) for tag in tags):
+            raise ValueError(
+                f"invalid raw_tags value {value!r} (must be a collection of integers or None)"
+            )
+
+        self._raw_tags = tags
+
+    @property
+    def raw_keys(self) -> frozenset[Any] | None:
+        return self._raw_keys
+
+    @raw_keys.setter
+    def raw_keys(self, value: Collection[Any] | None) -> None:
+        if value is None:
+            self._raw_keys = None
+            return
+
+        try:
+            self._raw_keys = frozenset(value)
+        except TypeError:
+            raise ValueError(
+                f"invalid raw_keys value {value!r} (must be a collection of hashable values "
+                "or None)"
+            ) from None
+
+    @property
+    def record_type(self) -> type | None:
+        return self._record_type
+
+    @record_type.setter
+    def record_type(self, value: type | None) -> None:
+        if value is None:
+            names: frozenset[str] | None = None
+        elif isinstance(value, type) and is_dataclass(value):
+            names = frozenset(field.name for field in fields(value) if field.init)
+        elif (
+            isinstance(value, type)
+            and issubclass(value, tuple)
+            and isinstance(getattr(value, "_fields", None), tuple)
+        ):
+            names = frozenset(value._fields)  # type: ignore[attr-defined]
+        else:
+            raise ValueError(
+                f"invalid record_type value {value!r} (must be a dataclass, a named tuple "
+                "class, or None)"
+            )
+
+        self._record_type = value
+        self._record_fields = names
+
     def set_shareable(self, value: T) -> T:
         """
         Set the shareable value for the last encountered shared value marker,
@@ -191,6 +594,32 @@ class CBORDecoder:
             if is_referenced:
                 self._stringref_namespace.append(string)
 
+    def reset(self, fp: IO[bytes] | None = None) -> None:
+        """
+        Forget all the shared values decoded so far, so that the next value decoded
+        can't refer back to any of them.
+
+        :param fp:
+            if given, the new file to read from
+        """
+        if fp is not None:
+            self.fp = fp
+
+        self._shareables.clear()
+
+    def release_read_ahead(self) -> bytes:
+        """
+        Hand back any data read from ``fp`` but not yet decoded.
+
+        If ``fp`` is seekable, it's already just after the last decoded value (the
+        decoder moves it back there at the end of every call) and an empty bytestring
+        is returned. Otherwise the unconsumed data is returned instead. Either way the
+        decoder forgets about it.
+
+        The pure Python decoder never reads ahead so this always returns ``b""``.
+        """
+        return b""
+
     def read(self, amount: int) -> bytes:
         """
         Read bytes from the data stream.
@@ -206,7 +635,9 @@ class CBORDecoder:
 
         return data
 
-    def _decode(self, immutable: bool = False, unshared: bool = False) -> Any:
+    def _decode(
+        self, immutable: bool = False, unshared: bool = False, initial_byte: int | None = None
+    ) -> Any:
         if immutable:
             old_immutable = self._immutable
             self._immutable = True
@@ -214,7 +645,12 @@ class CBORDecoder:
             old_index = self._share_index
             self._share_index = None
         try:
-            initial_byte = self.read(1)[0]
+            if initial_byte is None:
+                initial_byte = self.read(1)[0]
+
+            if self._tracking:
+                return self._track(initial_byte, self._decode_major)
+
             major_type = initial_byte >> 5
             subtype = initial_byte & 31
             decoder = major_decoders[major_type]
@@ -225,14 +661,381 @@ class CBORDecoder:
             if unshared:
                 self._share_index = old_index
 
+    def _decode_key(self) -> Any:
+        # Decode a map key, reusing the same str object for short string keys
+        # (the ones whose length fits in the initial byte) seen before
+        initial_byte = self.read(1)[0]
+        if self._key_cache is not None and 0x60 <= initial_byte < 0x78:
+            length = initial_byte & 31
+            if self._tracking:
+                # Counted as if it had been decoded by _decode()
+                self._depth += 1
+                self._count_item(initial_byte)
+                self._depth -= 1
+                if self._limited:
+                    self._charge_allocation(length)
+
+            data = self.read(length)
+            key = self._key_cache.get(data)
+            if key is None:
+                try:
+                    key = data.decode("utf-8", self._str_errors)
+                except UnicodeDecodeError as exc:
+                    raise CBORDecodeValueError("error decoding unicode string") from exc
+
+                if len(self._key_cache) < KEY_CACHE_SIZE:
+                    self._key_cache[data] = key
+
+            self._stringref_namespace_add(key, length)
+            return key
+
+        return self._decode(immutable=True, unshared=True, initial_byte=initial_byte)
+
+    def _decode_record(self, initial_byte: int | None = None) -> Any:
+        # Decode a map straight into an instance of record_type, skipping the values
+        # of any keys that aren't fields of it
+        if initial_byte is None:
+            initial_byte = self.read(1)[0]
+
+        if initial_byte >> 5 != 5:
+            raise CBORDecodeValueError(
+                f"expected a map to decode into {self._record_type!r} (found major type "
+                f"{initial_byte >> 5})"
+            )
+
+        if self._tracking:
+            return self._track(initial_byte, self._decode_record_map)
+
+        return self._decode_record_map(initial_byte)
+
+    def _decode_record_map(self, initial_byte: int) -> Any:
+        names = cast("frozenset[str]", self._record_fields)
+        kwargs: dict[str, Any] = {}
+        length = self._decode_length(initial_byte & 31, allow_indefinite=True)
+        if length is not None and self._limited:
+            self._check_container(length, True)
+
+        while length is None or length > 0:
+            key = self._decode_key()
+            if length is None:
+                if key is break_marker:
+                    break
+            else:
+                length -= 1
+
+            if isinstance(key, str) and key in names:
+                kwargs[key] = self._decode_map_value(key)
+            else:
+                # the values of keys that aren't fields are skipped over
+                self._skip_value()
+
+        return cast(type, self._record_type)(**kwargs)
+
+    def _skip_bytes(self, length: int) -> None:
+        # Read in chunks so that a long string isn't held in memory all at once
+        while length > 65536:
+            self.read(65536)
+            length -= 65536
+
+        self.read(length)
+
+    def _skip_length(self, subtype: int, stats: list[int], allow_indefinite: bool = False) -> Any:
+        # Decode the length following an initial byte, counting the bytes it took
+        # (including the initial byte itself)
+        length = (
+            self._decode_length(subtype, allow_indefinite=True)
+            if allow_indefinite
+            else self._decode_length(subtype)
+        )
+        stats[0] += 1 + (1 << (subtype - 24) if 24 <= subtype < 28 else 0)
+        return length
+
+    def _skip(self, stats: list[int] | None = None, depth: int = 0) -> bool:
+        # Skip over the next item, checking that it's well-formed but building no
+        # objects; returns True if the "item" was a break marker. The size, number
+        # of items and maximum nesting depth are added to stats, if given
+        if stats is None:
+            stats = [0, 0, 0]
+
+        initial_byte = self.read(1)[0]
+        if initial_byte == 0xFF:
+            stats[0] += 1
+            return True
+
+        stats[1] += 1
+        major_type = initial_byte >> 5
+        subtype = initial_byte & 31
+        if major_type < 2:
+            self._skip_length(subtype, stats)
+        elif major_type < 4:
+            length = self._skip_length(subtype, stats, allow_indefinite=True)
+            if length is None:
+                while (initial_byte := self.read(1)[0]) != 0xFF:
+                    if initial_byte >> 5 != major_type or initial_byte & 31 == 31:
+                        raise CBORDecodeValueError(
+                            "non-bytestring found in indefinite length bytestring"
+                            if major_type == 2
+                            else "non-string found in indefinite length string"
+                        )
+
+                    length = self._skip_length(initial_byte & 31, stats)
+                    self._skip_bytes(length)
+                    stats[0] += length
+
+                stats[0] += 1
+            else:
+                self._skip_bytes(length)
+                stats[0] += length
+        elif major_type < 7:
+            depth += 1
+            stats[2] = max(stats[2], depth)
+            if major_type == 6:
+                self._skip_length(subtype, stats)
+                if self._skip(stats, depth):
+                    raise CBORDecodeValueError("unexpected break marker")
+
+                return False
+
+            # A map has two items (a key and a value) per entry
+            items_per_entry = major_type - 3
+            length = self._skip_length(subtype, stats, allow_indefinite=True)
+            if length is None:
+                count = 0
+                while not self._skip(stats, depth):
+                    count += 1
+
+                if count % items_per_entry:
+                    raise CBORDecodeValueError("unexpected break marker")
+            else:
+                for _ in range(length * items_per_entry):
+                    if self._skip(stats, depth):
+                        raise CBORDecodeValueError("unexpected break marker")
+        elif subtype > 27 and subtype != 31:
+            raise CBORDecodeValueError(
+                f"Undefined Reserved major type 7 subtype 0x{subtype:x}"
+            )
+        else:
+            stats[0] += 1
+            if subtype >= 24:
+                self._skip_bytes(1 << (subtype - 24))
+                stats[0] += 1 << (subtype - 24)
+
+        return False
+
+    def _decode_raw(self, header: bytes = b"") -> CBORRaw:
+        # Skip over the next item, keeping everything read while doing so; header is
+        # the already consumed header of a tag whose content the item is
+        chunks = [header]
+        fp_read = self._fp_read
+
+        def read(amount: int) -> bytes:
+            data = fp_read(amount)
+            chunks.append(data)
+            return data
+
+        self._fp_read = read
+        try:
+            self._skip_value()
+        finally:
+            self._fp_read = fp_read
+
+        return CBORRaw(b"".join(chunks))
+
+    def _skip_value(self) -> list[int]:
+        stats = [0, 0, 0]
+        if self._skip(stats):
+            raise CBORDecodeValueError("unexpected break marker")
+
+        return stats
+
+    def skip(self) -> int:
+        """
+        Skip over the next value in the stream without decoding it.
+
+        The value is still checked for being well-formed, but no objects are built for
+        it, and tags are not interpreted.
+
+        :return: the size of the value in bytes
+        :raises CBORDecodeError: if the value is malformed or truncated
+        """
+        return self._skip_value()[0]
+
+    def decode_raw(self) -> CBORRaw:
+        """
+        Return the next value in the stream without decoding it.
+
+        The value is checked for being well-formed like with :meth:`skip`.
+
+        :return: the encoded value, which the encoder writes out again as it is
+        :raises CBORDecodeError: if the value is malformed or truncated
+        """
+        return self._decode_raw()
+
+    def scan(self) -> tuple[int, int, int]:
+        """
+        Skip over the next value in the stream like :meth:`skip`, collecting statistics
+        about it.
+
+        :return: a tuple of the size of the value in bytes, the number of data items
+            in it (counting the value itself, each array item, map key and map value,
+            and each tag) and the maximum nesting depth of arrays, maps and tags (0
+            for a value that isn't one of those)
+        :raises CBORDecodeError: if the value is malformed or truncated
+        """
+        size, items, depth = self._skip_value()
+        return size, items, depth
+
+    def _decode_lazy(self) -> Any:
+        # Decode the next item, returning arrays and maps as lazy containers
+        # positioned at their first item
+        initial_byte = self.read(1)[0]
+        major_type = initial_byte >> 5
+        if major_type == 4:
+            return LazyArray(self, self._decode_length(initial_byte & 31, allow_indefinite=True))
+        elif major_type == 5:
+            return LazyMap(self, self._decode_length(initial_byte & 31, allow_indefinite=True))
+
+        # Anything else is decoded in full, on its own; shared values and string
+        # references can't be resolved between lazily decoded items
+        self.reset()
+        return self._decode(initial_byte=initial_byte)
+
+    def _extract(
+        self,
+        paths: list[tuple[Any, ...]],
+        wanted: list[int],
+        depth: int,
+        results: list[Any],
+        remaining: list[int],
+    ) -> None:
+        # Walk over the next item, decoding only the parts that the paths numbered in
+        # wanted lead to (from depth on) and skipping the rest. The values found are
+        # stored in results, and remaining[0] is decremented for each path resolved,
+        # whether found or not; once it reaches 0 the walk stops without reading any
+        # further
+        initial_byte = self.read(1)[0]
+        if initial_byte == 0xFF:
+            raise CBORDecodeValueError("unexpected break marker")
+
+        # Anything that isn't an array or map, or that a path ends at, is decoded in
+        # full and the paths followed into the result
+        major_type = initial_byte >> 5
+        if major_type not in (4, 5) or any(len(paths[i]) == depth for i in wanted):
+            self.reset()
+            value = self._decode(initial_byte=initial_byte)
+            for i in wanted:
+                item = value
+                for component in paths[i][depth:]:
+                    if isinstance(item, dict):
+                        try:
+                            item = item.get(component, _missing)
+                        except TypeError:
+                            item = _missing
+                    elif (
+                        isinstance(item, (list, tuple))
+                        and isinstance(component, int)
+                        and 0 <= component < len(item)
+                    ):
+                        item = item[component]
+                    else:
+                        item = _missing
+                        break
+
+                if item is not _missing:
+                    results[i] = item
+
+            remaining[0] -= len(wanted)
+            return
+
+        length = self._decode_length(initial_byte & 31, allow_indefinite=True)
+        children: dict[Any, list[int]] = {}
+        for i in wanted:
+            children.setdefault(paths[i][depth], []).append(i)
+
+        # A map is walked to its end, noting where the value of the last occurrence of
+        # each key the paths lead through is, as that's the one loads() keeps; the
+        # paths are only followed into them afterwards
+        fp = self.fp
+        last: dict[Any, int] = {}
+        index = 0
+        while (length is None or index < length) and remaining[0]:
+            byte = fp.read(1)
+            if byte == b"\xff":
+                if length is None:
+                    break
+
+                raise CBORDecodeValueError("unexpected break marker")
+
+            fp.seek(-len(byte), 1)
+
+            # Map keys are decoded while there's still a path to match them against;
+            # array items are matched by their index
+            group = None
+            if children:
+                if major_type == 5:
+                    self.reset()
+                    key = self._decode_key()
+                else:
+                    key = index
+
+                try:
+                    if major_type == 5:
+                        if key in children:
+                            last[key] = fp.tell()
+                    else:
+                        group = children.pop(key, None)
+                except TypeError:
+                    pass  # an unhashable key can't match any path
+            elif major_type == 5:
+                self._skip_value()
+
+            if group is not None:
+                self._extract(paths, group, depth + 1, results, remaining)
+            else:
+                self._skip_value()
+
+            index += 1
+
+        if last:
+            end = fp.tell()
+            for key, position in last.items():
+                fp.seek(position)
+                self._extract(paths, children.pop(key), depth + 1, results, remaining)
+
+            fp.seek(end)
+
+        # Whatever paths are left weren't found
+        remaining[0] -= sum(len(group) for group in children.values())
+
     def decode(self) -> object:
         """
         Decode the next value from the stream.
 
         :raises CBORDecodeError: if there is any problem decoding the stream
         """
+        if self._record_type is not None:
+            return self._decode_record()
+
         return self._decode()
 
+    def __iter__(self) -> Iterator[Any]:
+        return self
+
+    def __next__(self) -> Any:
+        # Iteration over a CBOR sequence ends cleanly only when the input runs out
+        # between items; running out part way through an item raises CBORDecodeEOF
+        initial_byte = self._fp_read(1)
+        if not initial_byte:
+            raise StopIteration
+
+        # Items of a sequence are independent, so shared values can't be referenced
+        # from later items
+        self.reset()
+        if self._record_type is not None:
+            return self._decode_record(initial_byte[0])
+
+        return self._decode(initial_byte=initial_byte[0])
+
     def decode_from_bytes(self, buf: bytes) -> object:
         """
         Wrap the given bytestring as a file and call :meth:`decode` with it as
@@ -245,6 +1048,11 @@ class CBORDecoder:
         with BytesIO(buf) as fp:
             old_fp = self.fp
             self.fp = fp
+            if self._depth:
+                # buf is part of the input of the value being decoded, so it's
+                # already been counted
+                self._fp_read = fp.read
+
             retval = self._decode()
             self.fp = old_fp
             return retval
@@ -273,14 +1081,45 @@ class CBORDecoder:
 
     def decode_uint(self, subtype: int) -> int:
         # Major tag 0
-        return self.set_shareable(self._decode_length(subtype))
+        value = self._decode_length(subtype)
+        if 256 < value < self._int_cache_size:
+            value = self._int_cache.setdefault(value, value)
+
+        return self.set_shareable(value)
 
     def decode_negint(self, subtype: int) -> int:
         # Major tag 1
-        return self.set_shareable(-self._decode_length(subtype) - 1)
+        length = self._decode_length(subtype)
+        value = -length - 1
+        if 5 <= length < self._int_cache_size:
+            value = self._int_cache.setdefault(value, value)
+
+        return self.set_shareable(value)
+
+    def _read_view(self, amount: int) -> memoryview:
+        # Return the next amount bytes of fp as a read-only view of it instead of a copy
+        # (only the slice returned keeps fp's buffer exported, so fp can be closed once
+        # that's gone)
+        position = self._fp.tell()
+        with memoryview(self._fp) as whole:  # type: ignore[arg-type]
+            size = whole.nbytes
+            if position + amount > size:
+                got = max(size - position, 0)
+                raise CBORDecodeEOF(
+                    f"premature end of stream (expected to read {amount} bytes, got {got} "
+                    "instead)"
+                )
+
+            self._fp.seek(position + amount)
+            if self._stats is not None:
+                self._stats["bytes_read"] += amount
 
-    def decode_bytestring(self, subtype: int) -> bytes:
+            with whole.cast("B") as view, view.toreadonly() as readonly:
+                return readonly[position : position + amount]
+
+    def decode_bytestring(self, subtype: int) -> bytes | memoryview:
         # Major tag 2
+        result: bytes | memoryview
         length = self._decode_length(subtype, allow_indefinite=True)
         if length is None:
             # Indefinite length
@@ -296,6 +1135,9 @@ class CBORDecoder:
                         raise CBORDecodeValueError(
                             f"invalid length for indefinite bytestring chunk 0x{length:x}"
                         )
+                    if self._limited:
+                        self._charge_allocation(length)
+
                     value = self.read(length)
                     buf.append(value)
                 else:
@@ -305,18 +1147,30 @@ class CBORDecoder:
         else:
             if length > sys.maxsize:
                 raise CBORDecodeValueError(f"invalid length for bytestring 0x{length:x}")
-            elif length <= 65536:
-                result = self.read(length)
+            elif (
+                self._fp_buffer
+                and self._memoryview_size is not None
+                and length >= self._memoryview_size
+                and not self._immutable
+            ):
+                # views aren't hashable, so map keys are still copied
+                result = self._read_view(length)
             else:
-                # Read large bytestrings 65536 (2 ** 16) bytes at a time
-                left = length
-                buffer = bytearray()
-                while left:
-                    chunk_size = min(left, 65536)
-                    buffer.extend(self.read(chunk_size))
-                    left -= chunk_size
+                if self._limited:
+                    self._charge_allocation(length)
 
-                result = bytes(buffer)
+                if length <= 65536:
+                    result = self.read(length)
+                else:
+                    # Read large bytestrings 65536 (2 ** 16) bytes at a time
+                    left = length
+                    buffer = bytearray()
+                    while left:
+                        chunk_size = min(left, 65536)
+                        buffer.extend(self.read(chunk_size))
+                        left -= chunk_size
+
+                    result = bytes(buffer)
 
             self._stringref_namespace_add(result, length)
 
@@ -352,6 +1206,8 @@ class CBORDecoder:
                         raise CBORDecodeValueError(
                             f"invalid length for indefinite string chunk 0x{length:x}"
                         )
+                    if self._limited:
+                        self._charge_allocation(length)
 
                     try:
                         value = self.read(length).decode("utf-8", self._str_errors)
@@ -364,6 +1220,8 @@ class CBORDecoder:
         else:
             if length > sys.maxsize:
                 raise CBORDecodeValueError(f"invalid length for string 0x{length:x}")
+            elif self._limited:
+                self._charge_allocation(length)
 
             if length <= 65536:
                 try:
@@ -398,21 +1256,26 @@ class CBORDecoder:
             if not self._immutable:
                 self.set_shareable(items)
             while True:
-                value = self._decode()
+                value = self._decode(unshared=True)
                 if value is break_marker:
                     break
                 else:
+                    if self._limited:
+                        self._check_indefinite(len(items) + 1, False)
+
                     items.append(value)
         else:
             if length > sys.maxsize:
                 raise CBORDecodeValueError(f"invalid length for array 0x{length:x}")
+            elif self._limited:
+                self._check_container(length, False)
 
             items = []
             if not self._immutable:
                 self.set_shareable(items)
 
             for index in range(length):
-                items.append(self._decode())
+                items.append(self._decode(unshared=True))
 
         if self._immutable:
             items_tuple = tuple(items)
@@ -421,6 +1284,14 @@ class CBORDecoder:
 
         return items
 
+    def _decode_map_value(self, key: Any) -> Any:
+        # Decode the value of a map entry, leaving it encoded if the key is one of
+        # raw_keys
+        if self._raw_keys is not None and key in self._raw_keys:
+            return self._decode_raw()
+
+        return self._decode(unshared=True)
+
     def decode_map(self, subtype: int) -> Mapping[Any, Any]:
         # Major tag 5
         length = self._decode_length(subtype, allow_indefinite=True)
@@ -429,19 +1300,28 @@ class CBORDecoder:
             dictionary: dict[Any, Any] = {}
             self.set_shareable(dictionary)
             while True:
-                key = self._decode(immutable=True, unshared=True)
+                key = self._decode_key()
                 if key is break_marker:
                     break
                 else:
-                    dictionary[key] = self._decode(unshared=True)
+                    if self._limited:
+                        self._check_indefinite(len(dictionary) + 1, True)
+
+                    dictionary[key] = self._decode_map_value(key)
         else:
+            if self._limited:
+                self._check_container(length, True)
+
             dictionary = {}
             self.set_shareable(dictionary)
             for _ in range(length):
-                key = self._decode(immutable=True, unshared=True)
-                dictionary[key] = self._decode(unshared=True)
+                key = self._decode_key()
+                dictionary[key] = self._decode_map_value(key)
 
         if self._object_hook:
+            if self._stats is not None:
+                self._stats["object_hook_calls"] += 1
+
             dictionary = self._object_hook(self, dictionary)
             self.set_shareable(dictionary)
         elif self._immutable:
@@ -454,13 +1334,32 @@ class CBORDecoder:
     def decode_semantic(self, subtype: int) -> Any:
         # Major tag 6
         tagnum = self._decode_length(subtype)
-        if semantic_decoder := semantic_decoders.get(tagnum):
+        if self._raw_tags is not None and tagnum in self._raw_tags:
+            # Rebuild the tag's header, which has been consumed already
+            header = bytes([0xC0 | subtype])
+            if subtype >= 24:
+                header += tagnum.to_bytes(1 << (subtype - 24), "big")
+
+            return self._decode_raw(header)
+        elif semantic_decoder := semantic_decoders.get(tagnum):
+            if tagnum in bytes_tags and self._memoryview_size is not None:
+                memoryview_size, self._memoryview_size = self._memoryview_size, None
+                try:
+                    return semantic_decoder(self)
+                finally:
+                    self._memoryview_size = memoryview_size
+
             return semantic_decoder(self)
+        elif tagnum in typed_array_tags:
+            return self.decode_typed_array(tagnum)
 
         tag = CBORTag(tagnum, None)
         self.set_shareable(tag)
         tag.value = self._decode(unshared=True)
         if self._tag_hook:
+            if self._stats is not None:
+                self._stats["tag_hook_calls"] += 1
+
             tag = self._tag_hook(self, tag)
 
         return self.set_shareable(tag)
@@ -715,6 +1614,46 @@ class CBORDecoder:
 
         raise CBORDecodeValueError(f"invalid ipnetwork value {net_map!r}")
 
+    def decode_typed_array(self, tagnum: int) -> array[Any] | tuple[Any, ...]:
+        # Semantic tags 64-87
+        from array import array
+
+        if tagnum & 16:
+            size = 2 << (tagnum & 3)
+            typecode = "d" if size == 8 else "f"
+        else:
+            size = 1 << (tagnum & 3)
+            typecode = ("bhiq" if tagnum & 8 else "BHIQ")[tagnum & 3]
+
+        initial_byte = self.read(1)[0]
+        if initial_byte >> 5 != 2:
+            raise CBORDecodeValueError(
+                f"invalid typed array value (expected a byte string, found major type "
+                f"{initial_byte >> 5})"
+            )
+
+        buf = self.decode_bytestring(initial_byte & 31)
+        if len(buf) % size:
+            raise CBORDecodeValueError(
+                f"invalid typed array length {len(buf)} for {size} byte elements"
+            )
+
+        little = bool(tagnum & 4)
+        if size == 2 and typecode == "f":
+            # The array module has no half-precision type
+            values = array("f", struct.unpack(f"{'<' if little else '>'}{len(buf) // 2}e", buf))
+        else:
+            values = array(typecode, buf)
+            if size > 1 and little != (sys.byteorder == "little"):
+                values.byteswap()
+
+        # Arrays aren't hashable, so immutable ones (map keys, for instance) are
+        # returned as tuples
+        if self._immutable:
+            return self.set_shareable(tuple(values))
+
+        return self.set_shareable(values)
+
     def decode_self_describe_cbor(self) -> Any:
         # Semantic tag 55799
         return self._decode()
@@ -737,6 +1676,303 @@ class CBORDecoder:
         return self.set_shareable(cast(float, struct.unpack(">d", self.read(8))[0]))
 
 
+class _LazyContainer:
+    # The lazy arrays and maps returned by loads_lazy() share a decoder reading the
+    # whole document. An item is located by skipping over the ones before it, and
+    # decoded the first time it's accessed; offsets and values are both kept so that
+    # each item is only skipped and decoded once
+    __slots__ = ("_decoder", "_length", "_next", "_offsets", "_values")
+
+    _index: dict[Any, int] | None = None
+
+    def __init__(self, decoder: CBORDecoder, length: int | None):
+        self._decoder = decoder
+        self._length = length
+        self._next = decoder.fp.tell()
+        self._offsets: list[int] = []
+        self._values: dict[int, Any] = {}
+
+    def _locate(self, n: int) -> None:
+        # Locate items until more than n of them are known, or all of them are
+        fp = self._decoder.fp
+        old_position = fp.tell()
+        fp.seek(self._next)
+        try:
+            while len(self._offsets) <= n and len(self._offsets) != self._length:
+                if self._length is None:
+                    if fp.read(1) == b"\xff":
+                        self._length = len(self._offsets)
+                        break
+
+                    fp.seek(-1, 1)
+
+                # Map keys are always decoded; they're needed to find the values
+                if self._index is not None:
+                    self._decoder.reset()
+                    key = self._decoder._decode_key()
+
+                offset = fp.tell()
+                if self._decoder._skip():
+                    raise CBORDecodeValueError("unexpected break marker")
+
+                # A repeated key refers to its last value, as it does in loads()
+                if self._index is not None:
+                    self._index[key] = len(self._offsets)
+
+                self._offsets.append(offset)
+                self._next = fp.tell()
+        finally:
+            fp.seek(old_position)
+
+    def _value(self, i: int) -> Any:
+        try:
+            return self._values[i]
+        except KeyError:
+            pass
+
+        fp = self._decoder.fp
+        old_position = fp.tell()
+        fp.seek(self._offsets[i])
+        try:
+            value = self._decoder._decode_lazy()
+        finally:
+            fp.seek(old_position)
+
+        return self._values.setdefault(i, value)
+
+
+class LazyArray(_LazyContainer, Sequence[Any]):
+    """
+    A CBOR array returned by :func:`loads_lazy`.
+
+    Supports ``len()``, indexing and iteration. Items are only located and decoded when
+    they're first accessed, arrays and maps among them becoming :class:`LazyArray` and
+    :class:`LazyMap` objects in turn.
+    """
+
+    __slots__ = ()
+
+    def __len__(self) -> int:
+        if self._length is None:
+            self._locate(sys.maxsize)
+
+        return cast(int, self._length)
+
+    def __getitem__(self, index: int) -> Any:  # type: ignore[override]
+        if index < 0:
+            index += len(self)
+
+        if index >= len(self._offsets):
+            self._locate(index)
+
+        if not 0 <= index < len(self._offsets):
+            raise IndexError("LazyArray index out of range")
+
+        return self._value(index)
+
+
+class LazyMap(_LazyContainer, Mapping[Any, Any]):
+    """
+    A CBOR map returned by :func:`loads_lazy`.
+
+    Supports ``len()``, lookup by key, ``in`` and iteration over the keys, as well as
+    :meth:`get`, :meth:`keys`, :meth:`values` and :meth:`items`. All the keys are
+    decoded the first time the map is used, but values are only decoded when they're
+    first accessed, arrays and maps among them becoming :class:`LazyArray` and
+    :class:`LazyMap` objects in turn.
+    """
+
+    __slots__ = ("_index",)
+
+    def __init__(self, decoder: CBORDecoder, length: int | None):
+        super().__init__(decoder, length)
+        self._index = {}
+
+    def __len__(self) -> int:
+        self._locate(sys.maxsize)
+        return len(cast(dict, self._index))
+
+    def _find(self, key: Any) -> int | None:
+        # All the entries are located first, since a later occurrence of key would
+        # replace an earlier one
+        self._locate(sys.maxsize)
+        return cast(dict, self._index).get(key)
+
+    def __getitem__(self, key: Any) -> Any:
+        entry = self._find(key)
+        if entry is None:
+            raise KeyError(key)
+
+        return self._value(entry)
+
+    def __contains__(self, key: object) -> bool:
+        return self._find(key) is not None
+
+    def __iter__(self) -> Iterator[Any]:
+        self._locate(sys.maxsize)
+        return iter(cast(dict, self._index))
+
+
+class IncrementalDecoder:
+    """
+    Decodes a CBOR sequence (:rfc:`8742`) that arrives piece by piece, as from a
+    non-blocking socket or an asyncio protocol.
+
+    Each call to :meth:`feed` returns the values completed by the data passed to it.
+    The data of a value that isn't complete yet is kept until the rest of it arrives,
+    with only the lengths and nesting of its items tracked in the meantime, so each
+    value is decoded once, however many pieces it arrives in. As in
+    :func:`loads_sequence`, the values can't refer to each other's shared values.
+
+    The arguments have the same meaning as for :class:`CBORDecoder`.
+    """
+
+    __slots__ = ("_decoder", "_buffer", "_scanned", "_frames")
+
+    def __init__(
+        self,
+        tag_hook: Callable[[CBORDecoder, CBORTag], Any] | None = None,
+        object_hook: Callable[[CBORDecoder, dict[Any, Any]], Any] | None = None,
+        str_errors: Literal["strict", "error", "replace"] = "strict",
+        record_type: type | None = None,
+    ):
+        self._decoder = CBORDecoder(
+            BytesIO(),
+            tag_hook=tag_hook,
+            object_hook=object_hook,
+            str_errors=str_errors,
+            record_type=record_type,
+        )
+        self._buffer = bytearray()
+        self._scanned = 0  # how much of the buffer has been scanned
+        # The major type of each array, map, tag or string still open, whether it
+        # has an indefinite length, and the number of items it has left (or has had
+        # so far, if indefinite)
+        self._frames: list[list[Any]] = []
+
+    @property
+    def pending(self) -> int:
+        """The number of bytes fed so far that belong to a value not yet complete."""
+        return len(self._buffer)
+
+    def feed(self, data: bytes) -> list[Any]:
+        """
+        Add the given data to the end of the input.
+
+        If the input turns out to be malformed, or a value can't be decoded, the
+        exception is raised and all the data fed so far is discarded (including any
+        values completed by this call).
+
+        :param data:
+            the next piece of the input (any object supporting the buffer protocol)
+        :return: the values completed by ``data``, in order
+
+        """
+        buffer = self._buffer
+        buffer += data
+        values: list[Any] = []
+        start = 0
+        try:
+            while (end := self._scan()) is not None:
+                self._decoder.reset(BytesIO(buffer[start:end]))
+                values.append(next(self._decoder))
+                start = end
+        except BaseException:
+            self._frames.clear()
+            del buffer[:]
+            self._scanned = 0
+            raise
+
+        del buffer[:start]
+        self._scanned -= start
+        return values
+
+    def _scan(self) -> int | None:
+        # Follow the items in the buffer past those already scanned, without decoding
+        # them, and return the offset just past the next complete value; or None if
+        # the data runs out first
+        buffer = self._buffer
+        frames = self._frames
+        pos = self._scanned
+        while pos < len(buffer):
+            initial_byte = buffer[pos]
+            major_type = initial_byte >> 5
+            subtype = initial_byte & 31
+            if initial_byte == 0xFF:
+                frame = frames[-1] if frames else None
+                # A break marker may only end an indefinite length array, map or
+                # string, and not in the middle of a map entry
+                if not frame or not frame[1] or (frame[0] == 5 and frame[2] & 1):
+                    raise CBORDecodeValueError("unexpected break marker")
+
+                self._scanned = pos = pos + 1
+                frames.pop()
+                if self._complete():
+                    return pos
+
+                continue
+            elif frames and frames[-1][0] in (2, 3) and frames[-1][1]:
+                if major_type != frames[-1][0] or subtype == 31:
+                    raise CBORDecodeValueError(
+                        "non-bytestring found in indefinite length bytestring"
+                        if frames[-1][0] == 2
+                        else "non-string found in indefinite length string"
+                    )
+
+            size = 1
+            length: int | None = subtype
+            if 24 <= subtype < 28:
+                size += 1 << (subtype - 24)
+                if pos + size > len(buffer):
+                    return None
+
+                length = int.from_bytes(buffer[pos + 1 : pos + size], "big")
+            elif subtype == 31 and major_type in (2, 3, 4, 5):
+                length = None
+            elif subtype >= 28 and major_type == 7:
+                raise CBORDecodeValueError(
+                    f"Undefined Reserved major type 7 subtype 0x{subtype:x}"
+                )
+            elif subtype >= 28:
+                raise CBORDecodeValueError(f"unknown unsigned integer subtype 0x{subtype:x}")
+
+            if major_type in (2, 3) and length is not None:
+                if pos + size + length > len(buffer):
+                    return None
+
+                size += length
+
+            self._scanned = pos = pos + size
+            if major_type in (2, 3, 4, 5) and length is None:
+                frames.append([major_type, True, 0])
+            elif major_type == 6:
+                frames.append([major_type, False, 1])
+            elif major_type in (4, 5) and length:
+                frames.append([major_type, False, length * 2 if major_type == 5 else length])
+            elif self._complete():
+                return pos
+
+        return None
+
+    def _complete(self) -> bool:
+        # Count an item as finished in the innermost open container, closing those it
+        # completes; returns True if it completed a value at the top level
+        frames = self._frames
+        while frames:
+            frame = frames[-1]
+            if frame[1]:
+                frame[2] += 1
+                return False
+
+            frame[2] -= 1
+            if frame[2]:
+                return False
+
+            frames.pop()
+
+        return True
+
+
 major_decoders: dict[int, Callable[[CBORDecoder, int], Any]] = {
     0: CBORDecoder.decode_uint,
     1: CBORDecoder.decode_negint,
@@ -783,12 +2019,25 @@ semantic_decoders: dict[int, Callable[[CBORDecoder], Any]] = {
     55799: CBORDecoder.decode_self_describe_cbor,
 }
 
+#: the :rfc:`8746` typed array tags decoded to :class:`array.array`; the rest are the
+#: reserved tag 76 and the 128-bit float ones, which the array module has no type for
+typed_array_tags = frozenset(range(64, 87)) - {76, 83}
+
+#: the tags (bignums, UUIDs and IP addresses) whose bytestrings are always decoded as
+#: :class:`bytes`, even if ``memoryview_size`` would otherwise make them views
+bytes_tags = frozenset({2, 3, 37, 260})
+
 
 def loads(
     s: bytes | bytearray | memoryview,
     tag_hook: Callable[[CBORDecoder, CBORTag], Any] | None = None,
     object_hook: Callable[[CBORDecoder, dict[Any, Any]], Any] | None = None,
     str_errors: Literal["strict", "error", "replace"] = "strict",
+    record_type: type | None = None,
+    int_cache_size: int = 0,
+    max_items: int | None = None,
+    max_length: int | None = None,
+    max_allocation: int | None = None,
 ) -> Any:
     """
     Deserialize an object from a bytestring.
@@ -807,6 +2056,19 @@ def loads(
     :param str_errors:
         determines how to handle unicode decoding errors (see the `Error Handlers`_
         section in the standard library documentation for details)
+    :param record_type:
+        a dataclass or named tuple class to decode the value into (see
+        :class:`CBORDecoder`)
+    :param int_cache_size:
+        the range of integers to cache (see :class:`CBORDecoder`); the cache is off
+        by default, since only one value is decoded
+    :param max_items:
+        the most data items the value may contain (see :class:`CBORDecoder`)
+    :param max_length:
+        the most items any array, or entries any map, may have (see
+        :class:`CBORDecoder`)
+    :param max_allocation:
+        the most bytes that may be allocated for the value (see :class:`CBORDecoder`)
     :return:
         the deserialized object
 
@@ -815,7 +2077,15 @@ def loads(
     """
     with BytesIO(s) as fp:
         return CBORDecoder(
-            fp, tag_hook=tag_hook, object_hook=object_hook, str_errors=str_errors
+            fp,
+            tag_hook=tag_hook,
+            object_hook=object_hook,
+            str_errors=str_errors,
+            record_type=record_type,
+            int_cache_size=int_cache_size,
+            max_items=max_items,
+            max_length=max_length,
+            max_allocation=max_allocation,
         ).decode()
 
 
@@ -824,6 +2094,17 @@ def load(
     tag_hook: Callable[[CBORDecoder, CBORTag], Any] | None = None,
     object_hook: Callable[[CBORDecoder, dict[Any, Any]], Any] | None = None,
     str_errors: Literal["strict", "error", "replace"] = "strict",
+    read_size: int | None = None,
+    record_type: type | None = None,
+    cache_keys: bool = True,
+    int_cache_size: int = 0,
+    raw_tags: Collection[int] | None = None,
+    raw_keys: Collection[Any] | None = None,
+    memoryview_size: int | None = None,
+    max_items: int | None = None,
+    max_length: int | None = None,
+    max_allocation: int | None = None,
+    collect_stats: bool = False,
 ) -> Any:
     """
     Deserialize an object from an open file.
@@ -842,6 +2123,38 @@ def load(
     :param str_errors:
         determines how to handle unicode decoding errors (see the `Error Handlers`_
         section in the standard library documentation for details)
+    :param read_size:
+        the minimum number of bytes to read from ``fp`` at a time (see
+        :class:`CBORDecoder`); if ``fp`` is seekable it's left positioned just after the
+        decoded value
+    :param record_type:
+        a dataclass or named tuple class to decode the value into (see
+        :class:`CBORDecoder`)
+    :param cache_keys:
+        whether to cache short string map keys (see :class:`CBORDecoder`)
+    :param int_cache_size:
+        the range of integers to cache (see :class:`CBORDecoder`); the cache is off
+        by default, since only one value is decoded
+    :param raw_tags:
+        a collection of tag numbers to return as :class:`.CBORRaw` objects (see
+        :class:`CBORDecoder`)
+    :param raw_keys:
+        a collection of map keys whose values to return as :class:`.CBORRaw` objects
+        (see :class:`CBORDecoder`)
+    :param memoryview_size:
+        if ``fp`` supports the buffer protocol (such as an :class:`mmap.mmap`),
+        bytestrings at least this long are returned as :class:`memoryview` slices of it
+        instead of copies (see :class:`CBORDecoder`)
+    :param max_items:
+        the most data items the value may contain (see :class:`CBORDecoder`)
+    :param max_length:
+        the most items any array, or entries any map, may have (see
+        :class:`CBORDecoder`)
+    :param max_allocation:
+        the most bytes that may be allocated for the value (see :class:`CBORDecoder`)
+    :param collect_stats:
+        whether the decoder keeps counters of what it has done (see
+        :class:`CBORDecoder`)
     :return:
         the deserialized object
 
@@ -849,5 +2162,340 @@ def load(
 
     """
     return CBORDecoder(
-        fp, tag_hook=tag_hook, object_hook=object_hook, str_errors=str_errors
+        fp,
+        tag_hook=tag_hook,
+        object_hook=object_hook,
+        str_errors=str_errors,
+        read_size=read_size,
+        record_type=record_type,
+        cache_keys=cache_keys,
+        int_cache_size=int_cache_size,
+        raw_tags=raw_tags,
+        raw_keys=raw_keys,
+        memoryview_size=memoryview_size,
+        max_items=max_items,
+        max_length=max_length,
+        max_allocation=max_allocation,
+        collect_stats=collect_stats,
     ).decode()
+
+
+def loads_sequence(
+    s: bytes | bytearray | memoryview,
+    tag_hook: Callable[[CBORDecoder, CBORTag], Any] | None = None,
+    object_hook: Callable[[CBORDecoder, dict[Any, Any]], Any] | None = None,
+    str_errors: Literal["strict", "error", "replace"] = "strict",
+    record_type: type | None = None,
+) -> Iterator[Any]:
+    """
+    Iterate over the values of a CBOR sequence (:rfc:`8742`) in a bytestring.
+
+    The iterator stops when the bytestring has been consumed. If it ends part way
+    through a value, :exc:`CBORDecodeEOF` is raised instead.
+
+    :param bytes s:
+        the bytestring to deserialize
+    :param tag_hook:
+        callable that takes 2 arguments: the decoder instance, and the :class:`.CBORTag`
+        to be decoded. This callback is invoked for any tags for which there is no
+        built-in decoder. The return value is substituted for the :class:`.CBORTag`
+        object in the deserialized output
+    :param object_hook:
+        callable that takes 2 arguments: the decoder instance, and a dictionary. This
+        callback is invoked for each deserialized :class:`dict` object. The return value
+        is substituted for the dict in the deserialized output.
+    :param str_errors:
+        determines how to handle unicode decoding errors (see the `Error Handlers`_
+        section in the standard library documentation for details)
+    :param record_type:
+        a dataclass or named tuple class to decode each value into (see
+        :class:`CBORDecoder`)
+    :return:
+        an iterator over the deserialized objects
+
+    .. _Error Handlers: https://docs.python.org/3/library/codecs.html#error-handlers
+
+    """
+    return CBORDecoder(
+        BytesIO(s),
+        tag_hook=tag_hook,
+        object_hook=object_hook,
+        str_errors=str_errors,
+        record_type=record_type,
+    )
+
+
+def load_sequence(
+    fp: IO[bytes],
+    tag_hook: Callable[[CBORDecoder, CBORTag], Any] | None = None,
+    object_hook: Callable[[CBORDecoder, dict[Any, Any]], Any] | None = None,
+    str_errors: Literal["strict", "error", "replace"] = "strict",
+    read_size: int | None = None,
+    record_type: type | None = None,
+) -> Iterator[Any]:
+    """
+    Iterate over the values of a CBOR sequence (:rfc:`8742`) read from an open file.
+
+    The iterator stops when the end of the file is reached. If it ends part way
+    through a value, :exc:`CBORDecodeEOF` is raised instead.
+
+    :param fp:
+        the file to read from (any file-like object opened for reading in binary mode)
+    :param tag_hook:
+        callable that takes 2 arguments: the decoder instance, and the :class:`.CBORTag`
+        to be decoded. This callback is invoked for any tags for which there is no
+        built-in decoder. The return value is substituted for the :class:`.CBORTag`
+        object in the deserialized output
+    :param object_hook:
+        callable that takes 2 arguments: the decoder instance, and a dictionary. This
+        callback is invoked for each deserialized :class:`dict` object. The return value
+        is substituted for the dict in the deserialized output.
+    :param str_errors:
+        determines how to handle unicode decoding errors (see the `Error Handlers`_
+        section in the standard library documentation for details)
+    :param read_size:
+        the minimum number of bytes to read from ``fp`` at a time (see
+        :class:`CBORDecoder`)
+    :param record_type:
+        a dataclass or named tuple class to decode each value into (see
+        :class:`CBORDecoder`)
+    :return:
+        an iterator over the deserialized objects
+
+    .. _Error Handlers: https://docs.python.org/3/library/codecs.html#error-handlers
+
+    """
+    return CBORDecoder(
+        fp,
+        tag_hook=tag_hook,
+        object_hook=object_hook,
+        str_errors=str_errors,
+        read_size=read_size,
+        record_type=record_type,
+    )
+
+
+def loads_sequence_parallel(
+    s: bytes | bytearray | memoryview,
+    tag_hook: Callable[[CBORDecoder, CBORTag], Any] | None = None,
+    object_hook: Callable[[CBORDecoder, dict[Any, Any]], Any] | None = None,
+    str_errors: Literal["strict", "error", "replace"] = "strict",
+    record_type: type | None = None,
+    *,
+    workers: int | None = None,
+) -> list[Any]:
+    """
+    Decode all the values of a CBOR sequence (:rfc:`8742`) in a bytestring, using
+    several threads.
+
+    The values are first located by skipping over them one after another, then split
+    into up to ``workers`` runs of about equal size (but no smaller than 64 KiB), which
+    are decoded at the same time on threads of their own. On a free-threaded build of
+    Python, that spreads most of the work over as many cores. With the GIL, the threads
+    take turns, so this is no faster than :func:`loads_sequence` (and the extra pass
+    over ``s`` makes it somewhat slower). Input too short to split, or ``workers=1``, is
+    decoded directly as :func:`loads_sequence` would. The values are independent, as in
+    :func:`loads_sequence`, so they can't refer to each other's shared values.
+
+    The hooks are called from whichever thread decodes the value concerned, so they
+    must be safe to call from several threads at once.
+
+    :param bytes s:
+        the bytestring to deserialize
+    :param tag_hook:
+        callable that takes 2 arguments: the decoder instance, and the :class:`.CBORTag`
+        to be decoded (see :func:`loads_sequence`)
+    :param object_hook:
+        callable that takes 2 arguments: the decoder instance, and a dictionary (see
+        :func:`loads_sequence`)
+    :param str_errors:
+        determines how to handle unicode decoding errors (see the `Error Handlers`_
+        section in the standard library documentation for details)
+    :param record_type:
+        a dataclass or named tuple class to decode each value into (see
+        :class:`CBORDecoder`)
+    :param workers:
+        the most threads to decode with, including the calling one (defaults to
+        :func:`os.cpu_count`)
+    :return:
+        a list of the deserialized objects, in order
+    :raises CBORDecodeError:
+        if a value can't be decoded, the same error as ``list(loads_sequence(s))``
+        would raise
+
+    .. _Error Handlers: https://docs.python.org/3/library/codecs.html#error-handlers
+
+    """
+    from concurrent.futures import ThreadPoolExecutor
+
+    if workers is None:
+        workers = os.cpu_count() or 1
+    elif workers < 1:
+        raise ValueError(f"invalid workers value {workers!r} (must be a positive int or None)")
+
+    view = memoryview(s).cast("B")
+    size = len(view)
+    count = max(1, min(workers, size // PARALLEL_CHUNK_SIZE))
+    if count == 1:
+        # A single run needn't be located first
+        return list(
+            loads_sequence(
+                view,
+                tag_hook=tag_hook,
+                object_hook=object_hook,
+                str_errors=str_errors,
+                record_type=record_type,
+            )
+        )
+
+    # Start a new run at the first value past each share of the input. If a value is
+    # malformed, the values before it are decoded all the same in case one of them
+    # raises an error first. A stray break marker is decoded as the break_marker
+    # value, as in loads_sequence()
+    scanner = CBORDecoder(BytesIO(view))
+    starts = [0]
+    scan_error: Exception | None = None
+    position = 0
+    while position < size:
+        if len(starts) < count and position >= size // count * len(starts):
+            starts.append(position)
+
+        if view[position] == 0xFF:
+            position += 1
+            scanner.fp.seek(position)
+            continue
+
+        try:
+            position += scanner.skip()
+        except Exception as exc:
+            scan_error = exc
+            break
+
+    ends = starts[1:] + [position]
+
+    def decode_run(start: int, end: int) -> list[Any]:
+        return list(
+            loads_sequence(
+                view[start:end],
+                tag_hook=tag_hook,
+                object_hook=object_hook,
+                str_errors=str_errors,
+                record_type=record_type,
+            )
+        )
+
+    if len(starts) == 1:
+        runs = [decode_run(0, position)]
+    else:
+        # The first run is decoded on this thread meanwhile; an error in it still
+        # waits for the others to finish on leaving the with block
+        with ThreadPoolExecutor(len(starts) - 1) as executor:
+            futures = [executor.submit(decode_run, *run) for run in zip(starts[1:], ends[1:])]
+            runs = [decode_run(starts[0], ends[0])]
+            runs += [future.result() for future in futures]
+
+    if scan_error is not None:
+        raise scan_error
+
+    return [value for run in runs for value in run]
+
+
+def loads_lazy(
+    s: bytes | bytearray | memoryview,
+    tag_hook: Callable[[CBORDecoder, CBORTag], Any] | None = None,
+    str_errors: Literal["strict", "error", "replace"] = "strict",
+) -> Any:
+    """
+    Deserialize an object from a bytestring, deferring the decoding of arrays and maps.
+
+    Arrays and maps are returned as :class:`LazyArray` and :class:`LazyMap` objects,
+    which only decode an item when it's first accessed, skipping over the encoded
+    items before it without building any objects. Reading a few fields out of a large
+    document then costs little more than the size of those fields. Any other value is
+    decoded in full, as by :func:`loads`.
+
+    Decoding errors in an item are only raised when that item is accessed. Shared
+    values and string references can't be resolved between items decoded separately
+    this way, so documents relying on them should be decoded with :func:`loads`.
+
+    :param bytes s:
+        the bytestring to deserialize; it must not be modified while any of the lazy
+        containers returned for it are in use
+    :param tag_hook:
+        callable that takes 2 arguments: the decoder instance, and the :class:`.CBORTag`
+        to be decoded. This callback is invoked for any tags for which there is no
+        built-in decoder. The return value is substituted for the :class:`.CBORTag`
+        object in the deserialized output
+    :param str_errors:
+        determines how to handle unicode decoding errors (see the `Error Handlers`_
+        section in the standard library documentation for details)
+    :return:
+        the deserialized object
+
+    .. _Error Handlers: https://docs.python.org/3/library/codecs.html#error-handlers
+
+    """
+    return CBORDecoder(BytesIO(s), tag_hook=tag_hook, str_errors=str_errors)._decode_lazy()
+
+
+def extract(
+    s: bytes | bytearray | memoryview,
+    paths: Sequence[Sequence[Any]],
+    *,
+    default: Any = None,
+    tag_hook: Callable[[CBORDecoder, CBORTag], Any] | None = None,
+    str_errors: Literal["strict", "error", "replace"] = "strict",
+) -> list[Any]:
+    """
+    Decode only the values at the given paths in a bytestring.
+
+    Each path is a tuple (or list) of map keys and array indexes leading from the top
+    level value down to the one wanted; ``("user", "id")`` finds ``value["user"]["id"]``
+    and ``()`` the whole value. The document is walked through, and everything not on
+    the way to one of the paths is skipped over without building any objects. The walk
+    stops as soon as all the paths have been resolved, so whatever follows them isn't
+    checked.
+
+    Only arrays and maps are walked into; if a path leads through any other value (a
+    tagged map, for instance), that value is decoded in full and the rest of the path
+    followed into the result through any dicts, lists and tuples in it. Maps that paths
+    lead through are walked to their end, and if one has the same key more than once,
+    the last occurrence is used, as with :func:`loads`. Shared values and
+    string references can't be resolved between values decoded separately this way,
+    so documents relying on them should be decoded with :func:`loads`.
+
+    :param bytes s:
+        the bytestring to decode from
+    :param paths:
+        a sequence of paths, each a tuple or list of map keys and non-negative array
+        indexes
+    :param default:
+        the value returned for a path that doesn't lead to anything
+    :param tag_hook:
+        callable that takes 2 arguments: the decoder instance, and the :class:`.CBORTag`
+        to be decoded. This callback is invoked for any tags for which there is no
+        built-in decoder. The return value is substituted for the :class:`.CBORTag`
+        object in the deserialized output
+    :param str_errors:
+        determines how to handle unicode decoding errors (see the `Error Handlers`_
+        section in the standard library documentation for details)
+    :return:
+        a list of the values found, in the same order as ``paths``
+
+    .. _Error Handlers: https://docs.python.org/3/library/codecs.html#error-handlers
+
+    """
+    checked: list[tuple[Any, ...]] = []
+    for path in paths:
+        if not isinstance(path, (tuple, list)):
+            raise TypeError(f"invalid path {path!r} (must be a tuple or list)")
+
+        checked.append(tuple(path))
+
+    results = [default] * len(checked)
+    remaining = [len(checked)]
+    if checked:
+        decoder = CBORDecoder(BytesIO(s), tag_hook=tag_hook, str_errors=str_errors)
+        decoder._extract(checked, list(range(len(checked))), 0, results, remaining)
+
+    return results
@@ -5,17 +5,22 @@ import re
 import struct
 import sys
 from collections import OrderedDict, defaultdict
-from collections.abc import Callable, Generator, Mapping, Sequence, Set
+from collections.abc import Callable, Generator, Iterable, Mapping, Sequence, Set
 from contextlib import contextmanager
+from dataclasses import fields, is_dataclass
 from datetime import date, datetime, time, tzinfo
+from enum import Enum
 from functools import wraps
 from io import BytesIO
+from operator import itemgetter
 from sys import modules
-from typing import IO, TYPE_CHECKING, Any, cast
+from types import GeneratorType
+from typing import IO, TYPE_CHECKING, Any, Literal, cast
 
 from ._types import (
     CBOREncodeTypeError,
     CBOREncodeValueError,
+    CBORRaw,
     CBORSimpleValue,
     CBORTag,
     FrozenDict,
@@ -24,6 +29,7 @@ from ._types import (
 )
 
 if TYPE_CHECKING:
+    from array import array
     from decimal import Decimal
     from email.message import Message
     from fractions import Fraction
@@ -106,6 +112,11 @@ class CBOREncoder:
     When the class is constructed manually, the main entry points are
     :meth:`encode` and :meth:`encode_to_bytes`.
 
+    An encoder may be reused for any number of values. Containers and strings
+    encoded earlier remain available for value sharing and string referencing
+    until :meth:`reset` is called, which also allows switching to a new *fp*
+    without constructing a new encoder.
+
     .. _CBOR: https://cbor.io/
     """
 
@@ -123,6 +134,13 @@ class CBOREncoder:
         "string_referencing",
         "string_namespacing",
         "_string_references",
+        "_record_format",
+        "_record_fields",
+        "_indefinite_items",
+        "_indefinite_string_referencing",
+        "_indefinite_namespace",
+        "_stats",
+        "_value_depth",
     )
 
     _fp: IO[bytes]
@@ -138,6 +156,8 @@ class CBOREncoder:
         canonical: bool = False,
         date_as_datetime: bool = False,
         string_referencing: bool = False,
+        record_format: Literal["map", "array"] | None = None,
+        collect_stats: bool = False,
     ):
         """
         :param fp:
@@ -168,8 +188,25 @@ class CBOREncoder:
         :param string_referencing:
             set to ``True`` to allow more efficient serializing of repeated string
             values
+        :param record_format:
+            set to ``"map"`` to serialize dataclass instances and named tuples as maps
+            of field names to values, or to ``"array"`` to serialize them as arrays of
+            their values in field order; either also serializes :class:`~enum.Enum`
+            members as their values. Types registered in the encoders table
+            keep their own encoders
+        :param collect_stats:
+            if ``True``, the encoder keeps counters of what it has done, which are
+            available from :attr:`stats`
 
         """
+        if record_format not in (None, "map", "array"):
+            raise ValueError(
+                f"invalid record_format value {record_format!r} (must be 'map', 'array' or "
+                "None)"
+            )
+
+        self._stats: dict[str, int] | None = None
+        self._value_depth = 0  # nesting of the calls to encode() in progress
         self.fp = fp
         self.datetime_as_timestamp = datetime_as_timestamp
         self.date_as_datetime = date_as_datetime
@@ -186,8 +223,42 @@ class CBOREncoder:
         self._encoders = default_encoders.copy()
         if canonical:
             self._encoders.update(canonical_encoders)
+        self._record_format = record_format
+        self._record_fields: dict[type, tuple[str, ...]] = {}  # field layouts by type
+        # [lead byte, _value_depth when begun, number of values in it] for each item opened
+        # by begin_*() and not ended yet
+        self._indefinite_items: list[list[int]] = []
+        # string_referencing while an indefinite length string is open, else None
+        self._indefinite_string_referencing: bool | None = None
+        # number of open items when the one that started a string namespace began, or 0
+        self._indefinite_namespace = 0
+        self.collect_stats = collect_stats
+
+    def _find_record_encoder(self, obj_type: type) -> Callable[[CBOREncoder, Any], None] | None:
+        if issubclass(obj_type, Enum):
+            return CBOREncoder._encode_enum
+
+        names: tuple[str, ...]
+        if is_dataclass(obj_type):
+            names = tuple(field.name for field in fields(obj_type))
+        elif issubclass(obj_type, tuple) and isinstance(getattr(obj_type, "_fields", None), tuple):
+            names = obj_type._fields  # type: ignore[attr-defined]
+        else:
+            return None
+
+        if self._canonical and self._record_format == "map":
+            names = tuple(sorted(names, key=self.encode_sortable_key))
+
+        self._record_fields[obj_type] = names
+        return CBOREncoder._encode_record
 
     def _find_encoder(self, obj_type: type) -> Callable[[CBOREncoder, Any], None] | None:
+        if self._record_format is not None:
+            record_encoder = self._find_record_encoder(obj_type)
+            if record_encoder is not None:
+                self._encoders[obj_type] = record_encoder
+                return record_encoder
+
         for type_or_tuple, enc in list(self._encoders.items()):
             if type(type_or_tuple) is tuple:
                 try:
@@ -228,7 +299,7 @@ class CBOREncoder:
             raise ValueError("fp object has no write method")
         else:
             self._fp = value
-            self._fp_write = value.write
+            self._fp_write = value.write if self._stats is None else self._counted_write
 
     @property
     def timezone(self) -> tzinfo | None:
@@ -256,6 +327,55 @@ class CBOREncoder:
     def canonical(self) -> bool:
         return self._canonical
 
+    @property
+    def record_format(self) -> str | None:
+        return self._record_format
+
+    @property
+    def collect_stats(self) -> bool:
+        return self._stats is not None
+
+    @collect_stats.setter
+    def collect_stats(self, value: bool) -> None:
+        # Counting starts afresh each time it's enabled
+        if value:
+            self._stats = {
+                "bytes_written": 0,
+                "write_calls": 0,
+                "default_calls": 0,
+                "lookup_hits": 0,
+                "lookup_misses": 0,
+                "max_depth": 0,
+            }
+            self._fp_write = self._counted_write
+        else:
+            self._stats = None
+            self._fp_write = self._fp.write
+
+    @property
+    def stats(self) -> dict[str, int] | None:
+        """
+        The counters kept while :attr:`collect_stats` is enabled, or ``None``:
+
+        * ``bytes_written``: the output produced
+        * ``write_calls``: the calls made to ``fp.write()``
+        * ``default_calls``: the calls made to the ``default`` hook
+        * ``lookup_hits`` and ``lookup_misses``: how often the type of a value being
+          encoded was, and wasn't, found directly in the encoders table
+        * ``max_depth``: the deepest nesting of values encoded
+
+        The C extension encodes many built-in types without looking them up, so it
+        counts fewer lookups than the pure Python encoder does.
+        """
+        return None if self._stats is None else dict(self._stats)
+
+    def _counted_write(self, data: Buffer) -> int:
+        # fp.write(), counted in the statistics
+        stats = cast("dict[str, int]", self._stats)
+        stats["write_calls"] += 1
+        stats["bytes_written"] += memoryview(data).nbytes
+        return self._fp.write(data)
+
     @contextmanager
     def disable_value_sharing(self) -> Generator[None]:
         """
@@ -305,6 +425,12 @@ class CBOREncoder:
         :param obj:
             the object to encode
         """
+        if self._indefinite_items:
+            return self._encode_in_indefinite(obj)
+
+        if self._stats is not None:
+            return self._encode_counted(obj)
+
         obj_type = obj.__class__
         encoder = self._encoders.get(obj_type) or self._find_encoder(obj_type) or self._default
         if not encoder:
@@ -312,6 +438,201 @@ class CBOREncoder:
 
         encoder(self, obj)
 
+    def _encode_in_indefinite(self, obj: Any) -> None:
+        # encode(), while items opened by begin_*() are open; the values encoded directly
+        # in the innermost one are checked and counted
+        item = self._indefinite_items[-1]
+        direct = item[1] == self._value_depth
+        if direct:
+            if item[0] == 0x7F and not isinstance(obj, str):
+                raise CBOREncodeValueError(
+                    "the chunks of an indefinite length string must be str, not "
+                    f"{obj.__class__.__name__}"
+                )
+            elif item[0] == 0x5F and not isinstance(obj, (bytes, bytearray)):
+                raise CBOREncodeValueError(
+                    "the chunks of an indefinite length bytestring must be bytes or "
+                    f"bytearray, not {obj.__class__.__name__}"
+                )
+
+        if self._stats is not None:
+            self._encode_counted(obj)
+        else:
+            obj_type = obj.__class__
+            encoder = (
+                self._encoders.get(obj_type) or self._find_encoder(obj_type) or self._default
+            )
+            if not encoder:
+                raise CBOREncodeTypeError(f"cannot serialize type {obj_type.__name__}")
+
+            self._value_depth += 1
+            try:
+                encoder(self, obj)
+            finally:
+                self._value_depth -= 1
+
+        if direct:
+            item[2] += 1
+
+    def _encode_counted(self, obj: Any) -> None:
+        # encode(), counted in the statistics
+        stats = cast("dict[str, int]", self._stats)
+        if self._value_depth > stats["max_depth"]:
+            stats["max_depth"] = self._value_depth
+
+        obj_type = obj.__class__
+        encoder = self._encoders.get(obj_type)
+        if encoder:
+            stats["lookup_hits"] += 1
+        else:
+            stats["lookup_misses"] += 1
+            encoder = self._find_encoder(obj_type)
+            if not encoder:
+                if not self._default:
+                    raise CBOREncodeTypeError(f"cannot serialize type {obj_type.__name__}")
+
+                stats["default_calls"] += 1
+                encoder = self._default
+
+        self._value_depth += 1
+        try:
+            encoder(self, obj)
+        finally:
+            self._value_depth -= 1
+
+    def reset(self, fp: IO[bytes] | None = None) -> None:
+        """
+        Forget all the values encoded so far, so that the next value encoded
+        can't refer back to any of them through value sharing or string
+        referencing.
+
+        :param fp:
+            if given, the new file to write to; any indefinite length items left open
+            by ``begin_*()`` in the old one are abandoned
+        """
+        if fp is not None:
+            self.fp = fp
+            self._abandon_indefinite()
+
+        self._shared_containers.clear()
+        self._string_references.clear()
+        self.string_namespacing = self.string_referencing
+
+    def encode_sequence(self, values: Iterable[Any]) -> None:
+        """
+        Encode each of the given objects as an independent item of a CBOR
+        sequence (:rfc:`8742`).
+
+        The value sharing and string reference registries are cleared before
+        each item, so every item can be decoded on its own.
+
+        :param values:
+            an iterable of the objects to encode
+        """
+        for value in values:
+            self.reset()
+            self.encode(value)
+
+    def begin_array(self) -> None:
+        """
+        Start an indefinite length array. Each value passed to :meth:`encode`
+        from now on becomes an item of the array, until :meth:`end` is called.
+
+        This allows an array to be written out one item at a time without ever
+        holding all of its items in memory.
+        """
+        self._begin_indefinite(0x9F)
+
+    def begin_map(self) -> None:
+        """
+        Start an indefinite length map. The values passed to :meth:`encode`
+        from now on are its keys and values, alternately, until :meth:`end` is
+        called, which raises :exc:`.CBOREncodeValueError` if the last key has no
+        value.
+        """
+        self._begin_indefinite(0xBF)
+
+    def begin_string(self) -> None:
+        """
+        Start an indefinite length text string. Each :class:`str` passed to
+        :meth:`encode` from now on becomes a chunk of the string, until
+        :meth:`end` is called. Encoding anything else in the meantime raises
+        :exc:`.CBOREncodeValueError`, and the chunks are never encoded as string
+        references.
+        """
+        self._begin_indefinite(0x7F)
+
+    def begin_bytestring(self) -> None:
+        """
+        Start an indefinite length byte string. Each :class:`bytes` value passed to
+        :meth:`encode` from now on becomes a chunk of the byte string, until
+        :meth:`end` is called (a :class:`bytearray` will do as well). Encoding
+        anything else in the meantime raises :exc:`.CBOREncodeValueError`, and the
+        chunks are never encoded as string references.
+        """
+        self._begin_indefinite(0x5F)
+
+    def end(self) -> None:
+        """
+        End the indefinite length item most recently started with one of the
+        ``begin_*()`` methods.
+        """
+        if not self._indefinite_items:
+            raise CBOREncodeValueError("there is no indefinite length item to end")
+
+        lead_byte, _, count = self._indefinite_items[-1]
+        if lead_byte == 0xBF and count % 2:
+            raise CBOREncodeValueError(
+                "an indefinite length map can't end with a key that has no value"
+            )
+
+        if self._indefinite_string_referencing is not None:
+            self.string_referencing = self._indefinite_string_referencing
+            self._indefinite_string_referencing = None
+
+        del self._indefinite_items[-1]
+        self._end_indefinite_namespace()
+        self._fp_write(b"\xff")
+
+    def _begin_indefinite(self, lead_byte: int) -> None:
+        if self._indefinite_string_referencing is not None:
+            raise CBOREncodeValueError(
+                "an indefinite length string can only contain definite length strings"
+            )
+
+        new_namespace = self.string_namespacing and lead_byte in (0x9F, 0xBF)
+        if new_namespace:
+            # Create a new string reference domain, as encode_container() would
+            self.encode_length(6, 256)
+
+        self._fp_write(struct.pack(">B", lead_byte))
+        # The new item is itself a value of the one it's in
+        if self._indefinite_items and self._indefinite_items[-1][1] == self._value_depth:
+            self._indefinite_items[-1][2] += 1
+
+        self._indefinite_items.append([lead_byte, self._value_depth, 0])
+        if new_namespace:
+            self.string_namespacing = False
+            self._indefinite_namespace = len(self._indefinite_items)
+
+        if lead_byte in (0x5F, 0x7F):
+            # The chunks have to be encoded as they are
+            self._indefinite_string_referencing = self.string_referencing
+            self.string_referencing = False
+
+    def _abandon_indefinite(self) -> None:
+        if self._indefinite_string_referencing is not None:
+            self.string_referencing = self._indefinite_string_referencing
+            self._indefinite_string_referencing = None
+
+        self._indefinite_items.clear()
+        self._end_indefinite_namespace()
+
+    def _end_indefinite_namespace(self) -> None:
+        if len(self._indefinite_items) < self._indefinite_namespace:
+            self.string_namespacing = True
+            self._indefinite_namespace = 0
+
     def encode_to_bytes(self, obj: Any) -> bytes:
         """
         Encode the given object to a byte buffer and return its value as bytes.
@@ -323,6 +644,8 @@ class CBOREncoder:
         with BytesIO() as fp:
             old_fp = self.fp
             self.fp = fp
+            # what's encoded here is counted when the caller writes it
+            self._fp_write = fp.write
             self.encode(obj)
             self.fp = old_fp
             return fp.getvalue()
@@ -457,6 +780,30 @@ class CBOREncoder:
             self.encode(key)
             self.encode(val)
 
+    @container_encoder
+    def encode_indefinite_array(self, value: Iterable[Any]) -> None:
+        self._fp_write(b"\x9f")
+        for item in value:
+            self.encode(item)
+
+        self._fp_write(b"\xff")
+
+    @container_encoder
+    def _encode_record(self, value: Any) -> None:
+        names = self._record_fields[value.__class__]
+        if self._record_format == "map":
+            self.encode_length(5, len(names))
+            for name in names:
+                self.encode_string(name)
+                self.encode(getattr(value, name))
+        else:
+            self.encode_length(4, len(names))
+            for name in names:
+                self.encode(getattr(value, name))
+
+    def _encode_enum(self, value: Enum) -> None:
+        self.encode(value.value)
+
     def encode_sortable_key(self, value: Any) -> tuple[int, bytes]:
         """
         Takes a key and calculates the length of its optimal byte
@@ -472,7 +819,7 @@ class CBOREncoder:
         """Reorder keys according to Canonical CBOR specification"""
         keyed_keys = ((self.encode_sortable_key(key), key, value) for key, value in value.items())
         self.encode_length(5, len(value))
-        for sortkey, realkey, value in sorted(keyed_keys):
+        for sortkey, realkey, value in sorted(keyed_keys, key=itemgetter(0)):
             if self.string_referencing:
                 # String referencing requires that the order encoded is
                 # the same as the order emitted so string references are
@@ -584,7 +931,7 @@ class CBOREncoder:
 
     def encode_canonical_set(self, value: Set[Any]) -> None:
         # Semantic tag 258
-        values = sorted((self.encode_sortable_key(key), key) for key in value)
+        values = sorted(((self.encode_sortable_key(key), key) for key in value), key=itemgetter(0))
         self.encode_semantic(CBORTag(258, [key[1] for key in values]))
 
     def encode_ipaddress(self, value: IPv4Address | IPv6Address) -> None:
@@ -595,6 +942,34 @@ class CBOREncoder:
         # Semantic tag 261
         self.encode_semantic(CBORTag(261, {value.network_address.packed: value.prefixlen}))
 
+    @container_encoder
+    def encode_typed_array(self, value: array[Any] | memoryview) -> None:
+        # Semantic tags 64-87
+        view = memoryview(value)
+        if view.ndim != 1 or not view.c_contiguous:
+            raise CBOREncodeValueError("typed arrays must be one-dimensional and contiguous")
+
+        tag = typed_array_tag(view.format, view.itemsize)
+        if tag is None:
+            raise CBOREncodeValueError(f"cannot encode {view.format!r} elements as a typed array")
+
+        self.encode_length(6, tag)
+        self.encode_length(2, view.nbytes)
+        self._fp_write(view.cast("B"))
+
+    def encode_memoryview(self, value: memoryview) -> None:
+        # Views of single bytes, such as the bytestrings decoded with memoryview_size,
+        # are bytestrings so that they survive a round trip; views of wider elements
+        # are typed arrays
+        single_bytes = value.format.lstrip("@") in ("B", "b", "c")
+        if value.ndim != 1 or not value.c_contiguous or not single_bytes:
+            self.encode_typed_array(value)
+        elif self.string_referencing:
+            self.encode_bytestring(value.tobytes())
+        else:
+            self.encode_length(2, value.nbytes)
+            self._fp_write(value)
+
     #
     # Special encoders (major tag 7)
     #
@@ -605,6 +980,9 @@ class CBOREncoder:
         else:
             self._fp_write(struct.pack(">BB", 0xF8, value.value))
 
+    def encode_raw(self, value: CBORRaw) -> None:
+        self._fp_write(value.data)
+
     def encode_float(self, value: float) -> None:
         # Handle special values efficiently
         if math.isnan(value):
@@ -646,6 +1024,29 @@ class CBOREncoder:
         self._fp_write(b"\xf7")
 
 
+def typed_array_tag(fmt: str, itemsize: int) -> int | None:
+    """
+    Return the :rfc:`8746` typed array tag for elements of the given :mod:`struct`
+    format and size in native byte order, or ``None`` if there isn't one.
+    """
+    if fmt.startswith("@"):
+        fmt = fmt[1:]
+
+    if len(fmt) != 1 or itemsize not in (1, 2, 4, 8):
+        return None
+
+    log2size = itemsize.bit_length() - 1
+    little = 4 if sys.byteorder == "little" and itemsize > 1 else 0
+    if fmt in "bhilqn":
+        return 72 | little | log2size
+    elif fmt in "BHILQN":
+        return 64 | little | log2size
+    elif fmt in "efd" and itemsize > 1:
+        return 80 | little | (log2size - 1)
+
+    return None
+
+
 default_encoders: dict[type | tuple[str, str], Callable[[CBOREncoder, Any], None]] = {
     bytes: CBOREncoder.encode_bytestring,
     bytearray: CBOREncoder.encode_bytearray,
@@ -673,9 +1074,13 @@ default_encoders: dict[type | tuple[str, str], Callable[[CBOREncoder, Any], None
     ("ipaddress", "IPv4Network"): CBOREncoder.encode_ipnetwork,
     ("ipaddress", "IPv6Network"): CBOREncoder.encode_ipnetwork,
     CBORSimpleValue: CBOREncoder.encode_simple_value,
+    CBORRaw: CBOREncoder.encode_raw,
     CBORTag: CBOREncoder.encode_semantic,
     set: CBOREncoder.encode_set,
     frozenset: CBOREncoder.encode_set,
+    ("array", "array"): CBOREncoder.encode_typed_array,
+    memoryview: CBOREncoder.encode_memoryview,
+    GeneratorType: CBOREncoder.encode_indefinite_array,
 }
 
 
@@ -699,6 +1104,7 @@ def dumps(
     canonical: bool = False,
     date_as_datetime: bool = False,
     string_referencing: bool = False,
+    record_format: Literal["map", "array"] | None = None,
 ) -> bytes:
     """
     Serialize an object to a bytestring.
@@ -730,6 +1136,12 @@ def dumps(
         the default behavior in previous releases (cbor2 <= 4.1.2).
     :param string_referencing:
         set to ``True`` to allow more efficient serializing of repeated string values
+    :param record_format:
+        set to ``"map"`` to serialize dataclass instances and named tuples as maps
+        of field names to values, or to ``"array"`` to serialize them as arrays of
+        their values in field order; either also serializes :class:`~enum.Enum`
+        members as their values. Types registered in the encoders table
+        keep their own encoders
     :return: the serialized output
 
     """
@@ -743,6 +1155,7 @@ def dumps(
             canonical=canonical,
             date_as_datetime=date_as_datetime,
             string_referencing=string_referencing,
+            record_format=record_format,
         ).encode(obj)
         return fp.getvalue()
 
@@ -757,6 +1170,7 @@ def dump(
     canonical: bool = False,
     date_as_datetime: bool = False,
     string_referencing: bool = False,
+    record_format: Literal["map", "array"] | None = None,
 ) -> None:
     """
     Serialize an object to a file.
@@ -790,6 +1204,12 @@ def dump(
         the default behavior in previous releases (cbor2 <= 4.1.2).
     :param string_referencing:
         set to ``True`` to allow more efficient serializing of repeated string values
+    :param record_format:
+        set to ``"map"`` to serialize dataclass instances and named tuples as maps
+        of field names to values, or to ``"array"`` to serialize them as arrays of
+        their values in field order; either also serializes :class:`~enum.Enum`
+        members as their values. Types registered in the encoders table
+        keep their own encoders
 
     """
     CBOREncoder(
@@ -801,4 +1221,145 @@ def dump(
         canonical=canonical,
         date_as_datetime=date_as_datetime,
         string_referencing=string_referencing,
+        record_format=record_format,
     ).encode(obj)
+
+
+def dumps_sequence(
+    objs: Iterable[Any],
+    datetime_as_timestamp: bool = False,
+    timezone: tzinfo | None = None,
+    value_sharing: bool = False,
+    default: Callable[[CBOREncoder, Any], None] | None = None,
+    canonical: bool = False,
+    date_as_datetime: bool = False,
+    string_referencing: bool = False,
+    record_format: Literal["map", "array"] | None = None,
+) -> bytes:
+    """
+    Serialize the objects in an iterable to a bytestring, as a CBOR sequence
+    (:rfc:`8742`).
+
+    Each object is encoded as an independent item; value sharing and string
+    references never span items, so the output can be decoded with
+    :func:`loads_sequence`.
+
+    :param objs:
+        an iterable of the objects to serialize
+    :param datetime_as_timestamp:
+        set to ``True`` to serialize datetimes as UNIX timestamps (this makes datetimes
+        more concise on the wire, but loses the timezone information)
+    :param timezone:
+        the default timezone to use for serializing naive datetimes; if this is not
+        specified naive datetimes will throw a :exc:`ValueError` when encoding is
+        attempted
+    :param value_sharing:
+        set to ``True`` to allow more efficient serializing of repeated values
+        and, more importantly, cyclic data structures, at the cost of extra
+        line overhead
+    :param default:
+        a callable that is called by the encoder with two arguments (the encoder
+        instance and the value being encoded) when no suitable encoder has been found,
+        and should use the methods on the encoder to encode any objects it wants to add
+        to the data stream
+    :param canonical:
+        when ``True``, use "canonical" CBOR representation; this typically involves
+        sorting maps, sets, etc. into a pre-determined order ensuring that
+        serializations are comparable without decoding
+    :param date_as_datetime:
+        set to ``True`` to serialize date objects as datetimes (CBOR tag 0), which was
+        the default behavior in previous releases (cbor2 <= 4.1.2).
+    :param string_referencing:
+        set to ``True`` to allow more efficient serializing of repeated string values
+    :param record_format:
+        set to ``"map"`` to serialize dataclass instances and named tuples as maps
+        of field names to values, or to ``"array"`` to serialize them as arrays of
+        their values in field order; either also serializes :class:`~enum.Enum`
+        members as their values. Types registered in the encoders table
+        keep their own encoders
+    :return: the serialized output
+
+    """
+    with BytesIO() as fp:
+        CBOREncoder(
+            fp,
+            datetime_as_timestamp=datetime_as_timestamp,
+            timezone=timezone,
+            value_sharing=value_sharing,
+            default=default,
+            canonical=canonical,
+            date_as_datetime=date_as_datetime,
+            string_referencing=string_referencing,
+            record_format=record_format,
+        ).encode_sequence(objs)
+        return fp.getvalue()
+
+
+def dump_sequence(
+    objs: Iterable[Any],
+    fp: IO[bytes],
+    datetime_as_timestamp: bool = False,
+    timezone: tzinfo | None = None,
+    value_sharing: bool = False,
+    default: Callable[[CBOREncoder, Any], None] | None = None,
+    canonical: bool = False,
+    date_as_datetime: bool = False,
+    string_referencing: bool = False,
+    record_format: Literal["map", "array"] | None = None,
+) -> None:
+    """
+    Serialize the objects in an iterable to a file, as a CBOR sequence
+    (:rfc:`8742`).
+
+    Each object is encoded as an independent item; value sharing and string
+    references never span items, so the output can be decoded with
+    :func:`loads_sequence`.
+
+    :param objs:
+        an iterable of the objects to serialize
+    :param fp:
+        the file to write to (any file-like object opened for writing in binary mode)
+    :param datetime_as_timestamp:
+        set to ``True`` to serialize datetimes as UNIX timestamps (this makes datetimes
+        more concise on the wire, but loses the timezone information)
+    :param timezone:
+        the default timezone to use for serializing naive datetimes; if this is not
+        specified naive datetimes will throw a :exc:`ValueError` when encoding is
+        attempted
+    :param value_sharing:
+        set to ``True`` to allow more efficient serializing of repeated values
+        and, more importantly, cyclic data structures, at the cost of extra
+        line overhead
+    :param default:
+        a callable that is called by the encoder with two arguments (the encoder
+        instance and the value being encoded) when no suitable encoder has been found,
+        and should use the methods on the encoder to encode any objects it wants to add
+        to the data stream
+    :param canonical:
+        when ``True``, use "canonical" CBOR representation; this typically involves
+        sorting maps, sets, etc. into a pre-determined order ensuring that
+        serializations are comparable without decoding
+    :param date_as_datetime:
+        set to ``True`` to serialize date objects as datetimes (CBOR tag 0), which was
+        the default behavior in previous releases (cbor2 <= 4.1.2).
+    :param string_referencing:
+        set to ``True`` to allow more efficient serializing of repeated string values
+    :param record_format:
+        set to ``"map"`` to serialize dataclass instances and named tuples as maps
+        of field names to values, or to ``"array"`` to serialize them as arrays of
+        their values in field order; either also serializes :class:`~enum.Enum`
+        members as their values. Types registered in the encoders table
+        keep their own encoders
+
+    """
+    CBOREncoder(
+        fp,
+        datetime_as_timestamp=datetime_as_timestamp,
+        timezone=timezone,
+        value_sharing=value_sharing,
+        default=default,
+        canonical=canonical,
+        date_as_datetime=date_as_datetime,
+        string_referencing=string_referencing,
+        record_format=record_format,
+    ).encode_sequence(objs)
@@ -164,6 +164,29 @@ class CBORSimpleValue(namedtuple("CBORSimpleValue", ["value"])):
         return NotImplemented
 
 
+class CBORRaw(namedtuple("CBORRaw", ["data"])):
+    """
+    Wraps a value that is already encoded as CBOR, to be written out verbatim by the
+    encoder.
+
+    The data is not checked for being a single well-formed CBOR item. Decoders return
+    these for the tags and map values selected with their ``raw_tags`` and ``raw_keys``
+    options.
+
+    :param data: the encoded value (any bytes-like object)
+    """
+
+    __slots__ = ()
+
+    data: bytes
+
+    def __new__(cls, data: bytes | bytearray | memoryview) -> CBORRaw:
+        if not isinstance(data, (bytes, bytearray, memoryview)):
+            raise TypeError("CBORRaw data must be a bytes-like object")
+
+        return super().__new__(cls, bytes(data))
+
+
 class FrozenDict(Mapping[KT, VT_co]):
     """
     A hashable, immutable mapping type.
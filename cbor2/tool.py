@@ -17,7 +17,7 @@ from datetime import datetime
 from functools import partial
 from typing import TYPE_CHECKING, Any, TypeVar
 
-from . import CBORDecoder, CBORSimpleValue, CBORTag, FrozenDict, load, undefined
+from . import CBORDecoder, CBORSimpleValue, CBORTag, FrozenDict, load, load_sequence, undefined
 
 if TYPE_CHECKING:
     from typing import Literal, TypeAlias
@@ -72,12 +72,7 @@ def iterdecode(
     object_hook: Callable[[CBORDecoder, dict[Any, Any]], Any] | None = None,
     str_errors: Literal["strict", "error", "replace"] = "strict",
 ) -> Iterator[Any]:
-    decoder = CBORDecoder(f, tag_hook=tag_hook, object_hook=object_hook, str_errors=str_errors)
-    while True:
-        try:
-            yield decoder.decode()
-        except EOFError:
-            return
+    return load_sequence(f, tag_hook=tag_hook, object_hook=object_hook, str_errors=str_errors)
 
 
 def key_to_str(d: T, dict_ids: set[int] | None = None) -> str | list[Any] | dict[str, Any] | T:
@@ -37,18 +37,42 @@
 enum DecodeOption {
     DECODE_NORMAL = 0,
     DECODE_IMMUTABLE = 1,
-    DECODE_UNSHARED = 2
+    DECODE_UNSHARED = 2,
+    DECODE_KEY = 4       // a map key; short strings go through the key cache
 };
 typedef uint8_t DecodeOptions;
 
+// Totals kept while skipping over items
+typedef struct {
+    Py_ssize_t size;       // bytes skipped
+    Py_ssize_t items;      // data items skipped (including tags, keys, etc.)
+    Py_ssize_t depth;      // current nesting of arrays, maps and tags
+    Py_ssize_t max_depth;
+} SkipStats;
+
 static int _CBORDecoder_set_fp(CBORDecoderObject *, PyObject *, void *);
+static int _CBORDecoder_set_memoryview_size(CBORDecoderObject *, PyObject *,
+                                            void *);
 static int _CBORDecoder_set_tag_hook(CBORDecoderObject *, PyObject *, void *);
 static int _CBORDecoder_set_object_hook(CBORDecoderObject *, PyObject *, void *);
 static int _CBORDecoder_set_str_errors(CBORDecoderObject *, PyObject *, void *);
+static int _CBORDecoder_set_record_type(CBORDecoderObject *, PyObject *, void *);
+static int _CBORDecoder_set_cache_keys(CBORDecoderObject *, PyObject *, void *);
+static int _CBORDecoder_set_int_cache_size(CBORDecoderObject *, PyObject *, void *);
+static int _CBORDecoder_set_raw_tags(CBORDecoderObject *, PyObject *, void *);
+static int _CBORDecoder_set_raw_keys(CBORDecoderObject *, PyObject *, void *);
+static int _CBORDecoder_set_collect_stats(CBORDecoderObject *, PyObject *,
+                                          void *);
+static int set_limit(CBORDecoderObject *, Py_ssize_t *, const char *,
+                     PyObject *);
+static void key_cache_clear(CBORDecoderObject *);
+static void int_cache_clear(CBORDecoderObject *);
 
 static PyObject * decode(CBORDecoderObject *, DecodeOptions);
 static PyObject * decode_bytestring(CBORDecoderObject *, uint8_t);
 static PyObject * decode_string(CBORDecoderObject *, uint8_t);
+static PyObject * decode_raw(CBORDecoderObject *, const char *, Py_ssize_t);
+static int skip_value(CBORDecoderObject *, SkipStats *);
 static PyObject * CBORDecoder_decode_datetime_string(CBORDecoderObject *);
 static PyObject * CBORDecoder_decode_epoch_datetime(CBORDecoderObject *);
 static PyObject * CBORDecoder_decode_epoch_date(CBORDecoderObject *);
@@ -67,6 +91,7 @@ static PyObject * CBORDecoder_decode_float32(CBORDecoderObject *);
 static PyObject * CBORDecoder_decode_float64(CBORDecoderObject *);
 static PyObject * CBORDecoder_decode_ipaddress(CBORDecoderObject *);
 static PyObject * CBORDecoder_decode_ipnetwork(CBORDecoderObject *);
+static PyObject * decode_typed_array(CBORDecoderObject *, uint64_t);
 static PyObject * CBORDecoder_decode_self_describe_cbor(CBORDecoderObject *);
 
 static PyObject * CBORDecoder_decode_shareable(CBORDecoderObject *);
@@ -77,18 +102,34 @@ static PyObject * CBORDecoder_decode_stringref(CBORDecoderObject *);
 static PyObject * CBORDecoder_decode_stringref_ns(CBORDecoderObject *);
 
 
+// RFC 8746 typed arrays, except for the reserved tag 76 and the 128-bit float
+// ones (83 and 87), which the array module has no type for
+static inline bool
+is_typed_array_tag(uint64_t tagnum)
+{
+    return tagnum >= 64 && tagnum <= 86 && tagnum != 76 && tagnum != 83;
+}
+
+
 // Constructors and destructors //////////////////////////////////////////////
 
 static int
 CBORDecoder_traverse(CBORDecoderObject *self, visitproc visit, void *arg)
 {
     Py_VISIT(self->read);
+    Py_VISIT(self->seek);
+    Py_VISIT(self->tell);
+    Py_VISIT(self->fp_buffer);
     Py_VISIT(self->tag_hook);
     Py_VISIT(self->object_hook);
+    Py_VISIT(self->record_type);
+    Py_VISIT(self->record_fields);
     Py_VISIT(self->shareables);
     Py_VISIT(self->stringref_namespace);
-    // No need to visit str_errors; it's only a string and can't reference us
-    // or other objects
+    Py_VISIT(self->raw_keys);
+    Py_VISIT(self->input.obj);
+    // No need to visit str_errors or last_tz; they're only a string and a
+    // timezone and can't reference us or other objects
     return 0;
 }
 
@@ -96,11 +137,29 @@ static int
 CBORDecoder_clear(CBORDecoderObject *self)
 {
     Py_CLEAR(self->read);
+    Py_CLEAR(self->seek);
+    Py_CLEAR(self->tell);
+    Py_CLEAR(self->fp_buffer);
+    Py_CLEAR(self->readahead);
     Py_CLEAR(self->tag_hook);
     Py_CLEAR(self->object_hook);
+    Py_CLEAR(self->record_type);
+    Py_CLEAR(self->record_fields);
     Py_CLEAR(self->shareables);
     Py_CLEAR(self->stringref_namespace);
     Py_CLEAR(self->str_errors);
+    Py_CLEAR(self->raw_tags);
+    Py_CLEAR(self->raw_keys);
+    Py_CLEAR(self->raw_capture);
+    Py_CLEAR(self->last_tz);
+    key_cache_clear(self);
+    int_cache_clear(self);
+    if (self->input.obj)
+        PyBuffer_Release(&self->input);
+    PyMem_Free(self->scratch);
+    self->scratch = NULL;
+    self->scratch_size = 0;
+    self->scratch_len = 0;
     return 0;
 }
 
@@ -136,12 +195,54 @@ CBORDecoder_new(PyTypeObject *type, PyObject *args, PyObject *kwargs)
         Py_INCREF(Py_None);
         self->read = Py_None;
         Py_INCREF(Py_None);
+        self->seek = Py_None;
+        Py_INCREF(Py_None);
+        self->tell = Py_None;
+        Py_INCREF(Py_None);
         self->tag_hook = Py_None;
         Py_INCREF(Py_None);
         self->object_hook = Py_None;
+        Py_INCREF(Py_None);
+        self->record_type = Py_None;
+        Py_INCREF(Py_None);
+        self->record_fields = Py_None;
         self->str_errors = PyBytes_FromString("strict");
         self->immutable = false;
         self->shared_index = -1;
+        self->readahead = NULL;
+        self->read_pos = 0;
+        self->read_size = 0;
+        self->cache_keys = true;
+        self->int_cache_size = DEFAULT_INT_CACHE_SIZE;
+        self->int_cache = NULL;
+        Py_INCREF(Py_None);
+        self->raw_tags = Py_None;
+        Py_INCREF(Py_None);
+        self->raw_keys = Py_None;
+        self->raw_capture = NULL;
+        self->last_tz = NULL;
+        self->last_tz_offset = 0;
+        self->fp_input = false;
+        self->fp_buffer = NULL;
+        self->fp_acquired = false;
+        self->rewound = 0;
+        self->rewound_pos = 0;
+        self->memoryview_size = -1;
+        self->scratch = NULL;
+        self->scratch_size = 0;
+        self->scratch_len = 0;
+        self->fetched = 0;
+        self->depth = 0;
+        self->max_items = -1;
+        self->max_length = -1;
+        self->max_allocation = -1;
+        self->items = 0;
+        self->allocated = 0;
+        self->limited = false;
+        self->collect_stats = false;
+        self->tracking = false;
+        self->value_start = 0;
+        memset(&self->stats, 0, sizeof(DecoderStats));
     }
     return (PyObject *) self;
 error:
@@ -151,36 +252,129 @@ error:
 
 
 // CBORDecoder.__init__(self, fp=None, tag_hook=None, object_hook=None,
-//                      str_errors='strict')
+//                      str_errors='strict', read_size=None, record_type=None,
+//                      cache_keys=True, int_cache_size=1024, raw_tags=None,
+//                      raw_keys=None, memoryview_size=None, max_items=None,
+//                      max_length=None, max_allocation=None,
+//                      collect_stats=False)
 int
 CBORDecoder_init(CBORDecoderObject *self, PyObject *args, PyObject *kwargs)
 {
     static char *keywords[] = {
-        "fp", "tag_hook", "object_hook", "str_errors", NULL
+        "fp", "tag_hook", "object_hook", "str_errors", "read_size",
+        "record_type", "cache_keys", "int_cache_size", "raw_tags",
+        "raw_keys", "memoryview_size", "max_items", "max_length",
+        "max_allocation", "collect_stats", NULL
     };
     PyObject *fp = NULL, *tag_hook = NULL, *object_hook = NULL,
-             *str_errors = NULL;
-
-    if (!PyArg_ParseTupleAndKeywords(args, kwargs, "O|OOO", keywords,
-                &fp, &tag_hook, &object_hook, &str_errors))
+             *str_errors = NULL, *read_size = NULL, *record_type = NULL,
+             *cache_keys = NULL, *int_cache_size = NULL, *raw_tags = NULL,
+             *raw_keys = NULL, *memoryview_size = NULL, *max_items = NULL,
+             *max_length = NULL, *max_allocation = NULL,
+             *collect_stats = NULL;
+
+    if (!PyArg_ParseTupleAndKeywords(args, kwargs, "O|OOOOOOOOOOOOOO",
+                keywords, &fp, &tag_hook, &object_hook, &str_errors,
+                &read_size, &record_type, &cache_keys, &int_cache_size,
+                &raw_tags, &raw_keys, &memoryview_size, &max_items,
+                &max_length, &max_allocation, &collect_stats))
         return -1;
 
+    if (read_size && read_size != Py_None) {
+        self->read_size = PyLong_AsSsize_t(read_size);
+        if (self->read_size == -1 && PyErr_Occurred())
+            return -1;
+        if (self->read_size < 1) {
+            self->read_size = 0;
+            PyErr_Format(PyExc_ValueError,
+                    "invalid read_size value %R (must be a positive "
+                    "integer or None)", read_size);
+            return -1;
+        }
+    }
     if (_CBORDecoder_set_fp(self, fp, NULL) == -1)
         return -1;
+    if (cache_keys &&
+            _CBORDecoder_set_cache_keys(self, cache_keys, NULL) == -1)
+        return -1;
+    if (int_cache_size && _CBORDecoder_set_int_cache_size(
+                self, int_cache_size, NULL) == -1)
+        return -1;
+    if (raw_tags && _CBORDecoder_set_raw_tags(self, raw_tags, NULL) == -1)
+        return -1;
+    if (raw_keys && _CBORDecoder_set_raw_keys(self, raw_keys, NULL) == -1)
+        return -1;
+    if (memoryview_size && _CBORDecoder_set_memoryview_size(
+                self, memoryview_size, NULL) == -1)
+        return -1;
+    if (CBORDecoder_init_limits(
+                self, max_items, max_length, max_allocation) == -1)
+        return -1;
+    if (collect_stats && _CBORDecoder_set_collect_stats(
+                self, collect_stats, NULL) == -1)
+        return -1;
+    return CBORDecoder_init_options(
+            self, tag_hook, object_hook, str_errors, record_type);
+}
+
+
+// Common initialization of the decoder's hooks and options; also used by
+// loads() which constructs a decoder without a file-like object. Any of the
+// arguments may be NULL to leave the default in place
+int
+CBORDecoder_init_options(CBORDecoderObject *self, PyObject *tag_hook,
+                         PyObject *object_hook, PyObject *str_errors,
+                         PyObject *record_type)
+{
     if (tag_hook && _CBORDecoder_set_tag_hook(self, tag_hook, NULL) == -1)
         return -1;
     if (object_hook && _CBORDecoder_set_object_hook(self, object_hook, NULL) == -1)
         return -1;
     if (str_errors && _CBORDecoder_set_str_errors(self, str_errors, NULL) == -1)
         return -1;
+    if (record_type &&
+            _CBORDecoder_set_record_type(self, record_type, NULL) == -1)
+        return -1;
 
-    if (!_CBOR2_FrozenDict && _CBOR2_init_FrozenDict() == -1)
+    if (CBOR2_INIT(_CBOR2_FrozenDict, _CBOR2_init_FrozenDict) == -1)
         return -1;
 
     return 0;
 }
 
 
+// Turns the int cache off for the one-shot load() and loads(), which decode
+// just one value, unless value (which may be NULL) sets int_cache_size
+int
+CBORDecoder_init_int_cache(CBORDecoderObject *self, PyObject *value)
+{
+    int_cache_clear(self);
+    self->int_cache_size = 0;
+    if (value)
+        return _CBORDecoder_set_int_cache_size(self, value, NULL);
+    return 0;
+}
+
+
+// Sets the limits on each value decoded; also used by loads(). Any of the
+// arguments may be NULL to leave the limit off
+int
+CBORDecoder_init_limits(CBORDecoderObject *self, PyObject *max_items,
+                        PyObject *max_length, PyObject *max_allocation)
+{
+    if (max_items &&
+            set_limit(self, &self->max_items, "max_items", max_items) == -1)
+        return -1;
+    if (max_length &&
+            set_limit(self, &self->max_length, "max_length", max_length) == -1)
+        return -1;
+    if (max_allocation && set_limit(self, &self->max_allocation,
+                                    "max_allocation", max_allocation) == -1)
+        return -1;
+    return 0;
+}
+
+
 // Property accessors ////////////////////////////////////////////////////////
 
 // CBORDecoder._get_fp(self)
@@ -191,6 +385,7 @@ _CBORDecoder_get_fp(CBORDecoderObject *self, void *closure)
     if (fp) {
         return fp;
     } else {
+        PyErr_Clear();
         Py_RETURN_NONE;
     }
 }
@@ -200,7 +395,7 @@ _CBORDecoder_get_fp(CBORDecoderObject *self, void *closure)
 static int
 _CBORDecoder_set_fp(CBORDecoderObject *self, PyObject *value, void *closure)
 {
-    PyObject *tmp, *read;
+    PyObject *tmp, *read, *seek = NULL, *tell = NULL, *seekable;
 
     if (!value) {
         PyErr_SetString(PyExc_AttributeError, "cannot delete fp attribute");
@@ -213,10 +408,65 @@ _CBORDecoder_set_fp(CBORDecoderObject *self, PyObject *value, void *closure)
         return -1;
     }
 
+    // Hand anything read ahead from the old fp back to it
+    tmp = CBORDecoder_release_read_ahead(self);
+    if (!tmp) {
+        Py_DECREF(read);
+        return -1;
+    }
+    Py_DECREF(tmp);
+
+    // A new fp replaces any in-memory input
+    if (self->input.obj) {
+        PyBuffer_Release(&self->input);
+        self->input.buf = NULL;
+        self->input_pos = 0;
+    }
+    self->fp_input = false;
+    Py_CLEAR(self->fp_buffer);
+
+    if (PyObject_CheckBuffer(value)) {
+        // An fp exposing its whole content through the buffer protocol (such
+        // as an mmap) is decoded from directly by each call, starting at its
+        // current position, instead of through its read() method
+        seek = PyObject_GetAttr(value, _CBOR2_str_seek);
+    } else {
+        // Data read ahead can only be handed back to fp if it's seekable; any
+        // failure to determine that simply means it isn't
+        seekable = PyObject_CallMethodObjArgs(value, _CBOR2_str_seekable, NULL);
+        if (seekable) {
+            if (PyObject_IsTrue(seekable) == 1)
+                seek = PyObject_GetAttr(value, _CBOR2_str_seek);
+            Py_DECREF(seekable);
+        }
+    }
+    if (seek) {
+        // fp also has to say where it is; see fp_acquire
+        tell = PyObject_GetAttr(value, _CBOR2_str_tell);
+        if (!tell)
+            Py_CLEAR(seek);
+    }
+    if (!seek) {
+        PyErr_Clear();
+        Py_INCREF(Py_None);
+        seek = Py_None;
+        Py_INCREF(Py_None);
+        tell = Py_None;
+    } else if (PyObject_CheckBuffer(value)) {
+        Py_INCREF(value);
+        self->fp_buffer = value;
+    }
+
     // See notes in encoder.c / _CBOREncoder_set_fp
     tmp = self->read;
     self->read = read;
     Py_DECREF(tmp);
+    tmp = self->seek;
+    self->seek = seek;
+    Py_DECREF(tmp);
+    tmp = self->tell;
+    self->tell = tell;
+    Py_DECREF(tmp);
     return 0;
 }
 
@@ -324,6 +574,8 @@ _CBORDecoder_set_str_errors(CBORDecoderObject *self, PyObject *value,
                 tmp = self->str_errors;
                 self->str_errors = bytes;
                 Py_DECREF(tmp);
+                // Cached keys were decoded under the old error mode
+                key_cache_clear(self);
                 return 0;
             }
             Py_DECREF(bytes);
@@ -336,822 +588,2313 @@ _CBORDecoder_set_str_errors(CBORDecoderObject *self, PyObject *value,
 }
 
 
-// CBORDecoder._get_immutable(self, value)
+// CBORDecoder._get_record_type(self)
 static PyObject *
-_CBORDecoder_get_immutable(CBORDecoderObject *self, void *closure)
+_CBORDecoder_get_record_type(CBORDecoderObject *self, void *closure)
 {
-    if (self->immutable)
-        Py_RETURN_TRUE;
-    else
-        Py_RETURN_FALSE;
+    Py_INCREF(self->record_type);
+    return self->record_type;
 }
 
 
-// Utility functions /////////////////////////////////////////////////////////
-
-static void
-raise_from(PyObject *new_exc_type, const char *message) {
-    // This requires the error indicator to be set
-    PyObject *cause;
-#if PY_VERSION_HEX >= 0x030c0000
-    cause = PyErr_GetRaisedException();
-#else
-    PyObject *exc_type, *exc_traceback;
-    PyErr_Fetch(&exc_type, &cause, &exc_traceback);
-    PyErr_NormalizeException(&exc_type, &cause, &exc_traceback);
-    Py_XDECREF(exc_type);
-    Py_XDECREF(exc_traceback);
-#endif
-
-    PyObject *msg_obj = PyUnicode_FromString(message);
-    if (message) {
-        PyObject *new_exception = PyObject_CallFunctionObjArgs(
-            new_exc_type, msg_obj, NULL);
-        if (new_exception) {
-            PyException_SetCause(new_exception, cause);
-            PyErr_SetObject(new_exc_type, new_exception);
-        }
-        Py_DECREF(msg_obj);
-    }
-}
-
-static PyObject *
-fp_read_object(CBORDecoderObject *self, const Py_ssize_t size)
+// Adds name to the dict fields, mapping it to its index (the number of fields
+// before it)
+static int
+add_record_field(PyObject *fields, PyObject *name)
 {
-    PyObject *ret = NULL;
-    PyObject *obj, *size_obj;
-    size_obj = PyLong_FromSsize_t(size);
-    if (size_obj) {
-        obj = PyObject_CallFunctionObjArgs(self->read, size_obj, NULL);
-        Py_DECREF(size_obj);
-        if (obj) {
-            assert(PyBytes_CheckExact(obj));
-            if (PyBytes_GET_SIZE(obj) == (Py_ssize_t) size) {
-                ret = obj;
-            } else {
-                PyErr_Format(
-                    _CBOR2_CBORDecodeEOF,
-                    "premature end of stream (expected to read %zd bytes, "
-                    "got %zd instead)", size, PyBytes_GET_SIZE(obj));
-                Py_DECREF(obj);
-            }
-        }
-    }
+    PyObject *index;
+    int ret;
+
+    index = PyLong_FromSsize_t(PyDict_GET_SIZE(fields));
+    if (!index)
+        return -1;
+    ret = PyDict_SetItem(fields, name, index);
+    Py_DECREF(index);
     return ret;
 }
 
 
+// Adds each name in the sequence names to the dict fields; see
+// add_record_field
 static int
-fp_read(CBORDecoderObject *self, char *buf, const Py_ssize_t size)
+add_record_fields(PyObject *fields, PyObject *names)
 {
-    int ret = -1;
-    PyObject *obj = fp_read_object(self, size);
-    if (obj) {
-        char *data = PyBytes_AS_STRING(obj);
-        if (data) {
-            memcpy(buf, data, size);
-            ret = 0;
+    PyObject *name;
+    Py_ssize_t i;
+
+    for (i = 0; i < PyTuple_GET_SIZE(names); i++) {
+        name = PyTuple_GET_ITEM(names, i);
+        if (!PyUnicode_Check(name)) {
+            PyErr_Format(PyExc_TypeError,
+                    "record field name %R is not a string", name);
+            return -1;
         }
-        Py_DECREF(obj);
+        if (add_record_field(fields, name) == -1)
+            return -1;
     }
-    return ret;
+    return 0;
 }
 
 
-// CBORDecoder.read(self, length) -> bytes
+// Returns a new dict of the names accepted by the constructor of the
+// dataclass or named tuple class type (in field order, each mapped to its
+// index), or NULL with ValueError set if type is neither
 static PyObject *
-CBORDecoder_read(CBORDecoderObject *self, PyObject *length)
+record_fields(PyObject *type)
 {
-    PyObject *ret = NULL;
-    Py_ssize_t len;
+    PyObject *fields, *names, *field, *obj;
+    Py_ssize_t i;
+    int init;
 
-    len = PyLong_AsSsize_t(length);
-    if (PyErr_Occurred())
+    if (!PyType_Check(type))
+        goto error;
+    fields = PyDict_New();
+    if (!fields)
         return NULL;
-    ret = PyBytes_FromStringAndSize(NULL, len);
-    if (ret) {
-        if (fp_read(self, PyBytes_AS_STRING(ret), len) == -1) {
-            Py_DECREF(ret);
-            ret = NULL;
+
+    if (PyType_IsSubtype((PyTypeObject *) type, &PyTuple_Type)) {
+        // namedtuple(...) classes list their fields in _fields
+        names = PyObject_GetAttr(type, _CBOR2_str__fields);
+        if (names && PyTuple_Check(names)) {
+            if (add_record_fields(fields, names) == -1)
+                Py_CLEAR(fields);
+            Py_DECREF(names);
+            return fields;
+        }
+        Py_XDECREF(names);
+    } else {
+        obj = PyObject_GetAttr(type, _CBOR2_str___dataclass_fields__);
+        if (obj) {
+            Py_DECREF(obj);
+            if (CBOR2_INIT(_CBOR2_dataclass_fields,
+                           _CBOR2_init_dataclass_fields) == -1)
+                goto fail;
+            // names = tuple(f.name for f in dataclasses.fields(type) if f.init)
+            obj = PyObject_CallFunctionObjArgs(
+                    _CBOR2_dataclass_fields, type, NULL);
+            if (!obj)
+                goto fail;
+            names = PySequence_Tuple(obj);
+            Py_DECREF(obj);
+            if (!names)
+                goto fail;
+            for (i = 0; fields && i < PyTuple_GET_SIZE(names); i++) {
+                field = PyTuple_GET_ITEM(names, i);
+                obj = PyObject_GetAttr(field, _CBOR2_str_init);
+                init = obj ? PyObject_IsTrue(obj) : -1;
+                Py_XDECREF(obj);
+                if (init == 1) {
+                    obj = PyObject_GetAttr(field, _CBOR2_str_name);
+                    if (!obj || add_record_field(fields, obj) == -1)
+                        Py_CLEAR(fields);
+                    Py_XDECREF(obj);
+                } else if (init == -1)
+                    Py_CLEAR(fields);
+            }
+            Py_DECREF(names);
+            return fields;
         }
     }
-    return ret;
+    if (!PyErr_Occurred() || PyErr_ExceptionMatches(PyExc_AttributeError)) {
+        PyErr_Clear();
+        Py_DECREF(fields);
+        goto error;
+    }
+fail:
+    Py_DECREF(fields);
+    return NULL;
+error:
+    PyErr_Format(PyExc_ValueError,
+            "invalid record_type value %R (must be a dataclass, a named "
+            "tuple class, or None)", type);
+    return NULL;
 }
 
 
-static inline void
-set_shareable(CBORDecoderObject *self, PyObject *value)
+// CBORDecoder._set_record_type(self, value)
+static int
+_CBORDecoder_set_record_type(CBORDecoderObject *self, PyObject *value,
+                             void *closure)
 {
-    if (value && self->shared_index != -1) {
-        Py_INCREF(value);  // PyList_SetItem "steals" reference
-        // TODO use weakrefs? or explicitly empty list?
-#ifndef NDEBUG
-        int ret =
-#endif
-        PyList_SetItem(self->shareables, self->shared_index, value);
-        assert(!ret);
+    PyObject *tmp, *fields;
+
+    if (!value) {
+        PyErr_SetString(PyExc_AttributeError,
+                        "cannot delete record_type attribute");
+        return -1;
     }
+    if (value == Py_None) {
+        Py_INCREF(Py_None);
+        fields = Py_None;
+    } else {
+        fields = record_fields(value);
+        if (!fields)
+            return -1;
+    }
+
+    tmp = self->record_fields;
+    self->record_fields = fields;
+    Py_DECREF(tmp);
+    tmp = self->record_type;
+    Py_INCREF(value);
+    self->record_type = value;
+    Py_DECREF(tmp);
+    return 0;
 }
 
 
-// CBORDecoder.set_shareable(self, value)
+// CBORDecoder._get_cache_keys(self)
 static PyObject *
-CBORDecoder_set_shareable(CBORDecoderObject *self, PyObject *value)
+_CBORDecoder_get_cache_keys(CBORDecoderObject *self, void *closure)
 {
-    set_shareable(self, value);
-    Py_RETURN_NONE;
+    if (self->cache_keys)
+        Py_RETURN_TRUE;
+    else
+        Py_RETURN_FALSE;
 }
 
 
+// CBORDecoder._set_cache_keys(self, value)
 static int
-decode_length(CBORDecoderObject *self, uint8_t subtype,
-        uint64_t *length, bool *indefinite)
+_CBORDecoder_set_cache_keys(CBORDecoderObject *self, PyObject *value,
+                            void *closure)
 {
-    union {
-        union { uint64_t value; char buf[sizeof(uint64_t)]; } u64;
-        union { uint32_t value; char buf[sizeof(uint32_t)]; } u32;
-        union { uint16_t value; char buf[sizeof(uint16_t)]; } u16;
-        union { uint8_t value;  char buf[sizeof(uint8_t)];  } u8;
-    } value;
+    int enable;
 
-    if (subtype < 28) {
-        if (subtype < 24) {
-            *length = subtype;
-        } else if (subtype == 24) {
-            if (fp_read(self, value.u8.buf, sizeof(uint8_t)) == -1)
-                return -1;
-            *length = value.u8.value;
-        } else if (subtype == 25) {
-            if (fp_read(self, value.u16.buf, sizeof(uint16_t)) == -1)
-                return -1;
-            *length = be16toh(value.u16.value);
-        } else if (subtype == 26) {
-            if (fp_read(self, value.u32.buf, sizeof(uint32_t)) == -1)
-                return -1;
-            *length = be32toh(value.u32.value);
-        } else {
-            if (fp_read(self, value.u64.buf, sizeof(uint64_t)) == -1)
-                return -1;
-            *length = be64toh(value.u64.value);
-        }
-        if (indefinite)
-            *indefinite = false;
-        return 0;
-    } else if (subtype == 31 && indefinite && *indefinite) {
-        // well, indefinite is already true so nothing to see here...
-        return 0;
-    } else {
-        PyErr_Format(
-            _CBOR2_CBORDecodeValueError,
-            "unknown unsigned integer subtype 0x%x", subtype);
+    if (!value) {
+        PyErr_SetString(PyExc_AttributeError,
+                        "cannot delete cache_keys attribute");
         return -1;
     }
+    enable = PyObject_IsTrue(value);
+    if (enable == -1)
+        return -1;
+    self->cache_keys = enable;
+    if (!enable)
+        key_cache_clear(self);
+    return 0;
+}
+
+
+// CBORDecoder._get_int_cache_size(self)
+static PyObject *
+_CBORDecoder_get_int_cache_size(CBORDecoderObject *self, void *closure)
+{
+    return PyLong_FromSsize_t(self->int_cache_size);
 }
 
+
+// CBORDecoder._set_int_cache_size(self, value)
 static int
-string_namespace_add(CBORDecoderObject *self, PyObject *string, uint64_t length)
+_CBORDecoder_set_int_cache_size(CBORDecoderObject *self, PyObject *value,
+                                void *closure)
 {
-    if (self->stringref_namespace != Py_None) {
-        uint64_t next_index = PyList_GET_SIZE(self->stringref_namespace);
-        bool is_referenced = true;
-        if (next_index < 24) {
-            is_referenced = length >= 3;
-        } else if (next_index < 256) {
-            is_referenced = length >= 4;
-        } else if (next_index < 65536) {
-            is_referenced = length >= 5;
-        } else if (next_index < 4294967296ull) {
-            is_referenced = length >= 7;
-        } else {
-            is_referenced = length >= 11;
-        }
+    Py_ssize_t size;
 
-        if (is_referenced) {
-            return PyList_Append(self->stringref_namespace, string);
-        }
+    if (!value) {
+        PyErr_SetString(PyExc_AttributeError,
+                        "cannot delete int_cache_size attribute");
+        return -1;
     }
-
+    if (!PyLong_Check(value)) {
+        PyErr_Format(PyExc_ValueError,
+                "invalid int_cache_size value %R (must be a non-negative "
+                "integer)", value);
+        return -1;
+    }
+    size = PyLong_AsSsize_t(value);
+    if (size == -1 && PyErr_Occurred())
+        return -1;
+    if (size < 0) {
+        PyErr_Format(PyExc_ValueError,
+                "invalid int_cache_size value %R (must be a non-negative "
+                "integer)", value);
+        return -1;
+    }
+    int_cache_clear(self);
+    self->int_cache_size = size;
     return 0;
 }
 
 
-// Major decoders ////////////////////////////////////////////////////////////
-
+// CBORDecoder._get_memoryview_size(self)
 static PyObject *
-decode_uint(CBORDecoderObject *self, uint8_t subtype)
+_CBORDecoder_get_memoryview_size(CBORDecoderObject *self, void *closure)
 {
-    // major type 0
-    uint64_t length;
-    PyObject *ret;
-
-    if (decode_length(self, subtype, &length, NULL) == -1)
-        return NULL;
-    ret = PyLong_FromUnsignedLongLong(length);
-    set_shareable(self, ret);
-    return ret;
+    if (self->memoryview_size == -1)
+        Py_RETURN_NONE;
+    return PyLong_FromSsize_t(self->memoryview_size);
 }
 
 
-static PyObject *
-decode_negint(CBORDecoderObject *self, uint8_t subtype)
+// CBORDecoder._set_memoryview_size(self, value)
+static int
+_CBORDecoder_set_memoryview_size(CBORDecoderObject *self, PyObject *value,
+                                 void *closure)
 {
-    // major type 1
-    PyObject *value, *one, *ret = NULL;
+    Py_ssize_t size;
 
-    value = decode_uint(self, subtype);
-    if (value) {
-        one = PyLong_FromLong(1);
-        if (one) {
-            ret = PyNumber_Negative(value);
-            if (ret) {
-                Py_DECREF(value);
-                value = ret;
-                ret = PyNumber_Subtract(value, one);
-                set_shareable(self, ret);
-            }
-            Py_DECREF(one);
-        }
-        Py_DECREF(value);
+    if (!value) {
+        PyErr_SetString(PyExc_AttributeError,
+                        "cannot delete memoryview_size attribute");
+        return -1;
     }
-    return ret;
+    if (value == Py_None) {
+        self->memoryview_size = -1;
+        return 0;
+    }
+    if (!PyLong_Check(value)) {
+        PyErr_Format(PyExc_ValueError,
+                "invalid memoryview_size value %R (must be a non-negative "
+                "integer or None)", value);
+        return -1;
+    }
+    size = PyLong_AsSsize_t(value);
+    if (size == -1 && PyErr_Occurred())
+        return -1;
+    if (size < 0) {
+        PyErr_Format(PyExc_ValueError,
+                "invalid memoryview_size value %R (must be a non-negative "
+                "integer or None)", value);
+        return -1;
+    }
+    self->memoryview_size = size;
+    return 0;
 }
 
 
-static PyObject *
-decode_definite_short_bytestring(CBORDecoderObject *self, Py_ssize_t length)
+// Sets one of the limits on each value decoded (*limit is max_items,
+// max_length or max_allocation) from a non-negative int or None
+static int
+set_limit(CBORDecoderObject *self, Py_ssize_t *limit, const char *name,
+          PyObject *value)
 {
-    PyObject *ret = fp_read_object(self, length);
-    if (!ret)
-        return NULL;
+    Py_ssize_t size = -1;
 
-    if (string_namespace_add(self, ret, length) == -1) {
-        Py_DECREF(ret);
-        return NULL;
+    if (!value) {
+        PyErr_Format(PyExc_AttributeError,
+                     "cannot delete %s attribute", name);
+        return -1;
     }
-    return ret;
+    if (value != Py_None) {
+        if (PyLong_Check(value)) {
+            size = PyLong_AsSsize_t(value);
+            if (size == -1 && PyErr_Occurred())
+                return -1;
+        }
+        if (size < 0) {
+            PyErr_Format(PyExc_ValueError,
+                    "invalid %s value %R (must be a non-negative integer or "
+                    "None)", name, value);
+            return -1;
+        }
+    }
+    *limit = size;
+    self->limited = self->max_items != -1 || self->max_length != -1 ||
+                    self->max_allocation != -1;
+    self->tracking = self->limited || self->collect_stats;
+    return 0;
 }
 
 
 static PyObject *
-decode_definite_long_bytestring(CBORDecoderObject *self, Py_ssize_t length)
+get_limit(Py_ssize_t limit)
 {
-    PyObject *buffer = NULL;
-    Py_ssize_t left = length;
-    while (left) {
-        Py_ssize_t chunk_length = left <= 65536 ? left : 65536;
-        PyObject *chunk = fp_read_object(self, chunk_length);
-        if (!chunk) {
-            goto error;
-        }
-
-        if (!PyBytes_CheckExact(chunk)) {
-            Py_DECREF(chunk);
-            goto error;
-        }
+    if (limit == -1)
+        Py_RETURN_NONE;
+    return PyLong_FromSsize_t(limit);
+}
 
-        if (buffer) {
-            PyObject *new_buffer = PyByteArray_Concat(buffer, chunk);
-            Py_DECREF(chunk);
-            if (!new_buffer)
-                goto error;
 
-            if (new_buffer != buffer) {
-                Py_DECREF(buffer);
-                buffer = new_buffer;
-            }
-        } else {
-            buffer = PyByteArray_FromObject(chunk);
-            Py_DECREF(chunk);
-            if (!buffer)
-                goto error;
-        }
-        left -= chunk_length;
-    }
+// CBORDecoder._get_max_items(self)
+static PyObject *
+_CBORDecoder_get_max_items(CBORDecoderObject *self, void *closure)
+{
+    return get_limit(self->max_items);
+}
 
-    PyObject *ret = NULL;
-    if (buffer) {
-        ret = PyBytes_FromObject(buffer);
-        Py_DECREF(buffer);
 
-        if (ret && string_namespace_add(self, ret, length) == -1) {
-            Py_DECREF(ret);
-            ret = NULL;
-        }
-    }
-    return ret;
-error:
-    Py_XDECREF(buffer);
-    return NULL;
+// CBORDecoder._set_max_items(self, value)
+static int
+_CBORDecoder_set_max_items(CBORDecoderObject *self, PyObject *value,
+                           void *closure)
+{
+    return set_limit(self, &self->max_items, "max_items", value);
 }
 
 
+// CBORDecoder._get_max_length(self)
 static PyObject *
-decode_indefinite_bytestrings(CBORDecoderObject *self)
+_CBORDecoder_get_max_length(CBORDecoderObject *self, void *closure)
 {
-    PyObject *list, *ret = NULL;
-    LeadByte lead;
-
-    list = PyList_New(0);
-    if (list) {
-        while (1) {
-            if (fp_read(self, &lead.byte, 1) == -1)
-                break;
-            if (lead.major == 2 && lead.subtype != 31) {
-                ret = decode_bytestring(self, lead.subtype);
-                if (ret) {
-                    PyList_Append(list, ret);
-                    Py_DECREF(ret);
-                    ret = NULL;
-                } else {
-                    break;
-                }
-            } else if (lead.major == 7 && lead.subtype == 31) { // break-code
-                ret = PyObject_CallMethodObjArgs(
-                        _CBOR2_empty_bytes, _CBOR2_str_join, list, NULL);
-                break;
-            } else {
-                PyErr_SetString(
-                    _CBOR2_CBORDecodeValueError,
-                    "non-bytestring found in indefinite length bytestring");
-                break;
-            }
-        }
-        Py_DECREF(list);
-    }
-    return ret;
+    return get_limit(self->max_length);
 }
 
 
-static PyObject *
-decode_bytestring(CBORDecoderObject *self, uint8_t subtype)
+// CBORDecoder._set_max_length(self, value)
+static int
+_CBORDecoder_set_max_length(CBORDecoderObject *self, PyObject *value,
+                            void *closure)
 {
-    // major type 2
-    uint64_t length = 0;
-    bool indefinite = true;
-    PyObject *ret;
-    char length_hex[17];
+    return set_limit(self, &self->max_length, "max_length", value);
+}
 
-    if (decode_length(self, subtype, &length, &indefinite) == -1)
-        return NULL;
 
-    if (length > (uint64_t)PY_SSIZE_T_MAX - (uint64_t)PyBytesObject_SIZE) {
-        sprintf(length_hex, "%" PRIX64, length);
-        PyErr_Format(
-                _CBOR2_CBORDecodeValueError,
-                "excessive bytestring size 0x%s", length_hex);
-        return NULL;
-    }
-    if (indefinite)
-        ret = decode_indefinite_bytestrings(self);
-    else if (length <= 65536)
-        ret = decode_definite_short_bytestring(self, (Py_ssize_t)length);
-    else
-        ret = decode_definite_long_bytestring(self, (Py_ssize_t)length);
+// CBORDecoder._get_max_allocation(self)
+static PyObject *
+_CBORDecoder_get_max_allocation(CBORDecoderObject *self, void *closure)
+{
+    return get_limit(self->max_allocation);
+}
 
-    if (ret)
-        set_shareable(self, ret);
 
-    return ret;
+// CBORDecoder._set_max_allocation(self, value)
+static int
+_CBORDecoder_set_max_allocation(CBORDecoderObject *self, PyObject *value,
+                                void *closure)
+{
+    return set_limit(self, &self->max_allocation, "max_allocation", value);
 }
 
 
-// NOTE: It may seem redundant to repeat the definite and indefinite routines
-// to handle UTF-8 strings but there is a reason to do this separately.
-// Specifically, the CBOR spec states (in sec. 2.2):
-//
-//     Text strings with indefinite lengths act the same as byte strings with
-//     indefinite lengths, except that all their chunks MUST be definite-length
-//     text strings.  Note that this implies that the bytes of a single UTF-8
-//     character cannot be spread between chunks: a new chunk can only be
-//     started at a character boundary.
-//
-// This precludes using the indefinite bytestring decoder above as that would
-// happily ignore UTF-8 characters split across chunks.
+// CBORDecoder._get_collect_stats(self)
+static PyObject *
+_CBORDecoder_get_collect_stats(CBORDecoderObject *self, void *closure)
+{
+    if (self->collect_stats)
+        Py_RETURN_TRUE;
+    else
+        Py_RETURN_FALSE;
+}
 
 
-static PyObject *
-decode_definite_short_string(CBORDecoderObject *self, Py_ssize_t length)
+// CBORDecoder._set_collect_stats(self, value)
+static int
+_CBORDecoder_set_collect_stats(CBORDecoderObject *self, PyObject *value,
+                               void *closure)
 {
-    PyObject *bytes_obj = fp_read_object(self, length);
-    if (!bytes_obj)
-        return NULL;
+    int enable;
 
-    const char *bytes = PyBytes_AS_STRING(bytes_obj);
-    PyObject *ret = PyUnicode_FromStringAndSize(bytes, length);
-    Py_DECREF(bytes_obj);
-    if (ret && string_namespace_add(self, ret, length) == -1) {
-        Py_DECREF(ret);
-        return NULL;
+    if (!value) {
+        PyErr_SetString(PyExc_AttributeError,
+                        "cannot delete collect_stats attribute");
+        return -1;
     }
-    return ret;
+    enable = PyObject_IsTrue(value);
+    if (enable == -1)
+        return -1;
+    // Counting starts afresh each time it's enabled
+    memset(&self->stats, 0, sizeof(DecoderStats));
+    self->collect_stats = enable;
+    self->tracking = self->limited || self->collect_stats;
+    return 0;
 }
 
 
+// CBORDecoder._get_stats(self)
 static PyObject *
-decode_definite_long_string(CBORDecoderObject *self, Py_ssize_t length)
+_CBORDecoder_get_stats(CBORDecoderObject *self, void *closure)
 {
-    PyObject *ret = NULL, *chunk = NULL, *string = NULL;
-    Py_ssize_t left = length;
-    Py_ssize_t consumed;
-    Py_ssize_t buffer_size = 0;  // how many bytes are allocated for the buffer
-    Py_ssize_t buffer_length = 0;  // how many bytes are actually stored in the buffer
-    char *buffer = NULL;
-    while (left) {
-        // Read up to 65536 bytes of data from the stream
-        Py_ssize_t chunk_length = 65536 - buffer_size;
-        if (left < chunk_length)
-            chunk_length = left;
-
-        PyObject *chunk = fp_read_object(self, chunk_length);
-        left -= chunk_length;
-        if (!chunk)
-            goto error;
-
-        // Get the internal buffer of the bytes object
-        char *bytes_buffer = PyBytes_AsString(chunk);
-        if (!bytes_buffer)
-            goto error;
+    DecoderStats *stats = &self->stats;
 
-        char *source_buffer;
-        if (buffer) {
-            // Grow the buffer to accommodate the previous data plus the new chunk
-            if (buffer_length + chunk_length > buffer_size) {
-                buffer_size = buffer_length + chunk_length;
-                char *new_buffer = PyMem_Realloc(buffer, buffer_size);
-                if (!new_buffer)
-                    goto error;
-
-                buffer = new_buffer;
-            }
+    if (!self->collect_stats)
+        Py_RETURN_NONE;
+    return Py_BuildValue(
+            "{sn sn s(nnnnnnnn) sn sn sn}",
+            "bytes_read", stats->bytes_read,
+            "read_calls", stats->read_calls,
+            "items", stats->items[0], stats->items[1], stats->items[2],
+            stats->items[3], stats->items[4], stats->items[5],
+            stats->items[6], stats->items[7],
+            "tag_hook_calls", stats->tag_hook_calls,
+            "object_hook_calls", stats->object_hook_calls,
+            "max_depth", stats->max_depth);
+}
 
-            // Concatenate the chunk into the buffer
-            memcpy(buffer + buffer_length, bytes_buffer, chunk_length);
-            buffer_length += chunk_length;
 
-            source_buffer = buffer;
-            chunk_length = buffer_length;
-        } else {
-            // Use the chunk's internal buffer directly to decode as many characters as possible
-            source_buffer = bytes_buffer;
-        }
+// CBORDecoder._get_raw_tags(self)
+static PyObject *
+_CBORDecoder_get_raw_tags(CBORDecoderObject *self, void *closure)
+{
+    Py_INCREF(self->raw_tags);
+    return self->raw_tags;
+}
 
-        consumed = chunk_length;  // workaround for https://github.com/python/cpython/issues/99612
-        string = PyUnicode_DecodeUTF8Stateful(source_buffer, chunk_length, NULL, &consumed);
-        if (!string)
-            goto error;
 
-        if (ret) {
-            // Concatenate the result to the existing result
-            PyObject *joined = PyUnicode_Concat(ret, string);
-            if (!joined)
-                goto error;
+// CBORDecoder._set_raw_tags(self, value)
+static int
+_CBORDecoder_set_raw_tags(CBORDecoderObject *self, PyObject *value,
+                          void *closure)
+{
+    PyObject *tmp, *iter, *item;
+    bool valid = true;
 
-            Py_DECREF(string);
-            string = NULL;
-            ret = joined;
+    if (!value) {
+        PyErr_SetString(PyExc_AttributeError,
+                        "cannot delete raw_tags attribute");
+        return -1;
+    }
+    if (value == Py_None) {
+        Py_INCREF(value);
+        tmp = value;
+    } else {
+        tmp = PyFrozenSet_New(value);
+        if (!tmp) {
+            if (!PyErr_ExceptionMatches(PyExc_TypeError))
+                return -1;
+            PyErr_Clear();
+            valid = false;
         } else {
-            // Set the result to the decoded string
-            ret = string;
-        }
-
-        Py_ssize_t unconsumed = chunk_length - consumed;
-        if (consumed != chunk_length) {
-            if (buffer) {
-                // Move the unconsumed bytes to the start of the buffer
-                memmove(buffer, buffer + consumed, unconsumed);
-            } else {
-                // Create a new buffer
-                buffer = PyMem_Malloc(unconsumed);
-                if (!buffer)
-                    goto error;
-
-                memcpy(buffer, bytes_buffer + consumed, unconsumed);
+            iter = PyObject_GetIter(tmp);
+            if (!iter) {
+                Py_DECREF(tmp);
+                return -1;
+            }
+            while (valid && (item = PyIter_Next(iter))) {
+                valid = PyLong_Check(item);
+                Py_DECREF(item);
             }
-            buffer_length = unconsumed;
+            Py_DECREF(iter);
+            if (!valid)
+                Py_DECREF(tmp);
+        }
+        if (!valid) {
+            PyErr_Format(PyExc_ValueError,
+                    "invalid raw_tags value %R (must be a collection of "
+                    "integers or None)", value);
+            return -1;
         }
     }
+    Py_SETREF(self->raw_tags, tmp);
+    return 0;
+}
 
-    if (ret && string_namespace_add(self, ret, length) == -1)
-        goto error;
-
-    return ret;
-error:
-    Py_XDECREF(ret);
-    Py_XDECREF(chunk);
-    Py_XDECREF(string);
-    if (buffer)
-        PyMem_Free(buffer);
 
-    return NULL;
+// CBORDecoder._get_raw_keys(self)
+static PyObject *
+_CBORDecoder_get_raw_keys(CBORDecoderObject *self, void *closure)
+{
+    Py_INCREF(self->raw_keys);
+    return self->raw_keys;
 }
 
 
-static PyObject *
-decode_indefinite_strings(CBORDecoderObject *self)
+// CBORDecoder._set_raw_keys(self, value)
+static int
+_CBORDecoder_set_raw_keys(CBORDecoderObject *self, PyObject *value,
+                          void *closure)
 {
-    PyObject *list, *ret = NULL;
-    LeadByte lead;
+    PyObject *tmp;
 
-    list = PyList_New(0);
-    if (list) {
-        while (1) {
-            if (fp_read(self, &lead.byte, 1) == -1)
-                break;
-            if (lead.major == 3 && lead.subtype != 31) {
-                ret = decode_string(self, lead.subtype);
-                if (ret) {
-                    PyList_Append(list, ret);
-                    Py_DECREF(ret);
-                    ret = NULL;
-                } else {
-                    break;
-                }
-            } else if (lead.major == 7 && lead.subtype == 31) { // break-code
-                ret = PyObject_CallMethodObjArgs(
-                        _CBOR2_empty_str, _CBOR2_str_join, list, NULL);
-                break;
-            } else {
-                PyErr_SetString(
-                    _CBOR2_CBORDecodeValueError,
-                    "non-string found in indefinite length string");
-                break;
+    if (!value) {
+        PyErr_SetString(PyExc_AttributeError,
+                        "cannot delete raw_keys attribute");
+        return -1;
+    }
+    if (value == Py_None) {
+        Py_INCREF(value);
+        tmp = value;
+    } else {
+        tmp = PyFrozenSet_New(value);
+        if (!tmp) {
+            if (PyErr_ExceptionMatches(PyExc_TypeError)) {
+                PyErr_Clear();
+                PyErr_Format(PyExc_ValueError,
+                        "invalid raw_keys value %R (must be a collection of "
+                        "hashable values or None)", value);
             }
+            return -1;
         }
-        Py_DECREF(list);
     }
-    return ret;
+    Py_SETREF(self->raw_keys, tmp);
+    return 0;
 }
 
 
+// CBORDecoder._get_immutable(self, value)
 static PyObject *
-decode_string(CBORDecoderObject *self, uint8_t subtype)
+_CBORDecoder_get_immutable(CBORDecoderObject *self, void *closure)
 {
-    // major type 3
-    uint64_t length = 0;
-    bool indefinite = true;
-    PyObject *ret;
-    char length_hex[17];
-
-    if (decode_length(self, subtype, &length, &indefinite) == -1)
-        return NULL;
-    if (length > (uint64_t)PY_SSIZE_T_MAX - (uint64_t)PyBytesObject_SIZE) {
-        sprintf(length_hex, "%" PRIX64, length);
-        PyErr_Format(
-                _CBOR2_CBORDecodeValueError,
-                "excessive string size 0x%s", length_hex);
-        return NULL;
-    }
-    if (indefinite)
-        ret = decode_indefinite_strings(self);
-    else if (length <= 65536)
-        ret = decode_definite_short_string(self, (Py_ssize_t)length);
+    if (self->immutable)
+        Py_RETURN_TRUE;
     else
-        ret = decode_definite_long_string(self, (Py_ssize_t)length);
+        Py_RETURN_FALSE;
+}
 
-    if (!ret && PyErr_GivenExceptionMatches(PyErr_Occurred(), PyExc_UnicodeDecodeError))
-        raise_from(_CBOR2_CBORDecodeValueError, "error decoding unicode string");
 
-    set_shareable(self, ret);
-    return ret;
+// Utility functions /////////////////////////////////////////////////////////
+
+static void
+raise_from(PyObject *new_exc_type, const char *message) {
+    // This requires the error indicator to be set
+    PyObject *cause;
+#if PY_VERSION_HEX >= 0x030c0000
+    cause = PyErr_GetRaisedException();
+#else
+    PyObject *exc_type, *exc_traceback;
+    PyErr_Fetch(&exc_type, &cause, &exc_traceback);
+    PyErr_NormalizeException(&exc_type, &cause, &exc_traceback);
+    Py_XDECREF(exc_type);
+    Py_XDECREF(exc_traceback);
+#endif
+
+    PyObject *msg_obj = PyUnicode_FromString(message);
+    if (message) {
+        PyObject *new_exception = PyObject_CallFunctionObjArgs(
+            new_exc_type, msg_obj, NULL);
+        if (new_exception) {
+            PyException_SetCause(new_exception, cause);
+            PyErr_SetObject(new_exc_type, new_exception);
+        }
+        Py_DECREF(msg_obj);
+    }
 }
 
+static void
+raise_premature_eof(const Py_ssize_t expected, const Py_ssize_t got)
+{
+    PyErr_Format(
+        _CBOR2_CBORDecodeEOF,
+        "premature end of stream (expected to read %zd bytes, "
+        "got %zd instead)", expected, got);
+}
 
-static PyObject *
-decode_indefinite_array(CBORDecoderObject *self)
+
+// When decoding from an in-memory buffer (see decode_from_bytes), returns a
+// pointer to the next size bytes of the input and advances past them.
+// Returns NULL and raises CBORDecodeEOF if the input is too short
+static inline const char *
+input_consume(CBORDecoderObject *self, const Py_ssize_t size)
 {
-    PyObject *array, *item, *ret = NULL;
+    const char *ret = NULL;
+    Py_ssize_t left = self->input.len - self->input_pos;
 
-    array = PyList_New(0);
-    if (array) {
-        ret = array;
-        set_shareable(self, array);
-        while (ret) {
-            item = decode(self, DECODE_UNSHARED);
-            if (item == break_marker) {
-                Py_DECREF(item);
-                break;
-            } else if (item) {
-                if (PyList_Append(array, item) == -1)
-                    ret = NULL;
-                Py_DECREF(item);
-            } else
-                ret = NULL;
-        }
-        if (ret && self->immutable) {
-            ret = PyList_AsTuple(array);
-            if (ret) {
-                Py_DECREF(array);
-                // There's a potential here for an indefinite length recursive
-                // array to wind up with a strange representation (the outer
-                // being a tuple, the inners all being a list). However, a
-                // recursive tuple isn't valid in the first place so it's a bit
-                // of a waste of time searching for recursive references just
-                // to throw an error
-                set_shareable(self, ret);
-            } else
-                ret = NULL;
-        }
-        if (!ret)
-            Py_DECREF(array);
-    }
+    if (size <= left) {
+        ret = (const char *) self->input.buf + self->input_pos;
+        self->input_pos += size;
+    } else
+        raise_premature_eof(size, left);
     return ret;
 }
 
 
-static PyObject *
-decode_definite_array(CBORDecoderObject *self, Py_ssize_t length)
+static inline Py_ssize_t
+read_ahead_length(CBORDecoderObject *self)
 {
-    Py_ssize_t i;
-    PyObject *array, *item, *ret = NULL;
-    if (length > 65536) {
-        // Let cPython manage allocation of huge lists by appending
-        // items one-by-one
-        array = PyList_New(0);
-        if (array) {
-            ret = array;
-            set_shareable(self, array);
-            for (i = 0; i < length; ++i) {
-                item = decode(self, DECODE_UNSHARED);
-                if (item) {
-                    if (PyList_Append(array, item) == -1) {
-                        ret = NULL;
-                        Py_DECREF(item);
-                        break;
-                    }
-                    Py_DECREF(item);
-                } else {
-                    ret = NULL;
-                    break;
-                }
-            }
-            if (ret && self->immutable) {
-                ret = PyList_AsTuple(array);
-                if (ret) {
-                    Py_DECREF(array);
-                    // There's a potential here for an indefinite length recursive
-                    // array to wind up with a strange representation (the outer
-                    // being a tuple, the inners all being a list). However, a
-                    // recursive tuple isn't valid in the first place so it's a bit
-                    // of a waste of time searching for recursive references just
-                    // to throw an error
-                    set_shareable(self, ret);
-                } else
-                    ret = NULL;
-            }
-            if (!ret)
-                Py_DECREF(array);
-        }
-    } else {
-        if (self->immutable) {
-            array = PyTuple_New(length);
-            if (array) {
-                ret = array;
-                for (i = 0; i < length; ++i) {
-                    item = decode(self, DECODE_UNSHARED);
-                    if (item)
-                        PyTuple_SET_ITEM(array, i, item);
-                    else {
-                        ret = NULL;
-                        break;
-                    }
-                }
-            }
-            // This is done *after* the construction of the tuple because while
-            // it's valid for a tuple object to be shared, it's not valid for it to
-            // contain a reference to itself (because a reference to it can't exist
-            // during its own construction ... in Python at least; as can be seen
-            // above this *is* theoretically possible at the C level).
-            set_shareable(self, ret);
-        } else {
-            array = PyList_New(length);
-            if (array) {
-                ret = array;
-                set_shareable(self, array);
-                for (i = 0; i < length; ++i) {
-                    item = decode(self, DECODE_UNSHARED);
-                    if (item)
-                        PyList_SET_ITEM(array, i, item);
-                    else {
-                        ret = NULL;
-                        break;
-                    }
-                }
-            }
-        }
-        if (!ret)
-            Py_DECREF(array);
-    }
-    return ret;
+    return self->readahead ?
+        PyBytes_GET_SIZE(self->readahead) - self->read_pos : 0;
 }
 
 
-static PyObject *
-decode_array(CBORDecoderObject *self, uint8_t subtype)
+static inline Py_ssize_t
+read_ahead_size(CBORDecoderObject *self)
 {
-    // major type 4
-    uint64_t length;
-    bool indefinite = true;
-    char length_hex[17];
+    // Reading ahead of what's needed is only safe by default if the excess
+    // can be handed back to fp afterwards (see release_read_ahead)
+    if (self->read_size)
+        return self->read_size;
+    return self->seek != Py_None ? 65536 : 1;
+}
 
-    if (decode_length(self, subtype, &length, &indefinite) == -1)
-        return NULL;
-    if (indefinite)
-        return decode_indefinite_array(self);
-    if (length > (uint64_t)PY_SSIZE_T_MAX) {
-        sprintf(length_hex, "%" PRIX64, length);
-        PyErr_Format(
-                _CBOR2_CBORDecodeValueError,
-                "excessive array size 0x%s", length_hex);
-        return NULL;
-    } else
-        return decode_definite_array(self, (Py_ssize_t) length);
+
+// Calls fp.seek(offset, whence), setting *pos (if not NULL) to the position
+// it returns
+static int
+fp_seek(CBORDecoderObject *self, Py_ssize_t offset, int whence,
+        Py_ssize_t *pos)
+{
+    PyObject *obj;
+    Py_ssize_t ret;
+
+    obj = PyObject_CallFunction(self->seek, "ni", offset, whence);
+    if (!obj)
+        return -1;
+    ret = pos ? PyLong_AsSsize_t(obj) : 0;
+    Py_DECREF(obj);
+    if (ret == -1 && PyErr_Occurred())
+        return -1;
+    if (pos)
+        *pos = ret;
+    return 0;
 }
 
 
 static PyObject *
-decode_map(CBORDecoderObject *self, uint8_t subtype)
+fp_call_read(CBORDecoderObject *self, const Py_ssize_t size)
 {
-    // major type 5
-    uint64_t length;
-    bool indefinite = true;
-    PyObject *map, *key, *value, *ret = NULL;
+    PyObject *ret = NULL, *size_obj;
 
-    map = PyDict_New();
-    if (map) {
-        ret = map;
-        set_shareable(self, map);
-        if (decode_length(self, subtype, &length, &indefinite) == 0) {
-            if (indefinite) {
-                while (ret) {
-                    key = decode(self, DECODE_IMMUTABLE | DECODE_UNSHARED);
-                    if (key == break_marker) {
-                        Py_DECREF(key);
-                        break;
-                    } else if (key) {
-                        value = decode(self, DECODE_UNSHARED);
-                        if (value) {
-                            if (PyDict_SetItem(map, key, value) == -1)
-                                ret = NULL;
-                            Py_DECREF(value);
-                        } else
-                            ret = NULL;
-                        Py_DECREF(key);
-                    } else
-                        ret = NULL;
-                }
-            } else {
-                while (ret && length--) {
-                    key = decode(self, DECODE_IMMUTABLE | DECODE_UNSHARED);
-                    if (key) {
-                        value = decode(self, DECODE_UNSHARED);
-                        if (value) {
-                            if (PyDict_SetItem(map, key, value) == -1)
-                                ret = NULL;
-                            Py_DECREF(value);
-                        } else
-                            ret = NULL;
-                        Py_DECREF(key);
-                    } else
-                        ret = NULL;
-                }
-            }
-        } else
-            ret = NULL;
-        if (!ret)
-            Py_DECREF(map);
+    // fp has to catch up with the end of the read-ahead buffer first
+    if (self->rewound) {
+        if (fp_seek(self, self->rewound, SEEK_CUR, NULL) == -1)
+            return NULL;
+        self->rewound = 0;
     }
-    if (ret && self->immutable) {
-        // _CBOR2_FrozenDict is initialized in CBORDecoder_init
-        map = PyObject_CallFunctionObjArgs(_CBOR2_FrozenDict, ret, NULL);
-        if (map) {
-            set_shareable(self, map);
-            Py_DECREF(ret);
-            ret = map;
+    size_obj = PyLong_FromSsize_t(size);
+    if (size_obj) {
+        ret = PyObject_CallFunctionObjArgs(self->read, size_obj, NULL);
+        Py_DECREF(size_obj);
+        self->stats.read_calls++;
+        if (ret && !PyBytes_Check(ret)) {
+            PyErr_Format(PyExc_TypeError,
+                    "fp.read() returned %R instead of bytes",
+                    (PyObject *) Py_TYPE(ret));
+            Py_CLEAR(ret);
         }
+        if (ret)
+            self->fetched += PyBytes_GET_SIZE(ret);
     }
-    if (ret && self->object_hook != Py_None) {
-        map = PyObject_CallFunctionObjArgs(self->object_hook, self, ret, NULL);
-        if (!map)
-            return NULL;
+    return ret;
+}
 
-        set_shareable(self, map);
-        Py_DECREF(ret);
-        ret = map;
+
+// When decoding from fp, returns a pointer to the next size bytes of the
+// read-ahead buffer and advances past them, first topping the buffer up with
+// at least read_size bytes from fp if it doesn't hold enough. The pointer is
+// only valid until the next call. Returns NULL and raises CBORDecodeEOF if fp
+// runs out first (whatever was read remains in the buffer)
+static const char *
+read_ahead_consume(CBORDecoderObject *self, const Py_ssize_t size)
+{
+    PyObject *chunk, *joined;
+    Py_ssize_t left, want, read_size;
+    const char *ret;
+
+    left = read_ahead_length(self);
+    if (size > left) {
+        read_size = read_ahead_size(self);
+        want = size - left;
+        if (want < read_size)
+            want = read_size;
+        chunk = fp_call_read(self, want);
+        if (!chunk)
+            return NULL;
+        if (left) {
+            joined = PyBytes_FromStringAndSize(NULL, left + PyBytes_GET_SIZE(chunk));
+            if (joined) {
+                memcpy(PyBytes_AS_STRING(joined),
+                        PyBytes_AS_STRING(self->readahead) + self->read_pos, left);
+                memcpy(PyBytes_AS_STRING(joined) + left,
+                        PyBytes_AS_STRING(chunk), PyBytes_GET_SIZE(chunk));
+            }
+            Py_DECREF(chunk);
+            if (!joined)
+                return NULL;
+            chunk = joined;
+        }
+        Py_XDECREF(self->readahead);
+        self->readahead = chunk;
+        self->read_pos = 0;
+        left = PyBytes_GET_SIZE(chunk);
+        if (size > left) {
+            raise_premature_eof(size, left);
+            return NULL;
+        }
+    } else if (!size)
+        return "";
+    self->read_pos += size;
+    ret = PyBytes_AS_STRING(self->readahead) + self->read_pos - size;
+    if (self->raw_capture) {
+        // See decode_raw()
+        left = PyByteArray_GET_SIZE(self->raw_capture);
+        if (PyByteArray_Resize(self->raw_capture, left + size) == -1)
+            return NULL;
+        memcpy(PyByteArray_AS_STRING(self->raw_capture) + left, ret, size);
     }
     return ret;
 }
 
 
-// Semantic decoders /////////////////////////////////////////////////////////
-
-static PyObject *
-decode_semantic(CBORDecoderObject *self, uint8_t subtype)
+// Returns a pointer to the next size bytes of input (valid until the next
+// read) and advances past them
+static inline const char *
+fp_read_ptr(CBORDecoderObject *self, const Py_ssize_t size)
 {
-    // major type 6
-    uint64_t tagnum;
-    PyObject *tag, *value, *ret = NULL;
+    if (self->input.buf)
+        return input_consume(self, size);
+    else
+        return read_ahead_consume(self, size);
+}
 
-    if (decode_length(self, subtype, &tagnum, NULL) == 0) {
+
+// An exception set aside while cleaning up after it, or taken from one thread
+// to be raised again in another
+typedef struct {
+    PyObject *type;
+    PyObject *value;
+    PyObject *traceback;
+} SavedError;
+
+
+// Takes the exception currently raised, leaving the error indicator clear
+static void
+save_error(SavedError *error)
+{
+#if PY_VERSION_HEX >= 0x030c0000
+    error->value = PyErr_GetRaisedException();
+#else
+    PyErr_Fetch(&error->type, &error->value, &error->traceback);
+#endif
+}
+
+
+// Raises the exception saved by save_error again, giving up the references
+static void
+restore_error(SavedError *error)
+{
+#if PY_VERSION_HEX >= 0x030c0000
+    PyErr_SetRaisedException(error->value);
+#else
+    PyErr_Restore(error->type, error->value, error->traceback);
+#endif
+    memset(error, 0, sizeof(SavedError));
+}
+
+
+static void
+discard_error(SavedError *error)
+{
+    Py_CLEAR(error->type);
+    Py_CLEAR(error->value);
+    Py_CLEAR(error->traceback);
+}
+
+
+// Every call that reads fp at the top level (decode(), iteration, skip() and
+// so on) is bracketed by fp_acquire() and fp_release(), so that fp is left
+// just after what was consumed, as if it had been read exactly, and nothing of
+// it is held between calls:
+//
+// * An fp with a buffer (such as an mmap) is decoded from a view of it taken
+//   at fp.tell(), which fp_release() releases after seeking fp to the end of
+//   what was decoded
+// * A seekable fp is moved back over whatever is left in the read-ahead
+//   buffer. The buffer is kept, and used by the next call if fp is still
+//   where it was left; fp_call_read() moves fp forward again before reading
+//   more from it
+//
+// fp_acquire() returns 1 if the caller must call fp_release(), 0 if the call
+// is nested in another (or isn't reading fp at all), or -1 on error
+static int
+fp_acquire(CBORDecoderObject *self)
+{
+    PyObject *obj;
+    Py_ssize_t pos;
+
+    if (self->fp_acquired || self->input.buf)
+        return 0;
+    if (self->fp_buffer || self->rewound) {
+        obj = PyObject_CallFunctionObjArgs(self->tell, NULL);
+        if (!obj)
+            return -1;
+        pos = PyLong_AsSsize_t(obj);
+        Py_DECREF(obj);
+        if (pos == -1 && PyErr_Occurred())
+            return -1;
+        if (self->fp_buffer) {
+            if (PyObject_GetBuffer(self->fp_buffer, &self->input,
+                                   PyBUF_SIMPLE) == 0) {
+                if (pos > self->input.len)
+                    pos = self->input.len;
+                self->input_pos = pos < 0 ? 0 : pos;
+                self->fp_input = true;
+            } else {
+                // fp is read through its read() method instead
+                PyErr_Clear();
+                self->input.buf = NULL;
+                self->input.obj = NULL;
+            }
+        } else if (pos != self->rewound_pos) {
+            // fp has been moved since, so what was read ahead is stale
+            Py_CLEAR(self->readahead);
+            self->read_pos = 0;
+            self->rewound = 0;
+        }
+    }
+    self->fp_acquired = true;
+    return 1;
+}
+
+
+// Ends a call begun with fp_acquire(), passing through its result (ret, which
+// is NULL if it failed)
+static PyObject *
+fp_release(CBORDecoderObject *self, PyObject *ret)
+{
+    SavedError error;
+    Py_ssize_t left = read_ahead_length(self), delta;
+    int err = 0;
+
+    self->fp_acquired = false;
+    if (!ret)
+        save_error(&error);
+    if (self->fp_input) {
+        err = fp_seek(self, self->input_pos, SEEK_SET, NULL);
+        PyBuffer_Release(&self->input);
+        self->input.buf = NULL;
+        self->input.obj = NULL;
+        self->input_pos = 0;
+        self->fp_input = false;
+    } else if (self->seek != Py_None && (left || self->rewound)) {
+        delta = self->rewound - left;
+        if (delta)
+            err = fp_seek(self, delta, SEEK_CUR, &self->rewound_pos);
+        if (err == 0) {
+            self->rewound = left;
+            if (!left) {
+                Py_CLEAR(self->readahead);
+                self->read_pos = 0;
+            }
+        }
+    }
+    if (!ret) {
+        PyErr_Clear();
+        restore_error(&error);
+    } else if (err == -1)
+        Py_CLEAR(ret);
+    return ret;
+}
+
+
+// Copies size bytes of the in-memory input at data to dest. Large copies are
+// made with the GIL released so that other threads can run in the meantime;
+// the input object is kept alive throughout in case another thread switches
+// this decoder to different input
+static void
+input_copy(CBORDecoderObject *self, char *dest, const char *data,
+           Py_ssize_t size)
+{
+    PyObject *owner;
+
+    if (size < NOGIL_COPY_SIZE) {
+        memcpy(dest, data, size);
+    } else {
+        owner = self->input.obj;
+        Py_XINCREF(owner);
+        Py_BEGIN_ALLOW_THREADS
+        memcpy(dest, data, size);
+        Py_END_ALLOW_THREADS
+        Py_XDECREF(owner);
+    }
+}
+
+
+static PyObject *
+fp_read_object(CBORDecoderObject *self, const Py_ssize_t size)
+{
+    PyObject *ret = NULL;
+    const char *data;
+
+    if (self->input.buf) {
+        data = input_consume(self, size);
+        if (data) {
+            ret = PyBytes_FromStringAndSize(NULL, size);
+            if (ret)
+                input_copy(self, PyBytes_AS_STRING(ret), data, size);
+        }
+    } else if (!read_ahead_length(self) && size >= read_ahead_size(self)) {
+        // Nothing buffered and the read is at least as big as the buffer
+        // would be; use the result of fp.read() directly
+        ret = fp_call_read(self, size);
+        if (ret && PyBytes_GET_SIZE(ret) != size) {
+            raise_premature_eof(size, PyBytes_GET_SIZE(ret));
+            Py_CLEAR(ret);
+        }
+    } else {
+        data = read_ahead_consume(self, size);
+        if (data)
+            ret = PyBytes_FromStringAndSize(data, size);
+    }
+    return ret;
+}
+
+
+// Makes room for at least size bytes in the scratch buffer, keeping what's
+// in use. The buffer at least doubles each time it has to grow
+static int
+scratch_reserve(CBORDecoderObject *self, Py_ssize_t size)
+{
+    Py_ssize_t new_size;
+    char *new_scratch;
+
+    if (size <= self->scratch_size)
+        return 0;
+    new_size = self->scratch_size ? self->scratch_size : 65536;
+    while (new_size < size)
+        new_size = new_size > PY_SSIZE_T_MAX / 2 ? size : new_size * 2;
+    new_scratch = PyMem_Realloc(self->scratch, new_size);
+    if (!new_scratch) {
+        PyErr_NoMemory();
+        return -1;
+    }
+    self->scratch = new_scratch;
+    self->scratch_size = new_size;
+    return 0;
+}
+
+
+// Appends the next length bytes of input to the scratch buffer. The decoder
+// keeps this buffer from one string to the next, so that long and indefinite
+// length strings are assembled in place without reallocating for every chunk
+// (or building a list of chunks to join), and then copied once into the
+// result. Without in-memory input to check the length against first, fp is
+// read in pieces no bigger than what's been read so far, so that a bogus
+// length in a short stream can't make the buffer grow out of hand
+static int
+scratch_read(CBORDecoderObject *self, Py_ssize_t length)
+{
+    PyObject *chunk;
+    const char *data;
+    Py_ssize_t piece;
+
+    if (length > PY_SSIZE_T_MAX - self->scratch_len) {
+        PyErr_SetString(_CBOR2_CBORDecodeValueError, "excessive string size");
+        return -1;
+    }
+    if (self->input.buf) {
+        data = input_consume(self, length);
+        if (!data || scratch_reserve(self, self->scratch_len + length) == -1)
+            return -1;
+        input_copy(self, self->scratch + self->scratch_len, data, length);
+        self->scratch_len += length;
+        return 0;
+    }
+    while (length) {
+        piece = self->scratch_len > 65536 ? self->scratch_len : 65536;
+        if (piece > length)
+            piece = length;
+        if (scratch_reserve(self, self->scratch_len + piece) == -1)
+            return -1;
+        if (piece <= 65536) {
+            // straight from the read-ahead buffer
+            data = fp_read_ptr(self, piece);
+            if (!data)
+                return -1;
+            memcpy(self->scratch + self->scratch_len, data, piece);
+        } else {
+            chunk = fp_read_object(self, piece);
+            if (!chunk)
+                return -1;
+            memcpy(self->scratch + self->scratch_len,
+                   PyBytes_AS_STRING(chunk), piece);
+            Py_DECREF(chunk);
+        }
+        self->scratch_len += piece;
+        length -= piece;
+    }
+    return 0;
+}
+
+
+// Empties the scratch buffer once whatever was assembled in it has been
+// copied out (or abandoned), freeing it if it's grown too big to keep
+static void
+scratch_release(CBORDecoderObject *self)
+{
+    self->scratch_len = 0;
+    if (self->scratch_size > SCRATCH_RETAIN_SIZE) {
+        PyMem_Free(self->scratch);
+        self->scratch = NULL;
+        self->scratch_size = 0;
+    }
+}
+
+
+static int
+fp_read(CBORDecoderObject *self, char *buf, const Py_ssize_t size)
+{
+    int ret = -1;
+    const char *data = fp_read_ptr(self, size);
+
+    if (data) {
+        memcpy(buf, data, size);
+        ret = 0;
+    }
+    return ret;
+}
+
+
+// CBORDecoder.read(self, length) -> bytes
+static PyObject *
+CBORDecoder_read(CBORDecoderObject *self, PyObject *length)
+{
+    PyObject *ret = NULL;
+    Py_ssize_t len;
+    int acquired;
+
+    len = PyLong_AsSsize_t(length);
+    if (PyErr_Occurred())
+        return NULL;
+    acquired = fp_acquire(self);
+    if (acquired == -1)
+        return NULL;
+    ret = PyBytes_FromStringAndSize(NULL, len);
+    if (ret) {
+        if (fp_read(self, PyBytes_AS_STRING(ret), len) == -1) {
+            Py_DECREF(ret);
+            ret = NULL;
+        }
+    }
+    return acquired ? fp_release(self, ret) : ret;
+}
+
+
+static inline void
+set_shareable(CBORDecoderObject *self, PyObject *value)
+{
+    if (value && self->shared_index != -1) {
+        Py_INCREF(value);  // PyList_SetItem "steals" reference
+        // TODO use weakrefs? or explicitly empty list?
+#ifndef NDEBUG
+        int ret =
+#endif
+        PyList_SetItem(self->shareables, self->shared_index, value);
+        assert(!ret);
+    }
+}
+
+
+// CBORDecoder.set_shareable(self, value)
+static PyObject *
+CBORDecoder_set_shareable(CBORDecoderObject *self, PyObject *value)
+{
+    set_shareable(self, value);
+    Py_RETURN_NONE;
+}
+
+
+// Limits and statistics /////////////////////////////////////////////////////
+
+// While tracking, every item goes through decode(), which counts it (see
+// count_item) and, for a top-level value, starts the value's limits afresh
+// and adds the input it consumed to the statistics once it's done
+
+// Returns the position in the input of the next byte to be decoded
+static inline Py_ssize_t
+input_position(CBORDecoderObject *self)
+{
+    if (self->input.buf)
+        return self->input_pos;
+    return self->fetched - read_ahead_length(self);
+}
+
+
+static void
+value_begin(CBORDecoderObject *self)
+{
+    self->items = 0;
+    self->allocated = 0;
+    self->value_start = input_position(self);
+}
+
+
+static void
+value_end(CBORDecoderObject *self)
+{
+    if (self->collect_stats)
+        self->stats.bytes_read += input_position(self) - self->value_start;
+}
+
+
+static int
+raise_too_many_items(CBORDecoderObject *self)
+{
+    PyErr_Format(_CBOR2_CBORDecodeValueError,
+                 "maximum number of items (%zd) exceeded", self->max_items);
+    return -1;
+}
+
+
+// Counts the item whose lead byte has just been read, nested in depth - 1
+// arrays, maps and tags. Like scan(), max_depth is the nesting of the deepest
+// array, map or tag, counting itself, so an empty array still counts
+static int
+count_item(CBORDecoderObject *self, LeadByte lead)
+{
+    Py_ssize_t depth;
+
+    if ((uint8_t) lead.byte == 0xFF)
+        return 0;  // a break code ends an item rather than being one
+    if (self->collect_stats) {
+        self->stats.items[lead.major]++;
+        depth = self->depth - (lead.major >= 4 && lead.major <= 6 ? 0 : 1);
+        if (depth > self->stats.max_depth)
+            self->stats.max_depth = depth;
+    }
+    if (self->max_items != -1 && ++self->items > self->max_items)
+        return raise_too_many_items(self);
+    return 0;
+}
+
+
+// Charges count times size bytes to the allocation of the current value; see
+// max_allocation
+static int
+charge_allocation(CBORDecoderObject *self, uint64_t count, Py_ssize_t size)
+{
+    if (self->max_allocation != -1) {
+        if (count > (uint64_t) (self->max_allocation - self->allocated) /
+                    (uint64_t) size) {
+            PyErr_Format(_CBOR2_CBORDecodeValueError,
+                         "maximum allocation (%zd bytes) exceeded",
+                         self->max_allocation);
+            return -1;
+        }
+        self->allocated += (Py_ssize_t) count * size;
+    }
+    return 0;
+}
+
+
+// Checks an array of length items (or map of length entries) against the
+// limits before anything is allocated for it. Its items are counted as
+// they're decoded, but there's no point starting on more than could fit
+static int
+check_container(CBORDecoderObject *self, uint64_t length, bool map)
+{
+    if (self->max_length != -1 && length > (uint64_t) self->max_length) {
+        PyErr_Format(_CBOR2_CBORDecodeValueError,
+                     "%s length %llu exceeds max_length (%zd)",
+                     map ? "map" : "array", (unsigned long long) length,
+                     self->max_length);
+        return -1;
+    }
+    if (self->max_items != -1 &&
+            length > (uint64_t) (self->max_items - self->items) / (map ? 2 : 1))
+        return raise_too_many_items(self);
+    return charge_allocation(self, length, map ? 16 : 8);
+}
+
+
+// Checks an indefinite length array (or map) that's about to reach length
+// items (or entries) against the limits
+static int
+check_indefinite(CBORDecoderObject *self, Py_ssize_t length, bool map)
+{
+    if (self->max_length != -1 && length > self->max_length) {
+        PyErr_Format(_CBOR2_CBORDecodeValueError,
+                     "%s length exceeds max_length (%zd)",
+                     map ? "map" : "array", self->max_length);
+        return -1;
+    }
+    return charge_allocation(self, 1, map ? 16 : 8);
+}
+
+
+static int
+decode_length(CBORDecoderObject *self, uint8_t subtype,
+        uint64_t *length, bool *indefinite)
+{
+    union {
+        union { uint64_t value; char buf[sizeof(uint64_t)]; } u64;
+        union { uint32_t value; char buf[sizeof(uint32_t)]; } u32;
+        union { uint16_t value; char buf[sizeof(uint16_t)]; } u16;
+        union { uint8_t value;  char buf[sizeof(uint8_t)];  } u8;
+    } value;
+
+    if (subtype < 28) {
+        if (subtype < 24) {
+            *length = subtype;
+        } else if (subtype == 24) {
+            if (fp_read(self, value.u8.buf, sizeof(uint8_t)) == -1)
+                return -1;
+            *length = value.u8.value;
+        } else if (subtype == 25) {
+            if (fp_read(self, value.u16.buf, sizeof(uint16_t)) == -1)
+                return -1;
+            *length = be16toh(value.u16.value);
+        } else if (subtype == 26) {
+            if (fp_read(self, value.u32.buf, sizeof(uint32_t)) == -1)
+                return -1;
+            *length = be32toh(value.u32.value);
+        } else {
+            if (fp_read(self, value.u64.buf, sizeof(uint64_t)) == -1)
+                return -1;
+            *length = be64toh(value.u64.value);
+        }
+        if (indefinite)
+            *indefinite = false;
+        return 0;
+    } else if (subtype == 31 && indefinite && *indefinite) {
+        // well, indefinite is already true so nothing to see here...
+        return 0;
+    } else {
+        PyErr_Format(
+            _CBOR2_CBORDecodeValueError,
+            "unknown unsigned integer subtype 0x%x", subtype);
+        return -1;
+    }
+}
+
+static int
+string_namespace_add(CBORDecoderObject *self, PyObject *string, uint64_t length)
+{
+    if (self->stringref_namespace != Py_None) {
+        uint64_t next_index = PyList_GET_SIZE(self->stringref_namespace);
+        bool is_referenced = true;
+        if (next_index < 24) {
+            is_referenced = length >= 3;
+        } else if (next_index < 256) {
+            is_referenced = length >= 4;
+        } else if (next_index < 65536) {
+            is_referenced = length >= 5;
+        } else if (next_index < 4294967296ull) {
+            is_referenced = length >= 7;
+        } else {
+            is_referenced = length >= 11;
+        }
+
+        if (is_referenced) {
+            return PyList_Append(self->stringref_namespace, string);
+        }
+    }
+
+    return 0;
+}
+
+
+// Strings ///////////////////////////////////////////////////////////////////
+
+// Returns true if none of the length bytes at data has its top bit set. The
+// bytes are tested eight at a time, OR-ing together a block of four words
+// before each test so that the loop is branch-light and easily vectorized by
+// the compiler
+static inline bool
+is_ascii(const char *data, Py_ssize_t length)
+{
+    const uint64_t high_bits = 0x8080808080808080ull;
+    uint64_t words[4];
+    uint8_t tail = 0;
+
+    for (; length >= 32; data += 32, length -= 32) {
+        memcpy(words, data, 32);
+        if ((words[0] | words[1] | words[2] | words[3]) & high_bits)
+            return false;
+    }
+    for (; length >= 8; data += 8, length -= 8) {
+        memcpy(words, data, 8);
+        if (words[0] & high_bits)
+            return false;
+    }
+    while (length--)
+        tail |= (uint8_t) *data++;
+    return !(tail & 0x80);
+}
+
+
+// Creates a str from length bytes of UTF-8 at data, handling invalid input
+// according to str_errors. ASCII, which most strings are, is copied straight
+// into a new compact ASCII str without going through the UTF-8 decoder
+static PyObject *
+decode_utf8(CBORDecoderObject *self, const char *data, Py_ssize_t length)
+{
+    PyObject *ret, *owner;
+    bool ascii;
+
+    if (self->input.buf && length >= NOGIL_COPY_SIZE) {
+        // As in input_copy()
+        owner = self->input.obj;
+        Py_XINCREF(owner);
+        Py_BEGIN_ALLOW_THREADS
+        ascii = is_ascii(data, length);
+        Py_END_ALLOW_THREADS
+        Py_XDECREF(owner);
+    } else
+        ascii = is_ascii(data, length);
+    if (!ascii)
+        return PyUnicode_DecodeUTF8(
+                data, length, PyBytes_AS_STRING(self->str_errors));
+    // Single characters are shared by the interpreter
+    if (length == 1)
+        return PyUnicode_FromOrdinal((uint8_t) *data);
+    ret = PyUnicode_New(length, 127);
+    if (ret) {
+        if (self->input.buf)
+            input_copy(self, (char *) PyUnicode_1BYTE_DATA(ret), data, length);
+        else
+            memcpy(PyUnicode_1BYTE_DATA(ret), data, length);
+    }
+    return ret;
+}
+
+
+// Key cache /////////////////////////////////////////////////////////////////
+
+// Map keys tend to be drawn from a small set of strings, so the decoder keeps
+// the str objects it created for short keys in a direct-mapped table indexed
+// by a hash of their UTF-8 encoding. A repeated key then costs a hash and a
+// memcmp instead of a new string, and since a cached string keeps its hash
+// once computed, it's only hashed once however many dicts it's inserted into.
+// The strings aren't interned: keys come from untrusted input, and interned
+// strings are never freed on some Python versions. A colliding key simply
+// replaces the entry, keeping the table bounded
+
+static void
+key_cache_clear(CBORDecoderObject *self)
+{
+    Py_ssize_t i;
+
+    for (i = 0; i < KEY_CACHE_SIZE; i++)
+        Py_CLEAR(self->key_cache[i]);
+}
+
+
+static inline size_t
+key_cache_index(const char *data, Py_ssize_t length)
+{
+    // FNV-1a
+    uint32_t hash = 2166136261u;
+
+    while (length--)
+        hash = (hash ^ (uint8_t) *data++) * 16777619u;
+    return (hash ^ (hash >> 16)) & (KEY_CACHE_SIZE - 1);
+}
+
+
+// Decodes a string map key; subtype is that of the lead byte
+static PyObject *
+decode_key_string(CBORDecoderObject *self, uint8_t subtype)
+{
+    PyObject **entry, *ret;
+    const char *data, *cached;
+    Py_ssize_t cached_length;
+
+    // Only strings whose length is encoded in the lead byte are cached
+    if (subtype >= 24 || !self->cache_keys)
+        return decode_string(self, subtype);
+    if (self->limited && charge_allocation(self, subtype, 1) == -1)
+        return NULL;
+
+    data = fp_read_ptr(self, subtype);
+    if (!data)
+        return NULL;
+    entry = &self->key_cache[key_cache_index(data, subtype)];
+    if (*entry) {
+        // The UTF-8 form of an ASCII string is its own data, and any other
+        // string keeps its UTF-8 form once it has been computed once
+        cached = PyUnicode_AsUTF8AndSize(*entry, &cached_length);
+        if (!cached)
+            return NULL;
+        if (cached_length == subtype && !memcmp(cached, data, subtype)) {
+            ret = *entry;
+            Py_INCREF(ret);
+            goto found;
+        }
+    }
+
+    ret = decode_utf8(self, data, subtype);
+    if (!ret) {
+        if (PyErr_ExceptionMatches(PyExc_UnicodeDecodeError))
+            raise_from(_CBOR2_CBORDecodeValueError,
+                       "error decoding unicode string");
+        return NULL;
+    }
+    if (PyObject_Hash(ret) == -1) {
+        Py_DECREF(ret);
+        return NULL;
+    }
+    Py_INCREF(ret);
+    Py_XSETREF(*entry, ret);
+found:
+    if (string_namespace_add(self, ret, subtype) == -1)
+        Py_CLEAR(ret);
+    return ret;
+}
+
+
+// Integer cache /////////////////////////////////////////////////////////////
+
+// CPython only shares the int objects for -5 to 256, while decoded data is
+// often full of integers just beyond that (lengths, counters, status codes,
+// ports and so on). The decoder keeps the ones it creates for -size to size-1
+// outside CPython's range and hands out new references to those instead of
+// allocating the same values again; the table is only allocated once an
+// integer in range is met
+
+// The smallest value, and the smallest encoded negative value (-1 - n),
+// that CPython doesn't already share
+#define INT_CACHE_FIRST 257
+#define NEGINT_CACHE_FIRST 5
+
+// Returns the number of entries for values from first up to size - 1
+static inline Py_ssize_t
+int_cache_entries(Py_ssize_t size, Py_ssize_t first)
+{
+    return size > first ? size - first : 0;
+}
+
+
+static void
+int_cache_clear(CBORDecoderObject *self)
+{
+    Py_ssize_t i, count;
+
+    if (self->int_cache) {
+        count = int_cache_entries(self->int_cache_size, INT_CACHE_FIRST) +
+                int_cache_entries(self->int_cache_size, NEGINT_CACHE_FIRST);
+        for (i = 0; i < count; i++)
+            Py_XDECREF(self->int_cache[i]);
+        PyMem_Free(self->int_cache);
+        self->int_cache = NULL;
+    }
+}
+
+
+// Returns a new int for value, or for -1 - value if negative is set
+static PyObject *
+new_int(uint64_t value, bool negative)
+{
+    PyObject *tmp, *ret;
+
+    if (!negative)
+        return PyLong_FromUnsignedLongLong(value);
+    if (value <= INT64_MAX)
+        return PyLong_FromLongLong(-1 - (int64_t) value);
+    // -1 - value is ~value
+    tmp = PyLong_FromUnsignedLongLong(value);
+    if (!tmp)
+        return NULL;
+    ret = PyNumber_Invert(tmp);
+    Py_DECREF(tmp);
+    return ret;
+}
+
+
+// As new_int(), but from the cache when the result is within its range
+static PyObject *
+cached_int(CBORDecoderObject *self, uint64_t value, bool negative)
+{
+    PyObject **entry;
+    Py_ssize_t positives;
+
+    if (value >= (uint64_t) self->int_cache_size ||
+            value < (negative ? NEGINT_CACHE_FIRST : INT_CACHE_FIRST))
+        return new_int(value, negative);
+    positives = int_cache_entries(self->int_cache_size, INT_CACHE_FIRST);
+    if (!self->int_cache) {
+        self->int_cache = PyMem_Calloc(
+                (size_t) (positives + int_cache_entries(
+                        self->int_cache_size, NEGINT_CACHE_FIRST)),
+                sizeof(PyObject *));
+        if (!self->int_cache) {
+            PyErr_NoMemory();
+            return NULL;
+        }
+    }
+    entry = &self->int_cache[negative ?
+            positives + (Py_ssize_t) value - NEGINT_CACHE_FIRST :
+            (Py_ssize_t) value - INT_CACHE_FIRST];
+    if (!*entry && !(*entry = new_int(value, negative)))
+        return NULL;
+    Py_INCREF(*entry);
+    return *entry;
+}
+
+
+// Major decoders ////////////////////////////////////////////////////////////
+
+static PyObject *
+decode_uint(CBORDecoderObject *self, uint8_t subtype)
+{
+    // major type 0
+    uint64_t length;
+    PyObject *ret;
+
+    if (decode_length(self, subtype, &length, NULL) == -1)
+        return NULL;
+    ret = cached_int(self, length, false);
+    set_shareable(self, ret);
+    return ret;
+}
+
+
+static PyObject *
+decode_negint(CBORDecoderObject *self, uint8_t subtype)
+{
+    // major type 1
+    uint64_t length;
+    PyObject *ret;
+
+    if (decode_length(self, subtype, &length, NULL) == -1)
+        return NULL;
+    ret = cached_int(self, length, true);
+    set_shareable(self, ret);
+    return ret;
+}
+
+
+static PyObject *
+decode_definite_short_bytestring(CBORDecoderObject *self, Py_ssize_t length)
+{
+    PyObject *ret;
+
+    // Too short to be added to a string namespace
+    if (!length) {
+        Py_INCREF(_CBOR2_empty_bytes);
+        return _CBOR2_empty_bytes;
+    }
+    ret = fp_read_object(self, length);
+    if (!ret)
+        return NULL;
+
+    if (string_namespace_add(self, ret, length) == -1) {
+        Py_DECREF(ret);
+        return NULL;
+    }
+    return ret;
+}
+
+
+// Reads a bytestring too long to trust its length from fp a chunk at a time,
+// directly into the bytes object returned. The allocation grows geometrically
+// so that a bogus length at the end of a short stream can't force it all to be
+// allocated up front, but without copying everything read so far each time
+static PyObject *
+decode_definite_long_bytestring(CBORDecoderObject *self, Py_ssize_t length)
+{
+    PyObject *ret, *chunk;
+    Py_ssize_t size = 65536, filled = 0, chunk_length;
+
+    ret = PyBytes_FromStringAndSize(NULL, size);
+    if (!ret)
+        return NULL;
+    while (filled < length) {
+        if (filled == size) {
+            size = length - size > size ? size * 2 : length;
+            if (_PyBytes_Resize(&ret, size) == -1)
+                return NULL;
+        }
+        chunk_length = size - filled;
+        chunk = fp_read_object(self, chunk_length);
+        if (!chunk)
+            goto error;
+        memcpy(PyBytes_AS_STRING(ret) + filled, PyBytes_AS_STRING(chunk),
+               chunk_length);
+        Py_DECREF(chunk);
+        filled += chunk_length;
+    }
+    if (string_namespace_add(self, ret, length) == -1)
+        goto error;
+    return ret;
+error:
+    Py_DECREF(ret);
+    return NULL;
+}
+
+
+static PyObject *
+decode_indefinite_bytestrings(CBORDecoderObject *self)
+{
+    PyObject *ret = NULL;
+    LeadByte lead;
+    uint64_t length;
+
+    // The chunks are assembled in the scratch buffer; as chunks of another
+    // string, they're not added to any string namespace in their own right
+    while (1) {
+        if (fp_read(self, &lead.byte, 1) == -1)
+            break;
+        if (lead.major == 2 && lead.subtype != 31) {
+            if (decode_length(self, lead.subtype, &length, NULL) == -1)
+                break;
+            if (length > (uint64_t) PY_SSIZE_T_MAX) {
+                PyErr_SetString(_CBOR2_CBORDecodeValueError,
+                                "excessive bytestring size");
+                break;
+            }
+            if (self->limited && charge_allocation(self, length, 1) == -1)
+                break;
+            if (scratch_read(self, (Py_ssize_t) length) == -1)
+                break;
+        } else if (lead.major == 7 && lead.subtype == 31) { // break-code
+            ret = PyBytes_FromStringAndSize(self->scratch, self->scratch_len);
+            break;
+        } else {
+            PyErr_SetString(
+                _CBOR2_CBORDecodeValueError,
+                "non-bytestring found in indefinite length bytestring");
+            break;
+        }
+    }
+    scratch_release(self);
+    return ret;
+}
+
+
+// Returns the next length bytes of fp, when decoding from a view of it, as a
+// read-only memoryview slice of fp instead of a copy; see memoryview_size
+static PyObject *
+decode_definite_bytestring_view(CBORDecoderObject *self, Py_ssize_t length)
+{
+    PyObject *view, *tmp, *ret = NULL;
+    Py_ssize_t start = self->input_pos;
+    const char *format;
+
+    if (!input_consume(self, length))
+        return NULL;
+    view = PyMemoryView_FromObject(self->input.obj);
+    if (!view)
+        return NULL;
+    format = PyMemoryView_GET_BUFFER(view)->format;
+    if (format && strcmp(format, "B") != 0) {
+        tmp = PyObject_CallMethod(view, "cast", "s", "B");
+        Py_DECREF(view);
+        if (!tmp)
+            return NULL;
+        view = tmp;
+    }
+    if (!PyMemoryView_GET_BUFFER(view)->readonly) {
+        tmp = PyObject_CallMethod(view, "toreadonly", NULL);
+        Py_DECREF(view);
+        if (!tmp)
+            return NULL;
+        view = tmp;
+    }
+    ret = PySequence_GetSlice(view, start, start + length);
+    Py_DECREF(view);
+    if (ret && string_namespace_add(self, ret, length) == -1)
+        Py_CLEAR(ret);
+    return ret;
+}
+
+
+static PyObject *
+decode_bytestring(CBORDecoderObject *self, uint8_t subtype)
+{
+    // major type 2
+    uint64_t length = 0;
+    bool indefinite = true;
+    PyObject *ret;
+    char length_hex[17];
+
+    if (decode_length(self, subtype, &length, &indefinite) == -1)
+        return NULL;
+
+    if (length > (uint64_t)PY_SSIZE_T_MAX - (uint64_t)PyBytesObject_SIZE) {
+        sprintf(length_hex, "%" PRIX64, length);
+        PyErr_Format(
+                _CBOR2_CBORDecodeValueError,
+                "excessive bytestring size 0x%s", length_hex);
+        return NULL;
+    }
+    if (indefinite)
+        ret = decode_indefinite_bytestrings(self);
+    else if (self->fp_input && self->memoryview_size != -1 &&
+             length >= (uint64_t) self->memoryview_size && !self->immutable)
+        // views aren't hashable, so map keys are still copied
+        ret = decode_definite_bytestring_view(self, (Py_ssize_t)length);
+    else if (self->limited && charge_allocation(self, length, 1) == -1)
+        ret = NULL;
+    else if (length <= 65536 || self->input.buf)
+        // with in-memory input the length is checked against the remaining
+        // input before allocating, so there's no need to read in chunks
+        ret = decode_definite_short_bytestring(self, (Py_ssize_t)length);
+    else
+        ret = decode_definite_long_bytestring(self, (Py_ssize_t)length);
+
+    if (ret)
+        set_shareable(self, ret);
+
+    return ret;
+}
+
+
+// NOTE: It may seem redundant to repeat the definite and indefinite routines
+// to handle UTF-8 strings but there is a reason to do this separately.
+// Specifically, the CBOR spec states (in sec. 2.2):
+//
+//     Text strings with indefinite lengths act the same as byte strings with
+//     indefinite lengths, except that all their chunks MUST be definite-length
+//     text strings.  Note that this implies that the bytes of a single UTF-8
+//     character cannot be spread between chunks: a new chunk can only be
+//     started at a character boundary.
+//
+// This precludes using the indefinite bytestring decoder above as that would
+// happily ignore UTF-8 characters split across chunks.
+
+
+static PyObject *
+decode_definite_short_string(CBORDecoderObject *self, Py_ssize_t length)
+{
+    const char *data;
+
+    // Too short to be added to a string namespace
+    if (!length) {
+        Py_INCREF(_CBOR2_empty_str);
+        return _CBOR2_empty_str;
+    }
+    // decode straight from the input or read-ahead buffer; no intermediate
+    // bytes object
+    data = fp_read_ptr(self, length);
+    if (!data)
+        return NULL;
+
+    PyObject *ret = decode_utf8(self, data, length);
+    if (ret && string_namespace_add(self, ret, length) == -1) {
+        Py_DECREF(ret);
+        return NULL;
+    }
+    return ret;
+}
+
+
+static PyObject *
+decode_definite_long_string(CBORDecoderObject *self, Py_ssize_t length)
+{
+    PyObject *ret = NULL;
+
+    // Read it all into the scratch buffer and decode it in one go
+    if (scratch_read(self, length) == 0) {
+        ret = PyUnicode_DecodeUTF8(self->scratch, length,
+                                   PyBytes_AS_STRING(self->str_errors));
+        if (ret && string_namespace_add(self, ret, length) == -1)
+            Py_CLEAR(ret);
+    }
+    scratch_release(self);
+    return ret;
+}
+
+
+// Decodes the UTF-8 in the scratch buffer from start to end, appending the
+// result to *parts (a list created if need be). Returns -1 on error
+static int
+scratch_decode_part(CBORDecoderObject *self, Py_ssize_t start, Py_ssize_t end,
+                    PyObject **parts)
+{
+    PyObject *part;
+    int ret;
+
+    if (!*parts) {
+        *parts = PyList_New(0);
+        if (!*parts)
+            return -1;
+    }
+    part = PyUnicode_DecodeUTF8(self->scratch + start, end - start,
+                                PyBytes_AS_STRING(self->str_errors));
+    if (!part)
+        return -1;
+    ret = PyList_Append(*parts, part);
+    Py_DECREF(part);
+    return ret;
+}
+
+
+static PyObject *
+decode_indefinite_strings(CBORDecoderObject *self)
+{
+    PyObject *parts = NULL, *ret = NULL;
+    Py_ssize_t start = 0, chunk_start;
+    LeadByte lead;
+    uint64_t length;
+
+    // The chunks are assembled in the scratch buffer and decoded together;
+    // while each starts with the first byte of a character (as it must),
+    // that's the same as decoding each one separately. A chunk that starts
+    // part way through a character is decoded separately from what came
+    // before, giving the same error as decoding it on its own
+    while (1) {
+        if (fp_read(self, &lead.byte, 1) == -1)
+            break;
+        if (lead.major == 3 && lead.subtype != 31) {
+            if (decode_length(self, lead.subtype, &length, NULL) == -1)
+                break;
+            if (length > (uint64_t) PY_SSIZE_T_MAX) {
+                PyErr_SetString(_CBOR2_CBORDecodeValueError,
+                                "excessive string size");
+                break;
+            }
+            if (self->limited && charge_allocation(self, length, 1) == -1)
+                break;
+            chunk_start = self->scratch_len;
+            if (scratch_read(self, (Py_ssize_t) length) == -1)
+                break;
+            if (length && chunk_start > start &&
+                    ((uint8_t) self->scratch[chunk_start] & 0xC0) == 0x80) {
+                if (scratch_decode_part(self, start, chunk_start, &parts) == -1)
+                    break;
+                start = chunk_start;
+            }
+        } else if (lead.major == 7 && lead.subtype == 31) { // break-code
+            if (!parts) {
+                ret = PyUnicode_DecodeUTF8(self->scratch, self->scratch_len,
+                                           PyBytes_AS_STRING(self->str_errors));
+            } else if (scratch_decode_part(
+                        self, start, self->scratch_len, &parts) == 0) {
+                ret = PyUnicode_Join(_CBOR2_empty_str, parts);
+            }
+            break;
+        } else {
+            PyErr_SetString(
+                _CBOR2_CBORDecodeValueError,
+                "non-string found in indefinite length string");
+            break;
+        }
+    }
+    Py_XDECREF(parts);
+    scratch_release(self);
+    return ret;
+}
+
+
+static PyObject *
+decode_string(CBORDecoderObject *self, uint8_t subtype)
+{
+    // major type 3
+    uint64_t length = 0;
+    bool indefinite = true;
+    PyObject *ret;
+    char length_hex[17];
+
+    if (decode_length(self, subtype, &length, &indefinite) == -1)
+        return NULL;
+    if (length > (uint64_t)PY_SSIZE_T_MAX - (uint64_t)PyBytesObject_SIZE) {
+        sprintf(length_hex, "%" PRIX64, length);
+        PyErr_Format(
+                _CBOR2_CBORDecodeValueError,
+                "excessive string size 0x%s", length_hex);
+        return NULL;
+    }
+    if (indefinite)
+        ret = decode_indefinite_strings(self);
+    else if (self->limited && charge_allocation(self, length, 1) == -1)
+        ret = NULL;
+    else if (length <= 65536 || self->input.buf)
+        ret = decode_definite_short_string(self, (Py_ssize_t)length);
+    else
+        ret = decode_definite_long_string(self, (Py_ssize_t)length);
+
+    if (!ret && PyErr_GivenExceptionMatches(PyErr_Occurred(), PyExc_UnicodeDecodeError))
+        raise_from(_CBOR2_CBORDecodeValueError, "error decoding unicode string");
+
+    set_shareable(self, ret);
+    return ret;
+}
+
+
+// Decodes the next item into *item, without going through decode(), if it's a
+// number or simple value already in memory (in the input or read-ahead
+// buffer). Returns 1 if it did, 0 if the item needs decoding the usual way
+// (without having consumed anything), or -1 on error. Arrays of numbers are
+// typically long runs of these, so this keeps the loop over them tight
+static inline int
+decode_scalar(CBORDecoderObject *self, PyObject **item)
+{
+    const uint8_t *p;
+    Py_ssize_t available, size;
+    uint8_t lead;
+    union {
+        uint64_t u64; uint32_t u32; uint16_t u16;
+        double f64; float f32;
+    } value;
+
+    if (self->input.buf) {
+        p = (const uint8_t *) self->input.buf + self->input_pos;
+        available = self->input.len - self->input_pos;
+    } else {
+        p = (const uint8_t *) (self->readahead ?
+                PyBytes_AS_STRING(self->readahead) + self->read_pos : NULL);
+        available = read_ahead_length(self);
+    }
+    if (!available)
+        return 0;
+
+    lead = p[0];
+    if (lead < 0x18) {
+        *item = PyLong_FromLong(lead);
+        size = 1;
+    } else if (lead >= 0x20 && lead < 0x38) {
+        *item = cached_int(self, lead - 0x20, true);
+        size = 1;
+    } else if (lead < 0x40 && (lead & 31) < 28) {
+        // An integer with a 1, 2, 4 or 8 byte value following the lead byte
+        size = 1 + (1 << ((lead & 31) - 24));
+        if (available < size)
+            return 0;
+        switch (size) {
+            case 2:
+                value.u64 = p[1];
+                break;
+            case 3:
+                memcpy(&value.u16, p + 1, 2);
+                value.u64 = be16toh(value.u16);
+                break;
+            case 5:
+                memcpy(&value.u32, p + 1, 4);
+                value.u64 = be32toh(value.u32);
+                break;
+            default:
+                memcpy(&value.u64, p + 1, 8);
+                value.u64 = be64toh(value.u64);
+                break;
+        }
+        *item = cached_int(self, value.u64, lead >= 0x20);
+    } else {
+        size = 1;
+        switch (lead) {
+            case 0xf4: *item = Py_False; Py_INCREF(*item); break;
+            case 0xf5: *item = Py_True;  Py_INCREF(*item); break;
+            case 0xf6: *item = Py_None;  Py_INCREF(*item); break;
+            case 0xf7: *item = undefined; Py_INCREF(*item); break;
+            case 0xf9:
+                size = 3;
+                if (available < size)
+                    return 0;
+                memcpy(&value.u16, p + 1, 2);
+                *item = PyFloat_FromDouble(unpack_float16(value.u16));
+                break;
+            case 0xfa:
+                size = 5;
+                if (available < size)
+                    return 0;
+                memcpy(&value.u32, p + 1, 4);
+                value.u32 = be32toh(value.u32);
+                *item = PyFloat_FromDouble(value.f32);
+                break;
+            case 0xfb:
+                size = 9;
+                if (available < size)
+                    return 0;
+                memcpy(&value.u64, p + 1, 8);
+                value.u64 = be64toh(value.u64);
+                *item = PyFloat_FromDouble(value.f64);
+                break;
+            default:
+                return 0;
+        }
+    }
+    if (!*item)
+        return -1;
+    if (self->input.buf)
+        self->input_pos += size;
+    else
+        self->read_pos += size;
+    return 1;
+}
+
+
+// Decodes the next item of an array
+static inline PyObject *
+decode_array_item(CBORDecoderObject *self)
+{
+    PyObject *item;
+
+    if (self->tracking)
+        // decode() does the counting
+        return decode(self, DECODE_UNSHARED);
+    switch (decode_scalar(self, &item)) {
+        case 1: return item;
+        case 0: return decode(self, DECODE_UNSHARED);
+        default: return NULL;
+    }
+}
+
+
+static PyObject *
+decode_indefinite_array(CBORDecoderObject *self)
+{
+    PyObject *array, *item, *ret = NULL;
+
+    array = PyList_New(0);
+    if (array) {
+        ret = array;
+        set_shareable(self, array);
+        while (ret) {
+            item = decode_array_item(self);
+            if (item == break_marker) {
+                Py_DECREF(item);
+                break;
+            } else if (item) {
+                if ((self->limited && check_indefinite(
+                            self, PyList_GET_SIZE(array) + 1, false) == -1) ||
+                        PyList_Append(array, item) == -1)
+                    ret = NULL;
+                Py_DECREF(item);
+            } else
+                ret = NULL;
+        }
+        if (ret && self->immutable) {
+            ret = PyList_AsTuple(array);
+            if (ret) {
+                Py_DECREF(array);
+                // There's a potential here for an indefinite length recursive
+                // array to wind up with a strange representation (the outer
+                // being a tuple, the inners all being a list). However, a
+                // recursive tuple isn't valid in the first place so it's a bit
+                // of a waste of time searching for recursive references just
+                // to throw an error
+                set_shareable(self, ret);
+            } else
+                ret = NULL;
+        }
+        if (!ret)
+            Py_DECREF(array);
+    }
+    return ret;
+}
+
+
+static PyObject *
+decode_definite_array(CBORDecoderObject *self, Py_ssize_t length)
+{
+    Py_ssize_t i;
+    PyObject *array, *item, *ret = NULL;
+    if (length > 65536 ||
+            (self->input.buf && length > self->input.len - self->input_pos)) {
+        // Let cPython manage allocation of huge lists by appending
+        // items one-by-one. Every item takes at least a byte, so nor is
+        // there any point preallocating more than the rest of in-memory
+        // input could hold
+        array = PyList_New(0);
+        if (array) {
+            ret = array;
+            set_shareable(self, array);
+            for (i = 0; i < length; ++i) {
+                item = decode_array_item(self);
+                if (item) {
+                    if (PyList_Append(array, item) == -1) {
+                        ret = NULL;
+                        Py_DECREF(item);
+                        break;
+                    }
+                    Py_DECREF(item);
+                } else {
+                    ret = NULL;
+                    break;
+                }
+            }
+            if (ret && self->immutable) {
+                ret = PyList_AsTuple(array);
+                if (ret) {
+                    Py_DECREF(array);
+                    // There's a potential here for an indefinite length recursive
+                    // array to wind up with a strange representation (the outer
+                    // being a tuple, the inners all being a list). However, a
+                    // recursive tuple isn't valid in the first place so it's a bit
+                    // of a waste of time searching for recursive references just
+                    // to throw an error
+                    set_shareable(self, ret);
+                } else
+                    ret = NULL;
+            }
+            if (!ret)
+                Py_DECREF(array);
+        }
+    } else {
+        if (self->immutable) {
+            array = PyTuple_New(length);
+            if (array) {
+                ret = array;
+                for (i = 0; i < length; ++i) {
+                    item = decode_array_item(self);
+                    if (item)
+                        PyTuple_SET_ITEM(array, i, item);
+                    else {
+                        ret = NULL;
+                        break;
+                    }
+                }
+            }
+            // This is done *after* the construction of the tuple because while
+            // it's valid for a tuple object to be shared, it's not valid for it to
+            // contain a reference to itself (because a reference to it can't exist
+            // during its own construction ... in Python at least; as can be seen
+            // above this *is* theoretically possible at the C level).
+            set_shareable(self, ret);
+        } else {
+            array = PyList_New(length);
+            if (array) {
+                ret = array;
+                set_shareable(self, array);
+                for (i = 0; i < length; ++i) {
+                    item = decode_array_item(self);
+                    if (item)
+                        PyList_SET_ITEM(array, i, item);
+                    else {
+                        ret = NULL;
+                        break;
+                    }
+                }
+            }
+        }
+        if (!ret)
+            Py_DECREF(array);
+    }
+    return ret;
+}
+
+
+static PyObject *
+decode_array(CBORDecoderObject *self, uint8_t subtype)
+{
+    // major type 4
+    uint64_t length;
+    bool indefinite = true;
+    char length_hex[17];
+
+    if (decode_length(self, subtype, &length, &indefinite) == -1)
+        return NULL;
+    if (indefinite)
+        return decode_indefinite_array(self);
+    if (length > (uint64_t)PY_SSIZE_T_MAX) {
+        sprintf(length_hex, "%" PRIX64, length);
+        PyErr_Format(
+                _CBOR2_CBORDecodeValueError,
+                "excessive array size 0x%s", length_hex);
+        return NULL;
+    } else if (self->limited && check_container(self, length, false) == -1)
+        return NULL;
+    else
+        return decode_definite_array(self, (Py_ssize_t) length);
+}
+
+
+// Decodes the value of a map entry with the specified key, leaving it encoded
+// if the key is one of raw_keys
+static inline PyObject *
+decode_map_value(CBORDecoderObject *self, PyObject *key)
+{
+    if (self->raw_keys != Py_None) {
+        switch (PySet_Contains(self->raw_keys, key)) {
+            case 1: return decode_raw(self, NULL, 0);
+            case -1: return NULL;
+        }
+    }
+    return decode(self, DECODE_UNSHARED);
+}
+
+
+static PyObject *
+decode_map(CBORDecoderObject *self, uint8_t subtype)
+{
+    // major type 5
+    uint64_t length;
+    bool indefinite = true;
+    PyObject *map, *key, *value, *ret = NULL;
+
+    map = PyDict_New();
+    if (map) {
+        ret = map;
+        set_shareable(self, map);
+        if (decode_length(self, subtype, &length, &indefinite) == 0) {
+            if (indefinite) {
+                while (ret) {
+                    key = decode(self, DECODE_IMMUTABLE | DECODE_UNSHARED |
+                                       DECODE_KEY);
+                    if (key == break_marker) {
+                        Py_DECREF(key);
+                        break;
+                    } else if (key && self->limited && check_indefinite(
+                                self, PyDict_GET_SIZE(map) + 1, true) == -1) {
+                        Py_DECREF(key);
+                        ret = NULL;
+                    } else if (key) {
+                        value = decode_map_value(self, key);
+                        if (value) {
+                            if (PyDict_SetItem(map, key, value) == -1)
+                                ret = NULL;
+                            Py_DECREF(value);
+                        } else
+                            ret = NULL;
+                        Py_DECREF(key);
+                    } else
+                        ret = NULL;
+                }
+            } else {
+                if (self->limited && check_container(self, length, true) == -1)
+                    ret = NULL;
+                while (ret && length--) {
+                    key = decode(self, DECODE_IMMUTABLE | DECODE_UNSHARED |
+                                       DECODE_KEY);
+                    if (key) {
+                        value = decode_map_value(self, key);
+                        if (value) {
+                            if (PyDict_SetItem(map, key, value) == -1)
+                                ret = NULL;
+                            Py_DECREF(value);
+                        } else
+                            ret = NULL;
+                        Py_DECREF(key);
+                    } else
+                        ret = NULL;
+                }
+            }
+        } else
+            ret = NULL;
+        if (!ret)
+            Py_DECREF(map);
+    }
+    if (ret && self->immutable) {
+        // _CBOR2_FrozenDict is initialized in CBORDecoder_init
+        map = PyObject_CallFunctionObjArgs(_CBOR2_FrozenDict, ret, NULL);
+        if (map) {
+            set_shareable(self, map);
+            Py_DECREF(ret);
+            ret = map;
+        }
+    }
+    if (ret && self->object_hook != Py_None) {
+        self->stats.object_hook_calls++;
+        map = PyObject_CallFunctionObjArgs(self->object_hook, self, ret, NULL);
+        if (!map)
+            return NULL;
+
+        set_shareable(self, map);
+        Py_DECREF(ret);
+        ret = map;
+    }
+    return ret;
+}
+
+
+// Semantic decoders /////////////////////////////////////////////////////////
+
+// Returns the tag whose number (tagnum) has just been read, along with its
+// content, as a CBORRaw if the number is one of raw_tags. Returns NULL with
+// no error set if it isn't
+static PyObject *
+decode_raw_tag(CBORDecoderObject *self, uint8_t subtype, uint64_t tagnum)
+{
+    PyObject *num;
+    char header[1 + sizeof(uint64_t)];
+    Py_ssize_t header_len = 1, i;
+    int found;
+
+    num = PyLong_FromUnsignedLongLong(tagnum);
+    if (!num)
+        return NULL;
+    found = PySet_Contains(self->raw_tags, num);
+    Py_DECREF(num);
+    if (found != 1)
+        return NULL;
+
+    // Rebuild the tag's header, which has been consumed already
+    header[0] = (char) (0xC0 | subtype);
+    if (subtype >= 24) {
+        header_len += (Py_ssize_t) 1 << (subtype - 24);
+        for (i = 1; i < header_len; i++)
+            header[i] = (char) (tagnum >> (8 * (header_len - 1 - i)));
+    }
+    return decode_raw(self, header, header_len);
+}
+
+
+static PyObject *
+decode_semantic(CBORDecoderObject *self, uint8_t subtype)
+{
+    // major type 6
+    uint64_t tagnum;
+    PyObject *tag, *value, *ret = NULL;
+    Py_ssize_t memoryview_size = self->memoryview_size;
+
+    if (decode_length(self, subtype, &tagnum, NULL) == 0) {
+        if (self->raw_tags != Py_None) {
+            ret = decode_raw_tag(self, subtype, tagnum);
+            if (ret || PyErr_Occurred())
+                return ret;
+        }
+        // bignums, UUIDs and IP addresses are built from bytes, not views
+        if (tagnum == 2 || tagnum == 3 || tagnum == 37 || tagnum == 260)
+            self->memoryview_size = -1;
         switch (tagnum) {
             case 0:     ret = CBORDecoder_decode_datetime_string(self); break;
             case 1:     ret = CBORDecoder_decode_epoch_datetime(self);  break;
@@ -1175,1067 +2918,3447 @@ decode_semantic(CBORDecoderObject *self, uint8_t subtype)
             case 55799: ret = CBORDecoder_decode_self_describe_cbor(self);
                 break;
 
-            default:
-                tag = CBORTag_New(tagnum);
-                if (tag) {
-                    set_shareable(self, tag);
-                    value = decode(self, DECODE_UNSHARED);
-                    if (value) {
-                        if (CBORTag_SetValue(tag, value) == 0) {
-                            if (self->tag_hook == Py_None) {
-                                Py_INCREF(tag);
-                                ret = tag;
-                            } else {
-                                ret = PyObject_CallFunctionObjArgs(
-                                        self->tag_hook, self, tag, NULL);
-                                set_shareable(self, ret);
-                            }
-                        }
-                        Py_DECREF(value);
+            default:
+                if (is_typed_array_tag(tagnum)) {
+                    ret = decode_typed_array(self, tagnum);
+                    break;
+                }
+                tag = CBORTag_New(tagnum);
+                if (tag) {
+                    set_shareable(self, tag);
+                    value = decode(self, DECODE_UNSHARED);
+                    if (value) {
+                        if (CBORTag_SetValue(tag, value) == 0) {
+                            if (self->tag_hook == Py_None) {
+                                Py_INCREF(tag);
+                                ret = tag;
+                            } else {
+                                self->stats.tag_hook_calls++;
+                                ret = PyObject_CallFunctionObjArgs(
+                                        self->tag_hook, self, tag, NULL);
+                                set_shareable(self, ret);
+                            }
+                        }
+                        Py_DECREF(value);
+                    }
+                    Py_DECREF(tag);
+                }
+                break;
+        }
+        self->memoryview_size = memoryview_size;
+    }
+    return ret;
+}
+
+
+// Reads the *width* ASCII digits at *buf* into *value*; returns false if any
+// of them isn't a digit
+static inline bool
+parse_digits(const char *buf, int width, int *value)
+{
+    *value = 0;
+    while (width--) {
+        if (*buf < '0' || *buf > '9')
+            return false;
+        *value = *value * 10 + (*buf++ - '0');
+    }
+    return true;
+}
+
+
+// Returns a timezone *offset* seconds ahead of UTC, reusing the last one made
+// as most streams stick to one or two offsets
+static PyObject *
+get_timezone(CBORDecoderObject *self, int offset)
+{
+    PyObject *delta, *tz;
+
+    if (offset == 0) {
+        Py_INCREF(_CBOR2_timezone_utc);
+        return _CBOR2_timezone_utc;
+    }
+    if (self->last_tz && self->last_tz_offset == offset) {
+        Py_INCREF(self->last_tz);
+        return self->last_tz;
+    }
+    delta = PyDelta_FromDSU(0, offset, 0);
+    if (!delta)
+        return NULL;
+    tz = PyTimeZone_FromOffset(delta);
+    Py_DECREF(delta);
+    if (tz) {
+        Py_INCREF(tz);
+        Py_XSETREF(self->last_tz, tz);
+        self->last_tz_offset = offset;
+    }
+    return tz;
+}
+
+
+// Parses an RFC 3339 string, accepting exactly what _decoder.timestamp_re
+// matches (bar non-ASCII digits). Fractions of a second are truncated to
+// microsecond precision
+static PyObject *
+parse_datetimestr(CBORDecoderObject *self, PyObject *str)
+{
+    const char *buf, *p, *end;
+    Py_ssize_t size;
+    PyObject *tz, *ret = NULL;
+    int Y, m, d, H, M, S, uS, scale, offset_H, offset_M, offset;
+
+    if (CBOR2_INIT(_CBOR2_timezone_utc, _CBOR2_init_timezone_utc) == -1)
+        return NULL;
+    buf = PyUnicode_AsUTF8AndSize(str, &size);
+    if (!buf)
+        return NULL;
+    end = buf + size;
+    // like the regex's "$", allow a single trailing newline
+    if (size && end[-1] == '\n')
+        end--;
+    if (end - buf < 20 ||
+            !parse_digits(buf, 4, &Y) || buf[4] != '-' ||
+            !parse_digits(buf + 5, 2, &m) || buf[7] != '-' ||
+            !parse_digits(buf + 8, 2, &d) || buf[10] != 'T' ||
+            !parse_digits(buf + 11, 2, &H) || buf[13] != ':' ||
+            !parse_digits(buf + 14, 2, &M) || buf[16] != ':' ||
+            !parse_digits(buf + 17, 2, &S))
+        goto invalid;
+    p = buf + 19;
+    uS = 0;
+    if (*p == '.') {
+        p++;
+        if (p == end || *p < '0' || *p > '9')
+            goto invalid;
+        for (scale = 100000; p < end && *p >= '0' && *p <= '9'; p++) {
+            uS += (*p - '0') * scale;
+            scale /= 10;
+        }
+    }
+    if (end - p == 1 && *p == 'Z')
+        offset = 0;
+    else if (end - p == 6 && (*p == '+' || *p == '-') &&
+            parse_digits(p + 1, 2, &offset_H) && p[3] == ':' &&
+            parse_digits(p + 4, 2, &offset_M)) {
+        offset = offset_H * 3600 + offset_M * 60;
+        if (*p == '-')
+            offset = -offset;
+    } else
+        goto invalid;
+
+    tz = get_timezone(self, offset);
+    if (tz) {
+        ret = PyDateTimeAPI->DateTime_FromDateAndTime(
+                Y, m, d, H, M, S, uS, tz, PyDateTimeAPI->DateTimeType);
+        Py_DECREF(tz);
+    }
+    return ret;
+invalid:
+    PyErr_Format(
+        _CBOR2_CBORDecodeValueError, "invalid datetime string: %R", str);
+    return NULL;
+}
+
+static PyObject *
+parse_datestr(CBORDecoderObject *self, PyObject *str)
+{
+    const char* buf;
+    Py_ssize_t size;
+    PyObject *ret = NULL;
+    unsigned long int Y, m, d;
+
+    buf = PyUnicode_AsUTF8AndSize(str, &size);
+    if (
+            size < 10 || buf[4] != '-' || buf[7] != '-')
+    {
+        PyErr_Format(
+            _CBOR2_CBORDecodeValueError, "invalid date string %R", str);
+        return NULL;
+    }
+    if (buf) {
+        Y = strtoul(buf, NULL, 10);
+        m = strtoul(buf + 5, NULL, 10);
+        d = strtoul(buf + 8, NULL, 10);
+        ret = PyDate_FromDate(Y, m, d);
+    }
+    return ret;
+}
+
+
+// CBORDecoder.decode_datetime_string(self)
+static PyObject *
+CBORDecoder_decode_datetime_string(CBORDecoderObject *self)
+{
+    // semantic type 0
+    PyObject *str, *ret = NULL;
+
+    str = decode(self, DECODE_NORMAL);
+    if (str) {
+        if (PyUnicode_Check(str))
+            ret = parse_datetimestr(self, str);
+        else
+            PyErr_Format(
+                _CBOR2_CBORDecodeValueError, "invalid datetime value: %R", str);
+        Py_DECREF(str);
+    }
+    set_shareable(self, ret);
+    return ret;
+}
+
+// CBORDecoder.decode_epoch_date(self)
+static PyObject *
+CBORDecoder_decode_epoch_date(CBORDecoderObject *self)
+{
+    // semantic type 100
+    PyObject *num, *ordinal, *ret = NULL;
+
+    num = decode(self, DECODE_NORMAL);
+    if (num) {
+        if (PyNumber_Check(num)) {
+            ordinal = PyNumber_Add(num, _CBOR2_date_ordinal_offset);
+            if (ordinal) {
+                ret = PyObject_CallMethodObjArgs(
+                    (PyObject*) PyDateTimeAPI->DateType, _CBOR2_str_fromordinal, ordinal, NULL);
+                Py_DECREF(ordinal);
+            }
+        } else {
+            PyErr_Format(
+                _CBOR2_CBORDecodeValueError, "invalid timestamp value %R", num);
+        }
+        Py_DECREF(num);
+    }
+    set_shareable(self, ret);
+    return ret;
+}
+
+// CBORDecoder.decode_date_string(self)
+static PyObject *
+CBORDecoder_decode_date_string(CBORDecoderObject *self)
+{
+    // semantic type 0
+    PyObject *match, *str, *ret = NULL;
+
+    if (CBOR2_INIT(_CBOR2_datestr_re, _CBOR2_init_re_compile) == -1)
+        return NULL;
+    str = decode(self, DECODE_NORMAL);
+    if (str) {
+        if (PyUnicode_Check(str)) {
+            match = PyObject_CallMethodObjArgs(
+                    _CBOR2_datestr_re, _CBOR2_str_match, str, NULL);
+            if (match) {
+                if (match != Py_None)
+                    ret = parse_datestr(self, str);
+                else
+                    PyErr_Format(
+                        _CBOR2_CBORDecodeValueError,
+                        "invalid date string: %R", str);
+                Py_DECREF(match);
+            }
+        } else
+            PyErr_Format(
+                _CBOR2_CBORDecodeValueError, "invalid date value: %R", str);
+        Py_DECREF(str);
+    }
+    set_shareable(self, ret);
+    return ret;
+}
+
+
+// The range of UNIX timestamps within the years 1 to 9999
+#define MIN_TIMESTAMP INT64_C(-62135596800)
+#define MAX_TIMESTAMP INT64_C(253402300799)
+
+// Converts *seconds* since the epoch (and *microseconds*) to an aware datetime
+// in UTC, or returns NULL with no exception set if they're not in range
+static PyObject *
+datetime_from_timestamp(int64_t seconds, int microseconds)
+{
+    int64_t days, era, day_of_era, year_of_era, day_of_year, year;
+    int month, day, second_of_day, mp;
+
+    if (seconds < MIN_TIMESTAMP || seconds > MAX_TIMESTAMP)
+        return NULL;
+#ifdef MS_WINDOWS
+    // fromtimestamp() relies on gmtime_s(), which rejects times before 1970
+    if (seconds < 0)
+        return NULL;
+#endif
+    days = seconds / 86400;
+    second_of_day = seconds % 86400;
+    if (second_of_day < 0) {
+        second_of_day += 86400;
+        days--;
+    }
+    // the inverse of days_from_civil() in encoder.c
+    days += 719468;
+    era = (days >= 0 ? days : days - 146096) / 146097;
+    day_of_era = days - era * 146097;
+    year_of_era = (day_of_era - day_of_era / 1460 + day_of_era / 36524 -
+            day_of_era / 146096) / 365;
+    day_of_year = day_of_era - (365 * year_of_era + year_of_era / 4 -
+            year_of_era / 100);
+    mp = (5 * day_of_year + 2) / 153;
+    day = day_of_year - (153 * mp + 2) / 5 + 1;
+    month = mp < 10 ? mp + 3 : mp - 9;
+    year = year_of_era + era * 400 + (month <= 2);
+    return PyDateTimeAPI->DateTime_FromDateAndTime(
+            year, month, day, second_of_day / 3600, second_of_day / 60 % 60,
+            second_of_day % 60, microseconds, _CBOR2_timezone_utc,
+            PyDateTimeAPI->DateTimeType);
+}
+
+
+// Converts the int or float timestamp *num* exactly as
+// datetime.fromtimestamp(num, timezone.utc) would, or returns NULL with no
+// exception set if that would fail (or *num* is of another type) so that the
+// caller can call fromtimestamp() for its error
+static PyObject *
+fast_datetime_from_timestamp(PyObject *num)
+{
+    long long seconds;
+    double d, int_part, frac_part, rounded;
+    int overflow;
+
+    if (PyLong_CheckExact(num)) {
+        seconds = PyLong_AsLongLongAndOverflow(num, &overflow);
+        if (overflow || (seconds == -1 && PyErr_Occurred())) {
+            PyErr_Clear();
+            return NULL;
+        }
+        return datetime_from_timestamp(seconds, 0);
+    }
+    if (PyFloat_CheckExact(num)) {
+        d = PyFloat_AS_DOUBLE(num);
+        if (!isfinite(d) || d < MIN_TIMESTAMP - 1 || d > MAX_TIMESTAMP + 1)
+            return NULL;
+        // split into seconds and microseconds with round-half-even, as
+        // _PyTime_ObjectToTimeval does
+        frac_part = modf(d, &int_part) * 1e6;
+        rounded = round(frac_part);
+        if (fabs(frac_part - rounded) == 0.5)
+            rounded = 2.0 * round(frac_part / 2.0);
+        if (rounded >= 1e6) {
+            rounded -= 1e6;
+            int_part += 1.0;
+        } else if (rounded < 0) {
+            rounded += 1e6;
+            int_part -= 1.0;
+        }
+        return datetime_from_timestamp((int64_t)int_part, (int)rounded);
+    }
+    return NULL;
+}
+
+
+// CBORDecoder.decode_epoch_datetime(self)
+static PyObject *
+CBORDecoder_decode_epoch_datetime(CBORDecoderObject *self)
+{
+    // semantic type 1
+    PyObject *num, *tuple, *ret = NULL;
+
+    if (CBOR2_INIT(_CBOR2_timezone_utc, _CBOR2_init_timezone_utc) == -1)
+        return NULL;
+    num = decode(self, DECODE_NORMAL);
+    if (num) {
+        ret = fast_datetime_from_timestamp(num);
+        if (ret || PyErr_Occurred()) {
+            // done, one way or the other
+        } else if (PyNumber_Check(num)) {
+            tuple = PyTuple_Pack(2, num, _CBOR2_timezone_utc);
+            if (tuple) {
+                ret = PyDateTime_FromTimestamp(tuple);
+                Py_DECREF(tuple);
+                if (!ret && (
+                    PyErr_GivenExceptionMatches(PyErr_Occurred(), PyExc_OverflowError)
+                    || PyErr_GivenExceptionMatches(PyErr_Occurred(), PyExc_OSError)
+                    || PyErr_GivenExceptionMatches(PyErr_Occurred(), PyExc_ValueError)
+                ))
+                    raise_from(_CBOR2_CBORDecodeValueError, "error decoding datetime from epoch");
+            }
+        } else {
+            PyErr_Format(
+                _CBOR2_CBORDecodeValueError, "invalid timestamp value %R", num);
+        }
+        Py_DECREF(num);
+    }
+    set_shareable(self, ret);
+    return ret;
+}
+
+
+// CBORDecoder.decode_positive_bignum(self)
+static PyObject *
+CBORDecoder_decode_positive_bignum(CBORDecoderObject *self)
+{
+    // semantic type 2
+    PyObject *bytes, *ret = NULL;
+
+    bytes = decode(self, DECODE_NORMAL);
+    if (bytes) {
+        if (PyBytes_CheckExact(bytes))
+            ret = PyObject_CallMethod(
+                (PyObject*) &PyLong_Type, "from_bytes", "Os", bytes, "big");
+        else
+            PyErr_Format(
+                _CBOR2_CBORDecodeValueError, "invalid bignum value %R", bytes);
+        Py_DECREF(bytes);
+    }
+    set_shareable(self, ret);
+    return ret;
+}
+
+
+// CBORDecoder.decode_negative_bignum(self)
+static PyObject *
+CBORDecoder_decode_negative_bignum(CBORDecoderObject *self)
+{
+    // semantic type 3
+    PyObject *value, *one, *neg, *ret = NULL;
+
+    value = CBORDecoder_decode_positive_bignum(self);
+    if (value) {
+        one = PyLong_FromLong(1);
+        if (one) {
+            neg = PyNumber_Negative(value);
+            if (neg) {
+                ret = PyNumber_Subtract(neg, one);
+                Py_DECREF(neg);
+            }
+            Py_DECREF(one);
+        }
+        Py_DECREF(value);
+    }
+    set_shareable(self, ret);
+    return ret;
+}
+
+
+// CBORDecoder.decode_fraction(self)
+static PyObject *
+CBORDecoder_decode_fraction(CBORDecoderObject *self)
+{
+    // semantic type 4
+    PyObject *payload_t, *tmp, *sig, *exp, *ret = NULL;
+    PyObject *decimal_t, *sign, *digits, *args = NULL;
+
+    if (CBOR2_INIT(_CBOR2_Decimal, _CBOR2_init_Decimal) == -1)
+        return NULL;
+    // NOTE: There's no particular necessity for this to be immutable, it's
+    // just a performance choice
+    payload_t = decode(self, DECODE_IMMUTABLE | DECODE_UNSHARED);
+    if (payload_t) {
+        if (PyTuple_CheckExact(payload_t) && PyTuple_GET_SIZE(payload_t) == 2) {
+            exp = PyTuple_GET_ITEM(payload_t, 0);
+            sig = PyTuple_GET_ITEM(payload_t, 1);
+            tmp = PyObject_CallFunction(_CBOR2_Decimal, "O", sig);
+            if (tmp) {
+                decimal_t = PyObject_CallMethod(tmp, "as_tuple", NULL);
+                if (decimal_t) {
+                    sign = PyTuple_GET_ITEM(decimal_t, 0);
+                    digits = PyTuple_GET_ITEM(decimal_t, 1);
+                    args = PyTuple_Pack(3, sign, digits, exp);
+                    ret = PyObject_CallFunction(_CBOR2_Decimal, "(O)", args);
+                    Py_DECREF(decimal_t);
+                    Py_DECREF(args);
+                }
+                Py_DECREF(tmp);
+            }
+        } else {
+            PyErr_Format(
+                _CBOR2_CBORDecodeValueError,
+                            "Incorrect tag 4 payload");
+            }
+        Py_DECREF(payload_t);
+    }
+    set_shareable(self, ret);
+    return ret;
+}
+
+
+// CBORDecoder.decode_bigfloat
+static PyObject *
+CBORDecoder_decode_bigfloat(CBORDecoderObject *self)
+{
+    // semantic type 5
+    PyObject *tuple, *tmp, *sig, *exp, *two, *ret = NULL;
+
+    if (CBOR2_INIT(_CBOR2_Decimal, _CBOR2_init_Decimal) == -1)
+        return NULL;
+    // NOTE: see semantic type 4
+    tuple = decode(self, DECODE_IMMUTABLE | DECODE_UNSHARED);
+    if (tuple) {
+        if (PyTuple_CheckExact(tuple) && PyTuple_GET_SIZE(tuple) == 2) {
+            exp = PyTuple_GET_ITEM(tuple, 0);
+            sig = PyTuple_GET_ITEM(tuple, 1);
+            two = PyObject_CallFunction(_CBOR2_Decimal, "i", 2);
+            if (two) {
+                tmp = PyNumber_Power(two, exp, Py_None);
+                if (tmp) {
+                    ret = PyNumber_Multiply(sig, tmp);
+                    Py_DECREF(tmp);
+                }
+                Py_DECREF(two);
+            }
+        } else {
+            PyErr_Format(
+                _CBOR2_CBORDecodeValueError,
+                            "Incorrect tag 5 payload");
+            }
+        Py_DECREF(tuple);
+    }
+    set_shareable(self, ret);
+    return ret;
+}
+
+// CBORDecoder.decode_stringref(self)
+static PyObject *
+CBORDecoder_decode_stringref(CBORDecoderObject *self)
+{
+    // semantic type 25
+    PyObject *index, *ret = NULL;
+
+    if (self->stringref_namespace == Py_None) {
+        PyErr_Format(
+            _CBOR2_CBORDecodeValueError,
+            "string reference outside of namespace");
+        return NULL;
+    }
+
+    index = decode(self, DECODE_UNSHARED);
+    if (index) {
+        if (PyLong_CheckExact(index)) {
+            ret = PyList_GetItem(self->stringref_namespace, PyLong_AsSsize_t(index));
+            if (ret) {
+                // convert borrowed reference to new reference
+                Py_INCREF(ret);
+            } else {
+                PyErr_Format(
+                    _CBOR2_CBORDecodeValueError,
+                    "string reference %R not found", index);
+            }
+        } else {
+            PyErr_Format(
+                _CBOR2_CBORDecodeValueError,
+                "invalid string reference %R", index);
+        }
+    }
+
+    return ret;
+}
+
+
+// CBORDecoder.decode_shareable(self)
+static PyObject *
+CBORDecoder_decode_shareable(CBORDecoderObject *self)
+{
+    // semantic type 28
+    Py_ssize_t old_index;
+    PyObject *ret = NULL;
+
+    old_index = self->shared_index;
+    self->shared_index = PyList_GET_SIZE(self->shareables);
+    if (PyList_Append(self->shareables, Py_None) == 0)
+        ret = decode(self, DECODE_NORMAL);
+    self->shared_index = old_index;
+    return ret;
+}
+
+
+// CBORDecoder.decode_sharedref(self)
+static PyObject *
+CBORDecoder_decode_sharedref(CBORDecoderObject *self)
+{
+    // semantic type 29
+    PyObject *index, *ret = NULL;
+
+    index = decode(self, DECODE_UNSHARED);
+    if (index) {
+        if (PyLong_CheckExact(index)) {
+            ret = PyList_GetItem(self->shareables, PyLong_AsSsize_t(index));
+            if (ret) {
+                if (ret == Py_None) {
+                    PyErr_Format(
+                        _CBOR2_CBORDecodeValueError,
+                        "shared value %R has not been initialized", index);
+                    ret = NULL;
+                } else {
+                    // convert borrowed reference to new reference
+                    Py_INCREF(ret);
+                }
+            } else {
+                PyErr_Format(
+                    _CBOR2_CBORDecodeValueError,
+                    "shared reference %R not found", index);
+            }
+        } else {
+            PyErr_Format(
+                _CBOR2_CBORDecodeValueError,
+                "invalid shared reference %R", index);
+        }
+        Py_DECREF(index);
+    }
+    return ret;
+}
+
+
+// CBORDecoder.decode_rational(self)
+static PyObject *
+CBORDecoder_decode_rational(CBORDecoderObject *self)
+{
+    // semantic type 30
+    PyObject *tuple, *ret = NULL;
+
+    if (CBOR2_INIT(_CBOR2_Fraction, _CBOR2_init_Fraction) == -1)
+        return NULL;
+    // NOTE: see semantic type 4
+    tuple = decode(self, DECODE_IMMUTABLE | DECODE_UNSHARED);
+    if (tuple) {
+        if (PyTuple_CheckExact(tuple)) {
+            ret = PyObject_Call(_CBOR2_Fraction, tuple, NULL);
+            set_shareable(self, ret);
+            if (!ret && (
+                PyErr_GivenExceptionMatches(PyErr_Occurred(), PyExc_TypeError)
+                || PyErr_GivenExceptionMatches(PyErr_Occurred(), PyExc_ZeroDivisionError)
+            ))
+                raise_from(_CBOR2_CBORDecodeValueError, "error decoding rational");
+        } else {
+            PyErr_SetString(
+                _CBOR2_CBORDecodeValueError,
+                "error decoding rational: input value was not a tuple"
+            );
+        }
+        Py_DECREF(tuple);
+    }
+    return ret;
+}
+
+
+// CBORDecoder.decode_regexp(self)
+static PyObject *
+CBORDecoder_decode_regexp(CBORDecoderObject *self)
+{
+    // semantic type 35
+    PyObject *pattern, *ret = NULL;
+
+    if (CBOR2_INIT(_CBOR2_re_compile, _CBOR2_init_re_compile) == -1)
+        return NULL;
+    pattern = decode(self, DECODE_UNSHARED);
+    if (pattern) {
+        ret = PyObject_CallFunctionObjArgs(_CBOR2_re_compile, pattern, NULL);
+        Py_DECREF(pattern);
+        if (!ret && PyErr_GivenExceptionMatches(PyErr_Occurred(), _CBOR2_re_error))
+            raise_from(_CBOR2_CBORDecodeValueError, "error decoding regular expression");
+    }
+    set_shareable(self, ret);
+    return ret;
+}
+
+
+// CBORDecoder.decode_mime(self)
+static PyObject *
+CBORDecoder_decode_mime(CBORDecoderObject *self)
+{
+    // semantic type 36
+    PyObject *value, *parser, *ret = NULL;
+
+    if (CBOR2_INIT(_CBOR2_Parser, _CBOR2_init_Parser) == -1)
+        return NULL;
+    value = decode(self, DECODE_UNSHARED);
+    if (value) {
+        parser = PyObject_CallFunctionObjArgs(_CBOR2_Parser, NULL);
+        if (parser) {
+            ret = PyObject_CallMethodObjArgs(parser,
+                    _CBOR2_str_parsestr, value, NULL);
+            Py_DECREF(parser);
+            if (!ret && PyErr_GivenExceptionMatches(PyErr_Occurred(), PyExc_TypeError))
+                raise_from(_CBOR2_CBORDecodeValueError, "error decoding MIME message");
+        }
+        Py_DECREF(value);
+    }
+    set_shareable(self, ret);
+    return ret;
+}
+
+
+// CBORDecoder.decode_uuid(self)
+static PyObject *
+CBORDecoder_decode_uuid(CBORDecoderObject *self)
+{
+    // semantic type 37
+    PyObject *bytes, *ret = NULL;
+
+    if (CBOR2_INIT(_CBOR2_UUID, _CBOR2_init_UUID) == -1)
+        return NULL;
+    bytes = decode(self, DECODE_UNSHARED);
+    if (bytes) {
+        ret = PyObject_CallFunctionObjArgs(_CBOR2_UUID, Py_None, bytes, NULL);
+        Py_DECREF(bytes);
+        if (!ret && (
+            PyErr_GivenExceptionMatches(PyErr_Occurred(), PyExc_TypeError)
+            || PyErr_GivenExceptionMatches(PyErr_Occurred(), PyExc_ValueError)
+        ))
+            raise_from(_CBOR2_CBORDecodeValueError, "error decoding UUID value");
+    }
+    set_shareable(self, ret);
+    return ret;
+}
+
+// CBORDecoder.decode_stringref_namespace(self)
+static PyObject *
+CBORDecoder_decode_stringref_ns(CBORDecoderObject *self)
+{
+    // semantic type 256
+    PyObject *old_namespace, *ret = NULL;
+
+    old_namespace = self->stringref_namespace;
+
+    self->stringref_namespace = PyList_New(0);
+    if (self->stringref_namespace) {
+        ret = decode(self, DECODE_NORMAL);
+        Py_CLEAR(self->stringref_namespace);
+    }
+
+    self->stringref_namespace = old_namespace;
+    return ret;
+}
+
+// CBORDecoder.decode_set(self)
+static PyObject *
+CBORDecoder_decode_set(CBORDecoderObject *self)
+{
+    // semantic type 258
+    PyObject *array, *ret = NULL;
+
+    array = decode(self, DECODE_IMMUTABLE);
+    if (array) {
+        if (PyList_CheckExact(array) || PyTuple_CheckExact(array)) {
+            if (self->immutable)
+                ret = PyFrozenSet_New(array);
+            else
+                ret = PySet_New(array);
+        } else
+            PyErr_Format(
+                _CBOR2_CBORDecodeValueError, "invalid set array %R", array);
+        Py_DECREF(array);
+    }
+    // This can be done after construction of the set/frozenset because,
+    // unlike lists/dicts a set cannot contain a reference to itself (a set
+    // is unhashable). Nor can a frozenset contain a reference to itself
+    // because it can't refer to itself during its own construction.
+    set_shareable(self, ret);
+    return ret;
+}
+
+
+// CBORDecoder.decode_ipaddress(self)
+static PyObject *
+CBORDecoder_decode_ipaddress(CBORDecoderObject *self)
+{
+    // semantic type 260
+    PyObject *tag, *bytes, *ret = NULL;
+
+    if (CBOR2_INIT(_CBOR2_ip_address, _CBOR2_init_ip_address) == -1)
+        return NULL;
+    bytes = decode(self, DECODE_UNSHARED);
+    if (bytes) {
+        if (PyBytes_CheckExact(bytes)) {
+            if (PyBytes_GET_SIZE(bytes) == 4 || PyBytes_GET_SIZE(bytes) == 16)
+                ret = PyObject_CallFunctionObjArgs(_CBOR2_ip_address, bytes, NULL);
+            else if (PyBytes_GET_SIZE(bytes) == 6) {
+                // MAC address
+                tag = CBORTag_New(260);
+                if (tag) {
+                    if (CBORTag_SetValue(tag, bytes) == 0) {
+                        if (self->tag_hook == Py_None) {
+                            Py_INCREF(tag);
+                            ret = tag;
+                        } else {
+                            self->stats.tag_hook_calls++;
+                            ret = PyObject_CallFunctionObjArgs(
+                                    self->tag_hook, self, tag, NULL);
+                        }
+                    }
+                    Py_DECREF(tag);
+                }
+            } else
+                PyErr_Format(
+                    _CBOR2_CBORDecodeValueError,
+                    "invalid ipaddress value %R", bytes);
+        } else
+            PyErr_Format(
+                _CBOR2_CBORDecodeValueError,
+                "invalid ipaddress value %R", bytes);
+        Py_DECREF(bytes);
+    }
+    set_shareable(self, ret);
+    return ret;
+}
+
+
+// CBORDecoder.decode_ipnetwork(self)
+static PyObject *
+CBORDecoder_decode_ipnetwork(CBORDecoderObject *self)
+{
+    // semantic type 261
+    PyObject *map, *tuple, *bytes, *prefixlen, *ret = NULL;
+    Py_ssize_t pos = 0;
+
+    if (CBOR2_INIT(_CBOR2_ip_network, _CBOR2_init_ip_address) == -1)
+        return NULL;
+    map = decode(self, DECODE_UNSHARED);
+    if (map) {
+        if (PyDict_CheckExact(map) && PyDict_Size(map) == 1) {
+            if (PyDict_Next(map, &pos, &bytes, &prefixlen)) {
+                if (
+                        PyBytes_CheckExact(bytes) &&
+                        PyLong_CheckExact(prefixlen) &&
+                        (PyBytes_GET_SIZE(bytes) == 4 ||
+                         PyBytes_GET_SIZE(bytes) == 16)) {
+                    tuple = PyTuple_Pack(2, bytes, prefixlen);
+                    if (tuple) {
+                        ret = PyObject_CallFunctionObjArgs(
+                                _CBOR2_ip_network, tuple, Py_False, NULL);
+                        Py_DECREF(tuple);
+                    }
+                } else
+                    PyErr_Format(
+                        _CBOR2_CBORDecodeValueError,
+                        "invalid ipnetwork value %R", map);
+            } else
+                // We've already checked the size is 1 so this shouldn't be
+                // possible
+                assert(0);
+        } else
+            PyErr_Format(
+                _CBOR2_CBORDecodeValueError,
+                "invalid ipnetwork value %R", map);
+        Py_DECREF(map);
+    }
+    set_shareable(self, ret);
+    return ret;
+}
+
+
+// Byte swapping for typed arrays in the other byte order; compilers turn
+// these into bswap instructions, and vectorize the loops over them
+static inline uint16_t
+swap16(uint16_t x)
+{
+    return (uint16_t) (x << 8 | x >> 8);
+}
+
+
+static inline uint32_t
+swap32(uint32_t x)
+{
+    return (uint32_t) swap16((uint16_t) x) << 16 | swap16((uint16_t) (x >> 16));
+}
+
+
+static inline uint64_t
+swap64(uint64_t x)
+{
+    return (uint64_t) swap32((uint32_t) x) << 32 | swap32((uint32_t) (x >> 32));
+}
+
+
+static void
+swap_items(char *buf, Py_ssize_t len, Py_ssize_t size)
+{
+    Py_ssize_t i;
+
+    if (size == 2) {
+        uint16_t *p = (uint16_t *) buf;
+        for (i = 0; i < len / 2; i++)
+            p[i] = swap16(p[i]);
+    } else if (size == 4) {
+        uint32_t *p = (uint32_t *) buf;
+        for (i = 0; i < len / 4; i++)
+            p[i] = swap32(p[i]);
+    } else if (size == 8) {
+        uint64_t *p = (uint64_t *) buf;
+        for (i = 0; i < len / 8; i++)
+            p[i] = swap64(p[i]);
+    }
+}
+
+
+// Converts a typed array of half-precision floats to single-precision ones,
+// which the array module can hold
+static PyObject *
+unpack_half_floats(PyObject *data, bool little)
+{
+    Py_buffer view;
+    PyObject *ret;
+    float *out;
+
+    if (PyObject_GetBuffer(data, &view, PyBUF_SIMPLE) == -1)
+        return NULL;
+    ret = PyBytes_FromStringAndSize(NULL, view.len * 2);
+    if (ret) {
+        out = (float *) PyBytes_AS_STRING(ret);
+        unpack_float16_array(view.buf, out, view.len / 2, little);
+    }
+    PyBuffer_Release(&view);
+    return ret;
+}
+
+
+static PyObject *
+decode_typed_array(CBORDecoderObject *self, uint64_t tagnum)
+{
+    // semantic types 64-87
+    LeadByte lead;
+    uint64_t length;
+    const char *data;
+    PyObject *bytes, *array, *ret = NULL;
+    Py_buffer view;
+    Py_ssize_t size;
+    char typecode;
+    bool little = tagnum & 4, swap;
+
+    if (CBOR2_INIT(_CBOR2_array, _CBOR2_init_array) == -1)
+        return NULL;
+    if (tagnum & 16) {
+        size = 2 << (tagnum & 3);
+        typecode = size == 8 ? 'd' : 'f';
+    } else {
+        size = 1 << (tagnum & 3);
+        typecode = (tagnum & 8 ? "bhiq" : "BHIQ")[tagnum & 3];
+    }
+    swap = size > 1 && little == (bool) PY_BIG_ENDIAN;
+
+    if (fp_read(self, &lead.byte, 1) == -1)
+        return NULL;
+    if (lead.major != 2) {
+        PyErr_Format(
+            _CBOR2_CBORDecodeValueError,
+            "invalid typed array value (expected a byte string, found major "
+            "type %d)", lead.major);
+        return NULL;
+    }
+    if (self->input.buf && lead.subtype != 31 &&
+            self->stringref_namespace == Py_None) {
+        // Copy the elements straight from the input
+        if (decode_length(self, lead.subtype, &length, NULL) == -1)
+            return NULL;
+        if (length > (uint64_t) PY_SSIZE_T_MAX) {
+            PyErr_SetString(_CBOR2_CBORDecodeValueError,
+                            "excessive bytestring size");
+            return NULL;
+        }
+        data = input_consume(self, (Py_ssize_t) length);
+        if (!data)
+            return NULL;
+        bytes = PyMemoryView_FromMemory(
+                (char *) data, (Py_ssize_t) length, PyBUF_READ);
+    } else
+        bytes = decode_bytestring(self, lead.subtype);
+    if (!bytes)
+        return NULL;
+
+    length = (uint64_t) PyObject_Length(bytes);
+    if (length % size) {
+        PyErr_Format(
+            _CBOR2_CBORDecodeValueError,
+            "invalid typed array length %zd for %zd byte elements",
+            (Py_ssize_t) length, size);
+        goto out;
+    }
+    if (size == 2 && typecode == 'f') {
+        Py_SETREF(bytes, unpack_half_floats(bytes, little));
+        if (!bytes)
+            goto out;
+        swap = false;
+    }
+
+    array = PyObject_CallFunction(_CBOR2_array, "C", typecode);
+    if (!array)
+        goto out;
+    ret = PyObject_CallMethodObjArgs(array, _CBOR2_str_frombytes, bytes, NULL);
+    if (ret) {
+        Py_DECREF(ret);
+        ret = array;
+        if (swap) {
+            if (PyObject_GetBuffer(array, &view, PyBUF_WRITABLE) == 0) {
+                // Nothing else can see the new array yet
+                if (view.len < NOGIL_COPY_SIZE)
+                    swap_items(view.buf, view.len, size);
+                else {
+                    Py_BEGIN_ALLOW_THREADS
+                    swap_items(view.buf, view.len, size);
+                    Py_END_ALLOW_THREADS
+                }
+                PyBuffer_Release(&view);
+            } else
+                Py_CLEAR(ret);
+        }
+        // Arrays aren't hashable, so immutable ones (map keys, for instance)
+        // are returned as tuples
+        if (ret && self->immutable) {
+            ret = PySequence_Tuple(array);
+            Py_DECREF(array);
+        }
+    } else
+        Py_DECREF(array);
+out:
+    Py_XDECREF(bytes);
+    set_shareable(self, ret);
+    return ret;
+}
+
+
+// CBORDecoder.decode_typed_array(self, tagnum)
+static PyObject *
+CBORDecoder_decode_typed_array(CBORDecoderObject *self, PyObject *tagnum)
+{
+    // semantic types 64-87
+    uint64_t val = PyLong_AsUnsignedLongLong(tagnum);
+
+    if (val == (uint64_t) -1 && PyErr_Occurred())
+        return NULL;
+    if (!is_typed_array_tag(val)) {
+        PyErr_Format(PyExc_ValueError,
+                     "%R is not a supported typed array tag", tagnum);
+        return NULL;
+    }
+    return decode_typed_array(self, val);
+}
+
+
+// CBORDecoder.decode_self_describe_cbor(self)
+static PyObject *
+CBORDecoder_decode_self_describe_cbor(CBORDecoderObject *self)
+{
+    // semantic tag 55799
+    return decode(self, DECODE_NORMAL);
+}
+
+
+// Special decoders //////////////////////////////////////////////////////////
+
+static PyObject *
+decode_special(CBORDecoderObject *self, uint8_t subtype)
+{
+    // major type 7
+    PyObject *tag, *ret = NULL;
+
+    if ((subtype) < 20) {
+        tag = PyStructSequence_New(&CBORSimpleValueType);
+        if (tag) {
+            PyStructSequence_SET_ITEM(tag, 0, PyLong_FromLong(subtype));
+            if (PyStructSequence_GET_ITEM(tag, 0)) {
+                Py_INCREF(tag);
+                ret = tag;
+            }
+            Py_DECREF(tag);
+            // XXX Set shareable?
+        }
+    } else {
+        switch (subtype) {
+            case 20: Py_RETURN_FALSE;
+            case 21: Py_RETURN_TRUE;
+            case 22: Py_RETURN_NONE;
+            case 23: CBOR2_RETURN_UNDEFINED;
+            case 24: return CBORDecoder_decode_simple_value(self);
+            case 25: return CBORDecoder_decode_float16(self);
+            case 26: return CBORDecoder_decode_float32(self);
+            case 27: return CBORDecoder_decode_float64(self);
+            case 31: CBOR2_RETURN_BREAK;
+            default:
+                PyErr_Format(
+                    _CBOR2_CBORDecodeValueError,
+                    "Undefined Reserved major type 7 subtype 0x%x", subtype);
+                break;
+        }
+    }
+    return ret;
+}
+
+
+// CBORDecoder.decode_simple_value(self)
+static PyObject *
+CBORDecoder_decode_simple_value(CBORDecoderObject *self)
+{
+    PyObject *tag, *ret = NULL;
+    uint8_t buf;
+
+    if (fp_read(self, (char*)&buf, sizeof(uint8_t)) == 0) {
+        tag = PyStructSequence_New(&CBORSimpleValueType);
+        if (tag) {
+            PyStructSequence_SET_ITEM(tag, 0, PyLong_FromLong(buf));
+            if (PyStructSequence_GET_ITEM(tag, 0)) {
+                Py_INCREF(tag);
+                ret = tag;
+            }
+            Py_DECREF(tag);
+        }
+    }
+    // XXX Set shareable?
+    return ret;
+}
+
+
+// CBORDecoder.decode_float16(self)
+static PyObject *
+CBORDecoder_decode_float16(CBORDecoderObject *self)
+{
+    PyObject *ret = NULL;
+    union {
+        uint16_t i;
+        char buf[sizeof(uint16_t)];
+    } u;
+
+    if (fp_read(self, u.buf, sizeof(uint16_t)) == 0)
+        ret = PyFloat_FromDouble(unpack_float16(u.i));
+    set_shareable(self, ret);
+    return ret;
+}
+
+
+// CBORDecoder.decode_float32(self)
+static PyObject *
+CBORDecoder_decode_float32(CBORDecoderObject *self)
+{
+    PyObject *ret = NULL;
+    union {
+        uint32_t i;
+        float f;
+        char buf[sizeof(float)];
+    } u;
+
+    if (fp_read(self, u.buf, sizeof(float)) == 0) {
+        u.i = be32toh(u.i);
+        ret = PyFloat_FromDouble(u.f);
+    }
+    set_shareable(self, ret);
+    return ret;
+}
+
+
+// CBORDecoder.decode_float64(self)
+static PyObject *
+CBORDecoder_decode_float64(CBORDecoderObject *self)
+{
+    PyObject *ret = NULL;
+    union {
+        uint64_t i;
+        double f;
+        char buf[sizeof(double)];
+    } u;
+
+    if (fp_read(self, u.buf, sizeof(double)) == 0) {
+        u.i = be64toh(u.i);
+        ret = PyFloat_FromDouble(u.f);
+    }
+    set_shareable(self, ret);
+    return ret;
+}
+
+
+PyObject *
+decode(CBORDecoderObject *self, DecodeOptions options)
+{
+    bool old_immutable;
+    Py_ssize_t old_index;
+    PyObject *ret = NULL;
+    LeadByte lead;
+
+    if (options & DECODE_IMMUTABLE) {
+        old_immutable = self->immutable;
+        self->immutable = true;
+    }
+    if (options & DECODE_UNSHARED) {
+        old_index = self->shared_index;
+        self->shared_index = -1;
+    }
+
+    if (Py_EnterRecursiveCall(" in CBORDecoder.decode"))
+        return NULL;
+    if (self->depth++ == 0 && self->tracking)
+        value_begin(self);
+
+    if (fp_read(self, &lead.byte, 1) == 0 &&
+            (!self->tracking || count_item(self, lead) == 0)) {
+        switch (lead.major) {
+            case 0: ret = decode_uint(self, lead.subtype);       break;
+            case 1: ret = decode_negint(self, lead.subtype);     break;
+            case 2: ret = decode_bytestring(self, lead.subtype); break;
+            case 3:
+                if (options & DECODE_KEY)
+                    ret = decode_key_string(self, lead.subtype);
+                else
+                    ret = decode_string(self, lead.subtype);
+                break;
+            case 4: ret = decode_array(self, lead.subtype);      break;
+            case 5: ret = decode_map(self, lead.subtype);        break;
+            case 6: ret = decode_semantic(self, lead.subtype);   break;
+            case 7: ret = decode_special(self, lead.subtype);    break;
+            default: assert(0);
+        }
+    }
+
+    if (--self->depth == 0 && self->tracking)
+        value_end(self);
+    Py_LeaveRecursiveCall();
+    if (options & DECODE_IMMUTABLE)
+        self->immutable = old_immutable;
+    if (options & DECODE_UNSHARED)
+        self->shared_index = old_index;
+    return ret;
+}
+
+
+// Decodes a map directly into an instance of record_type, passing the values
+// of its fields as keyword arguments; the values of any other keys are
+// decoded and discarded
+static PyObject *
+decode_record_map(CBORDecoderObject *self)
+{
+    LeadByte lead;
+    uint64_t length;
+    bool indefinite = true;
+    PyObject *key, *index, *name, *value, *kwnames, **values, *ret = NULL;
+    Py_ssize_t count, found, i, pos;
+    int err = 0;
+
+    if (fp_read(self, &lead.byte, 1) == -1)
+        return NULL;
+    if (lead.major != 5) {
+        PyErr_Format(
+            _CBOR2_CBORDecodeValueError,
+            "expected a map to decode into %R (found major type %d)",
+            self->record_type, lead.major);
+        return NULL;
+    }
+    if (self->tracking && count_item(self, lead) == -1)
+        return NULL;
+    if (decode_length(self, lead.subtype, &length, &indefinite) == -1)
+        return NULL;
+    if (!indefinite && self->limited &&
+            check_container(self, length, true) == -1)
+        return NULL;
+
+    // The value of each field found, by index; each is passed as a keyword
+    // argument named for the field, which the constructor can match by
+    // identity, so no dict of them is built
+    count = PyDict_GET_SIZE(self->record_fields);
+    values = PyMem_Calloc(count ? count : 1, sizeof(PyObject *));
+    if (!values)
+        return PyErr_NoMemory();
+    while (err == 0 && (indefinite || length--)) {
+        key = decode(self,
+                     DECODE_IMMUTABLE | DECODE_UNSHARED | DECODE_KEY);
+        if (!key) {
+            err = -1;
+            break;
+        } else if (indefinite && key == break_marker) {
+            Py_DECREF(key);
+            break;
+        }
+        index = PyUnicode_Check(key) ?
+            PyDict_GetItemWithError(self->record_fields, key) : NULL;
+        if (index) {
+            value = decode_map_value(self, key);
+            if (value)
+                Py_XSETREF(values[PyLong_AsSsize_t(index)], value);
+            else
+                err = -1;
+        } else if (PyErr_Occurred())
+            err = -1;
+        else {
+            // the values of keys that aren't fields are skipped over
+            SkipStats stats = {0};
+
+            err = skip_value(self, &stats);
+        }
+        Py_DECREF(key);
+    }
+
+    if (err == 0) {
+        for (i = found = 0; i < count; i++)
+            found += values[i] != NULL;
+        kwnames = PyTuple_New(found);
+        if (kwnames) {
+            // record_fields is in field order, so the values found can be
+            // moved down in place
+            pos = 0;
+            found = 0;
+            while (PyDict_Next(self->record_fields, &pos, &name, &index)) {
+                i = PyLong_AsSsize_t(index);
+                if (values[i]) {
+                    Py_INCREF(name);
+                    PyTuple_SET_ITEM(kwnames, found, name);
+                    values[found] = values[i];
+                    if (i != found)
+                        values[i] = NULL;
+                    found++;
+                }
+            }
+            ret = PyObject_Vectorcall(self->record_type, values, 0, kwnames);
+            Py_DECREF(kwnames);
+        }
+    }
+    for (i = 0; i < count; i++)
+        Py_XDECREF(values[i]);
+    PyMem_Free(values);
+    return ret;
+}
+
+
+static PyObject *
+decode_record(CBORDecoderObject *self)
+{
+    PyObject *ret;
+
+    // Tracked as if the map were decoded by decode(), which it isn't
+    if (self->depth++ == 0 && self->tracking)
+        value_begin(self);
+    ret = decode_record_map(self);
+    if (--self->depth == 0 && self->tracking)
+        value_end(self);
+    return ret;
+}
+
+
+// CBORDecoder.decode(self) -> obj
+PyObject *
+CBORDecoder_decode(CBORDecoderObject *self)
+{
+    PyObject *ret;
+    int acquired = fp_acquire(self);
+
+    if (acquired == -1)
+        return NULL;
+    if (self->record_type != Py_None)
+        ret = decode_record(self);
+    else
+        ret = decode(self, DECODE_NORMAL);
+    return acquired ? fp_release(self, ret) : ret;
+}
+
+
+// Returns 1 if the input is exhausted, 0 if there's more to decode, or -1 on
+// error. Only meaningful between top-level items; for a stream this may read
+// the next block from fp into the read-ahead buffer
+static int
+input_exhausted(CBORDecoderObject *self)
+{
+    PyObject *chunk;
+    int ret = 0;
+
+    if (self->input.buf)
+        ret = self->input_pos >= self->input.len;
+    else if (!read_ahead_length(self)) {
+        chunk = fp_call_read(self, read_ahead_size(self));
+        if (chunk) {
+            Py_XDECREF(self->readahead);
+            self->readahead = chunk;
+            self->read_pos = 0;
+            ret = PyBytes_GET_SIZE(chunk) == 0;
+        } else
+            ret = -1;
+    }
+    return ret;
+}
+
+
+// Forget the shared values decoded so far so that the next value decoded
+// can't refer back to any of them
+static int
+clear_references(CBORDecoderObject *self)
+{
+    return PyList_SetSlice(self->shareables, 0, PY_SSIZE_T_MAX, NULL);
+}
+
+
+// CBORDecoder.reset(self, fp=None)
+static PyObject *
+CBORDecoder_reset(CBORDecoderObject *self, PyObject *args, PyObject *kwargs)
+{
+    static char *keywords[] = {"fp", NULL};
+    PyObject *fp = Py_None, *ret = NULL;
+
+    if (!PyArg_ParseTupleAndKeywords(args, kwargs, "|O", keywords, &fp))
+        return NULL;
+
+    if (fp == Py_None || _CBORDecoder_set_fp(self, fp, NULL) == 0) {
+        if (clear_references(self) == 0) {
+            Py_INCREF(Py_None);
+            ret = Py_None;
+        }
+    }
+    return ret;
+}
+
+
+// CBORDecoder.__next__(self) -> obj
+static PyObject *
+CBORDecoder_iternext(CBORDecoderObject *self)
+{
+    PyObject *ret = NULL;
+    int acquired = fp_acquire(self);
+
+    if (acquired == -1)
+        return NULL;
+    // Iteration over a CBOR sequence (RFC 8742) ends cleanly only when the
+    // input runs out between items; running out part way through an item
+    // raises CBORDecodeEOF as usual
+    switch (input_exhausted(self)) {
+        case 0:
+            // Items of a sequence are independent, so shared values can't be
+            // referenced from later items
+            if (clear_references(self) == 0)
+                ret = CBORDecoder_decode(self);
+            break;
+        case 1:
+            // returning NULL without an exception set raises StopIteration
+            break;
+    }
+    return acquired ? fp_release(self, ret) : ret;
+}
+
+
+// CBORDecoder.decode_from_bytes(self, data)
+PyObject *
+CBORDecoder_decode_from_bytes(CBORDecoderObject *self, PyObject *data)
+{
+    Py_buffer save_input;
+    Py_ssize_t save_pos;
+    bool save_fp_input;
+    PyObject *ret = NULL;
+
+    // Decode directly from a view of data (which may be any object
+    // supporting the buffer protocol) rather than wrapping it in a BytesIO;
+    // the current input is saved so that this can be called re-entrantly
+    // from tag_hook and object_hook
+    save_input = self->input;
+    save_pos = self->input_pos;
+    save_fp_input = self->fp_input;
+    if (PyObject_GetBuffer(data, &self->input, PyBUF_SIMPLE) == 0) {
+        self->input_pos = 0;
+        self->fp_input = false;
+        ret = decode(self, DECODE_NORMAL);
+        PyBuffer_Release(&self->input);
+    }
+    self->input = save_input;
+    self->input_pos = save_pos;
+    self->fp_input = save_fp_input;
+    return ret;
+}
+
+
+// Switches the decoder to reading from a view of data (which may be any object
+// supporting the buffer protocol) in place of fp; used by loads_sequence()
+int
+CBORDecoder_set_input(CBORDecoderObject *self, PyObject *data)
+{
+    Py_buffer view;
+
+    if (PyObject_GetBuffer(data, &view, PyBUF_SIMPLE) == -1)
+        return -1;
+    if (self->input.obj)
+        PyBuffer_Release(&self->input);
+    self->input = view;
+    self->input_pos = 0;
+    self->fp_input = false;
+    return 0;
+}
+
+
+// CBORDecoder.release_read_ahead(self) -> bytes
+PyObject *
+CBORDecoder_release_read_ahead(CBORDecoderObject *self)
+{
+    PyObject *ret = NULL;
+    Py_ssize_t left = read_ahead_length(self), delta;
+
+    if (self->fp_input) {
+        if (fp_seek(self, self->input_pos, SEEK_SET, NULL) == 0) {
+            Py_INCREF(_CBOR2_empty_bytes);
+            ret = _CBOR2_empty_bytes;
+        }
+    } else if (self->seek != Py_None) {
+        // Between calls fp is already just after what was decoded (see
+        // fp_release); otherwise it's moved back there
+        delta = self->rewound - left;
+        if (!delta || fp_seek(self, delta, SEEK_CUR, NULL) == 0) {
+            Py_INCREF(_CBOR2_empty_bytes);
+            ret = _CBOR2_empty_bytes;
+        }
+    } else if (!left) {
+        Py_INCREF(_CBOR2_empty_bytes);
+        ret = _CBOR2_empty_bytes;
+    } else {
+        ret = PyBytes_FromStringAndSize(
+                PyBytes_AS_STRING(self->readahead) + self->read_pos, left);
+    }
+    if (ret) {
+        Py_CLEAR(self->readahead);
+        self->read_pos = 0;
+        self->rewound = 0;
+    }
+    return ret;
+}
+
+
+// Skipping //////////////////////////////////////////////////////////////////
+
+// Skips over length bytes of the input without creating any objects
+static int
+skip_bytes(CBORDecoderObject *self, uint64_t length, SkipStats *stats)
+{
+    Py_ssize_t chunk;
+
+    if (length > (uint64_t) (PY_SSIZE_T_MAX - stats->size)) {
+        PyErr_SetString(_CBOR2_CBORDecodeValueError, "excessive string size");
+        return -1;
+    }
+    stats->size += (Py_ssize_t) length;
+    if (self->input.buf)
+        return fp_read_ptr(self, (Py_ssize_t) length) ? 0 : -1;
+    // Don't make the read-ahead buffer hold all of a long string at once
+    while (length) {
+        chunk = length > 65536 ? 65536 : (Py_ssize_t) length;
+        if (!fp_read_ptr(self, chunk))
+            return -1;
+        length -= chunk;
+    }
+    return 0;
+}
+
+
+// Reads the length (or value) that follows a lead byte and counts the bytes
+// it took, including the lead byte itself
+static int
+skip_length(CBORDecoderObject *self, uint8_t subtype, uint64_t *length,
+            bool *indefinite, SkipStats *stats)
+{
+    if (decode_length(self, subtype, length, indefinite) == -1)
+        return -1;
+    stats->size++;
+    if (subtype >= 24 && subtype < 28)
+        stats->size += 1 << (subtype - 24);
+    return 0;
+}
+
+
+// Skips over the rest of an indefinite length string of the given major type
+static int
+skip_chunks(CBORDecoderObject *self, uint8_t major, SkipStats *stats)
+{
+    LeadByte lead;
+    uint64_t length;
+
+    for (;;) {
+        if (fp_read(self, &lead.byte, 1) == -1)
+            return -1;
+        if ((uint8_t) lead.byte == 0xFF) {
+            stats->size++;
+            return 0;
+        }
+        if (lead.major != major || lead.subtype == 31) {
+            PyErr_SetString(
+                _CBOR2_CBORDecodeValueError, major == 2 ?
+                "non-bytestring found in indefinite length bytestring" :
+                "non-string found in indefinite length string");
+            return -1;
+        }
+        if (skip_length(self, lead.subtype, &length, NULL, stats) == -1 ||
+                skip_bytes(self, length, stats) == -1)
+            return -1;
+    }
+}
+
+
+// Skips over the next item of the input, checking that it's well-formed but
+// creating no objects, and adds it to stats. Returns 0 on success, 1 if the
+// "item" was a break marker, or -1 on error
+static int
+skip_item(CBORDecoderObject *self, SkipStats *stats)
+{
+    LeadByte lead;
+    uint64_t length, count;
+    bool indefinite = true;
+    int ret = -1;
+
+    if (fp_read(self, &lead.byte, 1) == -1)
+        return -1;
+    if ((uint8_t) lead.byte == 0xFF) {
+        stats->size++;
+        return 1;
+    }
+    stats->items++;
+    switch (lead.major) {
+        case 0:
+        case 1:
+            return skip_length(self, lead.subtype, &length, NULL, stats);
+        case 2:
+        case 3:
+            if (skip_length(self, lead.subtype, &length, &indefinite,
+                            stats) == -1)
+                return -1;
+            if (indefinite)
+                return skip_chunks(self, lead.major, stats);
+            return skip_bytes(self, length, stats);
+        case 4:
+        case 5:
+        case 6:
+            if (lead.major == 6) {
+                if (skip_length(self, lead.subtype, &length, NULL,
+                                stats) == -1)
+                    return -1;
+                length = 1;
+                indefinite = false;
+            } else if (skip_length(self, lead.subtype, &length, &indefinite,
+                                   stats) == -1)
+                return -1;
+            // A map has two items (a key and a value) per entry
+            if (lead.major == 5 && !indefinite) {
+                if (length > UINT64_MAX / 2) {
+                    PyErr_SetString(_CBOR2_CBORDecodeValueError,
+                                    "excessive map size");
+                    return -1;
+                }
+                length *= 2;
+            }
+            if (Py_EnterRecursiveCall(" in CBORDecoder.skip"))
+                return -1;
+            if (++stats->depth > stats->max_depth)
+                stats->max_depth = stats->depth;
+            ret = 0;
+            for (count = 0; ret == 0 && (indefinite || count < length);
+                    count++) {
+                ret = skip_item(self, stats);
+                if (ret == 1) {
+                    // A break marker may only end an indefinite length array
+                    // or map, and not in the middle of a map entry
+                    if (indefinite && (lead.major == 4 || !(count & 1))) {
+                        ret = 0;
+                        break;
                     }
-                    Py_DECREF(tag);
+                    PyErr_SetString(_CBOR2_CBORDecodeValueError,
+                                    "unexpected break marker");
+                    ret = -1;
                 }
-                break;
-        }
+            }
+            stats->depth--;
+            Py_LeaveRecursiveCall();
+            return ret;
+        case 7:
+            stats->size++;
+            switch (lead.subtype) {
+                case 24: return skip_bytes(self, 1, stats);
+                case 25: return skip_bytes(self, 2, stats);
+                case 26: return skip_bytes(self, 4, stats);
+                case 27: return skip_bytes(self, 8, stats);
+                case 28:
+                case 29:
+                case 30:
+                    PyErr_Format(
+                        _CBOR2_CBORDecodeValueError,
+                        "Undefined Reserved major type 7 subtype 0x%x",
+                        lead.subtype);
+                    return -1;
+                default: return 0;
+            }
+        default: assert(0);
+    }
+    return -1;
+}
+
+
+// Skips over the next item at the top level of the input
+static int
+skip_value(CBORDecoderObject *self, SkipStats *stats)
+{
+    int ret = skip_item(self, stats);
+
+    if (ret == 1) {
+        PyErr_SetString(_CBOR2_CBORDecodeValueError,
+                        "unexpected break marker");
+        ret = -1;
+    }
+    return ret;
+}
+
+
+// Returns the next item as a CBORRaw holding its encoded form, preceded by
+// the header_len bytes at header (the already consumed header of a tag whose
+// content is the item). Reading from fp, what's consumed while skipping over
+// the item is collected in raw_capture (see read_ahead_consume); in-memory
+// input is simply sliced, the header being just before the item
+static PyObject *
+decode_raw(CBORDecoderObject *self, const char *header, Py_ssize_t header_len)
+{
+    SkipStats stats = {0};
+    PyObject *data = NULL, *ret = NULL;
+    Py_ssize_t start;
+
+    if (self->input.buf) {
+        start = self->input_pos - header_len;
+        if (skip_value(self, &stats) == 0)
+            data = PyBytes_FromStringAndSize(
+                    (const char *) self->input.buf + start,
+                    self->input_pos - start);
+    } else {
+        self->raw_capture = PyByteArray_FromStringAndSize(header, header_len);
+        if (!self->raw_capture)
+            return NULL;
+        if (skip_value(self, &stats) == 0)
+            data = PyBytes_FromStringAndSize(
+                    PyByteArray_AS_STRING(self->raw_capture),
+                    PyByteArray_GET_SIZE(self->raw_capture));
+        Py_CLEAR(self->raw_capture);
+    }
+    if (data) {
+        ret = CBORRaw_New(data);
+        Py_DECREF(data);
     }
     return ret;
 }
 
 
+// CBORDecoder.decode_raw(self) -> CBORRaw
+static PyObject *
+CBORDecoder_decode_raw(CBORDecoderObject *self)
+{
+    PyObject *ret;
+    int acquired = fp_acquire(self);
+
+    if (acquired == -1)
+        return NULL;
+    ret = decode_raw(self, NULL, 0);
+    return acquired ? fp_release(self, ret) : ret;
+}
+
+
+// CBORDecoder.skip(self) -> int
+static PyObject *
+CBORDecoder_skip(CBORDecoderObject *self)
+{
+    SkipStats stats = {0};
+    PyObject *ret = NULL;
+    int acquired = fp_acquire(self);
+
+    if (acquired == -1)
+        return NULL;
+    if (skip_value(self, &stats) == 0)
+        ret = PyLong_FromSsize_t(stats.size);
+    return acquired ? fp_release(self, ret) : ret;
+}
+
+
+// CBORDecoder.scan(self) -> (int, int, int)
+static PyObject *
+CBORDecoder_scan(CBORDecoderObject *self)
+{
+    SkipStats stats = {0};
+    PyObject *ret = NULL;
+    int acquired = fp_acquire(self);
+
+    if (acquired == -1)
+        return NULL;
+    if (skip_value(self, &stats) == 0)
+        ret = Py_BuildValue("(nnn)", stats.size, stats.items, stats.max_depth);
+    return acquired ? fp_release(self, ret) : ret;
+}
+
+
+// Decoder class definition //////////////////////////////////////////////////
+
+#define PUBLIC_MAJOR(type)                                                   \
+    static PyObject *                                                        \
+    CBORDecoder_decode_##type(CBORDecoderObject *self, PyObject *subtype)    \
+    {                                                                        \
+        return decode_##type(self, (uint8_t) PyLong_AsUnsignedLong(subtype));\
+    }
+
+PUBLIC_MAJOR(uint);
+PUBLIC_MAJOR(negint);
+PUBLIC_MAJOR(bytestring);
+PUBLIC_MAJOR(string);
+PUBLIC_MAJOR(array);
+PUBLIC_MAJOR(map);
+PUBLIC_MAJOR(semantic);
+PUBLIC_MAJOR(special);
+
+#undef PUBLIC_MAJOR
+
+static PyGetSetDef CBORDecoder_getsetters[] = {
+    {"fp",
+        (getter) _CBORDecoder_get_fp, (setter) _CBORDecoder_set_fp,
+        "input file-like object", NULL},
+    {"tag_hook",
+        (getter) _CBORDecoder_get_tag_hook, (setter) _CBORDecoder_set_tag_hook,
+        "hook called when decoding an unknown semantic tag", NULL},
+    {"object_hook",
+        (getter) _CBORDecoder_get_object_hook, (setter) _CBORDecoder_set_object_hook,
+        "hook called when decoding any dict", NULL},
+    {"str_errors",
+        (getter) _CBORDecoder_get_str_errors, (setter) _CBORDecoder_set_str_errors,
+        "the error mode to use when decoding UTF-8 encoded strings"},
+    {"record_type",
+        (getter) _CBORDecoder_get_record_type,
+        (setter) _CBORDecoder_set_record_type,
+        "dataclass or named tuple class that each top-level map is decoded "
+        "into, or None", NULL},
+    {"cache_keys",
+        (getter) _CBORDecoder_get_cache_keys,
+        (setter) _CBORDecoder_set_cache_keys,
+        "when True, repeated short string map keys are decoded as the same "
+        "str object", NULL},
+    {"int_cache_size",
+        (getter) _CBORDecoder_get_int_cache_size,
+        (setter) _CBORDecoder_set_int_cache_size,
+        "the number of non-negative (and of negative) integers nearest zero "
+        "that are decoded as shared int objects", NULL},
+    {"memoryview_size",
+        (getter) _CBORDecoder_get_memoryview_size,
+        (setter) _CBORDecoder_set_memoryview_size,
+        "the length from which bytestrings decoded from an fp supporting the "
+        "buffer protocol are returned as memoryview slices of it, or None", NULL},
+    {"raw_tags",
+        (getter) _CBORDecoder_get_raw_tags,
+        (setter) _CBORDecoder_set_raw_tags,
+        "frozenset of the numbers of tags that are returned still encoded, "
+        "as CBORRaw objects, or None", NULL},
+    {"raw_keys",
+        (getter) _CBORDecoder_get_raw_keys,
+        (setter) _CBORDecoder_set_raw_keys,
+        "frozenset of the map keys whose values are returned still encoded, "
+        "as CBORRaw objects, or None", NULL},
+    {"max_items",
+        (getter) _CBORDecoder_get_max_items,
+        (setter) _CBORDecoder_set_max_items,
+        "the most data items each value decoded may contain, or None", NULL},
+    {"max_length",
+        (getter) _CBORDecoder_get_max_length,
+        (setter) _CBORDecoder_set_max_length,
+        "the most items an array (or entries a map) may have, or None", NULL},
+    {"max_allocation",
+        (getter) _CBORDecoder_get_max_allocation,
+        (setter) _CBORDecoder_set_max_allocation,
+        "the most bytes each value decoded may allocate for its strings and "
+        "containers, or None", NULL},
+    {"collect_stats",
+        (getter) _CBORDecoder_get_collect_stats,
+        (setter) _CBORDecoder_set_collect_stats,
+        "when True, the decoder keeps the counters returned by stats", NULL},
+    {"stats",
+        (getter) _CBORDecoder_get_stats, NULL,
+        "dict of the counters kept while collect_stats is enabled, or None",
+        NULL},
+    {"immutable",
+        (getter) _CBORDecoder_get_immutable, NULL,
+        "when True, the next item decoded should be made immutable (a "
+        "tuple instead of a list, a frozenset instead of a set, etc.)"},
+    {NULL}
+};
+
+static PyMethodDef CBORDecoder_methods[] = {
+    {"read", (PyCFunction) CBORDecoder_read, METH_O,
+        "read the specified number of bytes from the input"},
+    // Decoding methods
+    {"decode", (PyCFunction) CBORDecoder_decode, METH_NOARGS,
+        "decode the next value from the input"},
+    {"decode_from_bytes", (PyCFunction) CBORDecoder_decode_from_bytes, METH_O,
+        "decode the specified byte-string"},
+    {"skip", (PyCFunction) CBORDecoder_skip, METH_NOARGS,
+        "skip over the next value without decoding it, returning its size"},
+    {"scan", (PyCFunction) CBORDecoder_scan, METH_NOARGS,
+        "skip over the next value, returning its size, item count and depth"},
+    {"decode_raw", (PyCFunction) CBORDecoder_decode_raw, METH_NOARGS,
+        "return the next value, still encoded, as a CBORRaw"},
+    {"decode_uint", (PyCFunction) CBORDecoder_decode_uint, METH_O,
+        "decode an unsigned integer from the input"},
+    {"decode_negint", (PyCFunction) CBORDecoder_decode_negint, METH_O,
+        "decode a negative integer from the input"},
+    {"decode_bytestring", (PyCFunction) CBORDecoder_decode_bytestring, METH_O,
+        "decode a bytes string from the input"},
+    {"decode_string", (PyCFunction) CBORDecoder_decode_string, METH_O,
+        "decode a unicode string from the input"},
+    {"decode_array", (PyCFunction) CBORDecoder_decode_array, METH_O,
+        "decode a list or tuple from the input"},
+    {"decode_map", (PyCFunction) CBORDecoder_decode_map, METH_O,
+        "decode a dict from the input"},
+    {"decode_semantic", (PyCFunction) CBORDecoder_decode_semantic, METH_O,
+        "decode a semantically tagged value from the input"},
+    {"decode_special", (PyCFunction) CBORDecoder_decode_special, METH_O,
+        "decode a special value from the input"},
+    {"decode_datetime_string",
+        (PyCFunction) CBORDecoder_decode_datetime_string, METH_NOARGS,
+        "decode a date-time string from the input"},
+    {"decode_epoch_datetime",
+        (PyCFunction) CBORDecoder_decode_epoch_datetime, METH_NOARGS,
+        "decode a timestamp offset from the input"},
+    {"decode_positive_bignum",
+        (PyCFunction) CBORDecoder_decode_positive_bignum, METH_NOARGS,
+        "decode a positive big-integer from the input"},
+    {"decode_negative_bignum",
+        (PyCFunction) CBORDecoder_decode_negative_bignum, METH_NOARGS,
+        "decode a negative big-integer from the input"},
+    {"decode_fraction", (PyCFunction) CBORDecoder_decode_fraction, METH_NOARGS,
+        "decode a fractional number from the input"},
+    {"decode_rational", (PyCFunction) CBORDecoder_decode_rational, METH_NOARGS,
+        "decode a rational value from the input"},
+    {"decode_bigfloat", (PyCFunction) CBORDecoder_decode_bigfloat, METH_NOARGS,
+        "decode a large floating-point value from the input"},
+    {"decode_regexp", (PyCFunction) CBORDecoder_decode_regexp, METH_NOARGS,
+        "decode a regular expression from the input"},
+    {"decode_mime", (PyCFunction) CBORDecoder_decode_mime, METH_NOARGS,
+        "decode a MIME message from the input"},
+    {"decode_uuid", (PyCFunction) CBORDecoder_decode_uuid, METH_NOARGS,
+        "decode a UUID from the input"},
+    {"decode_shareable",
+        (PyCFunction) CBORDecoder_decode_shareable, METH_NOARGS,
+        "decode a shareable value from the input"},
+    {"decode_sharedref", (PyCFunction) CBORDecoder_decode_sharedref, METH_NOARGS,
+        "decode a shared reference from the input"},
+    {"decode_stringref",
+        (PyCFunction) CBORDecoder_decode_stringref, METH_NOARGS,
+        "decode a string reference from the input"},
+    {"decode_stringref_namespace", (PyCFunction) CBORDecoder_decode_stringref_ns, METH_NOARGS,
+        "decode a string reference namespace from the input"},
+    {"decode_set", (PyCFunction) CBORDecoder_decode_set, METH_NOARGS,
+        "decode a set or frozenset from the input"},
+    {"decode_ipaddress", (PyCFunction) CBORDecoder_decode_ipaddress, METH_NOARGS,
+        "decode an IPv4Address or IPv6Address from the input"},
+    {"decode_ipnetwork", (PyCFunction) CBORDecoder_decode_ipnetwork, METH_NOARGS,
+        "decode an IPv4Network or IPv6Network from the input"},
+    {"decode_typed_array", (PyCFunction) CBORDecoder_decode_typed_array,
+        METH_O, "decode a typed array with the specified tag from the input"},
+    {"decode_self_describe_cbor", (PyCFunction) CBORDecoder_decode_self_describe_cbor, METH_NOARGS,
+        "decode a data item after a self-describe CBOR tag"},
+    {"decode_simple_value",
+        (PyCFunction) CBORDecoder_decode_simple_value, METH_NOARGS,
+        "decode a CBORSimpleValue from the input"},
+    {"decode_float16", (PyCFunction) CBORDecoder_decode_float16, METH_NOARGS,
+        "decode a half-precision floating-point value from the input"},
+    {"decode_float32", (PyCFunction) CBORDecoder_decode_float32, METH_NOARGS,
+        "decode a floating-point value from the input"},
+    {"decode_float64", (PyCFunction) CBORDecoder_decode_float64, METH_NOARGS,
+        "decode a double-precision floating-point value from the input"},
+    {"set_shareable", (PyCFunction) CBORDecoder_set_shareable, METH_O,
+        "set the specified object as the current shareable reference"},
+    {"reset", (PyCFunction) CBORDecoder_reset, METH_VARARGS | METH_KEYWORDS,
+        "forget all shared values decoded so far, so that the next value "
+        "can't refer to them, and optionally switch to a new fp"},
+    {"release_read_ahead",
+        (PyCFunction) CBORDecoder_release_read_ahead, METH_NOARGS,
+        "forget any data read ahead from fp but not yet decoded, returning "
+        "it if fp is not seekable"},
+    {NULL}
+};
+
+PyDoc_STRVAR(CBORDecoder__doc__,
+"The CBORDecoder class implements a fully featured `CBOR`_ decoder with\n"
+"several extensions for handling shared references, big integers,\n"
+"rational numbers and so on. Typically the class is not used directly,\n"
+"but the :func:`cbor2.load` and :func:`cbor2.loads` functions are called\n"
+"to indirectly construct and use the class.\n"
+"\n"
+"When the class is constructed manually, the main entry points are\n"
+":meth:`decode` and :meth:`decode_from_bytes`. Iterating over the decoder\n"
+"decodes successive values until the input is exhausted, treating it as a\n"
+"CBOR sequence (:rfc:`8742`).\n"
+"\n"
+"A decoder may be reused for any number of values. Shared values decoded\n"
+"earlier remain available to shared references until :meth:`reset` is\n"
+"called, which also allows switching to a new *fp* without constructing a\n"
+"new decoder.\n"
+"\n"
+":param tag_hook:\n"
+"    callable that takes 2 arguments: the decoder instance, and the\n"
+"    :class:`_cbor2.CBORTag` to be decoded. This callback is invoked for\n"
+"    any tags for which there is no built-in decoder. The return value is\n"
+"    substituted for the :class:`_cbor2.CBORTag` object in the\n"
+"    deserialized output\n"
+":param object_hook:\n"
+"    callable that takes 2 arguments: the decoder instance, and a\n"
+"    dictionary. This callback is invoked for each deserialized\n"
+"    :class:`dict` object. The return value is substituted for the dict\n"
+"    in the deserialized output.\n"
+":param read_size:\n"
+"    the minimum number of bytes to request from ``fp.read()`` at a time;\n"
+"    anything not yet decoded is buffered for subsequent reads. Defaults to\n"
+"    64 KiB if ``fp`` is seekable, in which case ``fp`` is moved back to\n"
+"    just after what was decoded at the end of every call, and to reading\n"
+"    only what is needed if not. See :meth:`release_read_ahead`.\n"
+":param record_type:\n"
+"    a dataclass or named tuple class; if given, each value decoded by\n"
+"    :meth:`decode` or by iteration must be a map, and is constructed\n"
+"    directly as an instance of this class with the map's values passed as\n"
+"    keyword arguments (the values of keys that aren't fields of the class\n"
+"    are skipped)\n"
+":param cache_keys:\n"
+"    if True (the default), short string map keys are looked up in a small\n"
+"    cache kept for the lifetime of the decoder, so that keys repeated\n"
+"    across maps and across values are decoded as the same :class:`str`\n"
+"    object instead of a new string each time (it isn't interned)\n"
+":param int_cache_size:\n"
+"    integers from ``-int_cache_size`` to ``int_cache_size - 1`` (outside\n"
+"    the -5 to 256 that Python always shares) are kept for the lifetime of\n"
+"    the decoder once decoded, and repeated values are returned as the same\n"
+"    :class:`int` object; 0 disables the cache\n"
+":param raw_tags:\n"
+"    a collection of tag numbers; tags with these numbers are returned as\n"
+"    :class:`CBORRaw` objects holding their encoded form (including the tag\n"
+"    itself) instead of being decoded\n"
+":param raw_keys:\n"
+"    a collection of map keys; the values of these keys are returned as\n"
+"    :class:`CBORRaw` objects holding their encoded form instead of being\n"
+"    decoded\n"
+":param memoryview_size:\n"
+"    if *fp* supports the buffer protocol (an :class:`mmap.mmap`, for\n"
+"    instance), bytestrings at least this long are returned as read-only\n"
+"    :class:`memoryview` slices of it instead of being copied; ``None``\n"
+"    (the default) always copies them\n"
+":param max_items:\n"
+"    the most data items (counting every key, value and tag, at any depth)\n"
+"    that each value decoded may contain, or ``None`` for no limit\n"
+":param max_length:\n"
+"    the most items an array, or entries a map, may have, or ``None`` for\n"
+"    no limit; definite lengths are checked before anything is allocated\n"
+":param max_allocation:\n"
+"    the most bytes each value decoded may have allocated for it, counting\n"
+"    the length of every string and bytestring, 8 bytes for each array item\n"
+"    and 16 for each map entry, or ``None`` for no limit. Exceeding any of\n"
+"    the limits raises :exc:`CBORDecodeValueError`\n"
+":param collect_stats:\n"
+"    if True, the decoder keeps counters of what it has done, which are\n"
+"    available from :attr:`stats`\n"
+"\n"
+".. _CBOR: https://cbor.io/\n"
+);
+
+PyTypeObject CBORDecoderType = {
+    PyVarObject_HEAD_INIT(NULL, 0)
+    .tp_name = "_cbor2.CBORDecoder",
+    .tp_doc = CBORDecoder__doc__,
+    .tp_basicsize = sizeof(CBORDecoderObject),
+    .tp_itemsize = 0,
+    .tp_flags = Py_TPFLAGS_DEFAULT | Py_TPFLAGS_BASETYPE | Py_TPFLAGS_HAVE_GC,
+    .tp_new = CBORDecoder_new,
+    .tp_init = (initproc) CBORDecoder_init,
+    .tp_dealloc = (destructor) CBORDecoder_dealloc,
+    .tp_traverse = (traverseproc) CBORDecoder_traverse,
+    .tp_clear = (inquiry) CBORDecoder_clear,
+    .tp_getset = CBORDecoder_getsetters,
+    .tp_methods = CBORDecoder_methods,
+    .tp_iter = PyObject_SelfIter,
+    .tp_iternext = (iternextfunc) CBORDecoder_iternext,
+};
+
+
+// Lazy decoding /////////////////////////////////////////////////////////////
+
+// The lazy arrays and maps returned by loads_lazy() share a decoder whose
+// input is a view of the whole document. An item is located by skipping over
+// the ones before it (see skip_item), and decoded the first time it's
+// accessed, with arrays and maps becoming lazy containers in turn. Offsets and
+// values are both kept so that each item is only skipped and decoded once
+
 static PyObject *
-parse_datetimestr(CBORDecoderObject *self, PyObject *str)
+lazy_new(PyTypeObject *type, CBORDecoderObject *decoder, uint64_t length,
+         bool indefinite)
 {
-    const char* buf;
-    char *p;
-    Py_ssize_t size;
-    PyObject *tz, *delta, *ret = NULL;
-    bool offset_sign;
-    unsigned long int Y, m, d, H, M, S, offset_H, offset_M, uS;
+    CBORLazyObject *self;
 
-    if (!_CBOR2_timezone_utc && _CBOR2_init_timezone_utc() == -1)
-        return NULL;
-    buf = PyUnicode_AsUTF8AndSize(str, &size);
-    if (
-            size < 20 || buf[4] != '-' || buf[7] != '-' ||
-            buf[10] != 'T' || buf[13] != ':' || buf[16] != ':')
-    {
-        PyErr_Format(
-            _CBOR2_CBORDecodeValueError, "invalid datetime string %R", str);
+    if (!indefinite && length > (uint64_t) PY_SSIZE_T_MAX) {
+        PyErr_SetString(_CBOR2_CBORDecodeValueError,
+                        type == &CBORLazyMapType ?
+                        "excessive map size" : "excessive array size");
         return NULL;
     }
-    if (buf) {
-        Y = strtoul(buf, NULL, 10);
-        m = strtoul(buf + 5, NULL, 10);
-        d = strtoul(buf + 8, NULL, 10);
-        H = strtoul(buf + 11, NULL, 10);
-        M = strtoul(buf + 14, NULL, 10);
-        S = strtoul(buf + 17, &p, 10);
-        uS = 0;
-        if (*p == '.') {
-            unsigned long int scale = 100000;
-            p++;
-            while (*p >= '0' && *p <= '9') {
-                uS += (*p++ - '0') * scale;
-                scale /= 10;
-            }
-        }
-        if (*p == 'Z') {
-            offset_sign = false;
-            Py_INCREF(_CBOR2_timezone_utc);
-            tz = _CBOR2_timezone_utc;
-        } else {
-            tz = NULL;
-            offset_sign = *p == '-';
-            if (offset_sign || *p == '+') {
-                p++;
-                offset_H = strtoul(p, &p, 10);
-                offset_M = strtoul(p + 1, &p, 10);
-                delta = PyDelta_FromDSU(0,
-                    (offset_sign ? -1 : 1) *
-                    (offset_H * 3600 + offset_M * 60), 0);
-                if (delta) {
-                    tz = PyTimeZone_FromOffset(delta);
-                    Py_DECREF(delta);
-                }
-            } else
-                PyErr_Format(
-                    _CBOR2_CBORDecodeValueError,
-                    "invalid datetime string %R", str);
-        }
-        if (tz) {
-            ret = PyDateTimeAPI->DateTime_FromDateAndTime(
-                    Y, m, d, H, M, S, uS, tz, PyDateTimeAPI->DateTimeType);
-            Py_DECREF(tz);
+    self = PyObject_GC_New(CBORLazyObject, type);
+    if (self) {
+        Py_INCREF(decoder);
+        self->decoder = decoder;
+        self->length = indefinite ? -1 : (Py_ssize_t) length;
+        self->located = 0;
+        self->next = decoder->input_pos;
+        self->allocated = 0;
+        self->offsets = NULL;
+        self->values = NULL;
+        self->index = NULL;
+        if (type == &CBORLazyMapType) {
+            self->index = PyDict_New();
+            if (!self->index)
+                Py_CLEAR(self);
         }
+        if (self)
+            PyObject_GC_Track(self);
     }
-    return ret;
+    return (PyObject *) self;
 }
 
-static PyObject *
-parse_datestr(CBORDecoderObject *self, PyObject *str)
+
+// Decodes the next item of the in-memory input, returning arrays and maps as
+// lazy containers positioned at their first item
+PyObject *
+CBORDecoder_decode_lazy(CBORDecoderObject *self)
 {
-    const char* buf;
-    Py_ssize_t size;
-    PyObject *ret = NULL;
-    unsigned long int Y, m, d;
+    LeadByte lead;
+    uint64_t length;
+    bool indefinite = true;
 
-    buf = PyUnicode_AsUTF8AndSize(str, &size);
-    if (
-            size < 10 || buf[4] != '-' || buf[7] != '-')
-    {
-        PyErr_Format(
-            _CBOR2_CBORDecodeValueError, "invalid date string %R", str);
+    if (fp_read(self, &lead.byte, 1) == -1)
         return NULL;
+    if (lead.major == 4 || lead.major == 5) {
+        if (decode_length(self, lead.subtype, &length, &indefinite) == -1)
+            return NULL;
+        return lazy_new(
+                lead.major == 4 ? &CBORLazyArrayType : &CBORLazyMapType,
+                self, length, indefinite);
     }
-    if (buf) {
-        Y = strtoul(buf, NULL, 10);
-        m = strtoul(buf + 5, NULL, 10);
-        d = strtoul(buf + 8, NULL, 10);
-        ret = PyDate_FromDate(Y, m, d);
-    }
-    return ret;
+
+    // Anything else is decoded in full, on its own; shared values and string
+    // references can't be resolved between lazily decoded items
+    self->input_pos--;
+    if (clear_references(self) == -1)
+        return NULL;
+    return decode(self, DECODE_NORMAL);
 }
 
 
-// CBORDecoder.decode_datetime_string(self)
-static PyObject *
-CBORDecoder_decode_datetime_string(CBORDecoderObject *self)
+static int
+lazy_grow(CBORLazyObject *self)
 {
-    // semantic type 0
-    PyObject *match, *str, *ret = NULL;
-
-    if (!_CBOR2_datetimestr_re && _CBOR2_init_re_compile() == -1)
-        return NULL;
-    str = decode(self, DECODE_NORMAL);
-    if (str) {
-        if (PyUnicode_Check(str)) {
-            match = PyObject_CallMethodObjArgs(
-                    _CBOR2_datetimestr_re, _CBOR2_str_match, str, NULL);
-            if (match) {
-                if (match != Py_None)
-                    ret = parse_datetimestr(self, str);
-                else
-                    PyErr_Format(
-                        _CBOR2_CBORDecodeValueError,
-                        "invalid datetime string: %R", str);
-                Py_DECREF(match);
-            }
-        } else
-            PyErr_Format(
-                _CBOR2_CBORDecodeValueError, "invalid datetime value: %R", str);
-        Py_DECREF(str);
-    }
-    set_shareable(self, ret);
-    return ret;
+    Py_ssize_t size = self->allocated ? self->allocated * 2 : 8;
+    Py_ssize_t *offsets;
+    PyObject **values;
+
+    if (self->length != -1 && size > self->length)
+        size = self->length;
+    offsets = PyMem_Realloc(self->offsets, size * sizeof(Py_ssize_t));
+    if (!offsets)
+        goto error;
+    self->offsets = offsets;
+    values = PyMem_Realloc(self->values, size * sizeof(PyObject *));
+    if (!values)
+        goto error;
+    memset(values + self->allocated, 0,
+           (size - self->allocated) * sizeof(PyObject *));
+    self->values = values;
+    self->allocated = size;
+    return 0;
+error:
+    PyErr_NoMemory();
+    return -1;
 }
 
-// CBORDecoder.decode_epoch_date(self)
-static PyObject *
-CBORDecoder_decode_epoch_date(CBORDecoderObject *self)
+
+// Locates items until more than n of them are known, or all of them are
+static int
+lazy_locate(CBORLazyObject *self, Py_ssize_t n)
 {
-    // semantic type 100
-    PyObject *num, *ordinal, *ret = NULL;
+    CBORDecoderObject *decoder = self->decoder;
+    Py_ssize_t save_pos, offset;
+    PyObject *key, *entry;
+    SkipStats stats = {0};
+    int ret = 0;
+
+    save_pos = decoder->input_pos;
+    decoder->input_pos = self->next;
+    while (self->located <= n && self->located != self->length) {
+        if (self->length == -1 && decoder->input_pos < decoder->input.len &&
+                ((const uint8_t *) decoder->input.buf)[decoder->input_pos] ==
+                0xFF) {
+            self->length = self->located;
+            break;
+        }
+        if (self->located == self->allocated && lazy_grow(self) == -1) {
+            ret = -1;
+            break;
+        }
 
-    num = decode(self, DECODE_NORMAL);
-    if (num) {
-        if (PyNumber_Check(num)) {
-            ordinal = PyNumber_Add(num, _CBOR2_date_ordinal_offset);
-            if (ordinal) {
-                ret = PyObject_CallMethodObjArgs(
-                    (PyObject*) PyDateTimeAPI->DateType, _CBOR2_str_fromordinal, ordinal, NULL);
-                Py_DECREF(ordinal);
+        // Map keys are always decoded; they're needed to find the values
+        key = NULL;
+        if (self->index) {
+            if (clear_references(decoder) == 0)
+                key = decode(decoder,
+                             DECODE_IMMUTABLE | DECODE_UNSHARED | DECODE_KEY);
+            if (!key) {
+                ret = -1;
+                break;
             }
-        } else {
-            PyErr_Format(
-                _CBOR2_CBORDecodeValueError, "invalid timestamp value %R", num);
         }
-        Py_DECREF(num);
+        offset = decoder->input_pos;
+        ret = skip_value(decoder, &stats);
+        if (ret == 0 && key) {
+            // A repeated key refers to its last value, as it does in loads()
+            entry = PyLong_FromSsize_t(self->located);
+            if (!entry || PyDict_SetItem(self->index, key, entry) == -1)
+                ret = -1;
+            Py_XDECREF(entry);
+        }
+        Py_XDECREF(key);
+        if (ret == -1)
+            break;
+        ret = 0;
+        self->offsets[self->located++] = offset;
+        self->next = decoder->input_pos;
     }
-    set_shareable(self, ret);
+    decoder->input_pos = save_pos;
     return ret;
 }
 
-// CBORDecoder.decode_date_string(self)
+
+// Returns the item at position i, which must have been located
 static PyObject *
-CBORDecoder_decode_date_string(CBORDecoderObject *self)
+lazy_value(CBORLazyObject *self, Py_ssize_t i)
 {
-    // semantic type 0
-    PyObject *match, *str, *ret = NULL;
-
-    if (!_CBOR2_datestr_re && _CBOR2_init_re_compile() == -1)
-        return NULL;
-    str = decode(self, DECODE_NORMAL);
-    if (str) {
-        if (PyUnicode_Check(str)) {
-            match = PyObject_CallMethodObjArgs(
-                    _CBOR2_datestr_re, _CBOR2_str_match, str, NULL);
-            if (match) {
-                if (match != Py_None)
-                    ret = parse_datestr(self, str);
-                else
-                    PyErr_Format(
-                        _CBOR2_CBORDecodeValueError,
-                        "invalid date string: %R", str);
-                Py_DECREF(match);
-            }
+    CBORDecoderObject *decoder = self->decoder;
+    Py_ssize_t save_pos;
+    PyObject *ret = self->values[i];
+
+    if (!ret) {
+        save_pos = decoder->input_pos;
+        decoder->input_pos = self->offsets[i];
+        ret = CBORDecoder_decode_lazy(decoder);
+        decoder->input_pos = save_pos;
+        if (!ret)
+            return NULL;
+        // A tag_hook may have accessed the same item in the meantime
+        if (self->values[i]) {
+            Py_DECREF(ret);
+            ret = self->values[i];
         } else
-            PyErr_Format(
-                _CBOR2_CBORDecodeValueError, "invalid date value: %R", str);
-        Py_DECREF(str);
+            self->values[i] = ret;
     }
-    set_shareable(self, ret);
+    Py_INCREF(ret);
     return ret;
 }
 
 
-// CBORDecoder.decode_epoch_datetime(self)
-static PyObject *
-CBORDecoder_decode_epoch_datetime(CBORDecoderObject *self)
+static int
+CBORLazy_traverse(CBORLazyObject *self, visitproc visit, void *arg)
 {
-    // semantic type 1
-    PyObject *num, *tuple, *ret = NULL;
+    Py_ssize_t i;
+
+    Py_VISIT(self->decoder);
+    Py_VISIT(self->index);
+    for (i = 0; i < self->located; i++)
+        Py_VISIT(self->values[i]);
+    return 0;
+}
 
-    if (!_CBOR2_timezone_utc && _CBOR2_init_timezone_utc() == -1)
+
+static int
+CBORLazy_clear(CBORLazyObject *self)
+{
+    Py_ssize_t i;
+
+    for (i = 0; i < self->located; i++)
+        Py_CLEAR(self->values[i]);
+    return 0;
+}
+
+
+static void
+CBORLazy_dealloc(CBORLazyObject *self)
+{
+    PyObject_GC_UnTrack(self);
+    CBORLazy_clear(self);
+    Py_CLEAR(self->index);
+    Py_CLEAR(self->decoder);
+    PyMem_Free(self->offsets);
+    PyMem_Free(self->values);
+    PyObject_GC_Del(self);
+}
+
+
+// LazyArray.__len__(self)
+static Py_ssize_t
+CBORLazyArray_length(CBORLazyObject *self)
+{
+    if (self->length == -1 && lazy_locate(self, PY_SSIZE_T_MAX) == -1)
+        return -1;
+    return self->length;
+}
+
+
+// LazyArray.__getitem__(self, index)
+static PyObject *
+CBORLazyArray_item(CBORLazyObject *self, Py_ssize_t i)
+{
+    if (i >= self->located && lazy_locate(self, i) == -1)
+        return NULL;
+    if (i < 0 || i >= self->located) {
+        PyErr_SetString(PyExc_IndexError, "LazyArray index out of range");
         return NULL;
-    num = decode(self, DECODE_NORMAL);
-    if (num) {
-        if (PyNumber_Check(num)) {
-            tuple = PyTuple_Pack(2, num, _CBOR2_timezone_utc);
-            if (tuple) {
-                ret = PyDateTime_FromTimestamp(tuple);
-                Py_DECREF(tuple);
-                if (!ret && (
-                    PyErr_GivenExceptionMatches(PyErr_Occurred(), PyExc_OverflowError)
-                    || PyErr_GivenExceptionMatches(PyErr_Occurred(), PyExc_OSError)
-                    || PyErr_GivenExceptionMatches(PyErr_Occurred(), PyExc_ValueError)
-                ))
-                    raise_from(_CBOR2_CBORDecodeValueError, "error decoding datetime from epoch");
-            }
-        } else {
-            PyErr_Format(
-                _CBOR2_CBORDecodeValueError, "invalid timestamp value %R", num);
-        }
-        Py_DECREF(num);
     }
-    set_shareable(self, ret);
-    return ret;
+    return lazy_value(self, i);
 }
 
 
-// CBORDecoder.decode_positive_bignum(self)
-static PyObject *
-CBORDecoder_decode_positive_bignum(CBORDecoderObject *self)
+// LazyMap.__len__(self)
+static Py_ssize_t
+CBORLazyMap_length(CBORLazyObject *self)
 {
-    // semantic type 2
-    PyObject *bytes, *ret = NULL;
+    if (lazy_locate(self, PY_SSIZE_T_MAX) == -1)
+        return -1;
+    return PyDict_GET_SIZE(self->index);
+}
 
-    bytes = decode(self, DECODE_NORMAL);
-    if (bytes) {
-        if (PyBytes_CheckExact(bytes))
-            ret = PyObject_CallMethod(
-                (PyObject*) &PyLong_Type, "from_bytes", "Os", bytes, "big");
-        else
-            PyErr_Format(
-                _CBOR2_CBORDecodeValueError, "invalid bignum value %R", bytes);
-        Py_DECREF(bytes);
-    }
-    set_shareable(self, ret);
-    return ret;
+
+// Returns the entry number of key (a borrowed reference), or NULL if it isn't
+// found or on error; all the entries are located first, since a later
+// occurrence of key would replace an earlier one
+static PyObject *
+lazy_map_find(CBORLazyObject *self, PyObject *key)
+{
+    if (lazy_locate(self, PY_SSIZE_T_MAX) == -1)
+        return NULL;
+    return PyDict_GetItemWithError(self->index, key);
 }
 
 
-// CBORDecoder.decode_negative_bignum(self)
+// LazyMap.__getitem__(self, key)
 static PyObject *
-CBORDecoder_decode_negative_bignum(CBORDecoderObject *self)
+CBORLazyMap_subscript(CBORLazyObject *self, PyObject *key)
 {
-    // semantic type 3
-    PyObject *value, *one, *neg, *ret = NULL;
+    PyObject *entry = lazy_map_find(self, key);
 
-    value = CBORDecoder_decode_positive_bignum(self);
-    if (value) {
-        one = PyLong_FromLong(1);
-        if (one) {
-            neg = PyNumber_Negative(value);
-            if (neg) {
-                ret = PyNumber_Subtract(neg, one);
-                Py_DECREF(neg);
-            }
-            Py_DECREF(one);
-        }
-        Py_DECREF(value);
+    if (!entry) {
+        if (!PyErr_Occurred())
+            PyErr_SetObject(PyExc_KeyError, key);
+        return NULL;
     }
-    set_shareable(self, ret);
-    return ret;
+    return lazy_value(self, PyLong_AsSsize_t(entry));
+}
+
+
+// LazyMap.__contains__(self, key)
+static int
+CBORLazyMap_contains(CBORLazyObject *self, PyObject *key)
+{
+    PyObject *entry = lazy_map_find(self, key);
+
+    return entry ? 1 : PyErr_Occurred() ? -1 : 0;
+}
+
+
+// LazyMap.__iter__(self)
+static PyObject *
+CBORLazyMap_iter(CBORLazyObject *self)
+{
+    if (lazy_locate(self, PY_SSIZE_T_MAX) == -1)
+        return NULL;
+    return PyObject_GetIter(self->index);
 }
 
 
-// CBORDecoder.decode_fraction(self)
+// LazyMap.get(self, key, default=None)
 static PyObject *
-CBORDecoder_decode_fraction(CBORDecoderObject *self)
+CBORLazyMap_get(CBORLazyObject *self, PyObject *args)
 {
-    // semantic type 4
-    PyObject *payload_t, *tmp, *sig, *exp, *ret = NULL;
-    PyObject *decimal_t, *sign, *digits, *args = NULL;
+    PyObject *key, *entry, *ret = Py_None;
 
-    if (!_CBOR2_Decimal && _CBOR2_init_Decimal() == -1)
+    if (!PyArg_ParseTuple(args, "O|O:get", &key, &ret))
         return NULL;
-    // NOTE: There's no particular necessity for this to be immutable, it's
-    // just a performance choice
-    payload_t = decode(self, DECODE_IMMUTABLE | DECODE_UNSHARED);
-    if (payload_t) {
-        if (PyTuple_CheckExact(payload_t) && PyTuple_GET_SIZE(payload_t) == 2) {
-            exp = PyTuple_GET_ITEM(payload_t, 0);
-            sig = PyTuple_GET_ITEM(payload_t, 1);
-            tmp = PyObject_CallFunction(_CBOR2_Decimal, "O", sig);
-            if (tmp) {
-                decimal_t = PyObject_CallMethod(tmp, "as_tuple", NULL);
-                if (decimal_t) {
-                    sign = PyTuple_GET_ITEM(decimal_t, 0);
-                    digits = PyTuple_GET_ITEM(decimal_t, 1);
-                    args = PyTuple_Pack(3, sign, digits, exp);
-                    ret = PyObject_CallFunction(_CBOR2_Decimal, "(O)", args);
-                    Py_DECREF(decimal_t);
-                    Py_DECREF(args);
-                }
-                Py_DECREF(tmp);
-            }
-        } else {
-            PyErr_Format(
-                _CBOR2_CBORDecodeValueError,
-                            "Incorrect tag 4 payload");
-            }
-        Py_DECREF(payload_t);
-    }
-    set_shareable(self, ret);
+    entry = lazy_map_find(self, key);
+    if (entry)
+        return lazy_value(self, PyLong_AsSsize_t(entry));
+    if (PyErr_Occurred())
+        return NULL;
+    Py_INCREF(ret);
     return ret;
 }
 
 
-// CBORDecoder.decode_bigfloat
+// LazyMap.keys(self)
 static PyObject *
-CBORDecoder_decode_bigfloat(CBORDecoderObject *self)
+CBORLazyMap_keys(CBORLazyObject *self)
 {
-    // semantic type 5
-    PyObject *tuple, *tmp, *sig, *exp, *two, *ret = NULL;
-
-    if (!_CBOR2_Decimal && _CBOR2_init_Decimal() == -1)
+    if (lazy_locate(self, PY_SSIZE_T_MAX) == -1)
         return NULL;
-    // NOTE: see semantic type 4
-    tuple = decode(self, DECODE_IMMUTABLE | DECODE_UNSHARED);
-    if (tuple) {
-        if (PyTuple_CheckExact(tuple) && PyTuple_GET_SIZE(tuple) == 2) {
-            exp = PyTuple_GET_ITEM(tuple, 0);
-            sig = PyTuple_GET_ITEM(tuple, 1);
-            two = PyObject_CallFunction(_CBOR2_Decimal, "i", 2);
-            if (two) {
-                tmp = PyNumber_Power(two, exp, Py_None);
-                if (tmp) {
-                    ret = PyNumber_Multiply(sig, tmp);
-                    Py_DECREF(tmp);
-                }
-                Py_DECREF(two);
-            }
-        } else {
-            PyErr_Format(
-                _CBOR2_CBORDecodeValueError,
-                            "Incorrect tag 5 payload");
-            }
-        Py_DECREF(tuple);
-    }
-    set_shareable(self, ret);
-    return ret;
+    return PyObject_CallMethodObjArgs(self->index, _CBOR2_str_keys, NULL);
 }
 
-// CBORDecoder.decode_stringref(self)
+
+// Returns a list of the values, or of the (key, value) tuples if items is true
 static PyObject *
-CBORDecoder_decode_stringref(CBORDecoderObject *self)
+lazy_map_list(CBORLazyObject *self, bool items)
 {
-    // semantic type 25
-    PyObject *index, *ret = NULL;
+    PyObject *key, *entry, *value, *ret;
+    Py_ssize_t pos = 0, i = 0;
 
-    if (self->stringref_namespace == Py_None) {
-        PyErr_Format(
-            _CBOR2_CBORDecodeValueError,
-            "string reference outside of namespace");
+    if (lazy_locate(self, PY_SSIZE_T_MAX) == -1)
         return NULL;
+    ret = PyList_New(PyDict_GET_SIZE(self->index));
+    while (ret && PyDict_Next(self->index, &pos, &key, &entry)) {
+        value = lazy_value(self, PyLong_AsSsize_t(entry));
+        if (value && items)
+            value = Py_BuildValue("(ON)", key, value);
+        if (value)
+            PyList_SET_ITEM(ret, i++, value);  // steals ref
+        else
+            Py_CLEAR(ret);
     }
-
-    index = decode(self, DECODE_UNSHARED);
-    if (index) {
-        if (PyLong_CheckExact(index)) {
-            ret = PyList_GetItem(self->stringref_namespace, PyLong_AsSsize_t(index));
-            if (ret) {
-                // convert borrowed reference to new reference
-                Py_INCREF(ret);
-            } else {
-                PyErr_Format(
-                    _CBOR2_CBORDecodeValueError,
-                    "string reference %R not found", index);
-            }
-        } else {
-            PyErr_Format(
-                _CBOR2_CBORDecodeValueError,
-                "invalid string reference %R", index);
-        }
-    }
-
     return ret;
 }
 
 
-// CBORDecoder.decode_shareable(self)
+// LazyMap.values(self)
 static PyObject *
-CBORDecoder_decode_shareable(CBORDecoderObject *self)
+CBORLazyMap_values(CBORLazyObject *self)
 {
-    // semantic type 28
-    Py_ssize_t old_index;
-    PyObject *ret = NULL;
-
-    old_index = self->shared_index;
-    self->shared_index = PyList_GET_SIZE(self->shareables);
-    if (PyList_Append(self->shareables, Py_None) == 0)
-        ret = decode(self, DECODE_NORMAL);
-    self->shared_index = old_index;
-    return ret;
+    return lazy_map_list(self, false);
 }
 
 
-// CBORDecoder.decode_sharedref(self)
+// LazyMap.items(self)
 static PyObject *
-CBORDecoder_decode_sharedref(CBORDecoderObject *self)
+CBORLazyMap_items(CBORLazyObject *self)
 {
-    // semantic type 29
-    PyObject *index, *ret = NULL;
+    return lazy_map_list(self, true);
+}
 
-    index = decode(self, DECODE_UNSHARED);
-    if (index) {
-        if (PyLong_CheckExact(index)) {
-            ret = PyList_GetItem(self->shareables, PyLong_AsSsize_t(index));
-            if (ret) {
-                if (ret == Py_None) {
-                    PyErr_Format(
-                        _CBOR2_CBORDecodeValueError,
-                        "shared value %R has not been initialized", index);
-                    ret = NULL;
-                } else {
-                    // convert borrowed reference to new reference
-                    Py_INCREF(ret);
-                }
-            } else {
-                PyErr_Format(
-                    _CBOR2_CBORDecodeValueError,
-                    "shared reference %R not found", index);
-            }
-        } else {
-            PyErr_Format(
-                _CBOR2_CBORDecodeValueError,
-                "invalid shared reference %R", index);
+
+// Returns the index of the first item equal to value from start up to stop,
+// -1 if there isn't one, or -2 on error; count (if not NULL) is set to the
+// number of such items instead, and stop is then ignored
+static Py_ssize_t
+lazy_array_find(CBORLazyObject *self, PyObject *value, Py_ssize_t start,
+                Py_ssize_t stop, Py_ssize_t *count)
+{
+    PyObject *item;
+    Py_ssize_t i;
+    int equal;
+
+    for (i = start; count || i < stop; i++) {
+        if (i >= self->located && lazy_locate(self, i) == -1)
+            return -2;
+        if (i >= self->located)
+            break;
+        item = lazy_value(self, i);
+        if (!item)
+            return -2;
+        equal = PyObject_RichCompareBool(item, value, Py_EQ);
+        Py_DECREF(item);
+        if (equal == -1)
+            return -2;
+        if (equal) {
+            if (!count)
+                return i;
+            (*count)++;
         }
-        Py_DECREF(index);
     }
-    return ret;
+    return -1;
 }
 
 
-// CBORDecoder.decode_rational(self)
+// LazyArray.index(self, value, start=0, stop=sys.maxsize)
 static PyObject *
-CBORDecoder_decode_rational(CBORDecoderObject *self)
+CBORLazyArray_index(CBORLazyObject *self, PyObject *args)
 {
-    // semantic type 30
-    PyObject *tuple, *ret = NULL;
+    PyObject *value;
+    Py_ssize_t start = 0, stop = PY_SSIZE_T_MAX, length, ret;
 
-    if (!_CBOR2_Fraction && _CBOR2_init_Fraction() == -1)
+    if (!PyArg_ParseTuple(args, "O|nn:index", &value, &start, &stop))
         return NULL;
-    // NOTE: see semantic type 4
-    tuple = decode(self, DECODE_IMMUTABLE | DECODE_UNSHARED);
-    if (tuple) {
-        if (PyTuple_CheckExact(tuple)) {
-            ret = PyObject_Call(_CBOR2_Fraction, tuple, NULL);
-            set_shareable(self, ret);
-            if (!ret && (
-                PyErr_GivenExceptionMatches(PyErr_Occurred(), PyExc_TypeError)
-                || PyErr_GivenExceptionMatches(PyErr_Occurred(), PyExc_ZeroDivisionError)
-            ))
-                raise_from(_CBOR2_CBORDecodeValueError, "error decoding rational");
-        } else {
-            PyErr_SetString(
-                _CBOR2_CBORDecodeValueError,
-                "error decoding rational: input value was not a tuple"
-            );
-        }
-        Py_DECREF(tuple);
+    // negative bounds count from the end, as with Sequence.index()
+    if (start < 0 || stop < 0) {
+        length = CBORLazyArray_length(self);
+        if (length == -1)
+            return NULL;
+        if (start < 0)
+            start = start + length < 0 ? 0 : start + length;
+        if (stop < 0)
+            stop += length;
     }
-    return ret;
+    ret = lazy_array_find(self, value, start, stop, NULL);
+    if (ret == -1)
+        PyErr_SetNone(PyExc_ValueError);
+    return ret < 0 ? NULL : PyLong_FromSsize_t(ret);
 }
 
 
-// CBORDecoder.decode_regexp(self)
+// LazyArray.count(self, value)
 static PyObject *
-CBORDecoder_decode_regexp(CBORDecoderObject *self)
+CBORLazyArray_count(CBORLazyObject *self, PyObject *value)
 {
-    // semantic type 35
-    PyObject *pattern, *ret = NULL;
+    Py_ssize_t count = 0;
 
-    if (!_CBOR2_re_compile && _CBOR2_init_re_compile() == -1)
+    if (lazy_array_find(self, value, 0, PY_SSIZE_T_MAX, &count) == -2)
         return NULL;
-    pattern = decode(self, DECODE_UNSHARED);
-    if (pattern) {
-        ret = PyObject_CallFunctionObjArgs(_CBOR2_re_compile, pattern, NULL);
-        Py_DECREF(pattern);
-        if (!ret && PyErr_GivenExceptionMatches(PyErr_Occurred(), _CBOR2_re_error))
-            raise_from(_CBOR2_CBORDecodeValueError, "error decoding regular expression");
-    }
-    set_shareable(self, ret);
-    return ret;
+    return PyLong_FromSsize_t(count);
 }
 
 
-// CBORDecoder.decode_mime(self)
+// LazyMap.__eq__(self, other) and LazyMap.__ne__(self, other); like
+// Mapping.__eq__(), this compares dict(self.items()) to dict(other.items())
 static PyObject *
-CBORDecoder_decode_mime(CBORDecoderObject *self)
+CBORLazyMap_richcompare(CBORLazyObject *self, PyObject *other, int op)
 {
-    // semantic type 36
-    PyObject *value, *parser, *ret = NULL;
+    PyObject *items, *mine, *theirs = NULL, *ret = NULL;
+    int mapping;
 
-    if (!_CBOR2_Parser && _CBOR2_init_Parser() == -1)
+    if (op != Py_EQ && op != Py_NE)
+        Py_RETURN_NOTIMPLEMENTED;
+    if (CBOR2_INIT(_CBOR2_Mapping, _CBOR2_init_Mapping) == -1)
         return NULL;
-    value = decode(self, DECODE_UNSHARED);
-    if (value) {
-        parser = PyObject_CallFunctionObjArgs(_CBOR2_Parser, NULL);
-        if (parser) {
-            ret = PyObject_CallMethodObjArgs(parser,
-                    _CBOR2_str_parsestr, value, NULL);
-            Py_DECREF(parser);
-            if (!ret && PyErr_GivenExceptionMatches(PyErr_Occurred(), PyExc_TypeError))
-                raise_from(_CBOR2_CBORDecodeValueError, "error decoding MIME message");
+    mapping = PyObject_IsInstance(other, _CBOR2_Mapping);
+    if (mapping == -1)
+        return NULL;
+    if (!mapping)
+        Py_RETURN_NOTIMPLEMENTED;
+
+    items = lazy_map_list(self, true);
+    if (!items)
+        return NULL;
+    mine = PyDict_New();
+    if (mine && PyDict_MergeFromSeq2(mine, items, 1) == 0) {
+        Py_DECREF(items);
+        items = PyMapping_Items(other);
+        if (items) {
+            theirs = PyDict_New();
+            if (theirs && PyDict_MergeFromSeq2(theirs, items, 1) == 0)
+                ret = PyObject_RichCompare(mine, theirs, op);
+            Py_XDECREF(theirs);
         }
-        Py_DECREF(value);
     }
-    set_shareable(self, ret);
+    Py_XDECREF(items);
+    Py_XDECREF(mine);
     return ret;
 }
 
 
-// CBORDecoder.decode_uuid(self)
+static PySequenceMethods CBORLazyArray_as_sequence = {
+    .sq_length = (lenfunc) CBORLazyArray_length,
+    .sq_item = (ssizeargfunc) CBORLazyArray_item,
+};
+
+static PyMethodDef CBORLazyArray_methods[] = {
+    {"index", (PyCFunction) CBORLazyArray_index, METH_VARARGS,
+        "return the index of the first item equal to value"},
+    {"count", (PyCFunction) CBORLazyArray_count, METH_O,
+        "return the number of items equal to value, decoding all of them"},
+    {NULL}
+};
+
+PyDoc_STRVAR(CBORLazyArray__doc__,
+"A CBOR array returned by :func:`cbor2.loads_lazy`.\n"
+"\n"
+"Supports ``len()``, indexing, iteration, :meth:`index` and :meth:`count`.\n"
+"Items are only located and decoded when they're first accessed, arrays\n"
+"and maps among them becoming :class:`LazyArray` and :class:`LazyMap`\n"
+"objects in turn.\n"
+);
+
+PyTypeObject CBORLazyArrayType = {
+    PyVarObject_HEAD_INIT(NULL, 0)
+    .tp_name = "_cbor2.LazyArray",
+    .tp_doc = CBORLazyArray__doc__,
+    .tp_basicsize = sizeof(CBORLazyObject),
+    .tp_itemsize = 0,
+    .tp_flags = Py_TPFLAGS_DEFAULT | Py_TPFLAGS_HAVE_GC,
+    .tp_dealloc = (destructor) CBORLazy_dealloc,
+    .tp_traverse = (traverseproc) CBORLazy_traverse,
+    .tp_clear = (inquiry) CBORLazy_clear,
+    .tp_as_sequence = &CBORLazyArray_as_sequence,
+    .tp_methods = CBORLazyArray_methods,
+};
+
+static PyMappingMethods CBORLazyMap_as_mapping = {
+    .mp_length = (lenfunc) CBORLazyMap_length,
+    .mp_subscript = (binaryfunc) CBORLazyMap_subscript,
+};
+
+static PySequenceMethods CBORLazyMap_as_sequence = {
+    .sq_contains = (objobjproc) CBORLazyMap_contains,
+};
+
+static PyMethodDef CBORLazyMap_methods[] = {
+    {"get", (PyCFunction) CBORLazyMap_get, METH_VARARGS,
+        "return the value for key if key is in the map, else default"},
+    {"keys", (PyCFunction) CBORLazyMap_keys, METH_NOARGS,
+        "return a view of the map's keys"},
+    {"values", (PyCFunction) CBORLazyMap_values, METH_NOARGS,
+        "return a list of the map's values, decoding all of them"},
+    {"items", (PyCFunction) CBORLazyMap_items, METH_NOARGS,
+        "return a list of the map's (key, value) pairs, decoding all values"},
+    {NULL}
+};
+
+PyDoc_STRVAR(CBORLazyMap__doc__,
+"A CBOR map returned by :func:`cbor2.loads_lazy`.\n"
+"\n"
+"Supports ``len()``, lookup by key, ``in`` and iteration over the keys, as\n"
+"well as :meth:`get`, :meth:`keys`, :meth:`values`, :meth:`items` and\n"
+"comparison with other mappings. All the keys are decoded the first time\n"
+"the map is used, but values are only decoded when they're first accessed,\n"
+"arrays and maps among them becoming :class:`LazyArray` and\n"
+":class:`LazyMap` objects in turn.\n"
+);
+
+PyTypeObject CBORLazyMapType = {
+    PyVarObject_HEAD_INIT(NULL, 0)
+    .tp_name = "_cbor2.LazyMap",
+    .tp_doc = CBORLazyMap__doc__,
+    .tp_basicsize = sizeof(CBORLazyObject),
+    .tp_itemsize = 0,
+    .tp_flags = Py_TPFLAGS_DEFAULT | Py_TPFLAGS_HAVE_GC,
+    .tp_dealloc = (destructor) CBORLazy_dealloc,
+    .tp_traverse = (traverseproc) CBORLazy_traverse,
+    .tp_clear = (inquiry) CBORLazy_clear,
+    .tp_as_mapping = &CBORLazyMap_as_mapping,
+    .tp_as_sequence = &CBORLazyMap_as_sequence,
+    .tp_richcompare = (richcmpfunc) CBORLazyMap_richcompare,
+    .tp_iter = (getiterfunc) CBORLazyMap_iter,
+    .tp_methods = CBORLazyMap_methods,
+};
+
+
+// Extraction ////////////////////////////////////////////////////////////////
+
+// Looks up the components of path from depth on in a value that has already
+// been decoded, following only dict keys and (non-negative) list and tuple
+// indexes. Returns a new reference, or NULL without an exception set if the
+// path leads nowhere
 static PyObject *
-CBORDecoder_decode_uuid(CBORDecoderObject *self)
+extract_from_value(PyObject *value, PyObject *path, Py_ssize_t depth)
 {
-    // semantic type 37
-    PyObject *bytes, *ret = NULL;
+    PyObject *component, *item;
+    Py_ssize_t index;
 
-    if (!_CBOR2_UUID && _CBOR2_init_UUID() == -1)
-        return NULL;
-    bytes = decode(self, DECODE_UNSHARED);
-    if (bytes) {
-        ret = PyObject_CallFunctionObjArgs(_CBOR2_UUID, Py_None, bytes, NULL);
-        Py_DECREF(bytes);
-        if (!ret && (
-            PyErr_GivenExceptionMatches(PyErr_Occurred(), PyExc_TypeError)
-            || PyErr_GivenExceptionMatches(PyErr_Occurred(), PyExc_ValueError)
-        ))
-            raise_from(_CBOR2_CBORDecodeValueError, "error decoding UUID value");
+    Py_INCREF(value);
+    for (; value && depth < PyTuple_GET_SIZE(path); depth++) {
+        component = PyTuple_GET_ITEM(path, depth);
+        item = NULL;
+        if (PyDict_Check(value)) {
+            item = PyDict_GetItemWithError(value, component);
+            if (!item && PyErr_ExceptionMatches(PyExc_TypeError))
+                PyErr_Clear();
+        } else if ((PyList_Check(value) || PyTuple_Check(value)) &&
+                PyLong_Check(component)) {
+            index = PyLong_AsSsize_t(component);
+            if (index >= 0 && index < PySequence_Fast_GET_SIZE(value))
+                item = PySequence_Fast_GET_ITEM(value, index);
+            else
+                PyErr_Clear();  // in case of overflow
+        }
+        Py_XINCREF(item);
+        Py_SETREF(value, item);
+    }
+    return value;
+}
+
+
+// Walks over the next item of the input, decoding only the parts that the
+// paths numbered in wanted lead to (from depth on) and skipping the rest.
+// Each value found is stored in results, and remaining is decremented for
+// each path resolved, whether found or not; once it reaches zero the walk
+// stops without reading any further
+static int
+extract_item(CBORDecoderObject *self, PyObject *paths, PyObject *wanted,
+             Py_ssize_t depth, PyObject *results, Py_ssize_t *remaining)
+{
+    LeadByte lead;
+    uint64_t length, count;
+    bool indefinite = true, whole;
+    PyObject *children, *last = NULL, *group, *path, *key, *value;
+    SkipStats stats = {0};
+    Py_ssize_t i, n, end;
+    int ret = -1;
+
+    if (fp_read(self, &lead.byte, 1) == -1)
+        return -1;
+    if ((uint8_t) lead.byte == 0xFF) {
+        PyErr_SetString(_CBOR2_CBORDecodeValueError,
+                        "unexpected break marker");
+        return -1;
+    }
+    whole = lead.major != 4 && lead.major != 5;
+    for (i = 0; !whole && i < PyList_GET_SIZE(wanted); i++) {
+        path = PyList_GET_ITEM(paths,
+                PyLong_AsSsize_t(PyList_GET_ITEM(wanted, i)));
+        whole = PyTuple_GET_SIZE(path) == depth;
+    }
+
+    // Anything that isn't an array or map, or that a path ends at, is
+    // decoded in full and the paths followed into the result
+    if (whole) {
+        self->input_pos--;
+        if (clear_references(self) == -1)
+            return -1;
+        value = decode(self, DECODE_NORMAL);
+        if (!value)
+            return -1;
+        for (i = 0; i < PyList_GET_SIZE(wanted); i++) {
+            n = PyLong_AsSsize_t(PyList_GET_ITEM(wanted, i));
+            key = extract_from_value(value, PyList_GET_ITEM(paths, n), depth);
+            if (key)
+                PyList_SetItem(results, n, key);
+            else if (PyErr_Occurred())
+                break;
+        }
+        *remaining -= PyList_GET_SIZE(wanted);
+        Py_DECREF(value);
+        return PyErr_Occurred() ? -1 : 0;
     }
-    set_shareable(self, ret);
-    return ret;
-}
 
-// CBORDecoder.decode_stringref_namespace(self)
-static PyObject *
-CBORDecoder_decode_stringref_ns(CBORDecoderObject *self)
-{
-    // semantic type 256
-    PyObject *old_namespace, *ret = NULL;
+    if (decode_length(self, lead.subtype, &length, &indefinite) == -1)
+        return -1;
 
-    old_namespace = self->stringref_namespace;
+    // Group the paths by their next component
+    children = PyDict_New();
+    if (!children)
+        return -1;
+    for (i = 0; i < PyList_GET_SIZE(wanted); i++) {
+        path = PyList_GET_ITEM(paths,
+                PyLong_AsSsize_t(PyList_GET_ITEM(wanted, i)));
+        group = PyDict_GetItemWithError(
+                children, PyTuple_GET_ITEM(path, depth));
+        if (!group) {
+            if (PyErr_Occurred())
+                goto out;
+            group = PyList_New(0);
+            if (!group)
+                goto out;
+            ret = PyDict_SetItem(
+                    children, PyTuple_GET_ITEM(path, depth), group);
+            Py_DECREF(group);
+            if (ret == -1)
+                goto out;
+        }
+        if (PyList_Append(group, PyList_GET_ITEM(wanted, i)) == -1)
+            goto out;
+    }
 
-    self->stringref_namespace = PyList_New(0);
-    if (self->stringref_namespace) {
-        ret = decode(self, DECODE_NORMAL);
-        Py_CLEAR(self->stringref_namespace);
+    // A map is walked to its end, noting where the value of the last
+    // occurrence of each key the paths lead through is, as that's the one
+    // loads() keeps; the paths are only followed into them afterwards
+    if (lead.major == 5) {
+        last = PyDict_New();
+        if (!last)
+            goto out;
     }
+    if (Py_EnterRecursiveCall(" in extract"))
+        goto out;
+    ret = 0;
+    for (count = 0; indefinite || count < length; count++) {
+        if (!*remaining)
+            break;
+        if (self->input_pos < self->input.len &&
+                ((const uint8_t *) self->input.buf)[self->input_pos] == 0xFF) {
+            if (!indefinite) {
+                PyErr_SetString(_CBOR2_CBORDecodeValueError,
+                                "unexpected break marker");
+                ret = -1;
+            }
+            self->input_pos++;
+            break;
+        }
 
-    self->stringref_namespace = old_namespace;
+        group = NULL;
+        if (PyDict_GET_SIZE(children)) {
+            // Map keys are decoded while there's still a path to match them
+            // against; array items are matched by their index
+            if (lead.major == 5) {
+                key = NULL;
+                if (clear_references(self) == 0)
+                    key = decode(self, DECODE_IMMUTABLE | DECODE_UNSHARED |
+                                 DECODE_KEY);
+            } else
+                key = PyLong_FromUnsignedLongLong(count);
+            if (!key) {
+                ret = -1;
+                break;
+            }
+            group = PyDict_GetItemWithError(children, key);
+            if (group && last) {
+                value = PyLong_FromSsize_t(self->input_pos);
+                ret = value ? PyDict_SetItem(last, key, value) : -1;
+                Py_XDECREF(value);
+                group = NULL;
+            } else if (group) {
+                Py_INCREF(group);
+                ret = PyDict_DelItem(children, key);
+            } else if (PyErr_Occurred()) {
+                // An unhashable key can't match any path
+                if (PyErr_ExceptionMatches(PyExc_TypeError))
+                    PyErr_Clear();
+                else
+                    ret = -1;
+            }
+            Py_DECREF(key);
+        } else if (lead.major == 5)
+            ret = skip_value(self, &stats);
+        if (ret == 0 && group)
+            ret = extract_item(self, paths, group, depth + 1, results,
+                               remaining);
+        else if (ret == 0)
+            ret = skip_value(self, &stats);
+        Py_XDECREF(group);
+        if (ret == -1)
+            break;
+    }
+    if (ret == 0 && last) {
+        end = self->input_pos;
+        i = 0;
+        while (ret == 0 && PyDict_Next(last, &i, &key, &value)) {
+            group = PyDict_GetItem(children, key);
+            Py_INCREF(group);
+            ret = PyDict_DelItem(children, key);
+            self->input_pos = PyLong_AsSsize_t(value);
+            if (ret == 0)
+                ret = extract_item(self, paths, group, depth + 1, results,
+                                   remaining);
+            Py_DECREF(group);
+        }
+        self->input_pos = end;
+    }
+    Py_LeaveRecursiveCall();
+
+    // Whatever paths are left weren't found
+    if (ret == 0) {
+        i = 0;
+        while (PyDict_Next(children, &i, NULL, &group))
+            *remaining -= PyList_GET_SIZE(group);
+    }
+out:
+    Py_XDECREF(last);
+    Py_DECREF(children);
     return ret;
 }
 
-// CBORDecoder.decode_set(self)
-static PyObject *
-CBORDecoder_decode_set(CBORDecoderObject *self)
+
+// Decodes the values that each of paths (a sequence of tuples or lists of map
+// keys and array indexes) leads to in the in-memory input, returning them as
+// a list with default in place of any that aren't found
+PyObject *
+CBORDecoder_extract(CBORDecoderObject *self, PyObject *paths,
+                    PyObject *default_value)
 {
-    // semantic type 258
-    PyObject *array, *ret = NULL;
+    PyObject *results, *wanted, *path, *index;
+    Py_ssize_t i, remaining;
 
-    array = decode(self, DECODE_IMMUTABLE);
-    if (array) {
-        if (PyList_CheckExact(array) || PyTuple_CheckExact(array)) {
-            if (self->immutable)
-                ret = PyFrozenSet_New(array);
-            else
-                ret = PySet_New(array);
-        } else
-            PyErr_Format(
-                _CBOR2_CBORDecodeValueError, "invalid set array %R", array);
-        Py_DECREF(array);
+    paths = PySequence_List(paths);
+    if (!paths)
+        return NULL;
+    remaining = PyList_GET_SIZE(paths);
+    results = PyList_New(remaining);
+    wanted = PyList_New(remaining);
+    if (!results || !wanted)
+        goto error;
+    for (i = 0; i < remaining; i++) {
+        path = PyList_GET_ITEM(paths, i);
+        if (!PyTuple_Check(path) && !PyList_Check(path)) {
+            PyErr_Format(PyExc_TypeError,
+                         "invalid path %R (must be a tuple or list)", path);
+            goto error;
+        }
+        path = PySequence_Tuple(path);
+        index = PyLong_FromSsize_t(i);
+        if (!path || !index) {
+            Py_XDECREF(path);
+            Py_XDECREF(index);
+            goto error;
+        }
+        PyList_SetItem(paths, i, path);  // paths is a list of our own
+        PyList_SET_ITEM(wanted, i, index);
+        Py_INCREF(default_value);
+        PyList_SET_ITEM(results, i, default_value);
     }
-    // This can be done after construction of the set/frozenset because,
-    // unlike lists/dicts a set cannot contain a reference to itself (a set
-    // is unhashable). Nor can a frozenset contain a reference to itself
-    // because it can't refer to itself during its own construction.
-    set_shareable(self, ret);
-    return ret;
+    if (remaining && extract_item(
+                self, paths, wanted, 0, results, &remaining) == -1)
+        goto error;
+    Py_DECREF(wanted);
+    Py_DECREF(paths);
+    return results;
+error:
+    Py_XDECREF(results);
+    Py_XDECREF(wanted);
+    Py_DECREF(paths);
+    return NULL;
 }
 
 
-// CBORDecoder.decode_ipaddress(self)
-static PyObject *
-CBORDecoder_decode_ipaddress(CBORDecoderObject *self)
+// Parallel decoding /////////////////////////////////////////////////////////
+
+// A run of consecutive values of a sequence, decoded by one thread
+typedef struct {
+    CBORDecoderObject *decoder;  // has the whole sequence as input
+    Py_ssize_t start;      // offset of the first value
+    Py_ssize_t count;      // number of values
+    PyObject *values;      // list of the values once decoded, or NULL
+    SavedError error;      // raised while decoding them instead
+    PyThread_type_lock done;  // held while a thread is decoding them
+    bool threaded;
+} ParallelChunk;
+
+
+// Returns a new decoder with the same options and input as self
+static CBORDecoderObject *
+decoder_copy(CBORDecoderObject *self)
 {
-    // semantic type 260
-    PyObject *tag, *bytes, *ret = NULL;
+    CBORDecoderObject *ret;
 
-    if (!_CBOR2_ip_address && _CBOR2_init_ip_address() == -1)
+    ret = (CBORDecoderObject *) CBORDecoder_new(&CBORDecoderType, NULL, NULL);
+    if (!ret)
         return NULL;
-    bytes = decode(self, DECODE_UNSHARED);
-    if (bytes) {
-        if (PyBytes_CheckExact(bytes)) {
-            if (PyBytes_GET_SIZE(bytes) == 4 || PyBytes_GET_SIZE(bytes) == 16)
-                ret = PyObject_CallFunctionObjArgs(_CBOR2_ip_address, bytes, NULL);
-            else if (PyBytes_GET_SIZE(bytes) == 6) {
-                // MAC address
-                tag = CBORTag_New(260);
-                if (tag) {
-                    if (CBORTag_SetValue(tag, bytes) == 0) {
-                        if (self->tag_hook == Py_None) {
-                            Py_INCREF(tag);
-                            ret = tag;
-                        } else {
-                            ret = PyObject_CallFunctionObjArgs(
-                                    self->tag_hook, self, tag, NULL);
-                        }
-                    }
-                    Py_DECREF(tag);
-                }
-            } else
-                PyErr_Format(
-                    _CBOR2_CBORDecodeValueError,
-                    "invalid ipaddress value %R", bytes);
-        } else
-            PyErr_Format(
-                _CBOR2_CBORDecodeValueError,
-                "invalid ipaddress value %R", bytes);
-        Py_DECREF(bytes);
-    }
-    set_shareable(self, ret);
+#define COPY_FIELD(name)                        \
+    Py_INCREF(self->name);                      \
+    Py_SETREF(ret->name, self->name);
+
+    COPY_FIELD(tag_hook);
+    COPY_FIELD(object_hook);
+    COPY_FIELD(str_errors);
+    COPY_FIELD(record_type);
+    COPY_FIELD(record_fields);
+    COPY_FIELD(raw_tags);
+    COPY_FIELD(raw_keys);
+
+#undef COPY_FIELD
+    ret->cache_keys = self->cache_keys;
+    ret->int_cache_size = self->int_cache_size;
+    ret->max_items = self->max_items;
+    ret->max_length = self->max_length;
+    ret->max_allocation = self->max_allocation;
+    ret->limited = ret->tracking = self->limited;
+    if (CBORDecoder_set_input(ret, self->input.obj) == -1)
+        Py_CLEAR(ret);
     return ret;
 }
 
 
-// CBORDecoder.decode_ipnetwork(self)
-static PyObject *
-CBORDecoder_decode_ipnetwork(CBORDecoderObject *self)
+// Decodes the values of chunk into a list, or saves the exception raised
+static void
+decode_chunk(ParallelChunk *chunk)
 {
-    // semantic type 261
-    PyObject *map, *tuple, *bytes, *prefixlen, *ret = NULL;
-    Py_ssize_t pos = 0;
+    CBORDecoderObject *decoder = chunk->decoder;
+    PyObject *value;
+    Py_ssize_t i;
 
-    if (!_CBOR2_ip_network && _CBOR2_init_ip_address() == -1)
-        return NULL;
-    map = decode(self, DECODE_UNSHARED);
-    if (map) {
-        if (PyDict_CheckExact(map) && PyDict_Size(map) == 1) {
-            if (PyDict_Next(map, &pos, &bytes, &prefixlen)) {
-                if (
-                        PyBytes_CheckExact(bytes) &&
-                        PyLong_CheckExact(prefixlen) &&
-                        (PyBytes_GET_SIZE(bytes) == 4 ||
-                         PyBytes_GET_SIZE(bytes) == 16)) {
-                    tuple = PyTuple_Pack(2, bytes, prefixlen);
-                    if (tuple) {
-                        ret = PyObject_CallFunctionObjArgs(
-                                _CBOR2_ip_network, tuple, Py_False, NULL);
-                        Py_DECREF(tuple);
-                    }
-                } else
-                    PyErr_Format(
-                        _CBOR2_CBORDecodeValueError,
-                        "invalid ipnetwork value %R", map);
-            } else
-                // We've already checked the size is 1 so this shouldn't be
-                // possible
-                assert(0);
-        } else
-            PyErr_Format(
-                _CBOR2_CBORDecodeValueError,
-                "invalid ipnetwork value %R", map);
-        Py_DECREF(map);
+    decoder->input_pos = chunk->start;
+    chunk->values = PyList_New(chunk->count);
+    for (i = 0; chunk->values && i < chunk->count; i++) {
+        // Items of a sequence are independent; see CBORDecoder_iternext
+        value = NULL;
+        if (clear_references(decoder) == 0)
+            value = CBORDecoder_decode(decoder);
+        if (value)
+            PyList_SET_ITEM(chunk->values, i, value);
+        else
+            Py_CLEAR(chunk->values);
     }
-    set_shareable(self, ret);
-    return ret;
+    if (!chunk->values)
+        save_error(&chunk->error);
 }
 
 
-// CBORDecoder.decode_self_describe_cbor(self)
-static PyObject *
-CBORDecoder_decode_self_describe_cbor(CBORDecoderObject *self)
+static void
+decode_chunk_thread(void *arg)
 {
-    // semantic tag 55799
-    return decode(self, DECODE_NORMAL);
-}
+    ParallelChunk *chunk = arg;
+    PyGILState_STATE state;
 
+    state = PyGILState_Ensure();
+    decode_chunk(chunk);
+    PyGILState_Release(state);
+    PyThread_release_lock(chunk->done);
+}
 
-// Special decoders //////////////////////////////////////////////////////////
 
-static PyObject *
-decode_special(CBORDecoderObject *self, uint8_t subtype)
+// Decodes all the values of the in-memory input, a CBOR sequence, into a
+// list. The values are located by skipping over them one after another, then
+// split into at most workers runs of about equal size (but no smaller than
+// PARALLEL_CHUNK_SIZE bytes), each decoded by a copy of the decoder on a
+// thread of its own. The first run is decoded on the calling thread, and if
+// there's only one it's decoded straight away, as by loads_sequence()
+PyObject *
+CBORDecoder_decode_parallel(CBORDecoderObject *self, Py_ssize_t workers)
 {
-    // major type 7
-    PyObject *tag, *ret = NULL;
+    ParallelChunk *chunks;
+    SavedError scan_error = {NULL};
+    SkipStats stats;
+    PyObject *ret = NULL;
+    Py_ssize_t size, count, i, j, k;
+
+    size = self->input.len - self->input_pos;
+    count = size / PARALLEL_CHUNK_SIZE;
+    if (count > workers)
+        count = workers;
+    if (count <= 1)
+        // The decoder is its own iterator over the values
+        return PySequence_List((PyObject *) self);
+    chunks = PyMem_Calloc(count, sizeof(ParallelChunk));
+    if (!chunks)
+        return PyErr_NoMemory();
+
+    // Start a new run at the first value past each share of the input. If a
+    // value is malformed, the values before it are decoded all the same in
+    // case one of them raises an error first. A stray break marker is decoded
+    // as the break_marker value, as in loads_sequence()
+    chunks[0].start = self->input_pos;
+    k = 0;
+    while (self->input_pos < self->input.len) {
+        if (k + 1 < count &&
+                self->input_pos - chunks[0].start >= size / count * (k + 1))
+            chunks[++k].start = self->input_pos;
+        memset(&stats, 0, sizeof(SkipStats));
+        if (((const uint8_t *) self->input.buf)[self->input_pos] == 0xFF)
+            self->input_pos++;
+        else if (skip_value(self, &stats) == -1) {
+            save_error(&scan_error);
+            break;
+        }
+        chunks[k].count++;
+    }
+    count = k + 1;
 
-    if ((subtype) < 20) {
-        tag = PyStructSequence_New(&CBORSimpleValueType);
-        if (tag) {
-            PyStructSequence_SET_ITEM(tag, 0, PyLong_FromLong(subtype));
-            if (PyStructSequence_GET_ITEM(tag, 0)) {
-                Py_INCREF(tag);
-                ret = tag;
+    for (i = 0; i < count; i++) {
+        if (i == 0) {
+            Py_INCREF(self);
+            chunks[i].decoder = self;
+        } else {
+            chunks[i].decoder = decoder_copy(self);
+            if (!chunks[i].decoder)
+                goto out;
+            chunks[i].done = PyThread_allocate_lock();
+            if (!chunks[i].done) {
+                PyErr_NoMemory();
+                goto out;
             }
-            Py_DECREF(tag);
-            // XXX Set shareable?
         }
-    } else {
-        switch (subtype) {
-            case 20: Py_RETURN_FALSE;
-            case 21: Py_RETURN_TRUE;
-            case 22: Py_RETURN_NONE;
-            case 23: CBOR2_RETURN_UNDEFINED;
-            case 24: return CBORDecoder_decode_simple_value(self);
-            case 25: return CBORDecoder_decode_float16(self);
-            case 26: return CBORDecoder_decode_float32(self);
-            case 27: return CBORDecoder_decode_float64(self);
-            case 31: CBOR2_RETURN_BREAK;
-            default:
-                PyErr_Format(
-                    _CBOR2_CBORDecodeValueError,
-                    "Undefined Reserved major type 7 subtype 0x%x", subtype);
-                break;
+    }
+    for (i = 1; i < count; i++) {
+        PyThread_acquire_lock(chunks[i].done, WAIT_LOCK);
+        chunks[i].threaded = PyThread_start_new_thread(
+                decode_chunk_thread, &chunks[i]) != PYTHREAD_INVALID_THREAD_ID;
+        if (!chunks[i].threaded)
+            PyThread_release_lock(chunks[i].done);
+    }
+    decode_chunk(&chunks[0]);
+    // A run whose thread couldn't be started is decoded here instead
+    for (i = 1; i < count; i++) {
+        if (chunks[i].threaded) {
+            Py_BEGIN_ALLOW_THREADS
+            PyThread_acquire_lock(chunks[i].done, WAIT_LOCK);
+            Py_END_ALLOW_THREADS
+            PyThread_release_lock(chunks[i].done);
+        } else
+            decode_chunk(&chunks[i]);
+    }
+
+    // Raise whichever error comes first in the input
+    for (i = 0; i < count; i++) {
+        if (!chunks[i].values) {
+            restore_error(&chunks[i].error);
+            goto out;
+        }
+    }
+    if (scan_error.value || scan_error.type) {
+        restore_error(&scan_error);
+        goto out;
+    }
+    for (i = 0, size = 0; i < count; i++)
+        size += chunks[i].count;
+    ret = PyList_New(size);
+    if (ret) {
+        for (i = 0, k = 0; i < count; i++) {
+            for (j = 0; j < chunks[i].count; j++) {
+                Py_INCREF(PyList_GET_ITEM(chunks[i].values, j));
+                PyList_SET_ITEM(ret, k++,
+                                PyList_GET_ITEM(chunks[i].values, j));
+            }
         }
     }
+out:
+    discard_error(&scan_error);
+    for (i = 0; i < count; i++) {
+        Py_XDECREF(chunks[i].decoder);
+        Py_XDECREF(chunks[i].values);
+        discard_error(&chunks[i].error);
+        if (chunks[i].done)
+            PyThread_free_lock(chunks[i].done);
+    }
+    PyMem_Free(chunks);
     return ret;
 }
 
 
-// CBORDecoder.decode_simple_value(self)
-static PyObject *
-CBORDecoder_decode_simple_value(CBORDecoderObject *self)
-{
-    PyObject *tag, *ret = NULL;
-    uint8_t buf;
+// Incremental decoding //////////////////////////////////////////////////////
 
-    if (fp_read(self, (char*)&buf, sizeof(uint8_t)) == 0) {
-        tag = PyStructSequence_New(&CBORSimpleValueType);
-        if (tag) {
-            PyStructSequence_SET_ITEM(tag, 0, PyLong_FromLong(buf));
-            if (PyStructSequence_GET_ITEM(tag, 0)) {
-                Py_INCREF(tag);
-                ret = tag;
-            }
-            Py_DECREF(tag);
-        }
-    }
-    // XXX Set shareable?
-    return ret;
+// Data fed to an IncrementalDecoder is appended to its buffer and the items in
+// it followed, much as when skipping, but one header at a time with the open
+// containers kept on an explicit stack. Scanning can then stop wherever the
+// data runs out and carry on from the same point when more arrives, and once
+// a top-level value is complete it's decoded straight from the buffer, once
+
+static int
+CBORIncrementalDecoder_traverse(CBORIncrementalDecoderObject *self,
+                                visitproc visit, void *arg)
+{
+    Py_VISIT(self->decoder);
+    return 0;
 }
 
 
-// CBORDecoder.decode_float16(self)
-static PyObject *
-CBORDecoder_decode_float16(CBORDecoderObject *self)
+static int
+CBORIncrementalDecoder_clear(CBORIncrementalDecoderObject *self)
 {
-    PyObject *ret = NULL;
-    union {
-        uint16_t i;
-        char buf[sizeof(uint16_t)];
-    } u;
+    Py_CLEAR(self->decoder);
+    return 0;
+}
 
-    if (fp_read(self, u.buf, sizeof(uint16_t)) == 0)
-        ret = PyFloat_FromDouble(unpack_float16(u.i));
-    set_shareable(self, ret);
-    return ret;
+
+// IncrementalDecoder.__del__(self)
+static void
+CBORIncrementalDecoder_dealloc(CBORIncrementalDecoderObject *self)
+{
+    PyObject_GC_UnTrack(self);
+    CBORIncrementalDecoder_clear(self);
+    PyMem_Free(self->buffer);
+    PyMem_Free(self->frames);
+    Py_TYPE(self)->tp_free((PyObject *) self);
 }
 
 
-// CBORDecoder.decode_float32(self)
+// IncrementalDecoder.__new__(cls, *args, **kwargs)
 static PyObject *
-CBORDecoder_decode_float32(CBORDecoderObject *self)
+CBORIncrementalDecoder_new(PyTypeObject *type, PyObject *args,
+                           PyObject *kwargs)
 {
-    PyObject *ret = NULL;
-    union {
-        uint32_t i;
-        float f;
-        char buf[sizeof(float)];
-    } u;
+    CBORIncrementalDecoderObject *self;
 
-    if (fp_read(self, u.buf, sizeof(float)) == 0) {
-        u.i = be32toh(u.i);
-        ret = PyFloat_FromDouble(u.f);
+    self = (CBORIncrementalDecoderObject *) type->tp_alloc(type, 0);
+    if (self) {
+        self->decoder = (CBORDecoderObject *)
+            CBORDecoder_new(&CBORDecoderType, NULL, NULL);
+        if (!self->decoder)
+            Py_CLEAR(self);
     }
-    set_shareable(self, ret);
-    return ret;
+    return (PyObject *) self;
 }
 
 
-// CBORDecoder.decode_float64(self)
-static PyObject *
-CBORDecoder_decode_float64(CBORDecoderObject *self)
+// IncrementalDecoder.__init__(self, tag_hook=None, object_hook=None,
+//                             str_errors='strict', record_type=None)
+static int
+CBORIncrementalDecoder_init(CBORIncrementalDecoderObject *self,
+                            PyObject *args, PyObject *kwargs)
 {
-    PyObject *ret = NULL;
-    union {
-        uint64_t i;
-        double f;
-        char buf[sizeof(double)];
-    } u;
+    static char *keywords[] = {
+        "tag_hook", "object_hook", "str_errors", "record_type", NULL
+    };
+    PyObject *tag_hook = NULL, *object_hook = NULL, *str_errors = NULL,
+             *record_type = NULL;
 
-    if (fp_read(self, u.buf, sizeof(double)) == 0) {
-        u.i = be64toh(u.i);
-        ret = PyFloat_FromDouble(u.f);
-    }
-    set_shareable(self, ret);
-    return ret;
+    if (!PyArg_ParseTupleAndKeywords(args, kwargs, "|OOOO", keywords,
+                &tag_hook, &object_hook, &str_errors, &record_type))
+        return -1;
+    return CBORDecoder_init_options(
+            self->decoder, tag_hook, object_hook, str_errors, record_type);
 }
 
 
-PyObject *
-decode(CBORDecoderObject *self, DecodeOptions options)
+// IncrementalDecoder._get_pending(self)
+static PyObject *
+_CBORIncrementalDecoder_get_pending(CBORIncrementalDecoderObject *self,
+                                    void *closure)
 {
-    bool old_immutable;
-    Py_ssize_t old_index;
-    PyObject *ret = NULL;
-    LeadByte lead;
+    return PyLong_FromSsize_t(self->length);
+}
 
-    if (options & DECODE_IMMUTABLE) {
-        old_immutable = self->immutable;
-        self->immutable = true;
+
+static int
+incremental_append(CBORIncrementalDecoderObject *self, const char *data,
+                   Py_ssize_t length)
+{
+    Py_ssize_t new_size;
+    char *new_buffer;
+
+    if (length > PY_SSIZE_T_MAX - self->length) {
+        PyErr_NoMemory();
+        return -1;
     }
-    if (options & DECODE_UNSHARED) {
-        old_index = self->shared_index;
-        self->shared_index = -1;
+    if (self->length + length > self->allocated) {
+        new_size = self->allocated ? self->allocated : 256;
+        while (new_size < self->length + length)
+            new_size = new_size <= PY_SSIZE_T_MAX / 2 ?
+                new_size * 2 : self->length + length;
+        new_buffer = PyMem_Realloc(self->buffer, new_size);
+        if (!new_buffer) {
+            PyErr_NoMemory();
+            return -1;
+        }
+        self->buffer = new_buffer;
+        self->allocated = new_size;
     }
+    memcpy(self->buffer + self->length, data, length);
+    self->length += length;
+    return 0;
+}
 
-    if (Py_EnterRecursiveCall(" in CBORDecoder.decode"))
-        return NULL;
 
-    if (fp_read(self, &lead.byte, 1) == 0) {
-        switch (lead.major) {
-            case 0: ret = decode_uint(self, lead.subtype);       break;
-            case 1: ret = decode_negint(self, lead.subtype);     break;
-            case 2: ret = decode_bytestring(self, lead.subtype); break;
-            case 3: ret = decode_string(self, lead.subtype);     break;
-            case 4: ret = decode_array(self, lead.subtype);      break;
-            case 5: ret = decode_map(self, lead.subtype);        break;
-            case 6: ret = decode_semantic(self, lead.subtype);   break;
-            case 7: ret = decode_special(self, lead.subtype);    break;
-            default: assert(0);
+static int
+incremental_push(CBORIncrementalDecoderObject *self, uint8_t major,
+                 bool indefinite, uint64_t count)
+{
+    IncrementalFrame *new_frames;
+    Py_ssize_t new_depth;
+
+    if (self->depth == self->max_depth) {
+        new_depth = self->max_depth ? self->max_depth * 2 : 16;
+        new_frames = PyMem_Realloc(
+                self->frames, new_depth * sizeof(IncrementalFrame));
+        if (!new_frames) {
+            PyErr_NoMemory();
+            return -1;
         }
+        self->frames = new_frames;
+        self->max_depth = new_depth;
     }
+    self->frames[self->depth].major = major;
+    self->frames[self->depth].indefinite = indefinite;
+    self->frames[self->depth].count = count;
+    self->depth++;
+    return 0;
+}
 
-    Py_LeaveRecursiveCall();
-    if (options & DECODE_IMMUTABLE)
-        self->immutable = old_immutable;
-    if (options & DECODE_UNSHARED)
-        self->shared_index = old_index;
-    return ret;
+
+// Counts an item as finished in the innermost open container, closing those
+// it completes. Returns true if it completed a value at the top level
+static bool
+incremental_complete(CBORIncrementalDecoderObject *self)
+{
+    IncrementalFrame *frame;
+
+    while (self->depth) {
+        frame = &self->frames[self->depth - 1];
+        if (frame->indefinite) {
+            frame->count++;
+            return false;
+        }
+        if (--frame->count)
+            return false;
+        self->depth--;
+    }
+    return true;
 }
 
 
-// CBORDecoder.decode(self) -> obj
-PyObject *
-CBORDecoder_decode(CBORDecoderObject *self)
+// Follows the items in the buffer past those already scanned, without
+// decoding them. Returns 1 and sets *end to the offset just past the next
+// complete value, 0 if the data runs out first, or -1 if it's malformed
+static int
+incremental_scan(CBORIncrementalDecoderObject *self, Py_ssize_t *end)
 {
-    return decode(self, DECODE_NORMAL);
+    const uint8_t *p;
+    IncrementalFrame *frame;
+    Py_ssize_t available, size, i;
+    uint64_t length;
+    uint8_t major, subtype;
+    bool indefinite;
+
+    while (self->scanned < self->length) {
+        p = (const uint8_t *) self->buffer + self->scanned;
+        available = self->length - self->scanned;
+        major = p[0] >> 5;
+        subtype = p[0] & 31;
+        frame = self->depth ? &self->frames[self->depth - 1] : NULL;
+        if (p[0] == 0xFF) {
+            // A break marker may only end an indefinite length array, map or
+            // string, and not in the middle of a map entry
+            if (!frame || !frame->indefinite ||
+                    (frame->major == 5 && frame->count & 1)) {
+                PyErr_SetString(_CBOR2_CBORDecodeValueError,
+                                "unexpected break marker");
+                return -1;
+            }
+            self->scanned++;
+            self->depth--;
+            if (incremental_complete(self))
+                goto found;
+            continue;
+        }
+        if (frame && frame->indefinite && frame->major <= 3 &&
+                (major != frame->major || subtype == 31)) {
+            PyErr_SetString(
+                _CBOR2_CBORDecodeValueError, frame->major == 2 ?
+                "non-bytestring found in indefinite length bytestring" :
+                "non-string found in indefinite length string");
+            return -1;
+        }
+
+        size = 1;
+        length = subtype;
+        indefinite = false;
+        if (subtype >= 24 && subtype < 28) {
+            size += (Py_ssize_t) 1 << (subtype - 24);
+            if (available < size)
+                return 0;
+            length = 0;
+            for (i = 1; i < size; i++)
+                length = length << 8 | p[i];
+        } else if (subtype == 31 && major >= 2 && major <= 5) {
+            indefinite = true;
+        } else if (subtype >= 28) {
+            if (major == 7)
+                PyErr_Format(
+                    _CBOR2_CBORDecodeValueError,
+                    "Undefined Reserved major type 7 subtype 0x%x", subtype);
+            else
+                PyErr_Format(
+                    _CBOR2_CBORDecodeValueError,
+                    "unknown unsigned integer subtype 0x%x", subtype);
+            return -1;
+        }
+        if ((major == 2 || major == 3) && !indefinite) {
+            if (length > (uint64_t) (available - size))
+                return 0;
+            size += (Py_ssize_t) length;
+        }
+        self->scanned += size;
+
+        if (indefinite || major == 6 || ((major == 4 || major == 5) && length)) {
+            if (indefinite)
+                length = 0;
+            else if (major == 6)
+                length = 1;
+            else if (major == 5) {
+                // A map has two items (a key and a value) per entry
+                if (length > UINT64_MAX / 2) {
+                    PyErr_SetString(_CBOR2_CBORDecodeValueError,
+                                    "excessive map size");
+                    return -1;
+                }
+                length *= 2;
+            }
+            if (incremental_push(self, major, indefinite, length) == -1)
+                return -1;
+        } else if (incremental_complete(self))
+            goto found;
+    }
+    return 0;
+found:
+    *end = self->scanned;
+    return 1;
 }
 
 
-// CBORDecoder.decode_from_bytes(self, data)
+// Decodes the complete value in the buffer from start to end
 static PyObject *
-CBORDecoder_decode_from_bytes(CBORDecoderObject *self, PyObject *data)
+incremental_decode(CBORIncrementalDecoderObject *self, Py_ssize_t start,
+                   Py_ssize_t end)
 {
-    PyObject *save_read, *buf, *ret = NULL;
+    CBORDecoderObject *decoder = self->decoder;
+    PyObject *ret = NULL;
 
-    if (!_CBOR2_BytesIO && _CBOR2_init_BytesIO() == -1)
+    // The values are independent, as in a CBOR sequence
+    if (clear_references(decoder) == -1)
         return NULL;
-
-    save_read = self->read;
-    buf = PyObject_CallFunctionObjArgs(_CBOR2_BytesIO, data, NULL);
-    if (buf) {
-        self->read = PyObject_GetAttr(buf, _CBOR2_str_read);
-        if (self->read) {
-            ret = decode(self, DECODE_NORMAL);
-            Py_DECREF(self->read);
-        }
-        Py_DECREF(buf);
-    }
-    self->read = save_read;
+    PyBuffer_FillInfo(&decoder->input, NULL, self->buffer + start,
+                      end - start, 1, PyBUF_SIMPLE);
+    decoder->input_pos = 0;
+    ret = CBORDecoder_decode(decoder);
+    memset(&decoder->input, 0, sizeof(Py_buffer));
+    decoder->input_pos = 0;
     return ret;
 }
 
 
-// Decoder class definition //////////////////////////////////////////////////
+// IncrementalDecoder.feed(self, data) -> list
+static PyObject *
+CBORIncrementalDecoder_feed(CBORIncrementalDecoderObject *self, PyObject *data)
+{
+    Py_buffer view;
+    PyObject *values, *value;
+    Py_ssize_t start = 0, end;
+    int found;
+
+    if (self->feeding) {
+        // The buffer mustn't move while a value is decoded from it
+        PyErr_SetString(PyExc_RuntimeError,
+                        "feed() cannot be called while decoding a value");
+        return NULL;
+    }
+    if (PyObject_GetBuffer(data, &view, PyBUF_SIMPLE) == -1)
+        return NULL;
+    found = incremental_append(self, view.buf, view.len);
+    PyBuffer_Release(&view);
+    if (found == -1)
+        return NULL;
 
-#define PUBLIC_MAJOR(type)                                                   \
-    static PyObject *                                                        \
-    CBORDecoder_decode_##type(CBORDecoderObject *self, PyObject *subtype)    \
-    {                                                                        \
-        return decode_##type(self, (uint8_t) PyLong_AsUnsignedLong(subtype));\
+    values = PyList_New(0);
+    if (!values)
+        goto error;
+    self->feeding = true;
+    while ((found = incremental_scan(self, &end)) == 1) {
+        value = incremental_decode(self, start, end);
+        if (!value)
+            break;
+        found = PyList_Append(values, value);
+        Py_DECREF(value);
+        if (found == -1)
+            break;
+        start = end;
     }
+    self->feeding = false;
+    if (found != 0)
+        goto error;
 
-PUBLIC_MAJOR(uint);
-PUBLIC_MAJOR(negint);
-PUBLIC_MAJOR(bytestring);
-PUBLIC_MAJOR(string);
-PUBLIC_MAJOR(array);
-PUBLIC_MAJOR(map);
-PUBLIC_MAJOR(semantic);
-PUBLIC_MAJOR(special);
+    memmove(self->buffer, self->buffer + start, self->length - start);
+    self->length -= start;
+    self->scanned -= start;
+    return values;
+error:
+    // There's no telling where the next value starts
+    Py_XDECREF(values);
+    self->length = self->scanned = self->depth = 0;
+    return NULL;
+}
 
-#undef PUBLIC_MAJOR
 
-static PyGetSetDef CBORDecoder_getsetters[] = {
-    {"fp",
-        (getter) _CBORDecoder_get_fp, (setter) _CBORDecoder_set_fp,
-        "input file-like object", NULL},
-    {"tag_hook",
-        (getter) _CBORDecoder_get_tag_hook, (setter) _CBORDecoder_set_tag_hook,
-        "hook called when decoding an unknown semantic tag", NULL},
-    {"object_hook",
-        (getter) _CBORDecoder_get_object_hook, (setter) _CBORDecoder_set_object_hook,
-        "hook called when decoding any dict", NULL},
-    {"str_errors",
-        (getter) _CBORDecoder_get_str_errors, (setter) _CBORDecoder_set_str_errors,
-        "the error mode to use when decoding UTF-8 encoded strings"},
-    {"immutable",
-        (getter) _CBORDecoder_get_immutable, NULL,
-        "when True, the next item decoded should be made immutable (a "
-        "tuple instead of a list, a frozenset instead of a set, etc.)"},
+static PyGetSetDef CBORIncrementalDecoder_getsetters[] = {
+    {"pending",
+        (getter) _CBORIncrementalDecoder_get_pending, NULL,
+        "the number of bytes fed so far that belong to a value not yet "
+        "complete", NULL},
     {NULL}
 };
 
-static PyMethodDef CBORDecoder_methods[] = {
-    {"read", (PyCFunction) CBORDecoder_read, METH_O,
-        "read the specified number of bytes from the input"},
-    // Decoding methods
-    {"decode", (PyCFunction) CBORDecoder_decode, METH_NOARGS,
-        "decode the next value from the input"},
-    {"decode_from_bytes", (PyCFunction) CBORDecoder_decode_from_bytes, METH_O,
-        "decode the specified byte-string"},
-    {"decode_uint", (PyCFunction) CBORDecoder_decode_uint, METH_O,
-        "decode an unsigned integer from the input"},
-    {"decode_negint", (PyCFunction) CBORDecoder_decode_negint, METH_O,
-        "decode a negative integer from the input"},
-    {"decode_bytestring", (PyCFunction) CBORDecoder_decode_bytestring, METH_O,
-        "decode a bytes string from the input"},
-    {"decode_string", (PyCFunction) CBORDecoder_decode_string, METH_O,
-        "decode a unicode string from the input"},
-    {"decode_array", (PyCFunction) CBORDecoder_decode_array, METH_O,
-        "decode a list or tuple from the input"},
-    {"decode_map", (PyCFunction) CBORDecoder_decode_map, METH_O,
-        "decode a dict from the input"},
-    {"decode_semantic", (PyCFunction) CBORDecoder_decode_semantic, METH_O,
-        "decode a semantically tagged value from the input"},
-    {"decode_special", (PyCFunction) CBORDecoder_decode_special, METH_O,
-        "decode a special value from the input"},
-    {"decode_datetime_string",
-        (PyCFunction) CBORDecoder_decode_datetime_string, METH_NOARGS,
-        "decode a date-time string from the input"},
-    {"decode_epoch_datetime",
-        (PyCFunction) CBORDecoder_decode_epoch_datetime, METH_NOARGS,
-        "decode a timestamp offset from the input"},
-    {"decode_positive_bignum",
-        (PyCFunction) CBORDecoder_decode_positive_bignum, METH_NOARGS,
-        "decode a positive big-integer from the input"},
-    {"decode_negative_bignum",
-        (PyCFunction) CBORDecoder_decode_negative_bignum, METH_NOARGS,
-        "decode a negative big-integer from the input"},
-    {"decode_fraction", (PyCFunction) CBORDecoder_decode_fraction, METH_NOARGS,
-        "decode a fractional number from the input"},
-    {"decode_rational", (PyCFunction) CBORDecoder_decode_rational, METH_NOARGS,
-        "decode a rational value from the input"},
-    {"decode_bigfloat", (PyCFunction) CBORDecoder_decode_bigfloat, METH_NOARGS,
-        "decode a large floating-point value from the input"},
-    {"decode_regexp", (PyCFunction) CBORDecoder_decode_regexp, METH_NOARGS,
-        "decode a regular expression from the input"},
-    {"decode_mime", (PyCFunction) CBORDecoder_decode_mime, METH_NOARGS,
-        "decode a MIME message from the input"},
-    {"decode_uuid", (PyCFunction) CBORDecoder_decode_uuid, METH_NOARGS,
-        "decode a UUID from the input"},
-    {"decode_shareable",
-        (PyCFunction) CBORDecoder_decode_shareable, METH_NOARGS,
-        "decode a shareable value from the input"},
-    {"decode_sharedref", (PyCFunction) CBORDecoder_decode_sharedref, METH_NOARGS,
-        "decode a shared reference from the input"},
-    {"decode_stringref",
-        (PyCFunction) CBORDecoder_decode_stringref, METH_NOARGS,
-        "decode a string reference from the input"},
-    {"decode_stringref_namespace", (PyCFunction) CBORDecoder_decode_stringref_ns, METH_NOARGS,
-        "decode a string reference namespace from the input"},
-    {"decode_set", (PyCFunction) CBORDecoder_decode_set, METH_NOARGS,
-        "decode a set or frozenset from the input"},
-    {"decode_ipaddress", (PyCFunction) CBORDecoder_decode_ipaddress, METH_NOARGS,
-        "decode an IPv4Address or IPv6Address from the input"},
-    {"decode_ipnetwork", (PyCFunction) CBORDecoder_decode_ipnetwork, METH_NOARGS,
-        "decode an IPv4Network or IPv6Network from the input"},
-    {"decode_self_describe_cbor", (PyCFunction) CBORDecoder_decode_self_describe_cbor, METH_NOARGS,
-        "decode a data item after a self-describe CBOR tag"},
-    {"decode_simple_value",
-        (PyCFunction) CBORDecoder_decode_simple_value, METH_NOARGS,
-        "decode a CBORSimpleValue from the input"},
-    {"decode_float16", (PyCFunction) CBORDecoder_decode_float16, METH_NOARGS,
-        "decode a half-precision floating-point value from the input"},
-    {"decode_float32", (PyCFunction) CBORDecoder_decode_float32, METH_NOARGS,
-        "decode a floating-point value from the input"},
-    {"decode_float64", (PyCFunction) CBORDecoder_decode_float64, METH_NOARGS,
-        "decode a double-precision floating-point value from the input"},
-    {"set_shareable", (PyCFunction) CBORDecoder_set_shareable, METH_O,
-        "set the specified object as the current shareable reference"},
+static PyMethodDef CBORIncrementalDecoder_methods[] = {
+    {"feed", (PyCFunction) CBORIncrementalDecoder_feed, METH_O,
+        "add *data* to the end of the input and return a list of the values "
+        "it completes"},
     {NULL}
 };
 
-PyDoc_STRVAR(CBORDecoder__doc__,
-"The CBORDecoder class implements a fully featured `CBOR`_ decoder with\n"
-"several extensions for handling shared references, big integers,\n"
-"rational numbers and so on. Typically the class is not used directly,\n"
-"but the :func:`cbor2.load` and :func:`cbor2.loads` functions are called\n"
-"to indirectly construct and use the class.\n"
+PyDoc_STRVAR(CBORIncrementalDecoder__doc__,
+"Decodes a CBOR sequence (:rfc:`8742`) that arrives piece by piece, as from\n"
+"a non-blocking socket or an asyncio protocol.\n"
 "\n"
-"When the class is constructed manually, the main entry points are\n"
-":meth:`decode` and :meth:`decode_from_bytes`.\n"
+"Each call to :meth:`feed` returns the values completed by the data passed\n"
+"to it. The data of a value that isn't complete yet is kept until the rest\n"
+"of it arrives, with only the lengths and nesting of its items tracked in\n"
+"the meantime, so each value is decoded once, however many pieces it\n"
+"arrives in. As in :func:`loads_sequence`, the values can't refer to each\n"
+"other's shared values.\n"
 "\n"
-":param tag_hook:\n"
-"    callable that takes 2 arguments: the decoder instance, and the\n"
-"    :class:`_cbor2.CBORTag` to be decoded. This callback is invoked for\n"
-"    any tags for which there is no built-in decoder. The return value is\n"
-"    substituted for the :class:`_cbor2.CBORTag` object in the\n"
-"    deserialized output\n"
-":param object_hook:\n"
-"    callable that takes 2 arguments: the decoder instance, and a\n"
-"    dictionary. This callback is invoked for each deserialized\n"
-"    :class:`dict` object. The return value is substituted for the dict\n"
-"    in the deserialized output.\n"
+"If the input turns out to be malformed, or a value can't be decoded, the\n"
+"exception is raised and all the data fed so far is discarded (including\n"
+"any values completed by that call).\n"
 "\n"
-".. _CBOR: https://cbor.io/\n"
+"The arguments have the same meaning as for :class:`CBORDecoder`.\n"
 );
 
-PyTypeObject CBORDecoderType = {
+PyTypeObject CBORIncrementalDecoderType = {
     PyVarObject_HEAD_INIT(NULL, 0)
-    .tp_name = "_cbor2.CBORDecoder",
-    .tp_doc = CBORDecoder__doc__,
-    .tp_basicsize = sizeof(CBORDecoderObject),
+    .tp_name = "_cbor2.IncrementalDecoder",
+    .tp_doc = CBORIncrementalDecoder__doc__,
+    .tp_basicsize = sizeof(CBORIncrementalDecoderObject),
     .tp_itemsize = 0,
     .tp_flags = Py_TPFLAGS_DEFAULT | Py_TPFLAGS_BASETYPE | Py_TPFLAGS_HAVE_GC,
-    .tp_new = CBORDecoder_new,
-    .tp_init = (initproc) CBORDecoder_init,
-    .tp_dealloc = (destructor) CBORDecoder_dealloc,
-    .tp_traverse = (traverseproc) CBORDecoder_traverse,
-    .tp_clear = (inquiry) CBORDecoder_clear,
-    .tp_getset = CBORDecoder_getsetters,
-    .tp_methods = CBORDecoder_methods,
+    .tp_new = CBORIncrementalDecoder_new,
+    .tp_init = (initproc) CBORIncrementalDecoder_init,
+    .tp_dealloc = (destructor) CBORIncrementalDecoder_dealloc,
+    .tp_traverse = (traverseproc) CBORIncrementalDecoder_traverse,
+    .tp_clear = (inquiry) CBORIncrementalDecoder_clear,
+    .tp_getset = CBORIncrementalDecoder_getsetters,
+    .tp_methods = CBORIncrementalDecoder_methods,
 };
@@ -3,20 +3,155 @@
 #include <stdbool.h>
 #include <stdint.h>
 
+// Number of slots in the per-decoder cache of map key strings; must be a
+// power of two. Only keys short enough for their length to fit in the lead
+// byte (up to 23 bytes of UTF-8) are cached
+#define KEY_CACHE_SIZE 256
+
+// Strings and typed arrays at least this long that are decoded from in-memory
+// input are copied (and checked, or byte swapped) with the GIL released
+#define NOGIL_COPY_SIZE 65536
+
+// The least input each thread is given to decode by
+// CBORDecoder_decode_parallel, so that a thread isn't started for too little
+#define PARALLEL_CHUNK_SIZE 65536
+
+// Scratch buffers (see scratch_read in decoder.c) that have grown beyond this
+// are freed once the string being assembled in them is done, rather than being
+// kept for the next one
+#define SCRATCH_RETAIN_SIZE (16 * 1024 * 1024)
+
+// Default number of non-negative (and of negative) integers kept by each
+// decoder for reuse; see int_cache_size
+#define DEFAULT_INT_CACHE_SIZE 1024
+
+// Counters kept by a decoder while collect_stats is enabled; see
+// _CBORDecoder_get_stats in decoder.c
+typedef struct {
+    Py_ssize_t bytes_read;     // input consumed by the values decoded
+    Py_ssize_t read_calls;     // calls made to fp.read()
+    Py_ssize_t items[8];       // data items decoded, by major type
+    Py_ssize_t tag_hook_calls;
+    Py_ssize_t object_hook_calls;
+    Py_ssize_t max_depth;      // deepest nesting of arrays, maps and tags,
+                               // counting the innermost (as in scan())
+} DecoderStats;
+
 typedef struct {
     PyObject_HEAD
     PyObject *read;    // cached read() method of fp
+    PyObject *seek;    // cached seek() method of fp, or None if not seekable
+    PyObject *tell;    // cached tell() method of fp, or None if not seekable
     PyObject *tag_hook;
     PyObject *object_hook;
     PyObject *shareables;
     PyObject *stringref_namespace;
     PyObject *str_errors;
+    PyObject *record_type;
+    PyObject *record_fields;  // maps each field name of record_type to its
+                              // index, in field order
     bool immutable;
     Py_ssize_t shared_index;
+    Py_buffer input;   // in-memory input; input.buf is NULL when reading fp
+    Py_ssize_t input_pos;
+    bool fp_input;     // input is a view of fp itself (such as an mmap)
+    PyObject *fp_buffer;  // fp, if it has a buffer, tell() and seek() so
+                          // each call decodes from a view of it (see
+                          // fp_acquire), or NULL
+    bool fp_acquired;  // a call reading from fp is in progress
+    Py_ssize_t memoryview_size;  // bytestrings at least this long are
+                                 // returned as views of fp, or -1
+    PyObject *readahead;  // bytes read from fp, consumed from read_pos on
+    Py_ssize_t read_pos;
+    Py_ssize_t rewound;   // bytes at the end of readahead that fp has been
+                          // moved back over (see fp_release)
+    Py_ssize_t rewound_pos;  // the position fp was moved back to
+    Py_ssize_t read_size; // 0 selects the default based on seekability
+    bool cache_keys;
+    PyObject *key_cache[KEY_CACHE_SIZE];  // str keys (or NULL)
+    Py_ssize_t int_cache_size;
+    PyObject **int_cache;  // 257 .. size-1 then -6 .. -size (or NULL);
+                           // allocated on first use
+    PyObject *raw_tags;    // frozenset of tag numbers, or None
+    PyObject *raw_keys;    // frozenset of map keys, or None
+    PyObject *raw_capture; // bytearray collecting what's read from fp while
+                           // skipping over a raw item, or NULL
+    PyObject *last_tz;     // the timezone of the last datetime string with
+                           // a non-zero offset, or NULL
+    int last_tz_offset;    // the offset of last_tz in seconds
+    char *scratch;         // where long and indefinite length strings are
+                           // assembled, or NULL; kept between values
+    Py_ssize_t scratch_size;   // bytes allocated for scratch
+    Py_ssize_t scratch_len;    // bytes of scratch in use
+    Py_ssize_t fetched;    // bytes returned by fp.read() so far
+    Py_ssize_t depth;      // nesting of the calls to decode() in progress
+    Py_ssize_t max_items;  // limits on each top-level value, or -1 for none
+    Py_ssize_t max_length;
+    Py_ssize_t max_allocation;
+    Py_ssize_t items;      // items of the current value decoded so far
+    Py_ssize_t allocated;  // allocation charged to the current value
+    bool limited;          // any of the limits is set
+    bool collect_stats;
+    bool tracking;         // limited or collect_stats; every item is then
+                           // decoded through decode() to be counted
+    Py_ssize_t value_start;  // input position the current value started at
+    DecoderStats stats;
 } CBORDecoderObject;
 
+// A map or array whose items are only located and decoded when accessed; see
+// loads_lazy() in module.c
+typedef struct {
+    PyObject_HEAD
+    CBORDecoderObject *decoder;  // has a view of the whole document as input
+    Py_ssize_t length;     // number of items (entries of a map), or -1 if
+                           // the indefinite length hasn't been found yet
+    Py_ssize_t located;    // number of items whose offsets are known
+    Py_ssize_t next;       // offset just after the last located item
+    Py_ssize_t allocated;  // capacity of offsets and values
+    Py_ssize_t *offsets;   // offset of each item (of the value, for maps)
+    PyObject **values;     // each item decoded so far, or NULL
+    PyObject *index;       // maps only; dict of each key to its entry number
+} CBORLazyObject;
+
+// An array, map, tag or indefinite length string whose start the incremental
+// decoder has seen, but not its end
+typedef struct {
+    uint8_t major;
+    bool indefinite;
+    uint64_t count;        // items left, or items so far if indefinite
+} IncrementalFrame;
+
+// Decodes a CBOR sequence fed to it piece by piece; see IncrementalDecoder in
+// decoder.c
+typedef struct {
+    PyObject_HEAD
+    CBORDecoderObject *decoder;  // decodes each value once it's complete
+    char *buffer;          // data fed but not yet decoded
+    Py_ssize_t length;     // bytes in buffer
+    Py_ssize_t allocated;  // capacity of buffer
+    Py_ssize_t scanned;    // bytes of buffer whose items have been followed
+    IncrementalFrame *frames;  // the containers still open, innermost last
+    Py_ssize_t depth;      // number of frames in use
+    Py_ssize_t max_depth;  // capacity of frames
+    bool feeding;          // feed() is running
+} CBORIncrementalDecoderObject;
+
 extern PyTypeObject CBORDecoderType;
+extern PyTypeObject CBORLazyArrayType;
+extern PyTypeObject CBORLazyMapType;
+extern PyTypeObject CBORIncrementalDecoderType;
 
 PyObject * CBORDecoder_new(PyTypeObject *, PyObject *, PyObject *);
 int CBORDecoder_init(CBORDecoderObject *, PyObject *, PyObject *);
+int CBORDecoder_init_options(CBORDecoderObject *, PyObject *, PyObject *,
+                             PyObject *, PyObject *);
+int CBORDecoder_init_int_cache(CBORDecoderObject *, PyObject *);
+int CBORDecoder_init_limits(CBORDecoderObject *, PyObject *, PyObject *,
+                            PyObject *);
 PyObject * CBORDecoder_decode(CBORDecoderObject *);
+PyObject * CBORDecoder_decode_from_bytes(CBORDecoderObject *, PyObject *);
+PyObject * CBORDecoder_decode_lazy(CBORDecoderObject *);
+PyObject * CBORDecoder_extract(CBORDecoderObject *, PyObject *, PyObject *);
+PyObject * CBORDecoder_decode_parallel(CBORDecoderObject *, Py_ssize_t);
+PyObject * CBORDecoder_release_read_ahead(CBORDecoderObject *);
+int CBORDecoder_set_input(CBORDecoderObject *, PyObject *);
@@ -34,14 +34,21 @@ typedef PyObject * (EncodeFunction)(CBOREncoderObject *, PyObject *);
 static int encode_semantic(CBOREncoderObject *, const uint64_t, PyObject *);
 static PyObject * encode_shared(CBOREncoderObject *, EncodeFunction *, PyObject *);
 static PyObject * encode_container(CBOREncoderObject *, EncodeFunction *, PyObject *);
+static Py_ssize_t indefinite_parent(CBOREncoderObject *);
+static int check_indefinite_value(CBOREncoderObject *, Py_ssize_t, PyObject *);
 
 static PyObject * CBOREncoder_encode_to_bytes(CBOREncoderObject *, PyObject *);
 static PyObject * CBOREncoder_encode_int(CBOREncoderObject *, PyObject *);
+static PyObject * CBOREncoder_encode_string(CBOREncoderObject *, PyObject *);
 static PyObject * CBOREncoder_encode_float(CBOREncoderObject *, PyObject *);
+static int encode_minimal_floats(CBOREncoderObject *, PyObject **, Py_ssize_t);
 
 static int _CBOREncoder_set_fp(CBOREncoderObject *, PyObject *, void *);
+static int fp_flush(CBOREncoderObject *);
 static int _CBOREncoder_set_default(CBOREncoderObject *, PyObject *, void *);
 static int _CBOREncoder_set_timezone(CBOREncoderObject *, PyObject *, void *);
+static int _CBOREncoder_set_collect_stats(CBOREncoderObject *, PyObject *,
+                                          void *);
 
 
 // Constructors and destructors //////////////////////////////////////////////
@@ -52,23 +59,34 @@ CBOREncoder_traverse(CBOREncoderObject *self, visitproc visit, void *arg)
     Py_VISIT(self->write);
     Py_VISIT(self->encoders);
     Py_VISIT(self->default_handler);
-    Py_VISIT(self->shared);
     Py_VISIT(self->tz);
     Py_VISIT(self->shared_handler);
-    Py_VISIT(self->string_references);
+    for (Py_ssize_t i = 0; i < self->shared.size; i++)
+        Py_VISIT(self->shared.entries[i].key);
+    for (Py_ssize_t i = 0; i < self->string_references.size; i++)
+        Py_VISIT(self->string_references.entries[i].key);
+    for (int i = 0; i < DISPATCH_CACHE_SIZE; i++) {
+        Py_VISIT(self->dispatch[i].type);
+        Py_VISIT(self->dispatch[i].encoder);
+        Py_VISIT(self->dispatch[i].fields);
+    }
     return 0;
 }
 
+static void dispatch_clear(CBOREncoderObject *);
+static void ref_table_clear(RefTable *);
+
 static int
 CBOREncoder_clear(CBOREncoderObject *self)
 {
     Py_CLEAR(self->write);
     Py_CLEAR(self->encoders);
     Py_CLEAR(self->default_handler);
-    Py_CLEAR(self->shared);
     Py_CLEAR(self->tz);
     Py_CLEAR(self->shared_handler);
-    Py_CLEAR(self->string_references);
+    ref_table_clear(&self->shared);
+    ref_table_clear(&self->string_references);
+    dispatch_clear(self);
     return 0;
 }
 
@@ -78,6 +96,9 @@ CBOREncoder_dealloc(CBOREncoderObject *self)
 {
     PyObject_GC_UnTrack(self);
     CBOREncoder_clear(self);
+    if (self->buffer)
+        PyMem_Free(self->buffer);
+    PyMem_Free(self->indefinite_items);
     Py_TYPE(self)->tp_free((PyObject *) self);
 }
 
@@ -97,15 +118,11 @@ CBOREncoder_new(PyTypeObject *type, PyObject *args, PyObject *kwargs)
         Py_INCREF(Py_None);
         self->encoders = Py_None;
         Py_INCREF(Py_None);
-        self->shared = Py_None;
-        Py_INCREF(Py_None);
         self->write = Py_None;
         Py_INCREF(Py_None);
         self->default_handler = Py_None;
         Py_INCREF(Py_None);
         self->tz = Py_None;
-        Py_INCREF(Py_None);
-        self->string_references = Py_None;
         self->enc_style = 0;
         self->timestamp_format = false;
         self->date_as_datetime = false;
@@ -113,6 +130,14 @@ CBOREncoder_new(PyTypeObject *type, PyObject *args, PyObject *kwargs)
         self->shared_handler = NULL;
         self->string_referencing = false;
         self->string_namespacing = false;
+        self->buffer = NULL;
+        self->buffer_len = 0;
+        self->buffer_size = 0;
+        self->flush_threshold = 65536;
+        self->encode_depth = 0;
+        self->value_depth = 0;
+        self->collect_stats = false;
+        memset(&self->stats, 0, sizeof(EncoderStats));
     }
     return (PyObject *) self;
 }
@@ -120,23 +145,134 @@ CBOREncoder_new(PyTypeObject *type, PyObject *args, PyObject *kwargs)
 
 // CBOREncoder.__init__(self, fp=None, datetime_as_timestamp=0, timezone=None,
 //                      value_sharing=False, default=None, canonical=False,
-//                      date_as_datetime=False)
+//                      date_as_datetime=False, string_referencing=False,
+//                      record_format=None, collect_stats=False)
 int
 CBOREncoder_init(CBOREncoderObject *self, PyObject *args, PyObject *kwargs)
 {
     static char *keywords[] = {
         "fp", "datetime_as_timestamp", "timezone", "value_sharing", "default",
-        "canonical", "date_as_datetime", "string_referencing", NULL
+        "canonical", "date_as_datetime", "string_referencing",
+        "record_format", "collect_stats", NULL
     };
-    PyObject *tmp, *fp = NULL, *default_handler = NULL, *tz = NULL;
+    PyObject *fp = NULL, *default_handler = NULL, *tz = NULL,
+             *record_format = NULL, *collect_stats = NULL;
     int value_sharing = 0, timestamp_format = 0, enc_style = 0,
 	date_as_datetime = 0, string_referencing = 0;
 
-    if (!PyArg_ParseTupleAndKeywords(args, kwargs, "O|pOpOppp", keywords,
+    if (!PyArg_ParseTupleAndKeywords(args, kwargs, "O|pOpOpppOO", keywords,
                 &fp, &timestamp_format, &tz, &value_sharing,
                 &default_handler, &enc_style, &date_as_datetime,
-                &string_referencing))
+                &string_referencing, &record_format, &collect_stats))
+        return -1;
+
+    if (_CBOREncoder_set_fp(self, fp, NULL) == -1)
+        return -1;
+    if (collect_stats && _CBOREncoder_set_collect_stats(
+                self, collect_stats, NULL) == -1)
+        return -1;
+    return CBOREncoder_init_options(
+            self, timestamp_format, tz, value_sharing, default_handler,
+            enc_style, date_as_datetime, string_referencing, record_format);
+}
+
+
+#if PY_VERSION_HEX >= 0x030C0000
+// Dictionaries no longer expose a version tag, so a watcher bumps this
+// whenever any encoder's encoders dict is modified. The watcher is registered
+// when the module is loaded (see CBOREncoder_init_watcher), and with the GIL
+// disabled the encoders dicts of several threads may be modified at once
+static uint64_t encoders_version = 0;
+static int encoders_watcher_id = -1;
+
+static int
+encoders_watcher(PyDict_WatchEvent event, PyObject *dict, PyObject *key,
+                 PyObject *new_value)
+{
+    if (event != PyDict_EVENT_DEALLOCATED) {
+#ifdef Py_GIL_DISABLED
+        _Py_atomic_add_uint64(&encoders_version, 1);
+#else
+        encoders_version++;
+#endif
+    }
+    return 0;
+}
+
+int
+CBOREncoder_init_watcher(void)
+{
+    if (encoders_watcher_id == -1)
+        encoders_watcher_id = PyDict_AddWatcher(encoders_watcher);
+    return encoders_watcher_id == -1 ? -1 : 0;
+}
+
+static int
+watch_encoders(CBOREncoderObject *self)
+{
+    if (!PyDict_Check(self->encoders))
+        return 0;
+    return PyDict_Watch(encoders_watcher_id, self->encoders);
+}
+
+static inline uint64_t
+get_encoders_version(CBOREncoderObject *self)
+{
+#ifdef Py_GIL_DISABLED
+    return _Py_atomic_load_uint64(&encoders_version);
+#else
+    return encoders_version;
+#endif
+}
+#else
+int
+CBOREncoder_init_watcher(void)
+{
+    return 0;
+}
+
+static int
+watch_encoders(CBOREncoderObject *self)
+{
+    return 0;
+}
+
+static inline uint64_t
+get_encoders_version(CBOREncoderObject *self)
+{
+    return ((PyDictObject *)self->encoders)->ma_version_tag;
+}
+#endif
+
+
+// Common initialization of the encoder's options; also used by dumps() which
+// constructs an encoder without a file-like object (the output is left in the
+// internal buffer instead). tz, default_handler and record_format may be NULL
+// to leave the default in place
+int
+CBOREncoder_init_options(CBOREncoderObject *self, int timestamp_format,
+                         PyObject *tz, int value_sharing,
+                         PyObject *default_handler, int enc_style,
+                         int date_as_datetime, int string_referencing,
+                         PyObject *record_format)
+{
+    PyObject *tmp;
+
+    if (!record_format || record_format == Py_None)
+        self->record_format = 0;
+    else if (PyUnicode_Check(record_format) &&
+            PyUnicode_CompareWithASCIIString(record_format, "map") == 0)
+        self->record_format = 1;
+    else if (PyUnicode_Check(record_format) &&
+            PyUnicode_CompareWithASCIIString(record_format, "array") == 0)
+        self->record_format = 2;
+    else {
+        PyErr_Format(PyExc_ValueError,
+                "invalid record_format value %R (must be 'map', 'array' or "
+                "None)", record_format);
         return -1;
+    }
+
     // Predicate values are returned as ints, but need to be stored as bool or ubyte
     if (timestamp_format == 1)
 	self->timestamp_format = true;
@@ -151,23 +287,15 @@ CBOREncoder_init(CBOREncoderObject *self, PyObject *args, PyObject *kwargs)
         self->string_namespacing = true;
     }
 
-
-    if (_CBOREncoder_set_fp(self, fp, NULL) == -1)
-        return -1;
     if (default_handler && _CBOREncoder_set_default(self, default_handler, NULL) == -1)
         return -1;
     if (tz && _CBOREncoder_set_timezone(self, tz, NULL) == -1)
         return -1;
 
-    self->shared = PyDict_New();
-    if (!self->shared)
-        return -1;
-
-    self->string_references = PyDict_New();
-    if (!self->string_references)
-        return -1;
+    ref_table_clear(&self->shared);
+    ref_table_clear(&self->string_references);
 
-    if (!_CBOR2_default_encoders && init_default_encoders() == -1)
+    if (CBOR2_INIT(_CBOR2_default_encoders, init_default_encoders) == -1)
         return -1;
 
     tmp = self->encoders;
@@ -177,12 +305,16 @@ CBOREncoder_init(CBOREncoderObject *self, PyObject *args, PyObject *kwargs)
     if (!self->encoders)
         return -1;
     if (self->enc_style) {
-        if (!_CBOR2_canonical_encoders && init_canonical_encoders() == -1)
+        if (CBOR2_INIT(_CBOR2_canonical_encoders,
+                       init_canonical_encoders) == -1)
             return -1;
         if (!PyObject_CallMethodObjArgs(self->encoders,
                     _CBOR2_str_update, _CBOR2_canonical_encoders, NULL))
             return -1;
     }
+    dispatch_clear(self);
+    if (watch_encoders(self) == -1)
+        return -1;
 
     return 0;
 }
@@ -198,6 +330,7 @@ _CBOREncoder_get_fp(CBOREncoderObject *self, void *closure)
     if (fp) {
         return fp;
     } else {
+        PyErr_Clear();
         Py_RETURN_NONE;
     }
 }
@@ -225,6 +358,10 @@ _CBOREncoder_set_fp(CBOREncoderObject *self, PyObject *value, void *closure)
     // Still, it is theoretically valid for an object to change its write()
     // method in the middle of a dump. But unless someone actually complains
     // about this I'm loathe to change it...
+    if (fp_flush(self) == -1) {
+        Py_DECREF(write);
+        return -1;
+    }
     tmp = self->write;
     // NOTE: no need to INCREF write here as GetAttr returns a new ref
     self->write = write;
@@ -315,15 +452,225 @@ _CBOREncoder_get_canonical(CBOREncoderObject *self, void *closure)
 }
 
 
+// CBOREncoder._get_collect_stats(self)
+static PyObject *
+_CBOREncoder_get_collect_stats(CBOREncoderObject *self, void *closure)
+{
+    if (self->collect_stats)
+        Py_RETURN_TRUE;
+    else
+        Py_RETURN_FALSE;
+}
+
+
+// CBOREncoder._set_collect_stats(self, value)
+static int
+_CBOREncoder_set_collect_stats(CBOREncoderObject *self, PyObject *value,
+                               void *closure)
+{
+    int enable;
+
+    if (!value) {
+        PyErr_SetString(PyExc_AttributeError,
+                        "cannot delete collect_stats attribute");
+        return -1;
+    }
+    enable = PyObject_IsTrue(value);
+    if (enable == -1)
+        return -1;
+    // Counting starts afresh each time it's enabled
+    memset(&self->stats, 0, sizeof(EncoderStats));
+    self->collect_stats = enable;
+    return 0;
+}
+
+
+// CBOREncoder._get_stats(self)
+static PyObject *
+_CBOREncoder_get_stats(CBOREncoderObject *self, void *closure)
+{
+    EncoderStats *stats = &self->stats;
+
+    if (!self->collect_stats)
+        Py_RETURN_NONE;
+    return Py_BuildValue(
+            "{sn sn sn sn sn sn}",
+            "bytes_written", stats->bytes_written,
+            "write_calls", stats->write_calls,
+            "default_calls", stats->default_calls,
+            "lookup_hits", stats->lookup_hits,
+            "lookup_misses", stats->lookup_misses,
+            "max_depth", stats->max_depth);
+}
+
+
+// CBOREncoder._get_record_format(self)
+static PyObject *
+_CBOREncoder_get_record_format(CBOREncoderObject *self, void *closure)
+{
+    switch (self->record_format) {
+        case 1:
+            return PyUnicode_FromString("map");
+        case 2:
+            return PyUnicode_FromString("array");
+        default:
+            Py_RETURN_NONE;
+    }
+}
+
+
+// Reference tables //////////////////////////////////////////////////////////
+
+// The containers seen for value sharing (and cycle detection) are looked up
+// by identity, and the strings seen for string references by value. Either
+// way the table holds a reference to each key, so that an address can't be
+// reused by another object while it's in the table. Tables use linear
+// probing and are kept at most half full
+
+static inline Py_hash_t
+identity_hash(PyObject *key)
+{
+    // The low bits of an object's address are always zero; the multiplication
+    // spreads the rest over the upper half of the product
+    return (Py_hash_t) (((uint64_t) (uintptr_t) key >> 4) *
+            0x9E3779B97F4A7C15ull >> 32);
+}
+
+
+// Returns the entry for key, or NULL if there is none. Comparing keys by
+// value may raise an exception, in which case NULL is also returned
+static RefEntry *
+ref_table_get(RefTable *table, PyObject *key, Py_hash_t hash, bool by_value)
+{
+    size_t mask = (size_t) table->size - 1, i;
+    RefEntry *entry;
+    int equal;
+
+    if (!table->used)
+        return NULL;
+    for (i = (size_t) hash & mask; ; i = (i + 1) & mask) {
+        entry = &table->entries[i];
+        if (!entry->key)
+            return NULL;
+        if (entry->key == key)
+            return entry;
+        if (by_value && entry->hash == hash) {
+            equal = PyObject_RichCompareBool(entry->key, key, Py_EQ);
+            if (equal)
+                return equal == 1 ? entry : NULL;
+        }
+    }
+}
+
+
+// Places entry in the first free slot from its home slot onwards
+static inline void
+ref_table_place(RefTable *table, RefEntry *entry)
+{
+    size_t mask = (size_t) table->size - 1, i;
+
+    for (i = (size_t) entry->hash & mask; table->entries[i].key;
+            i = (i + 1) & mask);
+    table->entries[i] = *entry;
+}
+
+
+// Adds key, which must not be in the table already
+static int
+ref_table_add(RefTable *table, PyObject *key, Py_hash_t hash,
+              Py_ssize_t index)
+{
+    RefEntry entry = {key, hash, index}, *old_entries = table->entries;
+    Py_ssize_t old_size = table->size, i;
+
+    if ((table->used + 1) * 2 > table->size) {
+        if (table->size > PY_SSIZE_T_MAX / 2 / (Py_ssize_t) sizeof(RefEntry)) {
+            PyErr_NoMemory();
+            return -1;
+        }
+        table->size = table->size ? table->size * 2 : 16;
+        table->entries = PyMem_Calloc(table->size, sizeof(RefEntry));
+        if (!table->entries) {
+            table->entries = old_entries;
+            table->size = old_size;
+            PyErr_NoMemory();
+            return -1;
+        }
+        for (i = 0; i < old_size; i++)
+            if (old_entries[i].key)
+                ref_table_place(table, &old_entries[i]);
+        PyMem_Free(old_entries);
+    }
+    Py_INCREF(key);
+    ref_table_place(table, &entry);
+    table->used++;
+    return 0;
+}
+
+
+// Removes entry (which must belong to table), moving back any entries after
+// it that would otherwise no longer be found
+static void
+ref_table_remove(RefTable *table, RefEntry *entry)
+{
+    size_t mask = (size_t) table->size - 1, i, j, home;
+    PyObject *key = entry->key;
+
+    i = j = (size_t) (entry - table->entries);
+    for (;;) {
+        j = (j + 1) & mask;
+        if (!table->entries[j].key)
+            break;
+        home = (size_t) table->entries[j].hash & mask;
+        // Entry j can fill the gap at i unless its home lies in (i, j]
+        if (i <= j ? (home <= i || home > j) : (home <= i && home > j)) {
+            table->entries[i] = table->entries[j];
+            i = j;
+        }
+    }
+    table->entries[i].key = NULL;
+    table->used--;
+    Py_DECREF(key);
+}
+
+
+static void
+ref_table_clear(RefTable *table)
+{
+    RefEntry *entries = table->entries;
+    Py_ssize_t size = table->size, i;
+
+    // Detach the entries first in case releasing a key runs code that uses
+    // the table
+    table->entries = NULL;
+    table->size = table->used = 0;
+    if (entries) {
+        for (i = 0; i < size; i++)
+            Py_XDECREF(entries[i].key);
+        PyMem_Free(entries);
+    }
+}
+
+
 // Utility methods ///////////////////////////////////////////////////////////
 
+// Output is accumulated in self->buffer and only handed to fp.write() once
+// it exceeds flush_threshold, or when the outermost call to encode() returns
+// (see CBOREncoder_encode). Writes made outside of encode() (e.g. a direct
+// call to encoder.write() or encoder.encode_length()) are passed on
+// immediately. When self->write is None (as in dumps(), or temporarily in
+// encode_to_bytes()) nothing is flushed and the caller collects the buffer
+
 static int
-fp_write(CBOREncoderObject *self, const char *buf, const Py_ssize_t length)
+fp_write_direct(CBOREncoderObject *self, const char *buf,
+                const Py_ssize_t length)
 {
     PyObject *bytes, *ret = NULL;
 
     bytes = PyBytes_FromStringAndSize(buf, length);
     if (bytes) {
+        self->stats.write_calls++;
+        self->stats.bytes_written += length;
         ret = PyObject_CallFunctionObjArgs(self->write, bytes, NULL);
         Py_XDECREF(ret);
         Py_DECREF(bytes);
@@ -332,6 +679,68 @@ fp_write(CBOREncoderObject *self, const char *buf, const Py_ssize_t length)
 }
 
 
+static int
+fp_flush(CBOREncoderObject *self)
+{
+    int ret = 0;
+
+    if (self->buffer_len && self->write != Py_None) {
+        ret = fp_write_direct(self, self->buffer, self->buffer_len);
+        self->buffer_len = 0;
+    }
+    return ret;
+}
+
+
+static int
+buffer_reserve(CBOREncoderObject *self, const Py_ssize_t length)
+{
+    Py_ssize_t new_size;
+    char *new_buffer;
+
+    if (length > PY_SSIZE_T_MAX - self->buffer_len) {
+        PyErr_NoMemory();
+        return -1;
+    }
+    if (self->buffer_len + length > self->buffer_size) {
+        new_size = self->buffer_size ? self->buffer_size : 256;
+        while (new_size < self->buffer_len + length)
+            new_size = new_size <= PY_SSIZE_T_MAX / 2 ?
+                new_size * 2 : self->buffer_len + length;
+        new_buffer = PyMem_Realloc(self->buffer, new_size);
+        if (!new_buffer) {
+            PyErr_NoMemory();
+            return -1;
+        }
+        self->buffer = new_buffer;
+        self->buffer_size = new_size;
+    }
+    return 0;
+}
+
+
+static int
+fp_write(CBOREncoderObject *self, const char *buf, const Py_ssize_t length)
+{
+    bool flushing = self->write != Py_None;
+
+    if (flushing && length >= self->flush_threshold) {
+        // Don't bother copying large fragments into the buffer
+        if (fp_flush(self) == -1)
+            return -1;
+        return fp_write_direct(self, buf, length);
+    }
+    if (buffer_reserve(self, length) == -1)
+        return -1;
+    memcpy(self->buffer + self->buffer_len, buf, length);
+    self->buffer_len += length;
+    if (flushing && (self->encode_depth == 0 ||
+                self->buffer_len >= self->flush_threshold))
+        return fp_flush(self);
+    return 0;
+}
+
+
 // CBOREncoder.write(self, data)
 static PyObject *
 CBOREncoder_write(CBOREncoderObject *self, PyObject *data)
@@ -451,21 +860,21 @@ replace_deferred(CBOREncoderObject *self, PyObject *item)
 static int
 stringref(CBOREncoderObject *self, PyObject *value)
 {
-    PyObject *index, *ret = NULL;
+    RefEntry *entry;
+    Py_hash_t hash;
     int retcode = -1;
 
-    index = PyDict_GetItem(self->string_references, value);
-    if (index) {
-        if (encode_length(self, 6, 25) == 0) {
-            ret = CBOREncoder_encode_int(self, index);
-            if (ret) {
-                Py_DECREF(ret);
-                retcode = 1;
-            }
-        }
-    } else {
+    hash = PyObject_Hash(value);
+    if (hash == -1)
+        return -1;
+    entry = ref_table_get(&self->string_references, value, hash, true);
+    if (entry) {
+        if (encode_length(self, 6, 25) == 0 &&
+                encode_length(self, 0, entry->index) == 0)
+            retcode = 1;
+    } else if (!PyErr_Occurred()) {
         uint64_t length = PyObject_Length(value);
-        uint64_t next_index = PyDict_Size(self->string_references);
+        uint64_t next_index = self->string_references.used;
 
         bool is_referenced = true;
         if (next_index < 24) {
@@ -481,8 +890,8 @@ stringref(CBOREncoderObject *self, PyObject *value)
         }
 
         if (is_referenced) {
-            index = PyLong_FromLongLong(next_index);
-            if (index && PyDict_SetItem(self->string_references, value, index) == 0)
+            if (ref_table_add(&self->string_references, value, hash,
+                              (Py_ssize_t) next_index) == 0)
                 retcode = 0;
         } else {
             retcode = 0;
@@ -552,69 +961,348 @@ CBOREncoder_find_encoder(CBOREncoderObject *self, PyObject *type)
 }
 
 
-// Major encoders ////////////////////////////////////////////////////////////
+// Type dispatch cache ///////////////////////////////////////////////////////
 
-static PyObject *
-encode_negative_int(PyObject *value)
+// Every miss in self->encoders costs a subclass check against each entry, so
+// the result of find_encoder (including None for types that end up with the
+// default handler) is cached natively, keyed by type. The cache is an open
+// addressed hash table which is emptied whenever self->encoders is modified
+// or the table fills up
+
+static inline size_t
+dispatch_slot(PyTypeObject *type)
 {
-    PyObject *neg, *one, *ret = NULL;
+    // type objects are at least 16-byte aligned; skip the constant low bits
+    return ((uintptr_t) type >> 4) & (DISPATCH_CACHE_SIZE - 1);
+}
 
-    // return -value - 1
-    one = PyLong_FromLong(1);
-    if (one) {
-        neg = PyNumber_Negative(value);
-        if (neg) {
-            ret = PyNumber_Subtract(neg, one);
-            Py_DECREF(neg);
+static void
+dispatch_clear(CBOREncoderObject *self)
+{
+    if (self->dispatch_used) {
+        for (int i = 0; i < DISPATCH_CACHE_SIZE; i++) {
+            Py_CLEAR(self->dispatch[i].type);
+            Py_CLEAR(self->dispatch[i].encoder);
+            Py_CLEAR(self->dispatch[i].fields);
         }
-        Py_DECREF(one);
+        self->dispatch_used = 0;
     }
-    return ret;
 }
 
+// Works out whether type is one of those encoded natively under record_format
+// (dataclasses, named tuples and enums). Returns 1 and sets *fields to a new
+// reference to the names of the fields to encode, in order (None for enums),
+// 0 if type isn't a record type or -1 on error
+static int
+find_record(CBOREncoderObject *self, PyTypeObject *type, PyObject **fields)
+{
+    PyObject *names = NULL, *obj, *list, *name, *bytes, *tuple;
+    Py_ssize_t i, length;
+    bool string_referencing_old;
+    int ret = 0;
+
+    // An encoder registered for exactly this type takes precedence
+    if (self->encoders != Py_None &&
+            PyDict_GetItemWithError(self->encoders, (PyObject *) type))
+        return 0;
+    if (PyErr_Occurred())
+        return -1;
 
-static PyObject *
-encode_larger_int(CBOREncoderObject *self, PyObject *value)
-{
-    PyObject *zero, *bits, *buf, *tmp, *ret = NULL;
-    uint8_t major_tag;
-    unsigned long long val;
+    if (CBOR2_INIT(_CBOR2_Enum, _CBOR2_init_Enum) == -1)
+        return -1;
+    switch (PyObject_IsSubclass((PyObject *) type, _CBOR2_Enum)) {
+        case 1:
+            Py_INCREF(Py_None);
+            *fields = Py_None;
+            return 1;
+        case -1:
+            return -1;
+    }
 
-    zero = PyLong_FromLong(0);
-    if (zero) {
-        major_tag = 0;
-        // This isn't strictly required for the positive case, but ensuring
-        // value is a new (instead of "borrowed") reference simplifies the
-        // ref counting later
-        Py_INCREF(value);
-        switch (PyObject_RichCompareBool(value, zero, Py_LT)) {
-            case 1:
-                major_tag = 1;
-                tmp = encode_negative_int(value);
-                Py_DECREF(value);
-                value = tmp;
-                // fall-thru to positive case
-            case 0:
-                val = PyLong_AsUnsignedLongLong(value);
-                if (!PyErr_Occurred()) {
-                    if (encode_length(self, major_tag, val) == 0) {
-                        Py_INCREF(Py_None);
-                        ret = Py_None;
-                        break;
+    if (PyType_IsSubtype(type, &PyTuple_Type)) {
+        // namedtuple(...) classes list their fields in _fields
+        obj = PyObject_GetAttr((PyObject *) type, _CBOR2_str__fields);
+        if (obj && PyTuple_Check(obj))
+            names = obj;
+        else if (obj)
+            Py_DECREF(obj);
+        else if (PyErr_ExceptionMatches(PyExc_AttributeError))
+            PyErr_Clear();
+        else
+            return -1;
+    } else {
+        // names = tuple(field.name for field in dataclasses.fields(type))
+        obj = PyObject_GetAttr((PyObject *) type,
+                               _CBOR2_str___dataclass_fields__);
+        if (obj) {
+            Py_DECREF(obj);
+            if (CBOR2_INIT(_CBOR2_dataclass_fields,
+                           _CBOR2_init_dataclass_fields) == -1)
+                return -1;
+            obj = PyObject_CallFunctionObjArgs(
+                    _CBOR2_dataclass_fields, type, NULL);
+            if (!obj)
+                return -1;
+            if (PyTuple_Check(obj)) {
+                length = PyTuple_GET_SIZE(obj);
+                names = PyTuple_New(length);
+                for (i = 0; names && i < length; i++) {
+                    name = PyObject_GetAttr(PyTuple_GET_ITEM(obj, i),
+                                            _CBOR2_str_name);
+                    if (name)
+                        PyTuple_SET_ITEM(names, i, name);  // steals ref
+                    else
+                        Py_CLEAR(names);
+                }
+            } else
+                PyErr_SetString(PyExc_TypeError,
+                        "dataclasses.fields() did not return a tuple");
+            Py_DECREF(obj);
+            if (!names)
+                return -1;
+        } else if (PyErr_ExceptionMatches(PyExc_AttributeError))
+            PyErr_Clear();
+        else
+            return -1;
+    }
+    if (!names)
+        return 0;
+
+    if (self->enc_style == 1 && self->record_format == 1) {
+        // Sort the field names into canonical key order once, rather than for
+        // every instance
+        ret = -1;
+        length = PyTuple_GET_SIZE(names);
+        list = PyList_New(length);
+        if (list) {
+            string_referencing_old = self->string_referencing;
+            self->string_referencing = false;
+            for (i = 0; i < length; i++) {
+                name = PyTuple_GET_ITEM(names, i);
+                bytes = CBOREncoder_encode_to_bytes(self, name);
+                if (!bytes)
+                    break;
+                tuple = Py_BuildValue("(nNO)", PyBytes_GET_SIZE(bytes),
+                                      bytes, name);
+                if (!tuple)
+                    break;
+                PyList_SET_ITEM(list, i, tuple);  // steals ref
+            }
+            self->string_referencing = string_referencing_old;
+            if (i == length && PyList_Sort(list) == 0) {
+                // names may be the type's own _fields so a new tuple is built
+                // rather than sorting it in place
+                obj = PyTuple_New(length);
+                if (obj) {
+                    for (i = 0; i < length; i++) {
+                        name = PyTuple_GET_ITEM(PyList_GET_ITEM(list, i), 2);
+                        Py_INCREF(name);
+                        PyTuple_SET_ITEM(obj, i, name);
                     }
+                    ret = 0;
                 }
-                // fall-thru to error case
-            case -1:
-                // if error is overflow encode a big-num
-                if (PyErr_ExceptionMatches(PyExc_OverflowError)) {
-                    PyErr_Clear();
-                    major_tag += 2;
-                    bits = PyObject_CallMethodObjArgs(
-                            value, _CBOR2_str_bit_length, NULL);
-                    if (bits) {
-                        long length = PyLong_AsLong(bits);
-                        if (!PyErr_Occurred()) {
-                            buf = PyObject_CallMethod(
+            }
+            Py_DECREF(list);
+        }
+        Py_DECREF(names);
+        if (ret == -1)
+            return -1;
+        names = obj;
+    }
+    *fields = names;
+    return 1;
+}
+
+static void
+dispatch_store(CBOREncoderObject *self, PyTypeObject *type, PyObject *encoder,
+               PyObject *fields)
+{
+    uint64_t version = get_encoders_version(self);
+    size_t i;
+
+    if (self->dispatch_version != version ||
+            self->dispatch_used >= DISPATCH_CACHE_SIZE * 3 / 4) {
+        dispatch_clear(self);
+        self->dispatch_version = version;
+    }
+    for (i = dispatch_slot(type); self->dispatch[i].type;
+            i = (i + 1) & (DISPATCH_CACHE_SIZE - 1))
+        if (self->dispatch[i].type == type)
+            return;
+    Py_INCREF(type);
+    self->dispatch[i].type = type;
+    Py_XINCREF(encoder);
+    self->dispatch[i].encoder = encoder;
+    Py_XINCREF(fields);
+    self->dispatch[i].fields = fields;
+    self->dispatch_used++;
+}
+
+// Looks up how to encode instances of type. Returns 0 and sets *encoder to a
+// new reference to the encoder (None if there is none) or, for types encoded
+// natively under record_format, sets *encoder to NULL and *fields to a new
+// reference to the field names (see find_record). Returns -1 on error
+static int
+dispatch_lookup(CBOREncoderObject *self, PyTypeObject *type,
+                PyObject **encoder, PyObject **fields)
+{
+    size_t i;
+    int found = 0;
+
+    *encoder = *fields = NULL;
+    if (PyDict_Check(self->encoders)) {
+        if (self->dispatch_version == get_encoders_version(self)) {
+            for (i = dispatch_slot(type); self->dispatch[i].type;
+                    i = (i + 1) & (DISPATCH_CACHE_SIZE - 1))
+                if (self->dispatch[i].type == type) {
+                    self->stats.lookup_hits++;
+                    *encoder = self->dispatch[i].encoder;
+                    *fields = self->dispatch[i].fields;
+                    Py_XINCREF(*encoder);
+                    Py_XINCREF(*fields);
+                    return 0;
+                }
+        }
+        if (self->record_format)
+            found = find_record(self, type, fields);
+    }
+    self->stats.lookup_misses++;
+    if (found == 0)
+        *encoder = CBOREncoder_find_encoder(self, (PyObject *) type);
+    if (found == -1 || !(*encoder || *fields))
+        return -1;
+    // Resolving the type may have modified self->encoders (or, via
+    // __subclasscheck__, anything else) so the version is only read once it
+    // has finished
+    if (PyDict_Check(self->encoders))
+        dispatch_store(self, type, *encoder, *fields);
+    return 0;
+}
+
+
+// Record encoders ///////////////////////////////////////////////////////////
+
+static PyObject *
+encode_record(CBOREncoderObject *self, PyObject *value)
+{
+    PyObject *encoder, *fields, *name, *item, *ret = NULL;
+    Py_ssize_t i, length;
+
+    // The layout was cached by the dispatch in encode() just before this
+    if (dispatch_lookup(self, Py_TYPE(value), &encoder, &fields) == -1)
+        return NULL;
+    Py_XDECREF(encoder);
+    if (!fields || fields == Py_None) {
+        Py_XDECREF(fields);
+        PyErr_Format(PyExc_RuntimeError,
+                "encoders modified while encoding %R",
+                (PyObject *) Py_TYPE(value));
+        return NULL;
+    }
+
+    length = PyTuple_GET_SIZE(fields);
+    if (encode_length(self, self->record_format == 1 ? 5 : 4, length) == 0) {
+        Py_INCREF(Py_None);
+        ret = Py_None;
+        for (i = 0; ret && i < length; i++) {
+            name = PyTuple_GET_ITEM(fields, i);
+            if (self->record_format == 1) {
+                Py_DECREF(ret);
+                ret = CBOREncoder_encode_string(self, name);
+                if (!ret)
+                    break;
+            }
+            Py_DECREF(ret);
+            ret = NULL;
+            item = PyObject_GetAttr(value, name);
+            if (item) {
+                ret = CBOREncoder_encode(self, item);
+                Py_DECREF(item);
+            }
+        }
+    }
+    Py_DECREF(fields);
+    return ret;
+}
+
+
+static PyObject *
+encode_enum(CBOREncoderObject *self, PyObject *value)
+{
+    PyObject *obj, *ret = NULL;
+
+    obj = PyObject_GetAttr(value, _CBOR2_str_value);
+    if (obj) {
+        ret = CBOREncoder_encode(self, obj);
+        Py_DECREF(obj);
+    }
+    return ret;
+}
+
+
+// Major encoders ////////////////////////////////////////////////////////////
+
+static PyObject *
+encode_negative_int(PyObject *value)
+{
+    PyObject *neg, *one, *ret = NULL;
+
+    // return -value - 1
+    one = PyLong_FromLong(1);
+    if (one) {
+        neg = PyNumber_Negative(value);
+        if (neg) {
+            ret = PyNumber_Subtract(neg, one);
+            Py_DECREF(neg);
+        }
+        Py_DECREF(one);
+    }
+    return ret;
+}
+
+
+static PyObject *
+encode_larger_int(CBOREncoderObject *self, PyObject *value)
+{
+    PyObject *zero, *bits, *buf, *tmp, *ret = NULL;
+    uint8_t major_tag;
+    unsigned long long val;
+
+    zero = PyLong_FromLong(0);
+    if (zero) {
+        major_tag = 0;
+        // This isn't strictly required for the positive case, but ensuring
+        // value is a new (instead of "borrowed") reference simplifies the
+        // ref counting later
+        Py_INCREF(value);
+        switch (PyObject_RichCompareBool(value, zero, Py_LT)) {
+            case 1:
+                major_tag = 1;
+                tmp = encode_negative_int(value);
+                Py_DECREF(value);
+                value = tmp;
+                // fall-thru to positive case
+            case 0:
+                val = PyLong_AsUnsignedLongLong(value);
+                if (!PyErr_Occurred()) {
+                    if (encode_length(self, major_tag, val) == 0) {
+                        Py_INCREF(Py_None);
+                        ret = Py_None;
+                        break;
+                    }
+                }
+                // fall-thru to error case
+            case -1:
+                // if error is overflow encode a big-num
+                if (PyErr_ExceptionMatches(PyExc_OverflowError)) {
+                    PyErr_Clear();
+                    major_tag += 2;
+                    bits = PyObject_CallMethodObjArgs(
+                            value, _CBOR2_str_bit_length, NULL);
+                    if (bits) {
+                        long length = PyLong_AsLong(bits);
+                        if (!PyErr_Occurred()) {
+                            buf = PyObject_CallMethod(
                                     value, "to_bytes", "ls",
                                     (length + 7) / 8, "big");
                             if (buf) {
@@ -755,7 +1443,7 @@ static PyObject *
 encode_array(CBOREncoderObject *self, PyObject *value)
 {
     PyObject **items, *fast, *ret = NULL;
-    Py_ssize_t length;
+    Py_ssize_t length, run;
 
     fast = PySequence_Fast(value, "argument must be iterable");
     if (fast) {
@@ -763,6 +1451,17 @@ encode_array(CBOREncoderObject *self, PyObject *value)
         items = PySequence_Fast_ITEMS(fast);
         if (encode_length(self, 4, length) == 0) {
             while (length) {
+                if (self->enc_style == 1 && PyFloat_CheckExact(*items)) {
+                    // Canonical floats are sized up a run at a time
+                    for (run = 1; run < length; run++)
+                        if (!PyFloat_CheckExact(items[run]))
+                            break;
+                    if (encode_minimal_floats(self, items, run) == -1)
+                        goto error;
+                    items += run;
+                    length -= run;
+                    continue;
+                }
                 ret = CBOREncoder_encode(self, *items);
                 if (ret)
                     Py_DECREF(ret);
@@ -876,6 +1575,40 @@ CBOREncoder_encode_map(CBOREncoderObject *self, PyObject *value)
 }
 
 
+static PyObject *
+encode_indefinite_array(CBOREncoderObject *self, PyObject *value)
+{
+    PyObject *iter, *item, *ret;
+
+    iter = PyObject_GetIter(value);
+    if (!iter)
+        return NULL;
+    ret = NULL;
+    if (fp_write(self, "\x9f", 1) == 0) {
+        Py_INCREF(Py_None);
+        ret = Py_None;
+        while (ret && (item = PyIter_Next(iter))) {
+            Py_DECREF(ret);
+            ret = CBOREncoder_encode(self, item);
+            Py_DECREF(item);
+        }
+        if (ret && (PyErr_Occurred() || fp_write(self, "\xff", 1) == -1))
+            Py_CLEAR(ret);
+    }
+    Py_DECREF(iter);
+    return ret;
+}
+
+
+// CBOREncoder.encode_indefinite_array(self, value)
+static PyObject *
+CBOREncoder_encode_indefinite_array(CBOREncoderObject *self, PyObject *value)
+{
+    // major type 4, with a break marker instead of a length
+    return encode_container(self, &encode_indefinite_array, value);
+}
+
+
 // Semantic encoders /////////////////////////////////////////////////////////
 
 static int
@@ -898,20 +1631,18 @@ CBOREncoder_encode_semantic(CBOREncoderObject *self, PyObject *value)
     // major type 6
     CBORTagObject *tag;
     PyObject *ret = NULL;
-    PyObject *old_string_references = self->string_references;
-    bool old_string_referencing = self->string_referencing;
-
+    RefTable old_string_references = self->string_references;
+    bool old_string_referencing = self->string_referencing, new_namespace;
 
     if (!CBORTag_CheckExact(value))
         return NULL;
 
     tag = (CBORTagObject *) value;
-    if (tag->tag == 256) {
-        PyObject *string_references = PyDict_New();
-        if (!string_references)
-            return NULL;
+    new_namespace = tag->tag == 256;
+    if (new_namespace) {
+        // Start an empty table for the new namespace
         self->string_referencing = true;
-        self->string_references = string_references;
+        memset(&self->string_references, 0, sizeof(RefTable));
     }
 
     if (encode_semantic(self, tag->tag, tag->value) == 0) {
@@ -919,17 +1650,170 @@ CBOREncoder_encode_semantic(CBOREncoderObject *self, PyObject *value)
         ret = Py_None;
     }
 
-    if (self->string_references != old_string_references) {
-        Py_DECREF(self->string_references);
+    if (new_namespace) {
+        ref_table_clear(&self->string_references);
+        self->string_references = old_string_references;
     }
-
-    self->string_references = old_string_references;
     self->string_referencing = old_string_referencing;
 
     return ret;
 }
 
 
+// Writes the *width* lowest decimal digits of *value* to *buf*, zero padded,
+// and returns a pointer just past them
+static inline char *
+format_digits(char *buf, unsigned int value, int width)
+{
+    for (int i = width - 1; i >= 0; i--) {
+        buf[i] = '0' + value % 10;
+        value /= 10;
+    }
+    return buf + width;
+}
+
+
+// Returns the number of days from 1970-01-01 to the given date of the
+// proleptic Gregorian calendar; years run from 1 to 9999
+static int64_t
+days_from_civil(int year, int month, int day)
+{
+    int64_t era, year_of_era, day_of_year, day_of_era;
+
+    // count from March so the leap day falls at the end of each year
+    year -= month <= 2;
+    era = year / 400;
+    year_of_era = year - era * 400;
+    day_of_year = (153 * (month > 2 ? month - 3 : month + 9) + 2) / 5 + day - 1;
+    day_of_era = year_of_era * 365 + year_of_era / 4 - year_of_era / 100 +
+        day_of_year;
+    return era * 146097 + day_of_era - 719468;
+}
+
+
+// Stores the UTC offset of the aware datetime *value* in *offset*, in seconds.
+// Returns 0 on success, 1 if the offset can't be handled here (it isn't a
+// timedelta within a day, or has microseconds) so the caller should defer to
+// the datetime's own methods, or -1 on error
+static int
+datetime_offset(PyObject *value, int *offset)
+{
+    PyObject *tzinfo, *delta;
+    int ret = 1;
+
+    tzinfo = ((PyDateTime_DateTime*)value)->tzinfo;
+    if (tzinfo == PyDateTime_TimeZone_UTC) {
+        *offset = 0;
+        return 0;
+    }
+    delta = PyObject_CallMethodObjArgs(tzinfo, _CBOR2_str_utcoffset, value, NULL);
+    if (!delta)
+        return -1;
+    if (PyDelta_Check(delta) && PyDateTime_DELTA_GET_MICROSECONDS(delta) == 0
+            && (PyDateTime_DELTA_GET_DAYS(delta) == 0 || (
+                PyDateTime_DELTA_GET_DAYS(delta) == -1 &&
+                PyDateTime_DELTA_GET_SECONDS(delta) > 0))) {
+        *offset = PyDateTime_DELTA_GET_DAYS(delta) * 86400 +
+            PyDateTime_DELTA_GET_SECONDS(delta);
+        ret = 0;
+    }
+    Py_DECREF(delta);
+    return ret;
+}
+
+
+// Writes *value* as an RFC 3339 string (with semantic tag 0) that matches its
+// isoformat(), but with "Z" in place of a zero offset
+static int
+encode_datetime_string(CBOREncoderObject *self, PyObject *value, int offset)
+{
+    char buf[32], *p = buf;
+    int microsecond;
+
+    p = format_digits(p, PyDateTime_GET_YEAR(value), 4);
+    *p++ = '-';
+    p = format_digits(p, PyDateTime_GET_MONTH(value), 2);
+    *p++ = '-';
+    p = format_digits(p, PyDateTime_GET_DAY(value), 2);
+    *p++ = 'T';
+    p = format_digits(p, PyDateTime_DATE_GET_HOUR(value), 2);
+    *p++ = ':';
+    p = format_digits(p, PyDateTime_DATE_GET_MINUTE(value), 2);
+    *p++ = ':';
+    p = format_digits(p, PyDateTime_DATE_GET_SECOND(value), 2);
+    microsecond = PyDateTime_DATE_GET_MICROSECOND(value);
+    if (microsecond) {
+        *p++ = '.';
+        p = format_digits(p, microsecond, 6);
+    }
+    if (offset == 0)
+        *p++ = 'Z';
+    else {
+        if (offset < 0) {
+            *p++ = '-';
+            offset = -offset;
+        } else
+            *p++ = '+';
+        p = format_digits(p, offset / 3600, 2);
+        *p++ = ':';
+        p = format_digits(p, offset / 60 % 60, 2);
+    }
+    if (fp_write(self, "\xC0", 1) == -1)
+        return -1;
+    if (encode_length(self, 3, p - buf) == -1)
+        return -1;
+    return fp_write(self, buf, p - buf);
+}
+
+
+// Writes *value* as a UNIX timestamp (with semantic tag 1) equal to its
+// timestamp(). Returns 0 on success, 1 if the result would need more precision
+// than a double has to spare so the caller should use timestamp() itself, or
+// -1 on error
+static int
+encode_datetime_timestamp(CBOREncoderObject *self, PyObject *value, int offset)
+{
+    PyObject *timestamp, *tmp;
+    int64_t seconds, microseconds;
+    int ret;
+
+    seconds = days_from_civil(
+            PyDateTime_GET_YEAR(value),
+            PyDateTime_GET_MONTH(value),
+            PyDateTime_GET_DAY(value)) * 86400 +
+        PyDateTime_DATE_GET_HOUR(value) * 3600 +
+        PyDateTime_DATE_GET_MINUTE(value) * 60 +
+        PyDateTime_DATE_GET_SECOND(value) - offset;
+    microseconds = PyDateTime_DATE_GET_MICROSECOND(value);
+    if (microseconds) {
+        // timestamp() divides the exact number of microseconds by a million,
+        // rounding once; the same division of doubles agrees as long as
+        // converting the microseconds to a double is exact
+        microseconds += seconds * 1000000;
+        if (microseconds > (INT64_C(1) << 53) || microseconds < -(INT64_C(1) << 53))
+            return 1;
+        timestamp = PyFloat_FromDouble((double)microseconds / 1000000.0);
+        if (!timestamp)
+            return -1;
+        ret = -1;
+        if (fp_write(self, "\xC1", 1) == 0) {
+            tmp = CBOREncoder_encode_float(self, timestamp);
+            if (tmp) {
+                Py_DECREF(tmp);
+                ret = 0;
+            }
+        }
+        Py_DECREF(timestamp);
+        return ret;
+    }
+    if (fp_write(self, "\xC1", 1) == -1)
+        return -1;
+    if (seconds >= 0)
+        return encode_length(self, 0, seconds);
+    return encode_length(self, 1, -(seconds + 1));
+}
+
+
 static PyObject *
 encode_datestr(CBOREncoderObject *self, PyObject *datestr)
 {
@@ -987,6 +1871,7 @@ CBOREncoder_encode_datetime(CBOREncoderObject *self, PyObject *value)
 {
     // semantic type 0 or 1
     PyObject *tmp, *ret = NULL;
+    int status, offset;
 
     if (PyDateTime_Check(value)) {
         if (!((PyDateTime_DateTime*)value)->hastzinfo) {
@@ -1014,18 +1899,36 @@ CBOREncoder_encode_datetime(CBOREncoderObject *self, PyObject *value)
         }
 
         if (value) {
-            if (self->timestamp_format) {
-                tmp = PyObject_CallMethodObjArgs(
-                        value, _CBOR2_str_timestamp, NULL);
-                if (tmp)
-                    ret = encode_timestamp(self, tmp);
-            } else {
-                tmp = PyObject_CallMethodObjArgs(
-                        value, _CBOR2_str_isoformat, NULL);
-                if (tmp)
-                    ret = encode_datestr(self, tmp);
+            // work from the fields unless a subclass might have overridden
+            // isoformat() or timestamp()
+            status = 1;
+            if (PyDateTime_CheckExact(value))
+                status = datetime_offset(value, &offset);
+            if (status == 0) {
+                if (self->timestamp_format)
+                    status = encode_datetime_timestamp(self, value, offset);
+                else if (offset % 60 == 0)
+                    status = encode_datetime_string(self, value, offset);
+                else
+                    status = 1;
+            }
+            if (status == 0) {
+                Py_INCREF(Py_None);
+                ret = Py_None;
+            } else if (status == 1) {
+                if (self->timestamp_format) {
+                    tmp = PyObject_CallMethodObjArgs(
+                            value, _CBOR2_str_timestamp, NULL);
+                    if (tmp)
+                        ret = encode_timestamp(self, tmp);
+                } else {
+                    tmp = PyObject_CallMethodObjArgs(
+                            value, _CBOR2_str_isoformat, NULL);
+                    if (tmp)
+                        ret = encode_datestr(self, tmp);
+                }
+                Py_XDECREF(tmp);
             }
-            Py_XDECREF(tmp);
             Py_DECREF(value);
         }
     }
@@ -1039,7 +1942,10 @@ CBOREncoder_encode_date(CBOREncoderObject *self, PyObject *value)
 {
     // semantic type 100 or 1004
 
-    PyObject *tmp, *ret = NULL;
+    PyObject *tmp = NULL, *ordinal, *ret = NULL;
+    int64_t days;
+    char buf[10], *p;
+
     if (self->date_as_datetime) {
         tmp = PyDateTimeAPI->DateTime_FromDateAndTime(
                 PyDateTime_GET_YEAR(value),
@@ -1051,11 +1957,39 @@ CBOREncoder_encode_date(CBOREncoderObject *self, PyObject *value)
             ret = CBOREncoder_encode_datetime(self, tmp);
     }
     else if (self->timestamp_format) {
+        if (PyDate_CheckExact(value)) {
+            days = days_from_civil(
+                    PyDateTime_GET_YEAR(value),
+                    PyDateTime_GET_MONTH(value),
+                    PyDateTime_GET_DAY(value));
+            if (fp_write(self, "\xD8\x64", 2) == -1)
+                return NULL;
+            if (encode_length(self, days < 0, days < 0 ? -(days + 1) : days) == -1)
+                return NULL;
+            Py_RETURN_NONE;
+        }
         tmp = PyObject_CallMethodObjArgs(
                 value, _CBOR2_str_toordinal, NULL);
         if (tmp && fp_write(self, "\xD8\x64", 2) == 0) {
-            ret = CBOREncoder_encode_int(self, PyNumber_Subtract(tmp, _CBOR2_date_ordinal_offset));
+            ordinal = PyNumber_Subtract(tmp, _CBOR2_date_ordinal_offset);
+            if (ordinal) {
+                ret = CBOREncoder_encode_int(self, ordinal);
+                Py_DECREF(ordinal);
+            }
         }
+    } else if (PyDate_CheckExact(value)) {
+        p = format_digits(buf, PyDateTime_GET_YEAR(value), 4);
+        *p++ = '-';
+        p = format_digits(p, PyDateTime_GET_MONTH(value), 2);
+        *p++ = '-';
+        p = format_digits(p, PyDateTime_GET_DAY(value), 2);
+        if (fp_write(self, "\xD9\x03\xEC", 3) == -1)
+            return NULL;
+        if (encode_length(self, 3, p - buf) == -1)
+            return NULL;
+        if (fp_write(self, buf, p - buf) == -1)
+            return NULL;
+        Py_RETURN_NONE;
     } else {
         tmp = PyObject_CallMethodObjArgs(
                 value, _CBOR2_str_isoformat, NULL);
@@ -1237,47 +2171,36 @@ static PyObject *
 encode_shared(CBOREncoderObject *self, EncodeFunction *encoder,
               PyObject *value)
 {
-    PyObject *id, *index, *tuple, *ret = NULL;
+    RefEntry *entry;
+    Py_hash_t hash = identity_hash(value);
+    PyObject *ret = NULL;
 
-    id = PyLong_FromVoidPtr(value);
-    if (id) {
-        tuple = PyDict_GetItem(self->shared, id);
-        if (self->value_sharing) {
-            if (tuple) {
-                if (encode_length(self, 6, 29) == 0)
-                    ret = CBOREncoder_encode_int(
-                            self, PyTuple_GET_ITEM(tuple, 1));
-            } else {
-                index = PyLong_FromSsize_t(PyDict_Size(self->shared));
-                if (index) {
-                    tuple = PyTuple_Pack(2, value, index);
-                    if (tuple) {
-                        if (PyDict_SetItem(self->shared, id, tuple) == 0)
-                            if (encode_length(self, 6, 28) == 0)
-                                ret = encoder(self, value);
-                        Py_DECREF(tuple);
-                    }
-                    Py_DECREF(index);
-                }
-            }
-        } else {
-            if (tuple) {
-                PyErr_SetString(
-                    _CBOR2_CBOREncodeValueError,
-                    "cyclic data structure detected but value sharing is "
-                    "disabled");
-            } else {
-                tuple = PyTuple_Pack(2, value, Py_None);
-                if (tuple) {
-                    if (PyDict_SetItem(self->shared, id, tuple) == 0) {
-                        ret = encoder(self, value);
-                        PyDict_DelItem(self->shared, id);
-                    }
-                    Py_DECREF(tuple);
-                }
+    entry = ref_table_get(&self->shared, value, hash, false);
+    if (self->value_sharing) {
+        if (entry) {
+            if (encode_length(self, 6, 29) == 0 &&
+                    encode_length(self, 0, entry->index) == 0) {
+                Py_INCREF(Py_None);
+                ret = Py_None;
             }
+        } else if (ref_table_add(&self->shared, value, hash,
+                                 self->shared.used) == 0) {
+            if (encode_length(self, 6, 28) == 0)
+                ret = encoder(self, value);
+        }
+    } else {
+        if (entry) {
+            PyErr_SetString(
+                _CBOR2_CBOREncodeValueError,
+                "cyclic data structure detected but value sharing is "
+                "disabled");
+        } else if (ref_table_add(&self->shared, value, hash, -1) == 0) {
+            ret = encoder(self, value);
+            // The table may have been resized meanwhile
+            entry = ref_table_get(&self->shared, value, hash, false);
+            if (entry)
+                ref_table_remove(&self->shared, entry);
         }
-        Py_DECREF(id);
     }
     return ret;
 }
@@ -1548,6 +2471,109 @@ CBOREncoder_encode_ipnetwork(CBOREncoderObject *self, PyObject *value)
 }
 
 
+// Returns the RFC 8746 typed array tag for elements with the given struct
+// format and size in native byte order, or 0 if there isn't one
+static uint64_t
+typed_array_tag(const char *format, Py_ssize_t itemsize)
+{
+    uint64_t little = PY_BIG_ENDIAN ? 0 : 4, log2size;
+
+    if (format[0] == '@')
+        format++;
+    if (!format[0] || format[1])
+        return 0;
+    switch (itemsize) {
+        case 1: log2size = 0; little = 0; break;
+        case 2: log2size = 1; break;
+        case 4: log2size = 2; break;
+        case 8: log2size = 3; break;
+        default: return 0;
+    }
+    if (strchr("bhilqn", format[0]))
+        return 72 | little | log2size;
+    if (strchr("BHILQN", format[0]))
+        return 64 | little | log2size;
+    if (strchr("efd", format[0]) && itemsize > 1)
+        return 80 | little | (log2size - 1);
+    return 0;
+}
+
+
+static PyObject *
+encode_typed_array(CBOREncoderObject *self, PyObject *value)
+{
+    Py_buffer view;
+    uint64_t tag;
+    PyObject *ret = NULL;
+
+    if (PyObject_GetBuffer(value, &view, PyBUF_FORMAT | PyBUF_STRIDES) == -1)
+        return NULL;
+    tag = typed_array_tag(view.format ? view.format : "B", view.itemsize);
+    if (view.ndim != 1 || !PyBuffer_IsContiguous(&view, 'C'))
+        PyErr_SetString(_CBOR2_CBOREncodeValueError,
+                        "typed arrays must be one-dimensional and contiguous");
+    else if (!tag)
+        PyErr_Format(_CBOR2_CBOREncodeValueError,
+                     "cannot encode '%s' elements as a typed array",
+                     view.format ? view.format : "B");
+    else if (encode_length(self, 6, tag) == 0 &&
+            encode_length(self, 2, view.len) == 0 &&
+            fp_write(self, view.buf, view.len) == 0) {
+        Py_INCREF(Py_None);
+        ret = Py_None;
+    }
+    PyBuffer_Release(&view);
+    return ret;
+}
+
+
+// CBOREncoder.encode_typed_array(self, value)
+static PyObject *
+CBOREncoder_encode_typed_array(CBOREncoderObject *self, PyObject *value)
+{
+    // semantic types 64-87
+    return encode_container(self, &encode_typed_array, value);
+}
+
+
+// CBOREncoder.encode_memoryview(self, value)
+static PyObject *
+CBOREncoder_encode_memoryview(CBOREncoderObject *self, PyObject *value)
+{
+    // major type 2, or semantic types 64-87
+    Py_buffer view;
+    const char *format;
+    PyObject *bytes, *ret = NULL;
+
+    if (PyObject_GetBuffer(value, &view, PyBUF_FORMAT | PyBUF_STRIDES) == -1)
+        return NULL;
+    format = view.format ? view.format : "B";
+    if (format[0] == '@')
+        format++;
+    if (view.ndim != 1 || !PyBuffer_IsContiguous(&view, 'C') ||
+            !format[0] || format[1] || !strchr("Bbc", format[0])) {
+        // views of wider elements (or in other layouts) are typed arrays
+        PyBuffer_Release(&view);
+        return CBOREncoder_encode_typed_array(self, value);
+    }
+    // views of single bytes, such as the bytestrings decoded with
+    // memoryview_size, are bytestrings so that they survive a round trip
+    if (self->string_referencing) {
+        bytes = PyBytes_FromStringAndSize(view.buf, view.len);
+        if (bytes) {
+            ret = CBOREncoder_encode_bytestring(self, bytes);
+            Py_DECREF(bytes);
+        }
+    } else if (encode_length(self, 2, view.len) == 0 &&
+            fp_write(self, view.buf, view.len) == 0) {
+        Py_INCREF(Py_None);
+        ret = Py_None;
+    }
+    PyBuffer_Release(&view);
+    return ret;
+}
+
+
 // Special encoders //////////////////////////////////////////////////////////
 
 // CBOREncoder.encode_float(self, value)
@@ -1651,302 +2677,367 @@ CBOREncoder_encode_simple_value(CBOREncoderObject *self, PyObject *args)
 }
 
 
-// Canonical encoding methods ////////////////////////////////////////////////
-
-// CBOREncoder.encode_minimal_float(self, value)
+// CBOREncoder.encode_raw(self, (data,))
 static PyObject *
-CBOREncoder_encode_minimal_float(CBOREncoderObject *self, PyObject *value)
+CBOREncoder_encode_raw(CBOREncoderObject *self, PyObject *args)
 {
-    union {
-        double f;
-        uint64_t i;
-        char buf[sizeof(double)];
-    } u_double;
+    PyObject *data;
 
-    union {
-        float f;
-        uint32_t i;
-        char buf[sizeof(float)];
-    } u_single;
+    if (!PyArg_ParseTuple(args, "S", &data))
+        return NULL;
+    if (fp_write(self, PyBytes_AS_STRING(data), PyBytes_GET_SIZE(data)) == -1)
+        return NULL;
+    Py_RETURN_NONE;
+}
 
-    union {
-        uint16_t i;
-        char buf[sizeof(uint16_t)];
-    } u_half;
 
-    u_double.f = PyFloat_AS_DOUBLE(value);
-    if (u_double.f == -1.0 && PyErr_Occurred())
-        return NULL;
-    switch (fpclassify(u_double.f)) {
-        case FP_NAN:
-            if (fp_write(self, "\xF9\x7E\x00", 3) == -1)
-                return NULL;
-            break;
-        case FP_INFINITE:
-            if (u_double.f > 0) {
-                if (fp_write(self, "\xF9\x7C\x00", 3) == -1)
-                    return NULL;
-            } else {
-                if (fp_write(self, "\xF9\xFC\x00", 3) == -1)
-                    return NULL;
-            }
-            break;
-        default:
-            u_single.f = (float) u_double.f;
-            if (u_single.f == u_double.f) {
-                u_half.i = pack_float16(u_single.f);
-                if (unpack_float16(u_half.i) == u_single.f) {
-                    if (fp_write(self, "\xF9", 1) == -1)
-                        return NULL;
-                    if (fp_write(self, u_half.buf, sizeof(uint16_t)) == -1)
-                        return NULL;
-                } else {
-                    if (fp_write(self, "\xFA", 1) == -1)
-                        return NULL;
-                    u_single.i = htobe32(u_single.i);
-                    if (fp_write(self, u_single.buf, sizeof(float)) == -1)
-                        return NULL;
-                }
-            } else {
-                if (fp_write(self, "\xFB", 1) == -1)
-                    return NULL;
+// Canonical encoding methods ////////////////////////////////////////////////
+
+// Formats count doubles at values in the widths worked out for them by
+// minimal_float_widths() (which also gives the half-precision forms) to buf,
+// which must have room for 9 bytes each. Returns the number of bytes written
+static Py_ssize_t
+format_minimal_floats(char *buf, const double *values, const uint16_t *halves,
+                      const uint8_t *widths, Py_ssize_t count)
+{
+    union { float f; uint32_t i; } u_single;
+    union { double f; uint64_t i; } u_double;
+    uint16_t half;
+    char *p = buf;
+    Py_ssize_t i;
+
+    for (i = 0; i < count; i++) {
+        switch (widths[i]) {
+            case 2:
+                *p++ = '\xF9';
+                half = htobe16(halves[i]);
+                memcpy(p, &half, 2);
+                p += 2;
+                break;
+            case 4:
+                *p++ = '\xFA';
+                u_single.f = (float) values[i];
+                u_single.i = htobe32(u_single.i);
+                memcpy(p, &u_single.i, 4);
+                p += 4;
+                break;
+            default:
+                *p++ = '\xFB';
+                u_double.f = values[i];
                 u_double.i = htobe64(u_double.i);
-                if (fp_write(self, u_double.buf, sizeof(double)) == -1)
-                    return NULL;
-            }
-            break;
+                memcpy(p, &u_double.i, 8);
+                p += 8;
+                break;
+        }
     }
-    Py_RETURN_NONE;
+    return p - buf;
 }
 
 
+// CBOREncoder.encode_minimal_float(self, value)
 static PyObject *
-encode_canonical_map_list(CBOREncoderObject *self, PyObject *list)
+CBOREncoder_encode_minimal_float(CBOREncoderObject *self, PyObject *value)
 {
-    PyObject *bytes, *ret;
-    Py_ssize_t index;
+    double f;
+    uint16_t half;
+    uint8_t width;
+    char buf[9];
 
-    if (PyList_Sort(list) == -1)
+    f = PyFloat_AsDouble(value);
+    if (f == -1.0 && PyErr_Occurred())
         return NULL;
-    if (encode_length(self, 5, PyList_GET_SIZE(list)) == -1)
+    minimal_float_widths(&f, &half, &width, 1);
+    if (fp_write(self, buf,
+                format_minimal_floats(buf, &f, &half, &width, 1)) == -1)
         return NULL;
-    for (index = 0; index < PyList_GET_SIZE(list); ++index) {
-        // If we are encoding string references, the order of the keys
-        // needs to match the order we encode.
-        if (self->string_referencing) {
-            ret = CBOREncoder_encode(self,
-                    PyTuple_GET_ITEM(PyList_GET_ITEM(list, index), 2));
-            if (ret)
-                Py_DECREF(ret);
-            else
-                return NULL;
-        } else {
-            // We already have the encoded form of the key so just write it out
-            bytes = PyTuple_GET_ITEM(PyList_GET_ITEM(list, index), 1);
-            if (fp_write(self, PyBytes_AS_STRING(bytes), PyBytes_GET_SIZE(bytes)) == -1)
-                return NULL;
-        }
-        ret = CBOREncoder_encode(self,
-                PyTuple_GET_ITEM(PyList_GET_ITEM(list, index), 3));
-        if (ret)
-            Py_DECREF(ret);
-        else
-            return NULL;
-    }
     Py_RETURN_NONE;
 }
 
 
-static PyObject *
-dict_to_canonical_list(CBOREncoderObject *self, PyObject *value)
+// Encodes count floats (which must all be exact floats) in canonical form,
+// working out the widths for a block of them at a time; used for runs of
+// floats in arrays
+static int
+encode_minimal_floats(CBOREncoderObject *self, PyObject **items,
+                      Py_ssize_t count)
+{
+    double values[MINIMAL_FLOAT_BLOCK];
+    uint16_t halves[MINIMAL_FLOAT_BLOCK];
+    uint8_t widths[MINIMAL_FLOAT_BLOCK];
+    char buf[MINIMAL_FLOAT_BLOCK * 9];
+    Py_ssize_t block, i;
+
+    while (count) {
+        block = count < MINIMAL_FLOAT_BLOCK ? count : MINIMAL_FLOAT_BLOCK;
+        for (i = 0; i < block; i++)
+            values[i] = PyFloat_AS_DOUBLE(items[i]);
+        minimal_float_widths(values, halves, widths, block);
+        if (fp_write(self, buf, format_minimal_floats(
+                        buf, values, halves, widths, block)) == -1)
+            return -1;
+        items += block;
+        count -= block;
+    }
+    return 0;
+}
+
+
+// The keys of a canonical map (or the items of a canonical set) are encoded
+// one after another at the end of the output buffer, then moved into a single
+// scratch block and sorted by their encoded form (shortest first, then
+// bytewise, as per RFC 8949 section 4.2.1) so they can be written straight
+// from there
+
+typedef struct {
+    PyObject *key;
+    PyObject *value;       // NULL for sets
+    const char *data;      // encoded key, within the scratch block
+    Py_ssize_t length;
+} CanonicalEntry;
+
+
+static void
+canonical_entries_free(CanonicalEntry *entries, Py_ssize_t count)
 {
-    PyObject *bytes, *length, *key, *val, *tuple, *ret, *list;
+    Py_ssize_t index;
+
+    for (index = 0; index < count; index++) {
+        Py_DECREF(entries[index].key);
+        Py_XDECREF(entries[index].value);
+    }
+    PyMem_Free(entries);
+}
+
+
+// Returns the keys and values of value (a dict or any other mapping) in a
+// new block of size *count, or NULL on error
+static CanonicalEntry *
+map_canonical_entries(PyObject *value, Py_ssize_t *count)
+{
+    CanonicalEntry *entries;
+    PyObject *items, *fast, *item, *key, *val;
     Py_ssize_t index, pos;
 
-    ret = list = PyList_New(PyDict_Size(value));
-    if (list) {
+    if (PyDict_Check(value)) {
+        *count = PyDict_GET_SIZE(value);
+        entries = PyMem_New(CanonicalEntry, *count ? *count : 1);
+        if (!entries) {
+            PyErr_NoMemory();
+            return NULL;
+        }
         pos = 0;
         index = 0;
-        while (ret && PyDict_Next(value, &pos, &key, &val)) {
+        while (index < *count && PyDict_Next(value, &pos, &key, &val)) {
             Py_INCREF(key);
-            bytes = CBOREncoder_encode_to_bytes(self, key);
-            Py_DECREF(key);
-            if (bytes) {
-                length = PyLong_FromSsize_t(PyBytes_GET_SIZE(bytes));
-                if (length) {
-                    tuple = PyTuple_Pack(4, length, bytes, key, val);
-                    if (tuple)
-                        PyList_SET_ITEM(list, index, tuple); // steals ref
-                    else
-                        ret = NULL;
-                    index++;
-                    Py_DECREF(length);
-                } else
-                    ret = NULL;
-                Py_DECREF(bytes);
-            } else
-                ret = NULL;
+            Py_INCREF(val);
+            entries[index].key = key;
+            entries[index].value = val;
+            index++;
         }
-        if (!ret)
-            Py_DECREF(list);
+        *count = index;
+        return entries;
     }
-    return ret;
+
+    items = PyMapping_Items(value);
+    if (!items)
+        return NULL;
+    fast = PySequence_Fast(items, "internal error");
+    Py_DECREF(items);
+    if (!fast)
+        return NULL;
+    *count = PySequence_Fast_GET_SIZE(fast);
+    entries = PyMem_New(CanonicalEntry, *count ? *count : 1);
+    if (entries) {
+        for (index = 0; index < *count; index++) {
+            item = PySequence_Fast_GET_ITEM(fast, index);
+            key = PyTuple_GET_ITEM(item, 0);
+            val = PyTuple_GET_ITEM(item, 1);
+            Py_INCREF(key);
+            Py_INCREF(val);
+            entries[index].key = key;
+            entries[index].value = val;
+        }
+    } else
+        PyErr_NoMemory();
+    Py_DECREF(fast);
+    return entries;
 }
 
 
-static PyObject *
-mapping_to_canonical_list(CBOREncoderObject *self, PyObject *value)
+// Returns the items of value (a set or frozenset) in a new block of size
+// *count, or NULL on error
+static CanonicalEntry *
+set_canonical_entries(PyObject *value, Py_ssize_t *count)
 {
-    PyObject **items, *map_items, *fast, *bytes, *length, *tuple, *ret, *list;
-    Py_ssize_t fast_len, index;
+    CanonicalEntry *entries;
+    PyObject *iter, *item;
+    Py_ssize_t index = 0;
 
-    ret = list = PyList_New(PyMapping_Size(value));
-    if (list) {
-        map_items = PyMapping_Items(value);
-        if (map_items) {
-            fast = PySequence_Fast(map_items, "internal error");
-            if (fast) {
-                index = 0;
-                fast_len = PySequence_Fast_GET_SIZE(fast);
-                items = PySequence_Fast_ITEMS(fast);
-                while (ret && fast_len) {
-                    bytes = CBOREncoder_encode_to_bytes(self,
-                        PyTuple_GET_ITEM(*items, 0));
-                    if (bytes) {
-                        length = PyLong_FromSsize_t(PyBytes_GET_SIZE(bytes));
-                        if (length) {
-                            tuple = PyTuple_Pack(4,
-                                length, bytes,
-                                PyTuple_GET_ITEM(*items, 0),
-                                PyTuple_GET_ITEM(*items, 1));
-                            if (tuple)
-                                PyList_SET_ITEM(list, index, tuple); // steals ref
-                            else
-                                ret = NULL;
-                            Py_DECREF(length);
-                        } else
-                            ret = NULL;
-                        Py_DECREF(bytes);
-                    } else
-                        ret = NULL;
-                    items++;
-                    index++;
-                    fast_len--;
-                }
-                Py_DECREF(fast);
-            } else
-                ret = NULL;
-            Py_DECREF(map_items);
-        } else
-            ret = NULL;
-        if (!ret)
-            Py_DECREF(list);
+    *count = PySet_GET_SIZE(value);
+    entries = PyMem_New(CanonicalEntry, *count ? *count : 1);
+    if (!entries) {
+        PyErr_NoMemory();
+        return NULL;
     }
-    return ret;
+    iter = PyObject_GetIter(value);
+    if (iter) {
+        while (index < *count && (item = PyIter_Next(iter))) {
+            entries[index].key = item;
+            entries[index].value = NULL;
+            index++;
+        }
+        Py_DECREF(iter);
+    }
+    if (PyErr_Occurred()) {
+        canonical_entries_free(entries, index);
+        return NULL;
+    }
+    *count = index;
+    return entries;
 }
 
 
-static PyObject *
-encode_canonical_map(CBOREncoderObject *self, PyObject *value)
+static int
+canonical_entry_compare(const void *a, const void *b)
 {
-    PyObject *list, *ret = NULL;
+    const CanonicalEntry *x = a, *y = b;
+    int ret;
+
+    if (x->length != y->length)
+        return x->length < y->length ? -1 : 1;
+    ret = memcmp(x->data, y->data, x->length);
+    if (ret)
+        return ret;
+    // Keep keys with the same encoding (only possible with mappings other
+    // than dicts) in their original order; they're all in the same block
+    return x->data < y->data ? -1 : x->data > y->data;
+}
+
+
+// Encodes the key of each entry and sorts the entries into canonical order;
+// returns the scratch block holding the encoded keys, to be freed with
+// PyMem_Free once they've been written, or NULL on error
+static char *
+sort_canonical_entries(CBOREncoderObject *self, CanonicalEntry *entries,
+                       Py_ssize_t count)
+{
+    PyObject *save_write, *ret = NULL;
     bool string_referencing_old = self->string_referencing;
+    Py_ssize_t start, end, index;
+    char *scratch = NULL;
 
-    // Don't generate string references when sorting keys
+    // Encode onto the end of the output buffer as in encode_to_bytes(),
+    // without generating string references
+    save_write = self->write;
+    self->write = Py_None;
     self->string_referencing = false;
-    if (PyDict_Check(value))
-        list = dict_to_canonical_list(self, value);
-    else
-        list = mapping_to_canonical_list(self, value);
+    start = end = self->buffer_len;
+    for (index = 0; index < count; index++) {
+        ret = CBOREncoder_encode(self, entries[index].key);
+        if (!ret)
+            break;
+        Py_DECREF(ret);
+        entries[index].length = self->buffer_len - end;
+        end = self->buffer_len;
+    }
     self->string_referencing = string_referencing_old;
+    self->write = save_write;
 
-    if (list) {
-        ret = encode_canonical_map_list(self, list);
-        Py_DECREF(list);
+    if (index == count) {
+        scratch = PyMem_Malloc(end > start ? end - start : 1);
+        if (scratch) {
+            // The keys were encoded back to back
+            memcpy(scratch, self->buffer + start, end - start);
+            entries[0].data = scratch;
+            for (index = 1; index < count; index++)
+                entries[index].data =
+                    entries[index - 1].data + entries[index - 1].length;
+            qsort(entries, count, sizeof(CanonicalEntry),
+                    &canonical_entry_compare);
+        } else
+            PyErr_NoMemory();
     }
-
-    return ret;
-}
-
-
-static PyObject *
-CBOREncoder_encode_canonical_map(CBOREncoderObject *self, PyObject *value)
-{
-    return encode_container(self, &encode_canonical_map, value);
+    if (self->buffer_len > start)
+        self->buffer_len = start;
+    return scratch;
 }
 
 
 static PyObject *
-encode_canonical_set_list(CBOREncoderObject *self, PyObject *list)
+encode_canonical_map(CBOREncoderObject *self, PyObject *value)
 {
-    PyObject *bytes;
-    Py_ssize_t index;
+    CanonicalEntry *entries;
+    PyObject *ret = NULL;
+    Py_ssize_t count, index;
+    char *scratch;
 
-    if (PyList_Sort(list) == -1)
-        return NULL;
-    if (encode_length(self, 6, 258) == -1)
-        return NULL;
-    if (encode_length(self, 4, PyList_GET_SIZE(list)) == -1)
+    entries = map_canonical_entries(value, &count);
+    if (!entries)
         return NULL;
-    for (index = 0; index < PyList_GET_SIZE(list); ++index) {
-        // We already have the encoded form, so just write it out
-        bytes = PyTuple_GET_ITEM(PyList_GET_ITEM(list, index), 1);
-        if (fp_write(self, PyBytes_AS_STRING(bytes), PyBytes_GET_SIZE(bytes)) == -1)
-            return NULL;
+    scratch = sort_canonical_entries(self, entries, count);
+    if (scratch && encode_length(self, 5, count) == 0) {
+        for (index = 0; index < count; index++) {
+            // If we are encoding string references, the order of the keys
+            // needs to match the order we encode
+            if (self->string_referencing) {
+                ret = CBOREncoder_encode(self, entries[index].key);
+                if (!ret)
+                    break;
+                Py_DECREF(ret);
+            } else if (fp_write(self, entries[index].data,
+                        entries[index].length) == -1) {
+                ret = NULL;
+                break;
+            }
+            ret = CBOREncoder_encode(self, entries[index].value);
+            if (!ret)
+                break;
+            Py_DECREF(ret);
+        }
+        if (index == count) {
+            Py_INCREF(Py_None);
+            ret = Py_None;
+        }
     }
-    Py_RETURN_NONE;
+    PyMem_Free(scratch);
+    canonical_entries_free(entries, count);
+    return ret;
 }
 
 
 static PyObject *
-set_to_canonical_list(CBOREncoderObject *self, PyObject *value)
+CBOREncoder_encode_canonical_map(CBOREncoderObject *self, PyObject *value)
 {
-    PyObject *iter, *bytes, *length, *item, *tuple, *list, *ret;
-    Py_ssize_t index;
-
-    ret = list = PyList_New(PySet_GET_SIZE(value));
-    if (list) {
-        iter = PyObject_GetIter(value);
-        if (iter) {
-            index = 0;
-            while (ret && (item = PyIter_Next(iter))) {
-                bytes = CBOREncoder_encode_to_bytes(self, item);
-                if (bytes) {
-                    length = PyLong_FromSsize_t(PyBytes_GET_SIZE(bytes));
-                    if (length) {
-                        tuple = PyTuple_Pack(3, length, bytes, item);
-                        if (tuple)
-                            PyList_SET_ITEM(list, index, tuple); // steals ref
-                        else
-                            ret = NULL;
-                        index++;
-                        Py_DECREF(length);
-                    } else
-                        ret = NULL;
-                    Py_DECREF(bytes);
-                } else
-                    ret = NULL;
-                Py_DECREF(item);
-            }
-            Py_DECREF(iter);
-        }
-        if (!ret)
-            Py_DECREF(list);
-    }
-    return ret;
+    return encode_container(self, &encode_canonical_map, value);
 }
 
 
 static PyObject *
 encode_canonical_set(CBOREncoderObject *self, PyObject *value)
 {
-    PyObject *list, *ret = NULL;
+    CanonicalEntry *entries;
+    PyObject *ret = NULL;
+    Py_ssize_t count, index;
+    char *scratch;
 
-    list = set_to_canonical_list(self, value);
-    if (list) {
-        ret = encode_canonical_set_list(self, list);
-        Py_DECREF(list);
+    entries = set_canonical_entries(value, &count);
+    if (!entries)
+        return NULL;
+    scratch = sort_canonical_entries(self, entries, count);
+    if (scratch && encode_length(self, 6, 258) == 0 &&
+            encode_length(self, 4, count) == 0) {
+        // We already have the encoded form, so just write it out
+        for (index = 0; index < count; index++)
+            if (fp_write(self, entries[index].data,
+                        entries[index].length) == -1)
+                break;
+        if (index == count) {
+            Py_INCREF(Py_None);
+            ret = Py_None;
+        }
     }
+    PyMem_Free(scratch);
+    canonical_entries_free(entries, count);
     return ret;
 }
 
@@ -1963,7 +3054,7 @@ CBOREncoder_encode_canonical_set(CBOREncoderObject *self, PyObject *value)
 static inline PyObject *
 encode(CBOREncoderObject *self, PyObject *value)
 {
-    PyObject *encoder, *ret = NULL;
+    PyObject *encoder, *fields, *ret = NULL;
 
     switch (self->enc_style) {
         case 1:
@@ -2008,15 +3099,23 @@ encode(CBOREncoderObject *self, PyObject *value)
             // fall-thru
         default:
             // lookup type (or subclass) in self->encoders
-            encoder = CBOREncoder_find_encoder(self, (PyObject *)Py_TYPE(value));
-            if (encoder) {
+            if (dispatch_lookup(self, Py_TYPE(value), &encoder, &fields) == -1)
+                break;
+            if (fields) {
+                if (fields == Py_None)
+                    ret = encode_enum(self, value);
+                else
+                    ret = encode_container(self, &encode_record, value);
+                Py_DECREF(fields);
+            } else {
                 if (encoder != Py_None)
                     ret = PyObject_CallFunctionObjArgs(
                             encoder, self, value, NULL);
-                else if (self->default_handler != Py_None)
+                else if (self->default_handler != Py_None) {
+                    self->stats.default_calls++;
                     ret = PyObject_CallFunctionObjArgs(
                             self->default_handler, self, value, NULL);
-                else
+                } else
                     PyErr_Format(
                         _CBOR2_CBOREncodeTypeError,
                         "cannot serialize type %R", (PyObject *)Py_TYPE(value));
@@ -2032,39 +3131,318 @@ PyObject *
 CBOREncoder_encode(CBOREncoderObject *self, PyObject *value)
 {
     PyObject *ret;
+    Py_ssize_t parent = indefinite_parent(self);
 
-    // TODO reset shared dict?
+    if (parent != -1 && check_indefinite_value(self, parent, value) == -1)
+        return NULL;
+    // The shared value and string reference registries deliberately persist
+    // across calls (so that encode_to_bytes can be used from a default hook);
+    // reset() clears them between unrelated values
     if (Py_EnterRecursiveCall(" in CBOREncoder.encode"))
         return NULL;
+    if (self->collect_stats && self->value_depth > self->stats.max_depth)
+        self->stats.max_depth = self->value_depth;
+    self->encode_depth++;
+    self->value_depth++;
     ret = encode(self, value);
+    self->value_depth--;
+    if (ret && parent != -1)
+        self->indefinite_items[parent].values++;
+    if (--self->encode_depth == 0) {
+        if (!ret)
+            // discard the partially encoded value
+            self->buffer_len = 0;
+        else if (fp_flush(self) == -1)
+            Py_CLEAR(ret);
+    }
     Py_LeaveRecursiveCall();
     return ret;
 }
 
 
+// Forget the containers and strings seen so far so that the next value
+// encoded doesn't refer back to any of them
+static void
+clear_references(CBOREncoderObject *self)
+{
+    ref_table_clear(&self->shared);
+    ref_table_clear(&self->string_references);
+    self->string_namespacing = self->string_referencing;
+}
+
+
+// Indefinite length items //////////////////////////////////////////////////
+
+// begin_array() and friends write the lead byte of an indefinite length item
+// and leave it open, so that subsequent calls to encode() add its contents.
+// The item counts towards encode_depth while it's open, so the output is
+// only buffered (and flushed as it reaches flush_threshold) until the
+// outermost one is ended, rather than being written out after every value.
+// An array or map opened where encode_container() would start a new string
+// namespace starts one too, which lasts until it's ended. The values encoded
+// directly in the innermost item (at the value_depth it was begun at) are
+// checked to be chunks of the right type if it's a string, and counted so
+// that a map can't be ended with a key that has no value
+
+// Returns the index of the innermost open item if a value encoded now would
+// be directly in it, or -1
+static Py_ssize_t
+indefinite_parent(CBOREncoderObject *self)
+{
+    Py_ssize_t i = self->indefinite_depth - 1;
+
+    if (i != -1 && self->indefinite_items[i].value_depth == self->value_depth)
+        return i;
+    return -1;
+}
+
+
+static int
+check_indefinite_value(CBOREncoderObject *self, Py_ssize_t parent,
+                       PyObject *value)
+{
+    char lead = self->indefinite_items[parent].lead;
+
+    if (lead == '\x7f' && !PyUnicode_Check(value)) {
+        PyErr_Format(_CBOR2_CBOREncodeValueError,
+                "the chunks of an indefinite length string must be str, "
+                "not %.200s", Py_TYPE(value)->tp_name);
+        return -1;
+    }
+    if (lead == '\x5f' && !PyBytes_Check(value) && !PyByteArray_Check(value)) {
+        PyErr_Format(_CBOR2_CBOREncodeValueError,
+                "the chunks of an indefinite length bytestring must be bytes "
+                "or bytearray, not %.200s", Py_TYPE(value)->tp_name);
+        return -1;
+    }
+    return 0;
+}
+
+
 static PyObject *
-CBOREncoder_encode_to_bytes(CBOREncoderObject *self, PyObject *value)
+begin_indefinite(CBOREncoderObject *self, const char lead)
 {
-    PyObject *save_write, *buf, *ret = NULL;
+    bool new_namespace = self->string_namespacing &&
+        (lead == '\x9f' || lead == '\xbf');
+    Py_ssize_t parent = indefinite_parent(self), size;
+    IndefiniteItem *items;
 
-    if (!_CBOR2_BytesIO && _CBOR2_init_BytesIO() == -1)
+    if (self->indefinite_string) {
+        PyErr_SetString(_CBOR2_CBOREncodeValueError,
+                "an indefinite length string can only contain definite "
+                "length strings");
+        return NULL;
+    }
+    if (self->indefinite_depth == self->indefinite_allocated) {
+        size = self->indefinite_allocated ? self->indefinite_allocated * 2 : 8;
+        items = PyMem_Realloc(self->indefinite_items,
+                              size * sizeof(IndefiniteItem));
+        if (!items) {
+            PyErr_NoMemory();
+            return NULL;
+        }
+        self->indefinite_items = items;
+        self->indefinite_allocated = size;
+    }
+    self->encode_depth++;
+    if ((new_namespace && encode_length(self, 6, 256) == -1) ||
+            fp_write(self, &lead, 1) == -1) {
+        self->encode_depth--;
         return NULL;
+    }
+    // The new item is itself a value of the one it's in
+    if (parent != -1)
+        self->indefinite_items[parent].values++;
+    self->indefinite_items[self->indefinite_depth].lead = lead;
+    self->indefinite_items[self->indefinite_depth].value_depth =
+        self->value_depth;
+    self->indefinite_items[self->indefinite_depth].values = 0;
+    self->indefinite_depth++;
+    if (new_namespace) {
+        self->string_namespacing = false;
+        self->indefinite_namespace = self->indefinite_depth;
+    }
+    if (lead == '\x5f' || lead == '\x7f') {
+        // The chunks have to be encoded as they are
+        self->indefinite_string = true;
+        self->indefinite_string_referencing = self->string_referencing;
+        self->string_referencing = false;
+    }
+    Py_RETURN_NONE;
+}
+
+
+static void
+end_indefinite_string(CBOREncoderObject *self)
+{
+    if (self->indefinite_string) {
+        self->string_referencing = self->indefinite_string_referencing;
+        self->indefinite_string = false;
+    }
+}
+
 
+static void
+end_indefinite_namespace(CBOREncoderObject *self)
+{
+    if (self->indefinite_depth < self->indefinite_namespace) {
+        self->string_namespacing = true;
+        self->indefinite_namespace = 0;
+    }
+}
+
+
+static void
+abandon_indefinite(CBOREncoderObject *self)
+{
+    end_indefinite_string(self);
+    self->encode_depth -= self->indefinite_depth;
+    self->indefinite_depth = 0;
+    end_indefinite_namespace(self);
+}
+
+
+// CBOREncoder.begin_array(self)
+static PyObject *
+CBOREncoder_begin_array(CBOREncoderObject *self)
+{
+    return begin_indefinite(self, '\x9f');
+}
+
+
+// CBOREncoder.begin_map(self)
+static PyObject *
+CBOREncoder_begin_map(CBOREncoderObject *self)
+{
+    return begin_indefinite(self, '\xbf');
+}
+
+
+// CBOREncoder.begin_string(self)
+static PyObject *
+CBOREncoder_begin_string(CBOREncoderObject *self)
+{
+    return begin_indefinite(self, '\x7f');
+}
+
+
+// CBOREncoder.begin_bytestring(self)
+static PyObject *
+CBOREncoder_begin_bytestring(CBOREncoderObject *self)
+{
+    return begin_indefinite(self, '\x5f');
+}
+
+
+// CBOREncoder.end(self)
+static PyObject *
+CBOREncoder_end(CBOREncoderObject *self)
+{
+    IndefiniteItem *item;
+
+    if (!self->indefinite_depth) {
+        PyErr_SetString(_CBOR2_CBOREncodeValueError,
+                        "there is no indefinite length item to end");
+        return NULL;
+    }
+    item = &self->indefinite_items[self->indefinite_depth - 1];
+    if (item->lead == '\xbf' && item->values % 2) {
+        PyErr_SetString(_CBOR2_CBOREncodeValueError,
+                "an indefinite length map can't end with a key that has no "
+                "value");
+        return NULL;
+    }
+    end_indefinite_string(self);
+    self->indefinite_depth--;
+    end_indefinite_namespace(self);
+    // Flushes everything if this was the outermost item
+    self->encode_depth--;
+    if (fp_write(self, "\xff", 1) == -1)
+        return NULL;
+    Py_RETURN_NONE;
+}
+
+
+// CBOREncoder.reset(self, fp=None)
+static PyObject *
+CBOREncoder_reset(CBOREncoderObject *self, PyObject *args, PyObject *kwargs)
+{
+    static char *keywords[] = {"fp", NULL};
+    PyObject *fp = Py_None, *ret = NULL;
+
+    if (!PyArg_ParseTupleAndKeywords(args, kwargs, "|O", keywords, &fp))
+        return NULL;
+
+    // The options, the encoders dict and the output buffer's allocation are
+    // all kept; only the per-value state is cleared
+    if (fp == Py_None || _CBOREncoder_set_fp(self, fp, NULL) == 0) {
+        // Any indefinite length items left open belong to the old fp
+        if (fp != Py_None)
+            abandon_indefinite(self);
+        clear_references(self);
+        Py_INCREF(Py_None);
+        ret = Py_None;
+    }
+    return ret;
+}
+
+
+// CBOREncoder.encode_sequence(self, values)
+PyObject *
+CBOREncoder_encode_sequence(CBOREncoderObject *self, PyObject *values)
+{
+    PyObject *iter, *item, *ret;
+
+    iter = PyObject_GetIter(values);
+    if (!iter)
+        return NULL;
+
+    // Each value is a self-contained item of a CBOR sequence (RFC 8742) so
+    // none may refer to containers or strings in the ones before it. Output
+    // is only flushed once the whole sequence is encoded (or the buffer
+    // exceeds flush_threshold) rather than after every item
+    Py_INCREF(Py_None);
+    ret = Py_None;
+    self->encode_depth++;
+    while (ret && (item = PyIter_Next(iter))) {
+        clear_references(self);
+        Py_DECREF(ret);
+        ret = CBOREncoder_encode(self, item);
+        Py_DECREF(item);
+    }
+    if (ret && PyErr_Occurred())
+        Py_CLEAR(ret);
+    if (--self->encode_depth == 0) {
+        if (!ret)
+            self->buffer_len = 0;
+        else if (fp_flush(self) == -1)
+            Py_CLEAR(ret);
+    }
+    Py_DECREF(iter);
+    return ret;
+}
+
+
+static PyObject *
+CBOREncoder_encode_to_bytes(CBOREncoderObject *self, PyObject *value)
+{
+    PyObject *save_write, *ret = NULL;
+    Py_ssize_t start;
+
+    // Encode onto the end of the output buffer with flushing disabled, then
+    // cut the result back off again
     save_write = self->write;
-    buf = PyObject_CallFunctionObjArgs(_CBOR2_BytesIO, NULL);
-    if (buf) {
-        self->write = PyObject_GetAttr(buf, _CBOR2_str_write);
-        if (self->write) {
-            ret = CBOREncoder_encode(self, value);
-            if (ret) {
-                assert(ret == Py_None);
-                Py_DECREF(ret);
-                ret = PyObject_CallMethodObjArgs(buf, _CBOR2_str_getvalue, NULL);
-            }
-            Py_DECREF(self->write);
-        }
-        Py_DECREF(buf);
+    self->write = Py_None;
+    start = self->buffer_len;
+    ret = CBOREncoder_encode(self, value);
+    if (ret) {
+        assert(ret == Py_None);
+        Py_DECREF(ret);
+        ret = PyBytes_FromStringAndSize(
+                self->buffer + start, self->buffer_len - start);
     }
+    if (self->buffer_len > start)
+        self->buffer_len = start;
     self->write = save_write;
     return ret;
 }
@@ -2082,6 +3460,8 @@ static PyMemberDef CBOREncoder_members[] = {
         "the sub-type to use when encoding datetime objects"},
     {"value_sharing", T_BOOL, offsetof(CBOREncoderObject, value_sharing), 0,
         "if True, then efficiently encode recursive structures"},
+    {"flush_threshold", T_PYSSIZET, offsetof(CBOREncoderObject, flush_threshold), 0,
+        "the number of bytes to accumulate before passing them to fp.write()"},
     {NULL}
 };
 
@@ -2098,6 +3478,17 @@ static PyGetSetDef CBOREncoder_getsetters[] = {
     {"canonical",
         (getter) _CBOREncoder_get_canonical, NULL,
         "if True, then CBOR canonical encoding will be generated", NULL},
+    {"record_format",
+        (getter) _CBOREncoder_get_record_format, NULL,
+        "how dataclasses and named tuples are encoded, if at all", NULL},
+    {"collect_stats",
+        (getter) _CBOREncoder_get_collect_stats,
+        (setter) _CBOREncoder_set_collect_stats,
+        "when True, the encoder keeps the counters returned by stats", NULL},
+    {"stats",
+        (getter) _CBOREncoder_get_stats, NULL,
+        "dict of the counters kept while collect_stats is enabled, or None",
+        NULL},
     {NULL}
 };
 
@@ -2111,6 +3502,26 @@ static PyMethodDef CBOREncoder_methods[] = {
         "encode the specified *value* to the output"},
     {"encode_to_bytes", (PyCFunction) CBOREncoder_encode_to_bytes, METH_O,
         "encode the specified *value* to a bytestring"},
+    {"reset", (PyCFunction) CBOREncoder_reset, METH_VARARGS | METH_KEYWORDS,
+        "forget all values encoded so far, so that the next one can't refer "
+        "to them, and optionally switch to a new fp"},
+    {"encode_sequence", (PyCFunction) CBOREncoder_encode_sequence, METH_O,
+        "encode each of the specified *values* to the output as an "
+        "independent item of a CBOR sequence"},
+    {"begin_array", (PyCFunction) CBOREncoder_begin_array, METH_NOARGS,
+        "start an indefinite length array whose items are the values "
+        "encoded until end() is called"},
+    {"begin_map", (PyCFunction) CBOREncoder_begin_map, METH_NOARGS,
+        "start an indefinite length map whose keys and values are the values "
+        "encoded until end() is called"},
+    {"begin_string", (PyCFunction) CBOREncoder_begin_string, METH_NOARGS,
+        "start an indefinite length string whose chunks are the strings "
+        "encoded until end() is called"},
+    {"begin_bytestring", (PyCFunction) CBOREncoder_begin_bytestring, METH_NOARGS,
+        "start an indefinite length bytestring whose chunks are the "
+        "bytestrings encoded until end() is called"},
+    {"end", (PyCFunction) CBOREncoder_end, METH_NOARGS,
+        "end the indefinite length item most recently started"},
     {"encode_length", (PyCFunction) CBOREncoder_encode_length, METH_VARARGS,
         "encode the specified *major_tag* with the specified *length* to "
         "the output"},
@@ -2138,10 +3549,17 @@ static PyMethodDef CBOREncoder_methods[] = {
         "encode the specified sequence *value* to the output"},
     {"encode_map", (PyCFunction) CBOREncoder_encode_map, METH_O,
         "encode the specified mapping *value* to the output"},
+    {"encode_indefinite_array",
+        (PyCFunction) CBOREncoder_encode_indefinite_array, METH_O,
+        "encode the items of the specified iterable *value* to the output as "
+        "an indefinite length array"},
     {"encode_semantic", (PyCFunction) CBOREncoder_encode_semantic, METH_O,
         "encode the specified CBORTag to the output"},
     {"encode_simple_value", (PyCFunction) CBOREncoder_encode_simple_value, METH_O,
         "encode the specified CBORSimpleValue to the output"},
+    {"encode_raw", (PyCFunction) CBOREncoder_encode_raw, METH_O,
+        "write the already encoded contents of the specified CBORRaw to the "
+        "output"},
     {"encode_rational", (PyCFunction) CBOREncoder_encode_rational, METH_O,
         "encode the specified fraction to the output"},
     {"encode_decimal", (PyCFunction) CBOREncoder_encode_decimal, METH_O,
@@ -2158,6 +3576,11 @@ static PyMethodDef CBOREncoder_methods[] = {
         "encode the specified IPv4 or IPv6 address to the output"},
     {"encode_ipnetwork", (PyCFunction) CBOREncoder_encode_ipnetwork, METH_O,
         "encode the specified IPv4 or IPv6 network prefix to the output"},
+    {"encode_typed_array", (PyCFunction) CBOREncoder_encode_typed_array,
+        METH_O, "encode the specified array or memoryview as a typed array"},
+    {"encode_memoryview", (PyCFunction) CBOREncoder_encode_memoryview,
+        METH_O, "encode the specified memoryview as a bytestring if its "
+        "elements are single bytes, or as a typed array otherwise"},
     {"encode_shared", (PyCFunction) CBOREncoder_encode_shared, METH_VARARGS,
         "encode the specified CBORTag to the output"},
     {"encode_stringref", (PyCFunction) CBOREncoder_encode_stringref, METH_O,
@@ -2187,6 +3610,11 @@ PyDoc_STRVAR(CBOREncoder__doc__,
 "When the class is constructed manually, the main entry points are\n"
 ":meth:`encode` and :meth:`encode_to_bytes`.\n"
 "\n"
+"An encoder may be reused for any number of values. Containers and strings\n"
+"encoded earlier remain available for value sharing and string referencing\n"
+"until :meth:`reset` is called, which also allows switching to a new *fp*\n"
+"without constructing a new encoder.\n"
+"\n"
 ":param bool datetime_as_timestamp:\n"
 "    set to ``True`` to serialize datetimes as UNIX timestamps (this\n"
 "    makes datetimes more concise on the wire, but loses the timezone\n"
@@ -2208,6 +3636,15 @@ PyDoc_STRVAR(CBOREncoder__doc__,
 "    when True, use \"canonical\" CBOR representation; this typically\n"
 "    involves sorting maps, sets, etc. into a pre-determined order ensuring\n"
 "    that serializations are comparable without decoding\n"
+":param str record_format:\n"
+"    set to ``\"map\"`` to serialize dataclass instances and named tuples\n"
+"    as maps of field names to values, or to ``\"array\"`` to serialize\n"
+"    them as arrays of their values in field order; either also serializes\n"
+"    :class:`~enum.Enum` members as their values. Types registered in the\n"
+"    encoders table keep their own encoders\n"
+":param bool collect_stats:\n"
+"    if ``True``, the encoder keeps counters of what it has done, which are\n"
+"    available from :attr:`stats`\n"
 "\n"
 ".. _CBOR: https://cbor.io/\n"
 );
@@ -9,25 +9,95 @@
 #define DC_NAN 2
 #define DC_ERROR -1
 
+// Number of slots in each encoder's type dispatch cache; must be a power of 2
+#define DISPATCH_CACHE_SIZE 64
+
+// Number of floats in a run of an array whose canonical widths are worked out
+// together (see encode_minimal_floats)
+#define MINIMAL_FLOAT_BLOCK 256
+
+typedef struct {
+    PyTypeObject *type;
+    PyObject *encoder;  // None if type has no encoder (use default_handler)
+    PyObject *fields;   // field names if type is encoded as a record (with
+                        // encoder NULL); None for enums
+} DispatchEntry;
+
+// An open addressing hash table mapping objects to indexes; see "Reference
+// tables" in encoder.c
+typedef struct {
+    PyObject *key;      // NULL for an empty slot
+    Py_hash_t hash;
+    Py_ssize_t index;
+} RefEntry;
+
+typedef struct {
+    RefEntry *entries;  // NULL until the first key is added
+    Py_ssize_t size;    // number of slots; a power of 2
+    Py_ssize_t used;
+} RefTable;
+
+// An item opened by begin_*() and not ended yet; see "Indefinite length
+// items" in encoder.c
+typedef struct {
+    char lead;               // its lead byte
+    Py_ssize_t value_depth;  // value_depth when it was begun
+    Py_ssize_t values;       // number of values encoded directly in it
+} IndefiniteItem;
+
+// Counters kept by an encoder while collect_stats is enabled; see
+// _CBOREncoder_get_stats in encoder.c
+typedef struct {
+    Py_ssize_t bytes_written;  // bytes passed to fp.write()
+    Py_ssize_t write_calls;    // calls made to fp.write()
+    Py_ssize_t default_calls;  // calls made to default_handler
+    Py_ssize_t lookup_hits;    // types found in the dispatch cache
+    Py_ssize_t lookup_misses;  // types that had to be looked up in encoders
+    Py_ssize_t max_depth;      // deepest nesting of the values encoded
+} EncoderStats;
+
 typedef struct {
     PyObject_HEAD
     PyObject *write;    // cached write() method of fp
     PyObject *encoders;
     PyObject *default_handler;
-    PyObject *shared;
-    PyObject *string_references;
+    RefTable shared;    // containers being encoded, or with value sharing all
+                        // those encoded so far; keyed by identity
+    RefTable string_references;  // strings seen so far; keyed by value
     PyObject *tz;       // renamed from timezone to avoid Python issue #24643
     PyObject *shared_handler;
     uint8_t enc_style;  // 0=regular, 1=canonical, 2=custom
+    uint8_t record_format;  // 0=disabled, 1=map, 2=array
     bool timestamp_format;
     bool date_as_datetime;
     bool value_sharing;
     bool string_referencing;
     bool string_namespacing;
+    char *buffer;       // output not yet passed to write()
+    Py_ssize_t buffer_len;
+    Py_ssize_t buffer_size;
+    Py_ssize_t flush_threshold;
+    int encode_depth;
+    Py_ssize_t indefinite_depth;  // items opened by begin_*() and not ended
+    IndefiniteItem *indefinite_items;  // those items, innermost last (or NULL)
+    Py_ssize_t indefinite_allocated;
+    bool indefinite_string;  // an indefinite length string is open
+    bool indefinite_string_referencing;  // string_referencing before that
+    Py_ssize_t indefinite_namespace;  // depth of the item in a new namespace
+    DispatchEntry dispatch[DISPATCH_CACHE_SIZE];  // resolved self->encoders
+    Py_ssize_t dispatch_used;
+    uint64_t dispatch_version;  // version of self->encoders cached
+    Py_ssize_t value_depth;  // nesting of the calls to encode() in progress
+    bool collect_stats;
+    EncoderStats stats;
 } CBOREncoderObject;
 
 extern PyTypeObject CBOREncoderType;
 
+int CBOREncoder_init_watcher(void);
 PyObject * CBOREncoder_new(PyTypeObject *, PyObject *, PyObject *);
 int CBOREncoder_init(CBOREncoderObject *, PyObject *, PyObject *);
+int CBOREncoder_init_options(CBOREncoderObject *, int, PyObject *, int,
+                             PyObject *, int, int, int, PyObject *);
 PyObject * CBOREncoder_encode(CBOREncoderObject *, PyObject *);
+PyObject * CBOREncoder_encode_sequence(CBOREncoderObject *, PyObject *);
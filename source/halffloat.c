@@ -325,7 +325,7 @@ static const uint16_t basetable[] = {
     0x0200, 0x0400, 0x0800, 0x0c00, 0x1000, 0x1400, 0x1800, 0x1c00,
     0x2000, 0x2400, 0x2800, 0x2c00, 0x3000, 0x3400, 0x3800, 0x3c00,
     0x4000, 0x4400, 0x4800, 0x4c00, 0x5000, 0x5400, 0x5800, 0x5c00,
-    0x6000, 0x6400, 0x6800, 0x6c00, 0x7000, 0x7400, 0x7c00, 0x7c00,
+    0x6000, 0x6400, 0x6800, 0x6c00, 0x7000, 0x7400, 0x7800, 0x7c00,
     0x7c00, 0x7c00, 0x7c00, 0x7c00, 0x7c00, 0x7c00, 0x7c00, 0x7c00,
     0x7c00, 0x7c00, 0x7c00, 0x7c00, 0x7c00, 0x7c00, 0x7c00, 0x7c00,
     0x7c00, 0x7c00, 0x7c00, 0x7c00, 0x7c00, 0x7c00, 0x7c00, 0x7c00,
@@ -357,7 +357,7 @@ static const uint16_t basetable[] = {
     0x8200, 0x8400, 0x8800, 0x8c00, 0x9000, 0x9400, 0x9800, 0x9c00,
     0xa000, 0xa400, 0xa800, 0xac00, 0xb000, 0xb400, 0xb800, 0xbc00,
     0xc000, 0xc400, 0xc800, 0xcc00, 0xd000, 0xd400, 0xd800, 0xdc00,
-    0xe000, 0xe400, 0xe800, 0xec00, 0xf000, 0xf400, 0xfc00, 0xfc00,
+    0xe000, 0xe400, 0xe800, 0xec00, 0xf000, 0xf400, 0xf800, 0xfc00,
     0xfc00, 0xfc00, 0xfc00, 0xfc00, 0xfc00, 0xfc00, 0xfc00, 0xfc00,
     0xfc00, 0xfc00, 0xfc00, 0xfc00, 0xfc00, 0xfc00, 0xfc00, 0xfc00,
     0xfc00, 0xfc00, 0xfc00, 0xfc00, 0xfc00, 0xfc00, 0xfc00, 0xfc00,
@@ -392,7 +392,7 @@ static const uint16_t shifttable[] = {
     0x000e, 0x000d, 0x000d, 0x000d, 0x000d, 0x000d, 0x000d, 0x000d,
     0x000d, 0x000d, 0x000d, 0x000d, 0x000d, 0x000d, 0x000d, 0x000d,
     0x000d, 0x000d, 0x000d, 0x000d, 0x000d, 0x000d, 0x000d, 0x000d,
-    0x000d, 0x000d, 0x000d, 0x000d, 0x000d, 0x000d, 0x0018, 0x0018,
+    0x000d, 0x000d, 0x000d, 0x000d, 0x000d, 0x000d, 0x000d, 0x0018,
     0x0018, 0x0018, 0x0018, 0x0018, 0x0018, 0x0018, 0x0018, 0x0018,
     0x0018, 0x0018, 0x0018, 0x0018, 0x0018, 0x0018, 0x0018, 0x0018,
     0x0018, 0x0018, 0x0018, 0x0018, 0x0018, 0x0018, 0x0018, 0x0018,
@@ -424,7 +424,7 @@ static const uint16_t shifttable[] = {
     0x000e, 0x000d, 0x000d, 0x000d, 0x000d, 0x000d, 0x000d, 0x000d,
     0x000d, 0x000d, 0x000d, 0x000d, 0x000d, 0x000d, 0x000d, 0x000d,
     0x000d, 0x000d, 0x000d, 0x000d, 0x000d, 0x000d, 0x000d, 0x000d,
-    0x000d, 0x000d, 0x000d, 0x000d, 0x000d, 0x000d, 0x0018, 0x0018,
+    0x000d, 0x000d, 0x000d, 0x000d, 0x000d, 0x000d, 0x000d, 0x0018,
     0x0018, 0x0018, 0x0018, 0x0018, 0x0018, 0x0018, 0x0018, 0x0018,
     0x0018, 0x0018, 0x0018, 0x0018, 0x0018, 0x0018, 0x0018, 0x0018,
     0x0018, 0x0018, 0x0018, 0x0018, 0x0018, 0x0018, 0x0018, 0x0018,
@@ -492,3 +492,174 @@ uint16_t pack_float16(float f) {
     ret = basetable[in.exp] + (in.sig >> shifttable[in.exp]);
     return htobe16(ret);
 }
+
+
+// Batch conversions /////////////////////////////////////////////////////////
+//
+// These convert whole arrays at once. On x86 CPUs with the F16C extension
+// (checked at run time) they work on several values at a time with its
+// conversion instructions, which give exactly the same results as the tables
+// above; elsewhere they fall back to the scalar routines
+
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#include <immintrin.h>
+#define HAVE_F16C_KERNELS 1
+
+static bool
+have_f16c(void)
+{
+    // Racing threads all store the same answer
+    static int supported = -1;
+
+    if (supported == -1) {
+        __builtin_cpu_init();
+        supported = __builtin_cpu_supports("avx") &&
+            __builtin_cpu_supports("f16c");
+    }
+    return supported;
+}
+#endif
+
+
+static inline uint16_t
+swap_half(uint16_t half)
+{
+    return (uint16_t) ((half << 8) | (half >> 8));
+}
+
+
+static void
+unpack_float16_array_scalar(const char *in, float *out, size_t count,
+                            bool little)
+{
+    uint16_t half;
+    size_t i;
+
+    for (i = 0; i < count; i++) {
+        // unpack_float16 takes the value as laid out in big-endian order
+        memcpy(&half, in + i * 2, 2);
+        out[i] = unpack_float16(little ? swap_half(half) : half);
+    }
+}
+
+
+static void
+minimal_float_widths_scalar(const double *in, uint16_t *halves,
+                            uint8_t *widths, size_t count)
+{
+    float single;
+    uint16_t half;
+    size_t i;
+
+    for (i = 0; i < count; i++) {
+        single = (float) in[i];
+        widths[i] = 8;
+        if (single == in[i]) {
+            widths[i] = 4;
+            half = pack_float16(single);
+            if (unpack_float16(half) == single) {
+                widths[i] = 2;
+                halves[i] = PY_BIG_ENDIAN ? half : swap_half(half);
+            }
+        } else if (isnan(in[i])) {
+            widths[i] = 2;
+            halves[i] = 0x7E00;
+        }
+    }
+}
+
+
+#ifdef HAVE_F16C_KERNELS
+__attribute__((target("avx,f16c")))
+static void
+unpack_float16_array_f16c(const char *in, float *out, size_t count,
+                          bool little)
+{
+    const __m128i swap = _mm_set_epi8(
+            14, 15, 12, 13, 10, 11, 8, 9, 6, 7, 4, 5, 2, 3, 0, 1);
+    const __m128i exponent = _mm_set1_epi16(0x7C00);
+    __m128i halves, special;
+    size_t i;
+
+    for (i = 0; i + 8 <= count; i += 8) {
+        halves = _mm_loadu_si128((const __m128i *) (in + i * 2));
+        if (!little)
+            halves = _mm_shuffle_epi8(halves, swap);
+        // F16C quiets signalling NaNs, which the tables don't, so blocks
+        // holding any NaNs (or infinities) are left to the scalar routine
+        special = _mm_cmpeq_epi16(_mm_and_si128(halves, exponent), exponent);
+        if (_mm_testz_si128(special, special))
+            _mm256_storeu_ps(out + i, _mm256_cvtph_ps(halves));
+        else
+            unpack_float16_array_scalar(in + i * 2, out + i, 8, little);
+    }
+    unpack_float16_array_scalar(in + i * 2, out + i, count - i, little);
+}
+
+
+__attribute__((target("avx,f16c")))
+static void
+minimal_float_widths_f16c(const double *in, uint16_t *halves,
+                          uint8_t *widths, size_t count)
+{
+    __m256d doubles;
+    __m128 singles;
+    __m128i packed;
+    int exact_single, exact_half, j;
+    size_t i;
+
+    for (i = 0; i + 4 <= count; i += 4) {
+        doubles = _mm256_loadu_pd(in + i);
+        singles = _mm256_cvtpd_ps(doubles);
+        exact_single = _mm256_movemask_pd(_mm256_cmp_pd(
+                    doubles, _mm256_cvtps_pd(singles), _CMP_EQ_OQ));
+        packed = _mm_cvtps_ph(singles, _MM_FROUND_TO_NEAREST_INT);
+        exact_half = exact_single & _mm_movemask_ps(_mm_cmp_ps(
+                    singles, _mm_cvtph_ps(packed), _CMP_EQ_OQ));
+        _mm_storel_epi64((__m128i *) (halves + i), packed);
+        for (j = 0; j < 4; j++) {
+            if (exact_half & (1 << j))
+                widths[i + j] = 2;
+            else if (exact_single & (1 << j))
+                widths[i + j] = 4;
+            else
+                minimal_float_widths_scalar(
+                        in + i + j, halves + i + j, widths + i + j, 1);
+        }
+    }
+    minimal_float_widths_scalar(in + i, halves + i, widths + i, count - i);
+}
+#endif
+
+
+// Converts count half-precision floats at in, stored in little- or big-endian
+// order, to single-precision ones at out
+void
+unpack_float16_array(const char *in, float *out, size_t count, bool little)
+{
+#ifdef HAVE_F16C_KERNELS
+    if (have_f16c()) {
+        unpack_float16_array_f16c(in, out, count, little);
+        return;
+    }
+#endif
+    unpack_float16_array_scalar(in, out, count, little);
+}
+
+
+// Works out the narrowest width (2, 4 or 8 bytes) each of count doubles at in
+// can be encoded in without losing precision, storing it in widths. For those
+// that fit in 2, the half-precision value (in native byte order) is stored in
+// halves; NaNs of any kind are given 2 and the canonical NaN 0x7E00
+void
+minimal_float_widths(const double *in, uint16_t *halves, uint8_t *widths,
+                     size_t count)
+{
+#ifdef HAVE_F16C_KERNELS
+    if (have_f16c()) {
+        minimal_float_widths_f16c(in, halves, widths, count);
+        return;
+    }
+#endif
+    minimal_float_widths_scalar(in, halves, widths, count);
+}
@@ -1,4 +1,8 @@
+#include <stdbool.h>
+#include <stddef.h>
 #include <stdint.h>
 
 float unpack_float16(uint16_t);
 uint16_t pack_float16(float f);
+void unpack_float16_array(const char *, float *, size_t, bool);
+void minimal_float_widths(const double *, uint16_t *, uint8_t *, size_t);
@@ -211,6 +211,62 @@ CBORSimpleValue_richcompare(PyObject *a, PyObject *b, int op)
 }
 
 
+// CBORRaw namedtuple ////////////////////////////////////////////////////////
+
+PyTypeObject CBORRawType;
+
+static PyStructSequence_Field CBORRawFields[] = {
+    {.name = "data"},
+    {NULL},
+};
+
+PyDoc_STRVAR(_CBOR2_CBORRaw__doc__,
+"Wraps a value that is already encoded as CBOR, to be written out verbatim\n"
+"by the encoder."
+);
+
+static PyStructSequence_Desc CBORRawDesc = {
+    .name = "CBORRaw",
+    .doc = _CBOR2_CBORRaw__doc__,
+    .fields = CBORRawFields,
+    .n_in_sequence = 1,
+};
+
+PyObject *
+CBORRaw_New(PyObject *data)
+{
+    PyObject *ret = PyStructSequence_New(&CBORRawType);
+
+    if (ret) {
+        Py_INCREF(data);
+        PyStructSequence_SET_ITEM(ret, 0, data);
+    }
+    return ret;
+}
+
+static PyObject *
+CBORRaw_new(PyTypeObject *type, PyObject *args, PyObject *kwargs)
+{
+    static char *keywords[] = {"data", NULL};
+    PyObject *data, *bytes, *ret = NULL;
+
+    if (!PyArg_ParseTupleAndKeywords(args, kwargs, "O", keywords, &data))
+        return NULL;
+
+    if (!PyObject_CheckBuffer(data)) {
+        PyErr_SetString(PyExc_TypeError,
+                        "CBORRaw data must be a bytes-like object");
+        return NULL;
+    }
+    bytes = PyBytes_FromObject(data);
+    if (bytes) {
+        ret = CBORRaw_New(bytes);
+        Py_DECREF(bytes);
+    }
+    return ret;
+}
+
+
 // dump/load functions ///////////////////////////////////////////////////////
 
 static PyObject *
@@ -256,66 +312,126 @@ CBOR2_dump(PyObject *module, PyObject *args, PyObject *kwargs)
 }
 
 
+// Shared implementation of dumps() and dumps_sequence(); the first argument
+// (named *first_arg*) is passed to *encode*
 static PyObject *
-CBOR2_dumps(PyObject *module, PyObject *args, PyObject *kwargs)
+dumps_common(PyObject *args, PyObject *kwargs, char *first_arg,
+             PyObject * (*encode)(CBOREncoderObject *, PyObject *))
 {
-    PyObject *fp, *result, *new_args = NULL, *obj = NULL, *ret = NULL;
-    Py_ssize_t i;
+    char *keywords[] = {
+        first_arg, "datetime_as_timestamp", "timezone", "value_sharing",
+        "default", "canonical", "date_as_datetime", "string_referencing",
+        "record_format", NULL
+    };
+    PyObject *obj, *result, *default_handler = NULL, *tz = NULL,
+             *record_format = NULL, *ret = NULL;
+    int value_sharing = 0, timestamp_format = 0, enc_style = 0,
+        date_as_datetime = 0, string_referencing = 0;
+    CBOREncoderObject *self;
 
-    if (!_CBOR2_BytesIO && _CBOR2_init_BytesIO() == -1)
+    if (!PyArg_ParseTupleAndKeywords(args, kwargs, "O|pOpOpppO", keywords,
+                &obj, &timestamp_format, &tz, &value_sharing,
+                &default_handler, &enc_style, &date_as_datetime,
+                &string_referencing, &record_format))
         return NULL;
 
-    fp = PyObject_CallFunctionObjArgs(_CBOR2_BytesIO, NULL);
-    if (fp) {
-        if (PyTuple_GET_SIZE(args) == 0) {
-            if (kwargs)
-                obj = PyDict_GetItem(kwargs, _CBOR2_str_obj);
-            if (obj) {
-                if (PyDict_DelItem(kwargs, _CBOR2_str_obj) == 0)
-                    new_args = PyTuple_Pack(2, obj, fp);
-            } else {
-                PyErr_SetString(PyExc_TypeError,
-                        "dumps missing required argument: 'obj'");
-            }
-        } else {
-            obj = PyTuple_GET_ITEM(args, 0);
-            new_args = PyTuple_New(PyTuple_GET_SIZE(args) + 1);
-            if (new_args) {
-                Py_INCREF(obj);
-                Py_INCREF(fp);
-                PyTuple_SET_ITEM(new_args, 0, obj);  // steals ref
-                PyTuple_SET_ITEM(new_args, 1, fp);  // steals ref
-                for (i = 1; i < PyTuple_GET_SIZE(args); ++i) {
-                    Py_INCREF(PyTuple_GET_ITEM(args, i));
-                    PyTuple_SET_ITEM(new_args, i + 1, PyTuple_GET_ITEM(args, i));
-                }
-            }
-        }
-
-        if (new_args) {
-            result = CBOR2_dump(module, new_args, kwargs);
+    // The encoder is given no fp so the output accumulates in its internal
+    // buffer, which is then copied straight into the result
+    self = (CBOREncoderObject *)CBOREncoder_new(&CBOREncoderType, NULL, NULL);
+    if (self) {
+        if (CBOREncoder_init_options(
+                    self, timestamp_format, tz, value_sharing,
+                    default_handler, enc_style, date_as_datetime,
+                    string_referencing, record_format) == 0) {
+            result = encode(self, obj);
             if (result) {
-                ret = PyObject_CallMethodObjArgs(fp, _CBOR2_str_getvalue, NULL);
+                ret = PyBytes_FromStringAndSize(
+                        self->buffer, self->buffer_len);
                 Py_DECREF(result);
             }
-            Py_DECREF(new_args);
         }
-        Py_DECREF(fp);
+        Py_DECREF(self);
     }
     return ret;
 }
 
 
+static PyObject *
+CBOR2_dumps(PyObject *module, PyObject *args, PyObject *kwargs)
+{
+    return dumps_common(args, kwargs, "obj", CBOREncoder_encode);
+}
+
+
+static PyObject *
+CBOR2_dumps_sequence(PyObject *module, PyObject *args, PyObject *kwargs)
+{
+    return dumps_common(args, kwargs, "objs", CBOREncoder_encode_sequence);
+}
+
+
+static PyObject *
+CBOR2_dump_sequence(PyObject *module, PyObject *args, PyObject *kwargs)
+{
+    PyObject *objs = NULL, *ret = NULL;
+    CBOREncoderObject *self;
+    bool decref_args = false;
+
+    if (PyTuple_GET_SIZE(args) == 0) {
+        if (kwargs)
+            objs = PyDict_GetItem(kwargs, _CBOR2_str_objs);
+        if (!objs) {
+            PyErr_SetString(PyExc_TypeError,
+                    "dump_sequence missing 1 required argument: 'objs'");
+            return NULL;
+        }
+        Py_INCREF(objs);
+        if (PyDict_DelItem(kwargs, _CBOR2_str_objs) == -1) {
+            Py_DECREF(objs);
+            return NULL;
+        }
+    } else {
+        objs = PyTuple_GET_ITEM(args, 0);
+        args = PyTuple_GetSlice(args, 1, PyTuple_GET_SIZE(args));
+        if (!args)
+            return NULL;
+        Py_INCREF(objs);
+        decref_args = true;
+    }
+
+    self = (CBOREncoderObject *)CBOREncoder_new(&CBOREncoderType, NULL, NULL);
+    if (self) {
+        if (CBOREncoder_init(self, args, kwargs) == 0) {
+            ret = CBOREncoder_encode_sequence(self, objs);
+        }
+        Py_DECREF(self);
+    }
+    Py_DECREF(objs);
+    if (decref_args)
+        Py_DECREF(args);
+    return ret;
+}
+
+
 static PyObject *
 CBOR2_load(PyObject *module, PyObject *args, PyObject *kwargs)
 {
-    PyObject *ret = NULL;
+    PyObject *tmp, *ret = NULL;
     CBORDecoderObject *self;
 
     self = (CBORDecoderObject *)CBORDecoder_new(&CBORDecoderType, NULL, NULL);
     if (self) {
-        if (CBORDecoder_init(self, args, kwargs) == 0) {
+        if (CBORDecoder_init_int_cache(self, NULL) == 0 &&
+                CBORDecoder_init(self, args, kwargs) == 0) {
             ret = CBORDecoder_decode(self);
+            if (ret) {
+                // leave fp positioned just after the decoded value
+                tmp = CBORDecoder_release_read_ahead(self);
+                if (tmp)
+                    Py_DECREF(tmp);
+                else
+                    Py_CLEAR(ret);
+            }
         }
         Py_DECREF(self);
     }
@@ -326,49 +442,179 @@ CBOR2_load(PyObject *module, PyObject *args, PyObject *kwargs)
 static PyObject *
 CBOR2_loads(PyObject *module, PyObject *args, PyObject *kwargs)
 {
-    PyObject *fp, *new_args = NULL, *s = NULL, *ret = NULL;
-    Py_ssize_t i;
+    static char *keywords[] = {
+        "s", "tag_hook", "object_hook", "str_errors", "record_type",
+        "int_cache_size", "max_items", "max_length", "max_allocation", NULL
+    };
+    PyObject *s, *tag_hook = NULL, *object_hook = NULL, *str_errors = NULL,
+             *record_type = NULL, *int_cache_size = NULL, *max_items = NULL,
+             *max_length = NULL, *max_allocation = NULL, *ret = NULL;
+    CBORDecoderObject *self;
 
-    if (!_CBOR2_BytesIO && _CBOR2_init_BytesIO() == -1)
+    if (!PyArg_ParseTupleAndKeywords(args, kwargs, "O|OOOOOOOO", keywords,
+                &s, &tag_hook, &object_hook, &str_errors, &record_type,
+                &int_cache_size, &max_items, &max_length, &max_allocation))
         return NULL;
 
-    if (PyTuple_GET_SIZE(args) == 0) {
-        if (kwargs) {
-            new_args = PyTuple_New(1);
-            if (new_args) {
-                s = PyDict_GetItem(kwargs, _CBOR2_str_s);
-                Py_INCREF(s);
-                if (PyDict_DelItem(kwargs, _CBOR2_str_s) == -1) {
-                    Py_DECREF(s);
-                    Py_CLEAR(new_args);
-                }
-            }
-        } else {
-            PyErr_SetString(PyExc_TypeError,
-                    "dump missing 1 required argument: 's'");
-        }
+    // The decoder is given no fp; it reads directly from a view of s instead
+    // of going through BytesIO.read()
+    self = (CBORDecoderObject *)CBORDecoder_new(&CBORDecoderType, NULL, NULL);
+    if (self) {
+        if (CBORDecoder_init_options(self, tag_hook, object_hook, str_errors,
+                                     record_type) == 0 &&
+                CBORDecoder_init_int_cache(self, int_cache_size) == 0 &&
+                CBORDecoder_init_limits(self, max_items, max_length,
+                                        max_allocation) == 0 &&
+                CBORDecoder_set_input(self, s) == 0)
+            ret = CBORDecoder_decode(self);
+        Py_DECREF(self);
+    }
+    return ret;
+}
+
+
+static PyObject *
+CBOR2_load_sequence(PyObject *module, PyObject *args, PyObject *kwargs)
+{
+    CBORDecoderObject *self;
+
+    // The decoder is its own iterator over the values in the stream
+    self = (CBORDecoderObject *)CBORDecoder_new(&CBORDecoderType, NULL, NULL);
+    if (self) {
+        if (CBORDecoder_init(self, args, kwargs) == -1)
+            Py_CLEAR(self);
+    }
+    return (PyObject *) self;
+}
+
+
+static PyObject *
+CBOR2_loads_sequence(PyObject *module, PyObject *args, PyObject *kwargs)
+{
+    static char *keywords[] = {
+        "s", "tag_hook", "object_hook", "str_errors", "record_type", NULL
+    };
+    PyObject *s, *tag_hook = NULL, *object_hook = NULL, *str_errors = NULL,
+             *record_type = NULL;
+    CBORDecoderObject *self;
+
+    if (!PyArg_ParseTupleAndKeywords(args, kwargs, "O|OOOO", keywords,
+                &s, &tag_hook, &object_hook, &str_errors, &record_type))
+        return NULL;
+
+    self = (CBORDecoderObject *)CBORDecoder_new(&CBORDecoderType, NULL, NULL);
+    if (self) {
+        if (CBORDecoder_init_options(self, tag_hook, object_hook, str_errors,
+                                     record_type) == -1 ||
+                CBORDecoder_set_input(self, s) == -1)
+            Py_CLEAR(self);
+    }
+    return (PyObject *) self;
+}
+
+
+static PyObject *
+CBOR2_loads_sequence_parallel(PyObject *module, PyObject *args,
+                              PyObject *kwargs)
+{
+    static char *keywords[] = {
+        "s", "tag_hook", "object_hook", "str_errors", "record_type", "workers",
+        NULL
+    };
+    PyObject *s, *tag_hook = NULL, *object_hook = NULL, *str_errors = NULL,
+             *record_type = NULL, *workers = Py_None, *os, *tmp,
+             *ret = NULL;
+    CBORDecoderObject *self;
+    Py_ssize_t count;
+
+    if (!PyArg_ParseTupleAndKeywords(args, kwargs, "O|OOOO$O", keywords,
+                &s, &tag_hook, &object_hook, &str_errors, &record_type,
+                &workers))
+        return NULL;
+
+    if (workers == Py_None) {
+        // workers = os.cpu_count() or 1
+        os = PyImport_ImportModule("os");
+        if (!os)
+            return NULL;
+        tmp = PyObject_CallMethod(os, "cpu_count", NULL);
+        Py_DECREF(os);
+        if (!tmp)
+            return NULL;
+        count = tmp == Py_None ? 1 : PyLong_AsSsize_t(tmp);
+        Py_DECREF(tmp);
+        if (count == -1 && PyErr_Occurred())
+            return NULL;
     } else {
-        new_args = PyTuple_New(PyTuple_GET_SIZE(args));
-        if (new_args) {
-            s = PyTuple_GET_ITEM(args, 0);
-            Py_INCREF(s);
-            for (i = 1; i < PyTuple_GET_SIZE(args); ++i) {
-                // inc. ref because PyTuple_SET_ITEM steals a ref
-                Py_INCREF(PyTuple_GET_ITEM(args, i));
-                PyTuple_SET_ITEM(new_args, i, PyTuple_GET_ITEM(args, i));
-            }
+        count = PyLong_AsSsize_t(workers);
+        if (count == -1 && PyErr_Occurred())
+            return NULL;
+        if (count < 1) {
+            PyErr_Format(PyExc_ValueError,
+                         "invalid workers value %R (must be a positive int "
+                         "or None)", workers);
+            return NULL;
         }
     }
 
-    if (new_args) {
-        fp = PyObject_CallFunctionObjArgs(_CBOR2_BytesIO, s, NULL);
-        if (fp) {
-            PyTuple_SET_ITEM(new_args, 0, fp);
-            ret = CBOR2_load(module, new_args, kwargs);
-            // no need to dec. ref fp here because SET_ITEM above stole the ref
-        }
-        Py_DECREF(s);
-        Py_DECREF(new_args);
+    self = (CBORDecoderObject *)CBORDecoder_new(&CBORDecoderType, NULL, NULL);
+    if (self) {
+        if (CBORDecoder_init_options(self, tag_hook, object_hook, str_errors,
+                                     record_type) == 0 &&
+                CBORDecoder_set_input(self, s) == 0)
+            ret = CBORDecoder_decode_parallel(self, count);
+        Py_DECREF(self);
+    }
+    return ret;
+}
+
+
+static PyObject *
+CBOR2_loads_lazy(PyObject *module, PyObject *args, PyObject *kwargs)
+{
+    static char *keywords[] = {"s", "tag_hook", "str_errors", NULL};
+    PyObject *s, *tag_hook = NULL, *str_errors = NULL, *ret = NULL;
+    CBORDecoderObject *self;
+
+    if (!PyArg_ParseTupleAndKeywords(args, kwargs, "O|OO", keywords,
+                &s, &tag_hook, &str_errors))
+        return NULL;
+
+    // The decoder keeps its view of s for as long as any lazy container
+    // returned from it is alive
+    self = (CBORDecoderObject *)CBORDecoder_new(&CBORDecoderType, NULL, NULL);
+    if (self) {
+        if (CBORDecoder_init_options(
+                    self, tag_hook, NULL, str_errors, NULL) == 0 &&
+                CBORDecoder_set_input(self, s) == 0)
+            ret = CBORDecoder_decode_lazy(self);
+        Py_DECREF(self);
+    }
+    return ret;
+}
+
+
+static PyObject *
+CBOR2_extract(PyObject *module, PyObject *args, PyObject *kwargs)
+{
+    static char *keywords[] = {
+        "s", "paths", "default", "tag_hook", "str_errors", NULL
+    };
+    PyObject *s, *paths, *default_value = Py_None, *tag_hook = NULL,
+             *str_errors = NULL, *ret = NULL;
+    CBORDecoderObject *self;
+
+    if (!PyArg_ParseTupleAndKeywords(args, kwargs, "OO|$OOO", keywords,
+                &s, &paths, &default_value, &tag_hook, &str_errors))
+        return NULL;
+
+    self = (CBORDecoderObject *)CBORDecoder_new(&CBORDecoderType, NULL, NULL);
+    if (self) {
+        if (CBORDecoder_init_options(
+                    self, tag_hook, NULL, str_errors, NULL) == 0 &&
+                CBORDecoder_set_input(self, s) == 0)
+            ret = CBORDecoder_extract(self, paths, default_value);
+        Py_DECREF(self);
     }
     return ret;
 }
@@ -376,6 +622,24 @@ CBOR2_loads(PyObject *module, PyObject *args, PyObject *kwargs)
 
 // Cache-init functions //////////////////////////////////////////////////////
 
+#ifdef Py_GIL_DISABLED
+// Held while any of the functions below runs; see CBOR2_INIT in module.h
+static PyMutex init_lock = {0};
+
+int
+_CBOR2_init_locked(PyObject **global, int (*init)(void))
+{
+    int ret = 0;
+
+    PyMutex_Lock(&init_lock);
+    if (!*global)
+        ret = init();
+    PyMutex_Unlock(&init_lock);
+    return ret;
+}
+#endif
+
+
 int
 _CBOR2_init_BytesIO(void)
 {
@@ -437,6 +701,47 @@ error:
 }
 
 
+int
+_CBOR2_init_Enum(void)
+{
+    PyObject *enum_mod;
+
+    // from enum import Enum
+    enum_mod = PyImport_ImportModule("enum");
+    if (!enum_mod)
+        goto error;
+    _CBOR2_Enum = PyObject_GetAttr(enum_mod, _CBOR2_str_Enum);
+    Py_DECREF(enum_mod);
+    if (!_CBOR2_Enum)
+        goto error;
+    return 0;
+error:
+    PyErr_SetString(PyExc_ImportError, "unable to import Enum from enum");
+    return -1;
+}
+
+
+int
+_CBOR2_init_dataclass_fields(void)
+{
+    PyObject *dataclasses;
+
+    // from dataclasses import fields
+    dataclasses = PyImport_ImportModule("dataclasses");
+    if (!dataclasses)
+        goto error;
+    _CBOR2_dataclass_fields = PyObject_GetAttr(dataclasses, _CBOR2_str_fields);
+    Py_DECREF(dataclasses);
+    if (!_CBOR2_dataclass_fields)
+        goto error;
+    return 0;
+error:
+    PyErr_SetString(PyExc_ImportError,
+            "unable to import fields from dataclasses");
+    return -1;
+}
+
+
 int
 _CBOR2_init_Fraction(void)
 {
@@ -499,16 +804,6 @@ _CBOR2_init_re_compile(void)
         goto error;
     }
 
-    _CBOR2_datetimestr_re = PyObject_CallFunctionObjArgs(
-            _CBOR2_re_compile, _CBOR2_str_datetimestr_re, NULL);
-    if (!_CBOR2_datetimestr_re)
-        goto error;
-
-    _CBOR2_datestr_re = PyObject_CallFunctionObjArgs(
-            _CBOR2_re_compile, _CBOR2_str_datestr_re, NULL);
-    if (!_CBOR2_datestr_re)
-        goto error;
-
     _CBOR2_datestr_re = PyObject_CallFunctionObjArgs(
             _CBOR2_re_compile, _CBOR2_str_datestr_re, NULL);
     if (!_CBOR2_datestr_re)
@@ -596,11 +891,55 @@ _CBOR2_init_thread_locals(void)
 }
 
 
+int
+_CBOR2_init_array(void)
+{
+    PyObject *array;
+
+    // from array import array
+    array = PyImport_ImportModule("array");
+    if (!array)
+        goto error;
+    _CBOR2_array = PyObject_GetAttr(array, _CBOR2_str_array);
+    Py_DECREF(array);
+    if (!_CBOR2_array)
+        goto error;
+    return 0;
+error:
+    PyErr_SetString(PyExc_ImportError, "unable to import array from array");
+    return -1;
+}
+
+
+int
+_CBOR2_init_Mapping(void)
+{
+    PyObject *abc;
+
+    // from collections.abc import Mapping
+    abc = PyImport_ImportModule("collections.abc");
+    if (!abc)
+        goto error;
+    _CBOR2_Mapping = PyObject_GetAttr(abc, _CBOR2_str_Mapping);
+    Py_DECREF(abc);
+    if (!_CBOR2_Mapping)
+        goto error;
+    return 0;
+error:
+    PyErr_SetString(PyExc_ImportError,
+            "unable to import Mapping from collections.abc");
+    return -1;
+}
+
+
 // Module definition /////////////////////////////////////////////////////////
 
 PyObject *_CBOR2_empty_bytes = NULL;
 PyObject *_CBOR2_empty_str = NULL;
 PyObject *_CBOR2_date_ordinal_offset = NULL;
+PyObject *_CBOR2_str___dataclass_fields__ = NULL;
+PyObject *_CBOR2_str__fields = NULL;
+PyObject *_CBOR2_str_array = NULL;
 PyObject *_CBOR2_str_as_string = NULL;
 PyObject *_CBOR2_str_as_tuple = NULL;
 PyObject *_CBOR2_str_bit_length = NULL;
@@ -609,28 +948,35 @@ PyObject *_CBOR2_str_BytesIO = NULL;
 PyObject *_CBOR2_str_canonical_encoders = NULL;
 PyObject *_CBOR2_str_compile = NULL;
 PyObject *_CBOR2_str_copy = NULL;
-PyObject *_CBOR2_str_datetimestr_re = NULL;
 PyObject *_CBOR2_str_datestr_re = NULL;
 PyObject *_CBOR2_str_Decimal = NULL;
 PyObject *_CBOR2_str_default_encoders = NULL;
 PyObject *_CBOR2_str_denominator = NULL;
 PyObject *_CBOR2_str_encode_date = NULL;
+PyObject *_CBOR2_str_Enum = NULL;
+PyObject *_CBOR2_str_fields = NULL;
 PyObject *_CBOR2_str_Fraction = NULL;
+PyObject *_CBOR2_str_frombytes = NULL;
 PyObject *_CBOR2_str_fromtimestamp = NULL;
 PyObject *_CBOR2_str_FrozenDict = NULL;
 PyObject *_CBOR2_str_fromordinal = NULL;
 PyObject *_CBOR2_str_getvalue = NULL;
 PyObject *_CBOR2_str_groups = NULL;
+PyObject *_CBOR2_str_init = NULL;
 PyObject *_CBOR2_str_ip_address = NULL;
 PyObject *_CBOR2_str_ip_network = NULL;
 PyObject *_CBOR2_str_is_infinite = NULL;
 PyObject *_CBOR2_str_is_nan = NULL;
 PyObject *_CBOR2_str_isoformat = NULL;
 PyObject *_CBOR2_str_join = NULL;
+PyObject *_CBOR2_str_keys = NULL;
+PyObject *_CBOR2_str_Mapping = NULL;
 PyObject *_CBOR2_str_match = NULL;
+PyObject *_CBOR2_str_name = NULL;
 PyObject *_CBOR2_str_network_address = NULL;
 PyObject *_CBOR2_str_numerator = NULL;
 PyObject *_CBOR2_str_obj = NULL;
+PyObject *_CBOR2_str_objs = NULL;
 PyObject *_CBOR2_str_packed = NULL;
 PyObject *_CBOR2_str_Parser = NULL;
 PyObject *_CBOR2_str_parsestr = NULL;
@@ -638,13 +984,18 @@ PyObject *_CBOR2_str_pattern = NULL;
 PyObject *_CBOR2_str_prefixlen = NULL;
 PyObject *_CBOR2_str_read = NULL;
 PyObject *_CBOR2_str_s = NULL;
+PyObject *_CBOR2_str_seek = NULL;
+PyObject *_CBOR2_str_seekable = NULL;
+PyObject *_CBOR2_str_tell = NULL;
 PyObject *_CBOR2_str_timestamp = NULL;
 PyObject *_CBOR2_str_toordinal = NULL;
 PyObject *_CBOR2_str_timezone = NULL;
 PyObject *_CBOR2_str_update = NULL;
 PyObject *_CBOR2_str_utc = NULL;
+PyObject *_CBOR2_str_utcoffset = NULL;
 PyObject *_CBOR2_str_utc_suffix = NULL;
 PyObject *_CBOR2_str_UUID = NULL;
+PyObject *_CBOR2_str_value = NULL;
 PyObject *_CBOR2_str_write = NULL;
 
 PyObject *_CBOR2_CBORError = NULL;
@@ -659,17 +1010,20 @@ PyObject *_CBOR2_timezone = NULL;
 PyObject *_CBOR2_timezone_utc = NULL;
 PyObject *_CBOR2_BytesIO = NULL;
 PyObject *_CBOR2_Decimal = NULL;
+PyObject *_CBOR2_Enum = NULL;
+PyObject *_CBOR2_dataclass_fields = NULL;
 PyObject *_CBOR2_Fraction = NULL;
 PyObject *_CBOR2_FrozenDict = NULL;
 PyObject *_CBOR2_UUID = NULL;
 PyObject *_CBOR2_Parser = NULL;
 PyObject *_CBOR2_re_compile = NULL;
 PyObject *_CBOR2_re_error = NULL;
-PyObject *_CBOR2_datetimestr_re = NULL;
 PyObject *_CBOR2_datestr_re = NULL;
 PyObject *_CBOR2_ip_address = NULL;
 PyObject *_CBOR2_ip_network = NULL;
 PyObject *_CBOR2_thread_locals = NULL;
+PyObject *_CBOR2_array = NULL;
+PyObject *_CBOR2_Mapping = NULL;
 
 PyObject *_CBOR2_default_encoders = NULL;
 PyObject *_CBOR2_canonical_encoders = NULL;
@@ -681,15 +1035,18 @@ cbor2_free(PyObject *m)
     Py_CLEAR(_CBOR2_timezone);
     Py_CLEAR(_CBOR2_BytesIO);
     Py_CLEAR(_CBOR2_Decimal);
+    Py_CLEAR(_CBOR2_Enum);
+    Py_CLEAR(_CBOR2_dataclass_fields);
     Py_CLEAR(_CBOR2_Fraction);
     Py_CLEAR(_CBOR2_UUID);
     Py_CLEAR(_CBOR2_Parser);
     Py_CLEAR(_CBOR2_re_compile);
-    Py_CLEAR(_CBOR2_datetimestr_re);
     Py_CLEAR(_CBOR2_datestr_re);
     Py_CLEAR(_CBOR2_ip_address);
     Py_CLEAR(_CBOR2_ip_network);
     Py_CLEAR(_CBOR2_thread_locals);
+    Py_CLEAR(_CBOR2_array);
+    Py_CLEAR(_CBOR2_Mapping);
     Py_CLEAR(_CBOR2_CBOREncodeError);
     Py_CLEAR(_CBOR2_CBOREncodeTypeError);
     Py_CLEAR(_CBOR2_CBOREncodeValueError);
@@ -706,10 +1063,35 @@ static PyMethodDef _cbor2methods[] = {
         "encode a value to the stream"},
     {"dumps", (PyCFunction) CBOR2_dumps, METH_VARARGS | METH_KEYWORDS,
         "encode a value to a byte-string"},
+    {"dump_sequence", (PyCFunction) CBOR2_dump_sequence,
+        METH_VARARGS | METH_KEYWORDS,
+        "encode each of the specified values to the stream as a CBOR "
+        "sequence"},
+    {"dumps_sequence", (PyCFunction) CBOR2_dumps_sequence,
+        METH_VARARGS | METH_KEYWORDS,
+        "encode each of the specified values to a byte-string as a CBOR "
+        "sequence"},
     {"load", (PyCFunction) CBOR2_load, METH_VARARGS | METH_KEYWORDS,
         "decode a value from the stream"},
     {"loads", (PyCFunction) CBOR2_loads, METH_VARARGS | METH_KEYWORDS,
         "decode a value from a byte-string"},
+    {"load_sequence", (PyCFunction) CBOR2_load_sequence,
+        METH_VARARGS | METH_KEYWORDS,
+        "iterate over the values of a CBOR sequence read from the stream"},
+    {"loads_sequence", (PyCFunction) CBOR2_loads_sequence,
+        METH_VARARGS | METH_KEYWORDS,
+        "iterate over the values of a CBOR sequence in a byte-string"},
+    {"loads_sequence_parallel", (PyCFunction) CBOR2_loads_sequence_parallel,
+        METH_VARARGS | METH_KEYWORDS,
+        "decode all the values of a CBOR sequence in a byte-string to a "
+        "list, using several threads"},
+    {"loads_lazy", (PyCFunction) CBOR2_loads_lazy,
+        METH_VARARGS | METH_KEYWORDS,
+        "decode a value from a byte-string, deferring decoding of the items "
+        "of arrays and maps until they're accessed"},
+    {"extract", (PyCFunction) CBOR2_extract, METH_VARARGS | METH_KEYWORDS,
+        "decode only the values at the given paths of map keys and array "
+        "indexes in a byte-string"},
     {NULL}
 };
 
@@ -826,10 +1208,23 @@ PyInit__cbor2(void)
         return NULL;
     if (PyType_Ready(&CBORDecoderType) < 0)
         return NULL;
+    if (PyType_Ready(&CBORLazyArrayType) < 0)
+        return NULL;
+    if (PyType_Ready(&CBORLazyMapType) < 0)
+        return NULL;
+    if (PyType_Ready(&CBORIncrementalDecoderType) < 0)
+        return NULL;
 
     module = PyModule_Create(&_cbor2module);
     if (!module)
         return NULL;
+#ifdef Py_GIL_DISABLED
+    // Each encoder and decoder is only meant to be used by one thread at a
+    // time. The references cached by the module are set up under a lock (see
+    // CBOR2_INIT), and the dict watcher of the encoders (see encoder.c) is
+    // registered below and only counts atomically
+    PyUnstable_Module_SetGIL(module, Py_MOD_GIL_NOT_USED);
+#endif
 
     _CBOR2_CBORError = PyErr_NewExceptionWithDoc(
             "_cbor2.CBORError", _cbor2_CBORError__doc__, NULL, NULL);
@@ -912,6 +1307,14 @@ PyInit__cbor2(void)
             module, "CBORSimpleValue", (PyObject *) &CBORSimpleValueType) == -1)
         goto error;
 
+    if (PyStructSequence_InitType2(&CBORRawType, &CBORRawDesc) == -1)
+        goto error;
+
+    Py_INCREF((PyObject *) &CBORRawType);
+    CBORRawType.tp_new = CBORRaw_new;
+    if (PyModule_AddObject(module, "CBORRaw", (PyObject *) &CBORRawType) == -1)
+        goto error;
+
     Py_INCREF(&CBORTagType);
     if (PyModule_AddObject(module, "CBORTag", (PyObject *) &CBORTagType) == -1)
         goto error;
@@ -924,6 +1327,19 @@ PyInit__cbor2(void)
     if (PyModule_AddObject(module, "CBORDecoder", (PyObject *) &CBORDecoderType) == -1)
         goto error;
 
+    Py_INCREF(&CBORLazyArrayType);
+    if (PyModule_AddObject(module, "LazyArray", (PyObject *) &CBORLazyArrayType) == -1)
+        goto error;
+
+    Py_INCREF(&CBORLazyMapType);
+    if (PyModule_AddObject(module, "LazyMap", (PyObject *) &CBORLazyMapType) == -1)
+        goto error;
+
+    Py_INCREF(&CBORIncrementalDecoderType);
+    if (PyModule_AddObject(module, "IncrementalDecoder",
+                (PyObject *) &CBORIncrementalDecoderType) == -1)
+        goto error;
+
     Py_INCREF(break_marker);
     if (PyModule_AddObject(module, "break_marker", break_marker) == -1)
         goto error;
@@ -937,6 +1353,9 @@ PyInit__cbor2(void)
             !(_CBOR2_str_##name = PyUnicode_InternFromString(#name))) \
         goto error;
 
+    INTERN_STRING(__dataclass_fields__);
+    INTERN_STRING(_fields);
+    INTERN_STRING(array);
     INTERN_STRING(as_string);
     INTERN_STRING(as_tuple);
     INTERN_STRING(bit_length);
@@ -949,22 +1368,30 @@ PyInit__cbor2(void)
     INTERN_STRING(default_encoders);
     INTERN_STRING(denominator);
     INTERN_STRING(encode_date);
+    INTERN_STRING(Enum);
+    INTERN_STRING(fields);
     INTERN_STRING(Fraction);
+    INTERN_STRING(frombytes);
     INTERN_STRING(fromtimestamp);
     INTERN_STRING(FrozenDict);
     INTERN_STRING(fromordinal);
     INTERN_STRING(getvalue);
     INTERN_STRING(groups);
+    INTERN_STRING(init);
     INTERN_STRING(ip_address);
     INTERN_STRING(ip_network);
     INTERN_STRING(is_infinite);
     INTERN_STRING(is_nan);
     INTERN_STRING(isoformat);
     INTERN_STRING(join);
+    INTERN_STRING(keys);
+    INTERN_STRING(Mapping);
     INTERN_STRING(match);
+    INTERN_STRING(name);
     INTERN_STRING(network_address);
     INTERN_STRING(numerator);
     INTERN_STRING(obj);
+    INTERN_STRING(objs);
     INTERN_STRING(packed);
     INTERN_STRING(Parser);
     INTERN_STRING(parsestr);
@@ -972,12 +1399,17 @@ PyInit__cbor2(void)
     INTERN_STRING(prefixlen);
     INTERN_STRING(read);
     INTERN_STRING(s);
+    INTERN_STRING(seek);
+    INTERN_STRING(seekable);
+    INTERN_STRING(tell);
     INTERN_STRING(timestamp);
     INTERN_STRING(toordinal);
     INTERN_STRING(timezone);
     INTERN_STRING(update);
     INTERN_STRING(utc);
+    INTERN_STRING(utcoffset);
     INTERN_STRING(UUID);
+    INTERN_STRING(value);
     INTERN_STRING(write);
 
 #undef INTERN_STRING
@@ -988,13 +1420,6 @@ PyInit__cbor2(void)
     if (!_CBOR2_str_utc_suffix &&
             !(_CBOR2_str_utc_suffix = PyUnicode_InternFromString("+00:00")))
         goto error;
-    if (!_CBOR2_str_datetimestr_re &&
-        !(_CBOR2_str_datetimestr_re = PyUnicode_InternFromString(
-                    "^(\\d{4})-(\\d\\d)-(\\d\\d)T"     // Y-m-d
-                    "(\\d\\d):(\\d\\d):(\\d\\d)"       // H:M:S
-                    "(?:\\.(\\d{1,6})\\d*)?"           // .uS
-                    "(?:Z|([+-]\\d\\d):(\\d\\d))$")))  // +-TZ
-        goto error;
     if (!_CBOR2_str_datestr_re &&
         !(_CBOR2_str_datestr_re = PyUnicode_InternFromString("^(\\d{4})-(\\d\\d)-(\\d\\d)")))  // Y-m-d
         goto error;
@@ -1004,6 +1429,8 @@ PyInit__cbor2(void)
     if (!_CBOR2_empty_str &&
             !(_CBOR2_empty_str = PyUnicode_FromStringAndSize(NULL, 0)))
         goto error;
+    if (CBOREncoder_init_watcher() == -1)
+        goto error;
 
     return module;
 error:
@@ -29,10 +29,17 @@ extern PyObject _undefined_obj;
 // CBORSimpleValue namedtuple type
 extern PyTypeObject CBORSimpleValueType;
 
+// CBORRaw namedtuple type, and a constructor for it from a bytes object
+extern PyTypeObject CBORRawType;
+PyObject * CBORRaw_New(PyObject *);
+
 // Various interned strings
 extern PyObject *_CBOR2_empty_bytes;
 extern PyObject *_CBOR2_empty_str;
 extern PyObject *_CBOR2_date_ordinal_offset;
+extern PyObject *_CBOR2_str___dataclass_fields__;
+extern PyObject *_CBOR2_str__fields;
+extern PyObject *_CBOR2_str_array;
 extern PyObject *_CBOR2_str_as_string;
 extern PyObject *_CBOR2_str_as_tuple;
 extern PyObject *_CBOR2_str_bit_length;
@@ -41,28 +48,35 @@ extern PyObject *_CBOR2_str_BytesIO;
 extern PyObject *_CBOR2_str_canonical_encoders;
 extern PyObject *_CBOR2_str_compile;
 extern PyObject *_CBOR2_str_copy;
-extern PyObject *_CBOR2_str_datetimestr_re;
 extern PyObject *_CBOR2_str_datestr_re;
 extern PyObject *_CBOR2_str_Decimal;
 extern PyObject *_CBOR2_str_default_encoders;
 extern PyObject *_CBOR2_str_denominator;
 extern PyObject *_CBOR2_str_encode_date;
+extern PyObject *_CBOR2_str_Enum;
+extern PyObject *_CBOR2_str_fields;
 extern PyObject *_CBOR2_str_Fraction;
+extern PyObject *_CBOR2_str_frombytes;
 extern PyObject *_CBOR2_str_fromtimestamp;
 extern PyObject *_CBOR2_str_FrozenDict;
 extern PyObject *_CBOR2_str_fromordinal;
 extern PyObject *_CBOR2_str_getvalue;
 extern PyObject *_CBOR2_str_groups;
+extern PyObject *_CBOR2_str_init;
 extern PyObject *_CBOR2_str_ip_address;
 extern PyObject *_CBOR2_str_ip_network;
 extern PyObject *_CBOR2_str_is_infinite;
 extern PyObject *_CBOR2_str_is_nan;
 extern PyObject *_CBOR2_str_isoformat;
 extern PyObject *_CBOR2_str_join;
+extern PyObject *_CBOR2_str_keys;
+extern PyObject *_CBOR2_str_Mapping;
 extern PyObject *_CBOR2_str_match;
+extern PyObject *_CBOR2_str_name;
 extern PyObject *_CBOR2_str_network_address;
 extern PyObject *_CBOR2_str_numerator;
 extern PyObject *_CBOR2_str_obj;
+extern PyObject *_CBOR2_str_objs;
 extern PyObject *_CBOR2_str_packed;
 extern PyObject *_CBOR2_str_Parser;
 extern PyObject *_CBOR2_str_parsestr;
@@ -70,13 +84,18 @@ extern PyObject *_CBOR2_str_pattern;
 extern PyObject *_CBOR2_str_prefixlen;
 extern PyObject *_CBOR2_str_read;
 extern PyObject *_CBOR2_str_s;
+extern PyObject *_CBOR2_str_seek;
+extern PyObject *_CBOR2_str_seekable;
+extern PyObject *_CBOR2_str_tell;
 extern PyObject *_CBOR2_str_timestamp;
 extern PyObject *_CBOR2_str_toordinal;
 extern PyObject *_CBOR2_str_timezone;
 extern PyObject *_CBOR2_str_update;
 extern PyObject *_CBOR2_str_utc;
+extern PyObject *_CBOR2_str_utcoffset;
 extern PyObject *_CBOR2_str_utc_suffix;
 extern PyObject *_CBOR2_str_UUID;
+extern PyObject *_CBOR2_str_value;
 extern PyObject *_CBOR2_str_write;
 
 // Exception classes
@@ -93,33 +112,51 @@ extern PyObject *_CBOR2_timezone;
 extern PyObject *_CBOR2_timezone_utc;
 extern PyObject *_CBOR2_BytesIO;
 extern PyObject *_CBOR2_Decimal;
+extern PyObject *_CBOR2_Enum;
+extern PyObject *_CBOR2_dataclass_fields;
 extern PyObject *_CBOR2_Fraction;
 extern PyObject *_CBOR2_FrozenDict;
 extern PyObject *_CBOR2_UUID;
 extern PyObject *_CBOR2_Parser;
 extern PyObject *_CBOR2_re_compile;
 extern PyObject *_CBOR2_re_error;
-extern PyObject *_CBOR2_datetimestr_re;
 extern PyObject *_CBOR2_datestr_re;
 extern PyObject *_CBOR2_ip_address;
 extern PyObject *_CBOR2_ip_network;
 extern PyObject *_CBOR2_thread_locals;
+extern PyObject *_CBOR2_array;
+extern PyObject *_CBOR2_Mapping;
 
 // Initializers for the cached references above
 int _CBOR2_init_timezone_utc(void); // also handles timezone
 int _CBOR2_init_BytesIO(void);
 int _CBOR2_init_Decimal(void);
+int _CBOR2_init_Enum(void);
+int _CBOR2_init_dataclass_fields(void);
 int _CBOR2_init_Fraction(void);
 int _CBOR2_init_FrozenDict(void);
 int _CBOR2_init_UUID(void);
 int _CBOR2_init_Parser(void);
-int _CBOR2_init_re_compile(void); // also handles datetimestr_re & datestr_re & re_error
+int _CBOR2_init_re_compile(void); // also handles datestr_re & re_error
 int _CBOR2_init_ip_address(void);
 int _CBOR2_init_thread_locals(void);
+int _CBOR2_init_array(void);
+int _CBOR2_init_Mapping(void);
 
 int init_default_encoders(void);
 int init_canonical_encoders(void);
 
+// Calls init, one of the initializers above, unless global (the reference it
+// caches) is already set. With the GIL disabled this is done holding a lock,
+// so that threads racing to use the reference neither both run init nor see
+// it half done
+#ifdef Py_GIL_DISABLED
+int _CBOR2_init_locked(PyObject **global, int (*init)(void));
+#define CBOR2_INIT(global, init) _CBOR2_init_locked(&(global), (init))
+#else
+#define CBOR2_INIT(global, init) ((global) ? 0 : (init)())
+#endif
+
 // Encoder registries
 extern PyObject *_CBOR2_default_encoders;
 extern PyObject *_CBOR2_canonical_encoders;
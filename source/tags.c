@@ -143,7 +143,7 @@ CBORTag_richcompare(PyObject *aobj, PyObject *bobj, int op)
 static Py_hash_t
 CBORTag_hash(CBORTagObject *self)
 {
-    if (!_CBOR2_thread_locals && _CBOR2_init_thread_locals() == -1)
+    if (CBOR2_INIT(_CBOR2_thread_locals, _CBOR2_init_thread_locals) == -1)
         return -1;
 
     Py_hash_t ret = -1;
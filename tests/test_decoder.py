@@ -1,11 +1,16 @@
 from __future__ import annotations
 
 import math
+import mmap
 import platform
 import re
 import struct
 import sys
+import threading
+from array import array
 from binascii import unhexlify
+from collections.abc import Mapping, Sequence
+from dataclasses import dataclass, field
 from datetime import date, datetime, timedelta, timezone
 from decimal import Decimal
 from email.message import Message
@@ -13,7 +18,7 @@ from fractions import Fraction
 from io import BytesIO
 from ipaddress import ip_address, ip_network
 from pathlib import Path
-from typing import cast
+from typing import NamedTuple, cast
 from uuid import UUID
 
 import pytest
@@ -21,6 +26,18 @@ import pytest
 from cbor2 import FrozenDict
 
 
+@dataclass
+class Point:
+    x: int
+    y: int = 0
+    z: list = field(default_factory=list, init=False)
+
+
+class PointTuple(NamedTuple):
+    x: int
+    y: int = 0
+
+
 def test_fp_attr(impl):
     with pytest.raises(ValueError):
         impl.CBORDecoder(None)
@@ -101,6 +118,133 @@ def test_decode_from_bytes(impl):
             decoder.decode_from_bytes("foo")
 
 
+class NonSeekableStream:
+    def __init__(self, data):
+        self._fp = BytesIO(data)
+        self.reads = 0
+
+    def read(self, size):
+        self.reads += 1
+        return self._fp.read(size)
+
+    def seekable(self):
+        return False
+
+
+def test_read_size_attr(impl):
+    with BytesIO(b"foobar") as stream:
+        for read_size in (0, -1, "foo"):
+            with pytest.raises((ValueError, TypeError)):
+                impl.CBORDecoder(stream, read_size=read_size)
+
+
+def test_load_leaves_seekable_fp_after_value(impl):
+    with BytesIO(unhexlify("0163666f6f8201020a")) as stream:
+        assert impl.load(stream) == 1
+        assert stream.tell() == 1
+        assert impl.load(stream, read_size=2) == "foo"
+        assert impl.load(stream) == [1, 2]
+        assert impl.load(stream) == 10
+        with pytest.raises(impl.CBORDecodeEOF):
+            impl.load(stream)
+
+
+def test_release_read_ahead_seekable(impl):
+    with BytesIO(unhexlify("01020304") + b"trailer") as stream:
+        decoder = impl.CBORDecoder(stream)
+        assert [decoder.decode() for _ in range(4)] == [1, 2, 3, 4]
+        assert decoder.release_read_ahead() == b""
+        assert stream.read() == b"trailer"
+
+
+def test_decode_leaves_seekable_fp_after_value(impl, tmp_path):
+    # A header can be decoded and the rest of the file read as it is
+    tail = b"RAWTAIL" * 20000
+    with BytesIO(impl.dumps([1, 2, 3]) + tail) as stream:
+        decoder = impl.CBORDecoder(stream)
+        assert decoder.decode() == [1, 2, 3]
+        assert stream.tell() == 4
+        assert stream.read() == tail
+
+    path = tmp_path / "testdata.cbor"
+    path.write_bytes(impl.dumps({"length": len(tail)}) + tail)
+    with path.open("rb") as f:
+        header = impl.CBORDecoder(f).decode()
+        assert f.read(header["length"]) == tail
+        assert f.read() == b""
+
+
+def test_decode_after_seekable_fp_moved(impl):
+    with BytesIO(unhexlify("01020304") + b"trailer") as stream:
+        decoder = impl.CBORDecoder(stream)
+        assert decoder.decode() == 1
+        assert stream.read(1) == b"\x02"
+        assert decoder.decode() == 3
+        assert stream.tell() == 3
+        stream.seek(0)
+        for value in decoder:
+            assert value == 1
+            break
+
+        assert stream.tell() == 1
+        assert decoder.skip() == 1
+        assert decoder.read(1) == b"\x03"
+        assert stream.read() == b"\x04trailer"
+
+
+def test_release_read_ahead_nonseekable(impl):
+    stream = NonSeekableStream(unhexlify("8301020364746578740a") + b"trailer")
+    decoder = impl.CBORDecoder(stream, read_size=4)
+    assert decoder.decode() == [1, 2, 3]
+    assert decoder.decode() == "text"
+    assert decoder.decode() == 10
+    assert decoder.release_read_ahead() + stream.read(100) == b"trailer"
+
+
+def test_nonseekable_reads_only_what_is_needed(impl):
+    stream = NonSeekableStream(unhexlify("820102") + b"trailer")
+    assert impl.load(stream) == [1, 2]
+    assert stream.read(100) == b"trailer"
+
+
+def test_read_ahead_batches_reads(impl):
+    stream = NonSeekableStream(impl.dumps(list(range(1000))))
+    decoder = impl.CBORDecoder(stream, read_size=65536)
+    assert decoder.decode() == list(range(1000))
+    if impl.CBORDecoder.__module__ == "_cbor2":
+        # the pure Python decoder doesn't read ahead
+        assert stream.reads <= 2
+
+
+@pytest.mark.parametrize("wrapper", [bytes, bytearray, memoryview], ids=lambda t: t.__name__)
+def test_loads_buffer_types(impl, wrapper):
+    data = wrapper(unhexlify("a26161830102036162a1616364f09f9880"))
+    assert impl.loads(data) == {"a": [1, 2, 3], "b": {"c": "\U0001f600"}}
+
+
+def test_decode_from_bytes_restores_input(impl):
+    # decode_from_bytes() called from a tag hook must resume the outer input afterwards
+    def tag_hook(decoder, tag):
+        return decoder.decode_from_bytes(tag.value)
+
+    decoded = impl.loads(unhexlify("83d9138842183201d913884483020304"), tag_hook=tag_hook)
+    assert decoded == [50, 1, [2, 3, 4]]
+
+
+@pytest.mark.parametrize(
+    "payload",
+    [
+        pytest.param("1a0001", id="uint"),
+        pytest.param("5a000100004142", id="long_bytestring"),
+        pytest.param("7a000100006162", id="long_string"),
+        pytest.param("83010203"[:-2], id="array"),
+    ],
+)
+def test_loads_premature_end(impl, payload):
+    with pytest.raises(impl.CBORDecodeEOF, match="premature end of stream"):
+        impl.loads(unhexlify(payload))
+
+
 def test_immutable_attr(impl):
     with BytesIO(unhexlify("d917706548656c6c6f")) as stream:
         decoder = impl.CBORDecoder(stream)
@@ -255,6 +399,31 @@ def test_string_invalid_utf8(impl, payload: str) -> None:
     assert isinstance(exc.value.__cause__, UnicodeDecodeError)
 
 
+@pytest.mark.parametrize(
+    "payload, expected",
+    [
+        pytest.param("6198", "\ufffd", id="short"),
+        pytest.param("7a00010000" + "61" * 65535 + "c3", "a" * 65535 + "\ufffd", id="long"),
+        pytest.param("7f6198ff", "\ufffd", id="indefinite"),
+        pytest.param("a1629841f5", {"\ufffdA": True}, id="key"),
+    ],
+)
+def test_string_invalid_utf8_replace(impl, payload: str, expected) -> None:
+    with BytesIO(unhexlify(payload)) as stream:
+        assert impl.load(stream, str_errors="replace") == expected
+
+
+@pytest.mark.parametrize("length", [2, 7, 8, 9, 31, 32, 33, 100])
+@pytest.mark.parametrize("position", ["start", "middle", "end", "none"])
+def test_string_ascii_boundaries(impl, length: int, position: str) -> None:
+    value = ["b"] * length
+    if position != "none":
+        value[{"start": 0, "middle": length // 2, "end": -1}[position]] = "\u00fc"
+
+    value = "".join(value)
+    assert impl.loads(impl.dumps(value)) == value
+
+
 def test_string_oversized(impl) -> None:
     with pytest.raises(impl.CBORDecodeEOF, match="premature end of stream"):
         (impl.loads(unhexlify("aeaeaeaeaeaeaeaeae0108c29843d90100d8249f0000aeaeffc26ca799")),)
@@ -513,6 +682,47 @@ def test_datetime_timezone(impl):
     assert decoded == datetime(2018, 8, 2, 7, 0, 59, tzinfo=timezone(timedelta(minutes=-90)))
 
 
+def test_datetime_timezone_changes(impl):
+    offsets = [timedelta(hours=2), timedelta(0), timedelta(hours=2), timedelta(hours=-3)]
+    values = [datetime(2018, 8, 2, 7, 0, 59, tzinfo=timezone(offset)) for offset in offsets]
+    decoded = impl.loads(impl.dumps(values))
+    assert decoded == values
+    assert [value.utcoffset() for value in decoded] == offsets
+    assert decoded[1].tzinfo is timezone.utc
+
+
+def test_datetime_trailing_newline(impl):
+    decoded = impl.loads(b"\xc0\x752018-08-02T07:00:59Z\n")
+    assert decoded == datetime(2018, 8, 2, 7, 0, 59, tzinfo=timezone.utc)
+    with pytest.raises(impl.CBORDecodeValueError, match="invalid datetime string"):
+        impl.loads(b"\xc0\x762018-08-02T07:00:59Z\n\n")
+
+
+@pytest.mark.parametrize(
+    "timestamp",
+    [
+        0,
+        -1,
+        1363896240,
+        253402300799,
+        1363896240.5,
+        1363896240.1234565,
+        0.0000005,
+        0.0000015,
+        -0.0000005,
+        -1.25,
+        -3600.0000015,
+    ],
+)
+def test_epoch_datetime(impl, timestamp):
+    if timestamp < 0 and platform.system() == "Windows":
+        pytest.skip("fromtimestamp() rejects negative timestamps on Windows")
+
+    decoded = impl.loads(impl.dumps(impl.CBORTag(1, timestamp)))
+    assert decoded == datetime.fromtimestamp(timestamp, timezone.utc)
+    assert decoded.tzinfo is timezone.utc
+
+
 def test_positive_bignum(impl):
     # Example from RFC 8949 section 3.4.3.
     decoded = impl.loads(unhexlify("c249010000000000000000"))
@@ -683,6 +893,123 @@ def test_bad_ipnetwork(impl):
         assert isinstance(exc, ValueError)
 
 
+@pytest.mark.parametrize(
+    "payload, expected",
+    [
+        pytest.param("d84043010203", array("B", [1, 2, 3]), id="uint8"),
+        pytest.param("d84443ff0001", array("B", [255, 0, 1]), id="uint8_clamped"),
+        pytest.param("d84843ff0001", array("b", [-1, 0, 1]), id="sint8"),
+        pytest.param("d84144000101ff", array("H", [1, 511]), id="uint16_be"),
+        pytest.param("d84544010000ff", array("H", [1, 0xFF00]), id="uint16_le"),
+        pytest.param("d8494400fffffe", array("h", [255, -2]), id="sint16_be"),
+        pytest.param("d84d44fffffe00", array("h", [-1, 254]), id="sint16_le"),
+        pytest.param("d8424400000102", array("I", [258]), id="uint32_be"),
+        pytest.param("d84e44feffffff", array("i", [-2]), id="sint32_le"),
+        pytest.param("d843480000000000000100", array("Q", [256]), id="uint64_be"),
+        pytest.param("d84f48feffffffffffffff", array("q", [-2]), id="sint64_le"),
+        pytest.param("d850443c00c000", array("f", [1.0, -2.0]), id="float16_be"),
+        pytest.param("d85444003c00c0", array("f", [1.0, -2.0]), id="float16_le"),
+        pytest.param("d851443fc00000", array("f", [1.5]), id="float32_be"),
+        pytest.param("d855440000c03f", array("f", [1.5]), id="float32_le"),
+        pytest.param("d852483ff8000000000000", array("d", [1.5]), id="float64_be"),
+        pytest.param("d85648000000000000f83f", array("d", [1.5]), id="float64_le"),
+        pytest.param("d8555f42000042c03fff", array("f", [1.5]), id="indefinite"),
+        pytest.param("d84040", array("B"), id="empty"),
+    ],
+)
+def test_typed_array(impl, payload, expected):
+    value = impl.loads(unhexlify(payload))
+    assert value == expected
+    assert value.typecode == expected.typecode
+    with BytesIO(unhexlify(payload)) as stream:
+        assert impl.load(stream) == expected
+
+
+@pytest.mark.parametrize("tagnum, byteorder", [(80, ">"), (84, "<")], ids=["be", "le"])
+def test_typed_array_float16_long(impl, tagnum, byteorder):
+    halves = [0x3C00, 0xC000, 0x0001, 0x8000, 0x7BFF, 0x7800, 0x03FF, 0x3555] * 5
+    halves[20:22] = [0x7C00, 0xFC00]
+    data = struct.pack(f"{byteorder}{len(halves)}H", *halves)
+    expected = array("f", struct.unpack(f"{byteorder}{len(halves)}e", data))
+    assert impl.loads(impl.dumps(impl.CBORTag(tagnum, data))) == expected
+
+
+def test_typed_array_immutable(impl):
+    # Arrays aren't hashable, so they're decoded as tuples when used as map keys
+    assert impl.loads(unhexlify("a1d8414400010002f5")) == {(1, 2): True}
+
+
+def test_typed_array_unsupported(impl):
+    # The reserved tag 76 and the 128-bit float tags are left as they are
+    for tagnum in (76, 83, 87):
+        value = impl.loads(impl.dumps(impl.CBORTag(tagnum, bytes(16))))
+        assert value == impl.CBORTag(tagnum, bytes(16))
+
+
+def test_large_values_threads(impl):
+    # Large strings and typed arrays are copied with the GIL released in the C extension
+    size = 1 << 20
+    values = [
+        bytes(range(256)) * (size // 256),
+        "a" * size,
+        "\u00fc" * size,
+        array("H", range(65536)) * (size // 65536),
+    ]
+    # A big endian uint16 typed array, which has to be byte swapped on most platforms
+    payload = bytearray(impl.dumps(values[:3]))
+    payload[0] = 0x84
+    payload += unhexlify("d8415a") + struct.pack(">I", 2 * size)
+    payload += struct.pack(f">{size}H", *values[3])
+    payload = bytes(payload)
+
+    results = []
+    threads = [
+        threading.Thread(target=lambda: results.append(impl.loads(payload))) for _ in range(4)
+    ]
+    for thread in threads:
+        thread.start()
+    for thread in threads:
+        thread.join()
+
+    assert results == [values] * 4
+
+
+@pytest.mark.parametrize(
+    "payload, message",
+    [
+        pytest.param("d8418201f5", "expected a byte string", id="not_bytes"),
+        pytest.param("d84243010203", "invalid typed array length 3", id="length"),
+        pytest.param("d84144000102", "CBORDecodeEOF", id="truncated"),
+    ],
+)
+def test_bad_typed_array(impl, payload, message):
+    if message == "CBORDecodeEOF":
+        with pytest.raises(impl.CBORDecodeEOF):
+            impl.loads(unhexlify(payload))
+    else:
+        with pytest.raises(impl.CBORDecodeValueError, match=message):
+            impl.loads(unhexlify(payload))
+
+
+def test_scalar_array(impl):
+    # Numbers and simple values of every width, including ones straddling the end of the
+    # read-ahead buffer and negative integers beyond 64 bits
+    value = [0, 23, 24, 255, 256, 65535, 65536, 2**32 - 1, 2**32, 2**64 - 1, -1, -24, -25]
+    value += [-256, -257, -(2**32), -(2**63), -(2**63) - 1, -(2**64), 1.5, 1e300, 0.0]
+    value += [-0.0, 65504.0, math.inf, False, True, None, impl.undefined, "x", [1, 2.5]]
+    payloads = [impl.dumps(value), impl.dumps(value, canonical=True), impl.dumps(tuple(value))]
+    # An indefinite length version of the same array (of between 24 and 255 items)
+    payloads.append(b"\x9f" + impl.dumps(value)[2:] + b"\xff")
+    for payload in payloads:
+        assert impl.loads(payload) == value
+        for read_size in (1, 7, 4096):
+            decoder = impl.CBORDecoder(NonSeekableStream(payload), read_size=read_size)
+            assert decoder.decode() == value
+
+    assert impl.loads(impl.dumps({(1, 2.5, None): 1})) == {(1, 2.5, None): 1}
+    assert math.isnan(impl.loads(impl.dumps([math.nan]))[0])
+
+
 def test_bad_shared_reference(impl):
     with pytest.raises(impl.CBORDecodeError) as exc:
         impl.loads(unhexlify("d81d05"))
@@ -729,6 +1056,26 @@ def test_string_ref(impl):
     assert decoded[4] == "second"
 
 
+def test_string_ref_indefinite(impl):
+    # neither an indefinite length string nor its chunks are added to the namespace
+    decoded = impl.loads(unhexlify("d90100847f63616263ff6378797a5f43616263ffd81900"))
+    assert decoded == ["abc", "xyz", b"abc", "xyz"]
+
+
+@pytest.mark.parametrize("stream_type", [BytesIO, NonSeekableStream])
+def test_long_strings_from_fp(impl, stream_type):
+    text = "aé€😀" * 50000
+    chunks = [text[i : i + 1000].encode() for i in range(0, len(text), 1000)]
+    payload = impl.dumps([text, text.encode()])
+    payload += b"\x7f" + b"".join(impl.dumps(chunk.decode()) for chunk in chunks) + b"\xff"
+    payload += b"\x5f" + b"".join(impl.dumps(chunk) for chunk in chunks) + b"\xff"
+    decoder = impl.CBORDecoder(stream_type(payload + payload))
+    for _ in range(2):
+        assert decoder.decode() == [text, text.encode()]
+        assert decoder.decode() == text
+        assert decoder.decode() == text.encode()
+
+
 def test_outside_string_ref_namespace(impl):
     with pytest.raises(impl.CBORDecodeError) as exc:
         impl.loads(unhexlify("85656669727374d81900667365636f6e64d81900d81901"))
@@ -829,6 +1176,94 @@ def test_load_from_file(impl, tmpdir):
     assert obj == [1, 10]
 
 
+def test_load_mmap(impl, tmp_path):
+    path = tmp_path / "testdata.cbor"
+    path.write_bytes(b"\x00" + impl.dumps([b"x" * 100, b"abc", {b"k" * 10: 1}]) + b"\x01")
+    with path.open("rb") as f, mmap.mmap(f.fileno(), 0, access=mmap.ACCESS_READ) as mm:
+        mm.seek(1)
+        decoder = impl.CBORDecoder(mm, memoryview_size=10)
+        assert decoder.memoryview_size == 10
+        value = decoder.decode()
+        assert type(value[0]) is memoryview
+        assert value[0].readonly
+        assert value[0] == b"x" * 100
+        assert value[1] == b"abc"
+        assert type(value[1]) is bytes
+        assert value[2] == {b"k" * 10: 1}
+        decoder.release_read_ahead()
+        assert mm.read(1) == b"\x01"
+        del value
+        decoder.fp = BytesIO(b"\x00")
+
+
+def test_load_mmap_copies(impl, tmp_path):
+    path = tmp_path / "testdata.cbor"
+    path.write_bytes(impl.dumps([b"x" * 100, b"abc"]))
+    with path.open("r+b") as f, mmap.mmap(f.fileno(), 0) as mm:
+        assert impl.load(mm) == [b"x" * 100, b"abc"]
+        assert mm.tell() == len(mm)
+        mm.seek(0)
+        value = impl.load(mm, memoryview_size=0)
+        assert [type(item) for item in value] == [memoryview, memoryview]
+        assert value[0].readonly
+        assert value == [b"x" * 100, b"abc"]
+        del value
+
+
+def test_decode_mmap_position(impl):
+    # The mmap is left after each value decoded, and can be closed with the decoder alive
+    payload = impl.dumps([1, 2, 3]) * 3
+    for start in range(0, len(payload), 4):
+        mm = mmap.mmap(-1, len(payload))
+        mm.write(payload)
+        mm.seek(start)
+        decoder = impl.CBORDecoder(mm)
+        for end in range(start + 4, len(payload) + 1, 4):
+            assert decoder.decode() == [1, 2, 3]
+            assert mm.tell() == end
+
+        mm.close()
+        assert decoder.fp is mm
+
+
+def test_load_mmap_round_trip(impl, tmp_path):
+    # The views are encoded as bytestrings again, not as uint8 typed arrays
+    path = tmp_path / "testdata.cbor"
+    payload = impl.dumps({"blob": b"x" * 100, "name": "abc"})
+    path.write_bytes(payload)
+    with path.open("rb") as f, mmap.mmap(f.fileno(), 0, access=mmap.ACCESS_READ) as mm:
+        value = impl.load(mm, memoryview_size=10)
+        assert type(value["blob"]) is memoryview
+        assert impl.dumps(value) == payload
+        del value
+
+
+def test_load_mmap_premature_end(impl, tmp_path):
+    path = tmp_path / "testdata.cbor"
+    path.write_bytes(unhexlify("5864") + b"x" * 99)
+    with path.open("rb") as f, mmap.mmap(f.fileno(), 0, access=mmap.ACCESS_READ) as mm:
+        with pytest.raises(impl.CBORDecodeEOF, match="premature end of stream"):
+            impl.load(mm, memoryview_size=0)
+
+
+def test_load_mmap_bytes_tags(impl):
+    value = [2**100, UUID(int=1), ip_address("1.2.3.4"), impl.CBORTag(999, b"ab")]
+    payload = impl.dumps(value)
+    with mmap.mmap(-1, len(payload)) as mm:
+        mm.write(payload)
+        mm.seek(0)
+        decoded = impl.load(mm, memoryview_size=0)
+        assert decoded == value
+        assert type(decoded[3].value) is memoryview
+        del decoded
+
+
+@pytest.mark.parametrize("value", [-1, 1.5])
+def test_memoryview_size_invalid(impl, value):
+    with pytest.raises(ValueError, match="invalid memoryview_size value"):
+        impl.CBORDecoder(BytesIO(b""), memoryview_size=value)
+
+
 def test_nested_dict(impl):
     value = impl.loads(unhexlify("A1D9177082010201"))
     assert type(value) is dict
@@ -961,3 +1396,935 @@ def test_oversized_read(impl, payload: bytes, tmp_path: Path) -> None:
         dummy_path.write_bytes(payload)
         with dummy_path.open("rb") as f:
             impl.load(f)
+
+
+def test_loads_sequence(impl):
+    payload = unhexlify("0163666f6f820102f6")
+    assert list(impl.loads_sequence(payload)) == [1, "foo", [1, 2], None]
+    assert list(impl.loads_sequence(memoryview(payload)[1:])) == ["foo", [1, 2], None]
+    assert list(impl.loads_sequence(b"")) == []
+
+
+@pytest.mark.parametrize("read_size", [None, 1, 3, 65536])
+def test_load_sequence(impl, read_size):
+    with BytesIO(unhexlify("0163666f6f820102f6")) as stream:
+        items = impl.load_sequence(stream, read_size=read_size)
+        assert next(items) == 1
+        assert list(items) == ["foo", [1, 2], None]
+
+
+@pytest.mark.parametrize("payload", ["01820102830102", "0163666f"], ids=["array", "string"])
+def test_sequence_truncated(impl, payload):
+    items = impl.loads_sequence(unhexlify(payload))
+    assert next(items) == 1
+    with pytest.raises(impl.CBORDecodeEOF):
+        list(items)
+
+
+@pytest.mark.parametrize("workers", [1, 3, 8, None])
+def test_loads_sequence_parallel(impl, workers):
+    values = [{"id": i, "name": f"item {i}", "tags": ["a"] * (i % 5)} for i in range(10000)]
+    values += [b"x" * 200000, "last"]
+    payload = impl.dumps_sequence(values)
+    assert impl.loads_sequence_parallel(payload, workers=workers) == values
+    assert impl.loads_sequence_parallel(memoryview(payload)[:0], workers=workers) == []
+
+
+def test_loads_sequence_parallel_options(impl):
+    # Each value refers only to the array it shares itself
+    payload = unhexlify("82d81c820102d81d00") * 20000
+    values = impl.loads_sequence_parallel(payload, workers=4)
+    assert values == [[[1, 2], [1, 2]]] * 20000
+    assert all(value[0] is value[1] for value in values)
+    assert values[0][0] is not values[-1][0]
+
+    payload = unhexlify("a1617801") * 40000
+    values = impl.loads_sequence_parallel(payload, record_type=Point, workers=4)
+    assert values == [Point(1)] * 40000
+
+    payload = unhexlify("d90fa0820102") * 100000
+    values = impl.loads_sequence_parallel(
+        payload, tag_hook=lambda decoder, tag: tuple(tag.value), workers=4
+    )
+    assert values == [(1, 2)] * 100000
+
+
+@pytest.mark.parametrize("workers", [1, 4])
+def test_loads_sequence_parallel_errors(impl, workers):
+    # The error raised first when decoding the values in order wins, though with
+    # several runs the values are located before any are decoded
+    good = impl.dumps_sequence(["x" * 100] * 5000)
+    invalid = unhexlify("c06b303030302d3132332d3031")
+    with pytest.raises(impl.CBORDecodeEOF):
+        impl.loads_sequence_parallel(good + unhexlify("830102"), workers=workers)
+    with pytest.raises(impl.CBORDecodeValueError, match="invalid datetime string"):
+        impl.loads_sequence_parallel(good + invalid + good + unhexlify("ff"), workers=workers)
+    with pytest.raises(impl.CBORDecodeValueError, match="invalid datetime string"):
+        impl.loads_sequence_parallel(good + unhexlify("ff") + good + invalid, workers=workers)
+    # A stray break marker is decoded as in loads_sequence()
+    payload = good + unhexlify("ff") + good
+    values = impl.loads_sequence_parallel(payload, workers=workers)
+    assert values == list(impl.loads_sequence(payload))
+    assert values[5000] is impl.break_marker
+    with pytest.raises(ValueError, match="invalid workers value 0"):
+        impl.loads_sequence_parallel(good, workers=0)
+
+
+def test_decoder_iter(impl):
+    with BytesIO(unhexlify("a1616101a1616202")) as stream:
+        decoder = impl.CBORDecoder(
+            stream, object_hook=lambda decoder, value: sorted(value.items())
+        )
+        assert iter(decoder) is decoder
+        assert [item for item in decoder] == [[("a", 1)], [("b", 2)]]
+        with pytest.raises(StopIteration):
+            next(decoder)
+
+
+def test_decoder_reset(impl):
+    # The second value refers to the array shared by the first one
+    with BytesIO(unhexlify("d81c820102d81d00d81d00")) as stream:
+        decoder = impl.CBORDecoder(stream)
+        shared = decoder.decode()
+        assert decoder.decode() is shared
+        decoder.reset()
+        with pytest.raises(impl.CBORDecodeValueError, match="shared reference 0 not found"):
+            decoder.decode()
+
+
+def test_decoder_reset_fp(impl):
+    decoder = impl.loads_sequence(unhexlify("0102"))
+    assert next(decoder) == 1
+    with BytesIO(unhexlify("8103")) as stream:
+        decoder.reset(stream)
+        assert decoder.fp is stream
+        assert list(decoder) == [[3]]
+
+
+
+@pytest.mark.parametrize("record_type", [Point, PointTuple], ids=["dataclass", "namedtuple"])
+@pytest.mark.parametrize(
+    "payload, expected",
+    [
+        pytest.param("a2617902617801", (1, 2), id="definite"),
+        pytest.param("bf617801617902ff", (1, 2), id="indefinite"),
+        pytest.param("a36178016179026565787472618201a1616101", (1, 2), id="unknown_key"),
+        # an invalid datetime string, which is only skipped over
+        pytest.param("a3617801656578747261c06178617902", (1, 2), id="unknown_key_skipped"),
+        pytest.param("a2617a80617805", (5, 0), id="default"),
+        pytest.param("a2617801617809", (9, 0), id="duplicate_key"),
+    ],
+)
+def test_record_type(impl, record_type, payload, expected):
+    value = impl.loads(unhexlify(payload), record_type=record_type)
+    assert type(value) is record_type
+    assert (value.x, value.y) == expected
+
+
+def test_record_type_nested_maps(impl):
+    # Only the top-level map is decoded into the record type
+    value = impl.loads(unhexlify("a16178a1617902"), record_type=PointTuple)
+    assert value == PointTuple({"y": 2})
+
+
+def test_record_type_sequence(impl):
+    values = impl.loads_sequence(unhexlify("a1617801a2617802617903"), record_type=Point)
+    assert list(values) == [Point(1), Point(2, 3)]
+    with BytesIO(unhexlify("a1617801a1617802")) as stream:
+        assert list(impl.load_sequence(stream, record_type=PointTuple)) == [
+            PointTuple(1),
+            PointTuple(2),
+        ]
+
+
+def test_record_type_attr(impl):
+    with BytesIO(unhexlify("a1617801a1617802")) as stream:
+        decoder = impl.CBORDecoder(stream, record_type=Point)
+        assert decoder.record_type is Point
+        assert decoder.decode() == Point(1)
+        decoder.record_type = None
+        assert decoder.record_type is None
+        assert decoder.decode() == {"x": 2}
+        with pytest.raises(AttributeError):
+            del decoder.record_type
+
+
+def test_record_type_not_map(impl):
+    with pytest.raises(impl.CBORDecodeValueError, match="expected a map to decode into"):
+        impl.loads(unhexlify("820102"), record_type=Point)
+
+
+def test_record_type_missing_field(impl):
+    with pytest.raises(TypeError):
+        impl.loads(unhexlify("a1617902"), record_type=Point)
+
+
+@pytest.mark.parametrize("record_type", [dict, Point(1), tuple, "Point"])
+def test_record_type_invalid(impl, record_type):
+    with pytest.raises(ValueError, match="invalid record_type value"):
+        impl.CBORDecoder(BytesIO(b""), record_type=record_type)
+
+
+def test_cache_keys(impl):
+    with BytesIO(unhexlify("a163666f6f01a163666f6f02")) as stream:
+        decoder = impl.CBORDecoder(stream)
+        assert decoder.cache_keys
+        [key1] = decoder.decode()
+        [key2] = decoder.decode()
+        assert key1 == "foo"
+        assert key1 is key2
+        # Keys come from untrusted input, so they aren't interned
+        assert sys.intern("".join(["f", "oo"])) is not key1
+
+
+def test_cache_keys_disabled(impl):
+    with BytesIO(unhexlify("a163666f6f01a163666f6f02")) as stream:
+        decoder = impl.CBORDecoder(stream, cache_keys=False)
+        assert not decoder.cache_keys
+        [key1] = decoder.decode()
+        [key2] = decoder.decode()
+        assert key1 == key2 == "foo"
+        assert key1 is not key2
+
+
+def test_cache_keys_stringref(impl):
+    # The second map key is only in the string namespace if cached keys are added to it too
+    payload = unhexlify("d9010082a1636162630182a163616263d81900d81900")
+    assert impl.loads(payload) == [{"abc": 1}, [{"abc": "abc"}, "abc"]]
+
+
+def test_cache_keys_many(impl):
+    value = {f"key{i}": i for i in range(2000)}
+    decoder = impl.CBORDecoder(BytesIO(impl.dumps([value, value, {"ключ": 1}, {"ключ": 2}])))
+    assert decoder.decode() == [value, value, {"ключ": 1}, {"ключ": 2}]
+
+
+def test_cache_keys_invalid_utf8(impl):
+    with pytest.raises(impl.CBORDecodeValueError, match="error decoding unicode string"):
+        impl.loads(unhexlify("a261780161ff02"))
+
+
+def test_int_cache(impl):
+    payload = impl.dumps([1000, 1000, -1000, -1000, {"a": 1023, "b": 1023}, 1024, 1024])
+    with BytesIO(payload + payload) as stream:
+        decoder = impl.CBORDecoder(stream)
+        assert decoder.int_cache_size == 1024
+        values = decoder.decode()
+        assert values == [1000, 1000, -1000, -1000, {"a": 1023, "b": 1023}, 1024, 1024]
+        assert values[0] is values[1]
+        assert values[2] is values[3]
+        assert values[4]["a"] is values[4]["b"]
+        assert values[5] is not values[6]
+        assert decoder.decode()[0] is values[0]
+
+
+@pytest.mark.parametrize(
+    "payload", ["841903e71903e71903e81903e8", "843903e73903e73903e83903e8"], ids=["uint", "negint"]
+)
+def test_int_cache_size(impl, payload):
+    decoder = impl.CBORDecoder(BytesIO(unhexlify(payload)), int_cache_size=1000)
+    assert decoder.int_cache_size == 1000
+    values = decoder.decode()
+    assert values[0] is values[1]
+    assert values[2] is not values[3]
+    decoder.int_cache_size = 0
+    decoder.fp = BytesIO(unhexlify(payload))
+    values = decoder.decode()
+    assert values[0] == values[1]
+    assert values[0] is not values[1]
+
+
+def test_int_cache_range(impl):
+    # Only the integers Python doesn't share already are cached
+    payload = impl.dumps([257, 257, -6, -6, 256, 256, -5, -5])
+    values = impl.CBORDecoder(BytesIO(payload)).decode()
+    assert values[0] is values[1]
+    assert values[2] is values[3]
+    assert values == [257, 257, -6, -6, 256, 256, -5, -5]
+
+
+def test_int_cache_one_shot(impl):
+    # loads() and load() decode a single value, so they only cache integers if asked to
+    payload = impl.dumps([1000, 1000])
+    values = impl.loads(payload)
+    assert values[0] is not values[1]
+    values = impl.load(BytesIO(payload))
+    assert values[0] is not values[1]
+    values = impl.loads(payload, int_cache_size=1024)
+    assert values[0] is values[1]
+    values = impl.load(BytesIO(payload), int_cache_size=1024)
+    assert values[0] is values[1]
+
+
+@pytest.mark.parametrize("value", [-1, 1.5, None])
+def test_int_cache_size_invalid(impl, value):
+    with pytest.raises(ValueError, match="invalid int_cache_size value"):
+        impl.CBORDecoder(BytesIO(b""), int_cache_size=value)
+
+
+def test_big_negint(impl):
+    assert impl.loads(unhexlify("3bffffffffffffffff")) == -(2**64)
+    assert impl.loads(unhexlify("813b8000000000000000")) == [-(2**63) - 1]
+
+
+def test_empty_singletons(impl):
+    values = impl.loads(unhexlify("8460404060"))
+    assert values == ["", b"", b"", ""]
+    assert values[0] is values[3] is str()
+    assert values[1] is values[2] is bytes()
+    [value] = impl.loads(unhexlify("d901028180"))
+    assert value is tuple()
+
+
+@pytest.mark.parametrize(
+    "payload, expected",
+    [
+        pytest.param("01", (1, 1, 0), id="int"),
+        pytest.param("3903e7", (3, 1, 0), id="negint"),
+        pytest.param("1b000000e8d4a51000", (9, 1, 0), id="uint64"),
+        pytest.param("4401020304", (5, 1, 0), id="bytes"),
+        pytest.param("5f42010243030405ff", (9, 1, 0), id="bytes_indefinite"),
+        pytest.param("7f657374726561646d696e67ff", (13, 1, 0), id="string_indefinite"),
+        pytest.param("83010203", (4, 4, 1), id="array"),
+        pytest.param("9f018202039f04ffff", (9, 7, 2), id="array_indefinite"),
+        pytest.param("a26161016162820203", (9, 7, 2), id="map"),
+        pytest.param("bf61610161629f0203ffff", (11, 7, 2), id="map_indefinite"),
+        pytest.param("c11a514b67b0", (6, 2, 1), id="tag"),
+        pytest.param("d9010281d81c80", (7, 4, 4), id="nested_tags"),
+        pytest.param("f5", (1, 1, 0), id="bool"),
+        pytest.param("f820", (2, 1, 0), id="simple"),
+        pytest.param("f93c00", (3, 1, 0), id="half"),
+        pytest.param("fb3ff199999999999a", (9, 1, 0), id="double"),
+    ],
+)
+def test_scan(impl, payload, expected):
+    data = unhexlify(payload)
+    with BytesIO(data + b"\x01") as stream:
+        decoder = impl.CBORDecoder(stream)
+        assert decoder.scan() == expected
+        assert decoder.decode() == 1
+
+    decoder = impl.CBORDecoder(BytesIO(data))
+    assert decoder.skip() == len(data)
+
+
+def test_skip_sequence(impl):
+    # Skipping leaves the decoder at the next value, for both buffered and unbuffered input
+    data = impl.dumps([1, {"a": b"x" * 100000}]) + impl.dumps("foo") + impl.dumps(2)
+    for stream in (BytesIO(data), NonSeekableStream(data)):
+        decoder = impl.CBORDecoder(stream, read_size=4096)
+        assert decoder.skip() == len(data) - 5
+        assert decoder.skip() == 4
+        assert decoder.decode() == 2
+        with pytest.raises(impl.CBORDecodeEOF):
+            decoder.skip()
+
+
+def test_skip_builds_nothing(impl):
+    # Tags aren't interpreted and hooks aren't called when skipping
+    def hook(*args):
+        raise AssertionError("hook called")
+
+    # A map whose key is an invalid datetime and whose value refers to a missing shared value
+    data = unhexlify("a1c077696e76616c6964206461746574696d6520737472696e67d81d05")
+    decoder = impl.CBORDecoder(BytesIO(data), tag_hook=hook, object_hook=hook)
+    assert decoder.scan() == (len(data), 5, 2)
+
+
+@pytest.mark.parametrize(
+    "payload, exception",
+    [
+        pytest.param("ff", "CBORDecodeValueError", id="break"),
+        pytest.param("8201ff", "CBORDecodeValueError", id="break_in_array"),
+        pytest.param("bf6161ff", "CBORDecodeValueError", id="break_in_map_entry"),
+        pytest.param("c6ff", "CBORDecodeValueError", id="break_in_tag"),
+        pytest.param("7f6161416201ff", "CBORDecodeValueError", id="mixed_string_chunks"),
+        pytest.param("5f5fffff", "CBORDecodeValueError", id="nested_indefinite_bytes"),
+        pytest.param("1f", "CBORDecodeValueError", id="indefinite_int"),
+        pytest.param("df01", "CBORDecodeValueError", id="indefinite_tag"),
+        pytest.param("fc", "CBORDecodeValueError", id="reserved_simple"),
+        pytest.param("830102", "CBORDecodeEOF", id="truncated_array"),
+        pytest.param("5a00010000", "CBORDecodeEOF", id="truncated_bytes"),
+        pytest.param("1a0001", "CBORDecodeEOF", id="truncated_length"),
+    ],
+)
+def test_skip_malformed(impl, payload, exception):
+    with pytest.raises(getattr(impl, exception)):
+        impl.CBORDecoder(BytesIO(unhexlify(payload))).skip()
+
+
+def raw_decoders(impl, data, **kwargs):
+    # Decoders reading data from memory, and from buffered and unbuffered streams
+    decoder = impl.CBORDecoder(BytesIO(), **kwargs)
+    yield lambda: decoder.decode_from_bytes(data)
+    for stream in (BytesIO(data), NonSeekableStream(data)):
+        yield impl.CBORDecoder(stream, read_size=3, **kwargs).decode
+
+
+def test_decode_raw(impl):
+    data = impl.dumps([1, {"a": b"x" * 1000}]) + impl.dumps("foo")
+    for stream in (BytesIO(data), NonSeekableStream(data)):
+        decoder = impl.CBORDecoder(stream, read_size=3)
+        assert decoder.decode_raw() == impl.CBORRaw(data[:-4])
+        assert decoder.decode() == "foo"
+
+
+def test_raw_tags(impl):
+    def raw(payload):
+        return impl.CBORRaw(unhexlify(payload))
+
+    cases = [
+        ("d9ffff8201c10a", raw("d9ffff8201c10a")),
+        ("82d8aa01d8ab02", [raw("d8aa01"), impl.CBORTag(171, 2)]),
+        ("a16161d8aa63666f6f", {"a": raw("d8aa63666f6f")}),
+        ("dbffffffffffffffff00", raw("dbffffffffffffffff00")),
+    ]
+    for payload, expected in cases:
+        data = unhexlify(payload)
+        for decode in raw_decoders(impl, data, raw_tags={0xFFFF, 0xAA, 0xFFFFFFFFFFFFFFFF}):
+            value = decode()
+            assert value == expected
+            assert impl.dumps(value) == data
+
+
+def test_raw_keys(impl):
+    body = impl.dumps({"user": {"id": 1}, "items": list(range(100))})
+    data = impl.dumps({"route": "/a", "body": impl.CBORRaw(body), "n": 1})
+    for decode in raw_decoders(impl, data, raw_keys=["body"]):
+        value = decode()
+        assert value == {"route": "/a", "body": impl.CBORRaw(body), "n": 1}
+        assert impl.dumps(value) == data
+
+
+def test_raw_keys_record_type(impl):
+    @dataclass
+    class Envelope:
+        route: str
+        body: object
+
+    data = unhexlify("a265726f757465616264626f6479820102")
+    decoder = impl.CBORDecoder(BytesIO(data), record_type=Envelope, raw_keys={"body"})
+    assert decoder.decode() == Envelope("b", impl.CBORRaw(unhexlify("820102")))
+
+
+def test_raw_malformed(impl):
+    for decode in raw_decoders(impl, unhexlify("a161618201"), raw_keys={"a"}):
+        with pytest.raises(impl.CBORDecodeEOF):
+            decode()
+
+
+def test_raw_options(impl):
+    decoder = impl.CBORDecoder(BytesIO())
+    assert decoder.raw_tags is None
+    assert decoder.raw_keys is None
+    decoder.raw_tags = [1, 2]
+    decoder.raw_keys = ("a",)
+    assert decoder.raw_tags == frozenset([1, 2])
+    assert decoder.raw_keys == frozenset(["a"])
+    for value in (1, ["a"]):
+        with pytest.raises(ValueError, match="invalid raw_tags value"):
+            decoder.raw_tags = value
+
+    with pytest.raises(ValueError, match="invalid raw_keys value"):
+        decoder.raw_keys = [[]]
+
+    assert decoder.raw_keys == frozenset(["a"])
+
+
+def materialize(value):
+    if isinstance(value, Mapping):
+        return {key: materialize(item) for key, item in value.items()}
+    elif isinstance(value, Sequence) and not isinstance(value, (str, bytes)):
+        return [materialize(item) for item in value]
+
+    return value
+
+
+def test_loads_lazy(impl):
+    document = {
+        "header": {"id": 7, "tags": ["a", "b"]},
+        "body": [list(range(100)), {"text": "x" * 1000, 3: None}],
+        "when": datetime(2013, 3, 21, 20, 4, tzinfo=timezone.utc),
+        (1, 2): b"\x00" * 100,
+    }
+    data = impl.dumps(document)
+    value = impl.loads_lazy(data)
+    assert isinstance(value, impl.LazyMap)
+    assert isinstance(value, Mapping)
+    assert len(value) == 4
+    assert list(value) == ["header", "body", "when", (1, 2)]
+    assert value["header"]["id"] == 7
+    assert value["header"] is value["header"]
+    assert isinstance(value["body"], impl.LazyArray)
+    assert isinstance(value["body"], Sequence)
+    assert value["body"][0][-1] == 99
+    assert value["when"] == document["when"]
+    assert (1, 2) in value
+    assert "missing" not in value
+    assert value.get("missing", 5) == 5
+    with pytest.raises(KeyError):
+        value["missing"]
+    with pytest.raises(IndexError):
+        value["body"][2]
+    assert materialize(value) == impl.loads(data)
+
+
+def test_loads_lazy_indefinite(impl):
+    value = impl.loads_lazy(unhexlify("9f0102bf616102ff9fffff"))
+    assert len(value) == 4
+    assert value[2]["a"] == 2
+    assert list(value[3]) == []
+    assert materialize(value) == [1, 2, {"a": 2}, []]
+
+
+def test_loads_lazy_sequence_methods(impl):
+    value = impl.loads_lazy(impl.dumps([1, 2, 3, 2, "x"]))
+    assert value.index(2) == 1
+    assert value.index(2, 2) == 3
+    assert value.index(2, -2) == 3
+    assert value.index("x") == 4
+    assert value.count(2) == 2
+    assert value.count(5) == 0
+    with pytest.raises(ValueError):
+        value.index(5)
+    with pytest.raises(ValueError):
+        value.index(1, 1, 3)
+
+
+def test_loads_lazy_map_equality(impl):
+    value = impl.loads_lazy(impl.dumps({"a": 1, "b": "x"}))
+    assert value == {"a": 1, "b": "x"}
+    assert {"b": "x", "a": 1} == value
+    assert value != {"a": 1}
+    assert value != {"a": 1, "b": "y"}
+    assert value == impl.loads_lazy(impl.dumps({"b": "x", "a": 1}))
+    assert value != [("a", 1), ("b", "x")]
+    with pytest.raises(TypeError):
+        hash(value)
+
+
+def test_loads_lazy_scalar(impl):
+    assert impl.loads_lazy(unhexlify("63666f6f")) == "foo"
+
+
+def test_loads_lazy_duplicate_keys(impl):
+    # A repeated key gives its last value, as with loads()
+    payload = b"\xa2\x65admin\xf4\x65admin\xf5"
+    assert impl.loads_lazy(payload)["admin"] is True
+    assert dict(impl.loads_lazy(payload)) == impl.loads(payload) == {"admin": True}
+    value = impl.loads_lazy(unhexlify("a3617801617902617803"))
+    assert "x" in value
+    assert value["x"] == 3
+    assert value.get("x") == 3
+    assert len(value) == 2
+    assert list(value.items()) == [("x", 3), ("y", 2)]
+
+
+def test_loads_lazy_errors_deferred(impl):
+    # Items are only checked as far as needed to locate the ones accessed (all of a
+    # map's entries, for a lookup), and only fully decoded when accessed
+    value = impl.loads_lazy(unhexlify("a26362616461ff626f6b01"))
+    assert value["ok"] == 1
+    with pytest.raises(impl.CBORDecodeValueError, match="error decoding unicode string"):
+        value["bad"]
+    value = impl.loads_lazy(unhexlify("a2626f6b016362616463666f"))
+    with pytest.raises(impl.CBORDecodeEOF):
+        value["ok"]
+    value = impl.loads_lazy(unhexlify("8301028201"))
+    assert value[1] == 2
+    with pytest.raises(impl.CBORDecodeEOF):
+        value[2]
+
+
+@pytest.mark.parametrize(
+    "payload",
+    [
+        pytest.param("8201ff", id="break_in_array"),
+        pytest.param("bf6161ff", id="break_in_map_entry"),
+        pytest.param("82c6ff01", id="break_in_tag"),
+        pytest.param("827f6161416201ff", id="mixed_string_chunks"),
+        pytest.param("82fc01", id="reserved_simple"),
+    ],
+)
+def test_loads_lazy_malformed(impl, payload):
+    value = impl.loads_lazy(unhexlify(payload))
+    with pytest.raises(impl.CBORDecodeValueError):
+        list(value)
+
+
+def test_extract(impl):
+    data = impl.dumps(
+        {"body": [{"x": 1}] * 100, "user": {"name": "foo", "id": 5}, "ts": 123, 7: [4, 5, 6]}
+    )
+    assert impl.extract(data, [("user", "id"), ("ts",)]) == [5, 123]
+    assert impl.extract(data, [["user"], (7, 2), ("body", 99, "x")]) == [
+        {"name": "foo", "id": 5},
+        6,
+        1,
+    ]
+    assert impl.extract(data, [()])[0]["ts"] == 123
+    assert impl.extract(data, []) == []
+
+
+def test_extract_missing(impl):
+    data = impl.dumps({"user": {"name": "foo"}, "list": [1, 2]})
+    paths = [("user", "id"), ("nope",), ("list", 2), ("list", -1), ("user", "name", 0), (1,)]
+    assert impl.extract(data, paths) == [None] * 6
+    assert impl.extract(data, paths, default=...) == [...] * 6
+
+
+def test_extract_overlapping(impl):
+    data = impl.dumps({"a": {"b": [1, {"c": 2}]}, "d": 3})
+    paths = [("a", "b", 1, "c"), ("a",), ("a", "b", 0), ("a", "b", 1, "c"), ("d",)]
+    assert impl.extract(data, paths) == [2, {"b": [1, {"c": 2}]}, 1, 2, 3]
+
+
+def test_extract_indefinite(impl):
+    # {_ "a": [_ 1, 2], "b": {_ "c": 3}, "d": 4}
+    data = unhexlify("bf61619f0102ff6162bf616303ff616404ff")
+    assert impl.extract(data, [("b", "c"), ("a", 1), ("d",), ("e",)]) == [3, 2, 4, None]
+
+
+def test_extract_through_other_values(impl):
+    # Paths go on into values that have to be decoded in full, such as tagged ones
+    data = impl.dumps({"tagged": impl.CBORTag(4000, {"a": [1, 2]}), "key": {(1, 2): "tuple"}})
+    assert impl.extract(data, [("tagged", "a", 1)]) == [None]
+    assert impl.extract(data, [("tagged",)])[0].value == {"a": [1, 2]}
+    assert impl.extract(data, [("key", (1, 2))]) == ["tuple"]
+    # {"s": 256(["abc", "abc", [25(0)]])}
+    data = unhexlify("a16173d9010083636162636361626381d81900")
+    assert impl.extract(data, [("s", 2, 0)]) == ["abc"]
+
+
+def test_extract_skips_the_rest(impl):
+    # Only what's on the way to the paths is decoded, and nothing after the last one
+    # (except the rest of the maps they lead through)
+    def hook(*args):
+        raise AssertionError("hook called")
+
+    # [{"a": 1, "x": 0("invalid datetime string")}, <reserved simple value>]
+    data = unhexlify("82a26161016178c077696e76616c6964206461746574696d6520737472696e67fc")
+    assert impl.extract(data, [(0, "a")], tag_hook=hook) == [1]
+    with pytest.raises(impl.CBORDecodeValueError, match="Undefined Reserved"):
+        impl.extract(data, [(1,)])
+
+
+def test_extract_duplicate_keys(impl):
+    # The last occurrence of a key is used, as with loads()
+    data = unhexlify("a26561646d696ef46561646d696ef5")
+    assert impl.loads(data) == {"admin": True}
+    assert impl.extract(data, [("admin",)]) == [True]
+    # {"a": {"b": 1}, "c": 2, "a": [5], "a": {"b": 3, "b": 4}}
+    data = unhexlify("a46161a1616201616302616181056161a2616203616204")
+    assert impl.extract(data, [("a", "b"), ("c",), ("a",), ("a", 0)]) == [4, 2, {"b": 4}, None]
+    data = unhexlify("a3616101616102616281" + "00")
+    assert impl.extract(data, [("a",), ("b", 0)]) == [2, 0]
+    with pytest.raises(impl.CBORDecodeEOF):
+        impl.extract(unhexlify("a3616101616102"), [("a",)])
+
+
+@pytest.mark.parametrize(
+    "payload, exception",
+    [
+        pytest.param("ff", "CBORDecodeValueError", id="break"),
+        pytest.param("8201ff", "CBORDecodeValueError", id="break_in_array"),
+        pytest.param("bf6161ff", "CBORDecodeValueError", id="break_in_map_entry"),
+        pytest.param("a16162", "CBORDecodeEOF", id="truncated"),
+    ],
+)
+def test_extract_malformed(impl, payload, exception):
+    with pytest.raises(getattr(impl, exception)):
+        impl.extract(unhexlify(payload), [("a",), (1,)])
+
+
+def test_extract_invalid_path(impl):
+    with pytest.raises(TypeError, match="invalid path 'a'"):
+        impl.extract(b"\xa0", ["a"])
+    with pytest.raises(TypeError):
+        impl.extract(b"\xa0", [([],)])
+
+
+INCREMENTAL_PAYLOAD = (
+    "01"  # 1
+    "9f01820203ff"  # [1, [2, 3]]
+    "bf6161f5ff"  # {"a": True}
+    "5f41014102ff"  # b"\x01\x02"
+    "7f6161626263ff"  # "abc"
+    "c11a514b67b0"  # datetime(2013, 3, 21, 20, 4, tzinfo=timezone.utc)
+    "fb3ff199999999999a"  # 1.1
+    "c249010000000000000000"  # 2**64
+    "a2616181d81c80616280"  # {"a": [[]], "b": []}
+    "f93c00"  # 1.0
+)
+INCREMENTAL_VALUES = [
+    1,
+    [1, [2, 3]],
+    {"a": True},
+    b"\x01\x02",
+    "abc",
+    datetime(2013, 3, 21, 20, 4, tzinfo=timezone.utc),
+    1.1,
+    2**64,
+    {"a": [[]], "b": []},
+    1.0,
+]
+
+
+@pytest.mark.parametrize("chunk_size", [1, 2, 7, 1000])
+def test_incremental_decoder(impl, chunk_size):
+    decoder = impl.IncrementalDecoder()
+    data = unhexlify(INCREMENTAL_PAYLOAD)
+    values = []
+    for i in range(0, len(data), chunk_size):
+        values.extend(decoder.feed(data[i : i + chunk_size]))
+
+    assert values == INCREMENTAL_VALUES
+    assert decoder.pending == 0
+
+
+def test_incremental_decoder_pending(impl):
+    decoder = impl.IncrementalDecoder()
+    assert decoder.feed(unhexlify("019f0102")) == [1]
+    assert decoder.pending == 3
+    assert decoder.feed(b"") == []
+    assert decoder.feed(memoryview(unhexlify("ff1903"))) == [[1, 2]]
+    assert decoder.pending == 2
+    assert decoder.feed(b"\xe8") == [1000]
+    assert decoder.pending == 0
+
+
+def test_incremental_decoder_options(impl):
+    decoder = impl.IncrementalDecoder(
+        object_hook=lambda decoder, value: sorted(value), str_errors="replace"
+    )
+    assert decoder.feed(unhexlify("a2616201616101")) == [["a", "b"]]
+    assert decoder.feed(unhexlify("6198")) == ["�"]
+
+
+@pytest.mark.parametrize(
+    "payload, message",
+    [
+        pytest.param("ff", "unexpected break marker", id="break"),
+        pytest.param("8201ff", "unexpected break marker", id="break_in_array"),
+        pytest.param("bf6161ff", "unexpected break marker", id="break_in_map_entry"),
+        pytest.param(
+            "5f6161ff", "non-bytestring found in indefinite length bytestring", id="bytes"
+        ),
+        pytest.param("7f01ff", "non-string found in indefinite length string", id="string"),
+        pytest.param("1c", "unknown unsigned integer subtype 0x1c", id="subtype"),
+        pytest.param("81fc", "Undefined Reserved major type 7 subtype 0x1c", id="simple"),
+        pytest.param("6198", "error decoding unicode string", id="decode"),
+    ],
+)
+def test_incremental_decoder_malformed(impl, payload, message):
+    decoder = impl.IncrementalDecoder()
+    with pytest.raises(impl.CBORDecodeValueError, match=message):
+        decoder.feed(unhexlify("0181" + payload))
+
+    # Everything fed so far is discarded
+    assert decoder.pending == 0
+    assert decoder.feed(b"\x02") == [2]
+
+
+def test_decoder_stats(impl):
+    decoder = impl.CBORDecoder(
+        BytesIO(unhexlify("83018202a16161636263644378797ad9fffff6")),
+        tag_hook=lambda decoder, tag: tag.value,
+        object_hook=lambda decoder, value: value,
+        collect_stats=True,
+    )
+    assert decoder.decode() == [1, [2, {"a": "bcd"}], b"xyz"]
+    stats = decoder.stats
+    assert stats["bytes_read"] == 15
+    assert stats["read_calls"] >= 1
+    assert stats["items"] == (2, 0, 1, 2, 2, 1, 0, 0)
+    assert stats["object_hook_calls"] == 1
+    assert stats["tag_hook_calls"] == 0
+    assert stats["max_depth"] == 3
+
+    # Counting carries on across values, and starts afresh when re-enabled
+    assert decoder.decode() is None
+    assert decoder.stats["bytes_read"] == 19
+    assert decoder.stats["items"] == (2, 0, 1, 2, 2, 1, 1, 1)
+    assert decoder.stats["tag_hook_calls"] == 1
+    decoder.collect_stats = True
+    assert decoder.stats["bytes_read"] == 0
+    decoder.collect_stats = False
+    assert decoder.stats is None
+
+
+def test_decoder_stats_tag_hook(impl):
+    decoder = impl.CBORDecoder(
+        BytesIO(unhexlify("d9ffff01")), tag_hook=lambda decoder, tag: tag.value, collect_stats=True
+    )
+    assert decoder.decode() == 1
+    assert decoder.stats["tag_hook_calls"] == 1
+    assert decoder.stats["max_depth"] == 1
+
+
+@pytest.mark.parametrize(
+    "payload, items, max_depth",
+    [
+        pytest.param("01", (1, 0, 0, 0, 0, 0, 0, 0), 0, id="scalar"),
+        pytest.param("80", (0, 0, 0, 0, 1, 0, 0, 0), 1, id="empty_array"),
+        pytest.param("83019fffbfff", (1, 0, 0, 0, 2, 1, 0, 0), 2, id="empty_nested"),
+        pytest.param("9f019f02ffff", (2, 0, 0, 0, 2, 0, 0, 0), 2, id="indefinite_array"),
+        pytest.param("bf616101616280ff", (1, 0, 0, 2, 1, 1, 0, 0), 2, id="indefinite_map"),
+        pytest.param("5f4161ff", (0, 0, 1, 0, 0, 0, 0, 0), 0, id="indefinite_bytes"),
+    ],
+)
+def test_decoder_stats_items(impl, payload, items, max_depth):
+    # Break codes end items rather than being counted as ones
+    decoder = impl.CBORDecoder(BytesIO(unhexlify(payload)), collect_stats=True)
+    decoder.decode()
+    assert decoder.stats["items"] == items
+    assert decoder.stats["max_depth"] == max_depth
+    assert impl.CBORDecoder(BytesIO(unhexlify(payload))).scan()[2] == max_depth
+
+
+def test_decoder_stats_disabled(impl):
+    decoder = impl.CBORDecoder(BytesIO(b"\x01"))
+    assert not decoder.collect_stats
+    assert decoder.stats is None
+
+
+@pytest.mark.parametrize(
+    "payload, options, message",
+    [
+        pytest.param(
+            "83018202a1616163626364",
+            {"max_items": 5},
+            r"maximum number of items \(5\)",
+            id="items",
+        ),
+        pytest.param(
+            "9a00010000", {"max_items": 100}, r"maximum number of items \(100\)", id="items_header"
+        ),
+        pytest.param(
+            "83018201", {"max_length": 1}, r"array length 3 exceeds max_length \(1\)", id="array"
+        ),
+        pytest.param(
+            "a201020304", {"max_length": 1}, r"map length 2 exceeds max_length \(1\)", id="map"
+        ),
+        pytest.param(
+            "9a00010000", {"max_length": 1000}, r"array length 65536 exceeds", id="array_header"
+        ),
+        pytest.param(
+            "9f010203ff",
+            {"max_length": 2},
+            r"array length exceeds max_length \(2\)",
+            id="array_indef",
+        ),
+        pytest.param(
+            "bf01020304ff",
+            {"max_length": 1},
+            r"map length exceeds max_length \(1\)",
+            id="map_indef",
+        ),
+        pytest.param(
+            "5a00100000",
+            {"max_allocation": 1000},
+            r"maximum allocation \(1000 bytes\)",
+            id="bytes",
+        ),
+        pytest.param(
+            "826461626364626566", {"max_allocation": 20}, r"maximum allocation \(20", id="strings"
+        ),
+        pytest.param(
+            "7f63616263ff", {"max_allocation": 2}, r"maximum allocation \(2 bytes\)", id="chunks"
+        ),
+        pytest.param(
+            "9a00010000", {"max_allocation": 1000}, r"maximum allocation \(1000", id="array_header"
+        ),
+        pytest.param(
+            "a1616101", {"max_allocation": 10}, r"maximum allocation \(10 bytes\)", id="map_entry"
+        ),
+    ],
+)
+def test_decoder_limits(impl, payload, options, message):
+    decoder = impl.CBORDecoder(BytesIO(unhexlify(payload)), **options)
+    with pytest.raises(impl.CBORDecodeValueError, match=message):
+        decoder.decode()
+
+
+@pytest.mark.parametrize(
+    "payload, options, value",
+    [
+        pytest.param("9f0102ff", {"max_items": 3}, [1, 2], id="array_items"),
+        pytest.param("9f9fff01ff", {"max_items": 3}, [[], 1], id="nested_items"),
+        pytest.param("bf616101ff", {"max_items": 3}, {"a": 1}, id="map_items"),
+        pytest.param("9f0102ff", {"max_length": 2}, [1, 2], id="array_length"),
+        pytest.param("bf616101ff", {"max_length": 1}, {"a": 1}, id="map_length"),
+        pytest.param("9f0102ff", {"max_allocation": 16}, [1, 2], id="array_allocation"),
+    ],
+)
+def test_decoder_limits_indefinite(impl, payload, options, value):
+    # Break codes don't count against the limits
+    assert impl.CBORDecoder(BytesIO(unhexlify(payload)), **options).decode() == value
+
+
+def test_decoder_limits_per_value(impl):
+    # The limits apply to each value separately, not to the whole input
+    decoder = impl.CBORDecoder(
+        BytesIO(unhexlify("8201028203048405060708")), max_items=3, max_allocation=16
+    )
+    assert decoder.decode() == [1, 2]
+    assert decoder.decode() == [3, 4]
+    with pytest.raises(impl.CBORDecodeValueError, match="maximum number of items"):
+        decoder.decode()
+
+
+def test_decoder_limits_met(impl):
+    payload = unhexlify("a2616183010203616260")
+    assert impl.load(BytesIO(payload), max_items=8, max_length=3, max_allocation=58) == {
+        "a": [1, 2, 3],
+        "b": "",
+    }
+    decoder = impl.CBORDecoder(BytesIO(payload), max_allocation=57)
+    with pytest.raises(impl.CBORDecodeValueError, match="maximum allocation"):
+        decoder.decode()
+
+    decoder = impl.CBORDecoder(BytesIO(payload), max_items=7)
+    decoder.max_items = None
+    decoder.max_length = 2
+    with pytest.raises(impl.CBORDecodeValueError, match="array length 3"):
+        decoder.decode()
+
+
+@pytest.mark.parametrize("name", ["max_items", "max_length", "max_allocation"])
+@pytest.mark.parametrize("value", [-1, 1.5, "1"])
+def test_decoder_limits_invalid(impl, name, value):
+    with pytest.raises(ValueError, match=f"invalid {name} value"):
+        impl.CBORDecoder(BytesIO(b""), **{name: value})
+    with pytest.raises(ValueError, match=f"invalid {name} value"):
+        impl.loads(b"\x00", **{name: value})
+
+
+def test_loads_limits(impl):
+    payload = unhexlify("a2616183010203616260")
+    assert impl.loads(payload, max_items=8, max_length=3, max_allocation=58) == {
+        "a": [1, 2, 3],
+        "b": "",
+    }
+    with pytest.raises(impl.CBORDecodeValueError, match=r"maximum number of items \(7\)"):
+        impl.loads(payload, max_items=7)
+    with pytest.raises(impl.CBORDecodeValueError, match=r"array length 3 exceeds max_length"):
+        impl.loads(payload, max_length=2)
+    with pytest.raises(impl.CBORDecodeValueError, match=r"maximum allocation \(57 bytes\)"):
+        impl.loads(payload, max_allocation=57)
+    with pytest.raises(impl.CBORDecodeValueError, match=r"array length 65536 exceeds"):
+        impl.loads(unhexlify("9a00010000"), max_length=1000)
+
+
+def test_load_options(impl):
+    # load() takes the same options as CBORDecoder
+    payload = unhexlify("a2616101616bd9ffff02")
+    value = impl.load(
+        BytesIO(payload),
+        cache_keys=False,
+        int_cache_size=0,
+        raw_tags={0xFFFF},
+        raw_keys={"a"},
+        collect_stats=True,
+    )
+    assert value == {"a": impl.CBORRaw(b"\x01"), "k": impl.CBORRaw(unhexlify("d9ffff02"))}
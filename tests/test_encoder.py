@@ -1,9 +1,13 @@
 import re
+import sys
+from array import array
 from binascii import unhexlify
-from collections import OrderedDict
+from collections import OrderedDict, namedtuple
+from dataclasses import dataclass, field
 from datetime import date, datetime, timedelta, timezone
 from decimal import Decimal
 from email.mime.text import MIMEText
+from enum import Enum, IntEnum
 from fractions import Fraction
 from io import BytesIO
 from ipaddress import ip_address, ip_network
@@ -77,6 +81,29 @@ def test_encoders_load_type(impl):
             )
 
 
+def test_encoders_modified(impl):
+    class Foo:
+        pass
+
+    encoder = impl.CBOREncoder(BytesIO(), default=lambda encoder, value: encoder.encode(1))
+    assert encoder.encode_to_bytes(Foo()) == b"\x01"
+    # The lookup result for Foo must not outlive changes to the encoders
+    encoder._encoders[Foo] = lambda encoder, value: encoder.encode(2)
+    assert encoder.encode_to_bytes(Foo()) == b"\x02"
+    del encoder._encoders[Foo]
+    assert encoder.encode_to_bytes(Foo()) == b"\x01"
+
+
+def test_encoders_many_types(impl):
+    types = [type(f"Type{i}", (), {"index": i}) for i in range(200)]
+    encoder = impl.CBOREncoder(
+        BytesIO(), default=lambda encoder, value: encoder.encode(value.index)
+    )
+    for _ in range(2):
+        for type_ in types:
+            assert encoder.encode_to_bytes(type_()) == impl.dumps(type_.index)
+
+
 def test_encode_length(impl):
     # This test is purely for coverage in the C variant
     with BytesIO() as stream:
@@ -85,6 +112,20 @@ def test_encode_length(impl):
         assert stream.getvalue() == b"\x01"
 
 
+def test_encode_raw(impl):
+    raw = impl.CBORRaw(bytearray(b"\x82\x01\x02"))
+    assert raw.data == b"\x82\x01\x02"
+    assert impl.dumps([raw, raw]) == unhexlify("82820102820102")
+    # Raw keys are sorted by their encoded form like any other
+    value = {impl.CBORRaw(b"\x19\x01\x00"): 1, "a": 2, 3: 3}
+    assert impl.dumps(value, canonical=True) == unhexlify("a3030361610219010001")
+
+
+def test_raw_invalid(impl):
+    with pytest.raises(TypeError, match="CBORRaw data must be a bytes-like object"):
+        impl.CBORRaw(5)
+
+
 def test_canonical_attr(impl):
     # Another test purely for coverage in the C variant
     with BytesIO() as stream:
@@ -105,6 +146,280 @@ def test_dump(impl):
         assert stream.getvalue() == b"\x01"
 
 
+class WriteRecorder:
+    def __init__(self):
+        self.chunks = []
+
+    def write(self, data):
+        self.chunks.append(bytes(data))
+
+
+def test_dump_matches_dumps(impl):
+    value = [
+        {"id": i, "name": "x" * (i % 40), "data": b"\x00" * i, "f": i / 3} for i in range(500)
+    ]
+    fp = WriteRecorder()
+    impl.dump(value, fp)
+    assert b"".join(fp.chunks) == impl.dumps(value)
+
+
+def test_default_handler_write_order(impl):
+    # Writes made through the encoder from a default handler must appear in order
+    def default(encoder, value):
+        encoder.encode_length(4, 2)
+        encoder.write(b"\x61a")
+        encoder.encode(encoder.encode_to_bytes(value.x))
+
+    class Foo:
+        x = 7
+
+    expected = unhexlify("83018261614107" "02")
+    assert impl.dumps([1, Foo(), 2], default=default) == expected
+    fp = WriteRecorder()
+    impl.dump([1, Foo(), 2], fp, default=default)
+    assert b"".join(fp.chunks) == expected
+
+
+def test_flush_threshold(impl):
+    encoder = impl.CBOREncoder(WriteRecorder())
+    if not hasattr(encoder, "flush_threshold"):
+        pytest.skip("output buffering is specific to the C extension")
+
+    assert encoder.flush_threshold == 65536
+    encoder.encode(list(range(1000)))
+    assert len(encoder.fp.chunks) == 1
+    encoder.fp = WriteRecorder()
+    encoder.flush_threshold = 100
+    encoder.encode(list(range(1000)))
+    assert 10 < len(encoder.fp.chunks) < 100
+    assert b"".join(encoder.fp.chunks) == impl.dumps(list(range(1000)))
+
+
+def test_dumps_sequence(impl):
+    values = [1, "foo", [1, 2, 3], {"a": b"b"}]
+    data = impl.dumps_sequence(values)
+    assert data == b"".join(impl.dumps(value) for value in values)
+    assert list(impl.loads_sequence(data)) == values
+    assert impl.dumps_sequence(iter(values)) == data
+    assert impl.dumps_sequence([]) == b""
+
+
+def test_dumps_sequence_independent_items(impl):
+    shared = [1, 2]
+    values = [[shared, shared], ["abc", "abc"], [shared, "abc"]]
+    data = impl.dumps_sequence(values, value_sharing=True, string_referencing=True)
+    # Every item must decode on its own
+    assert data == b"".join(
+        impl.dumps(value, value_sharing=True, string_referencing=True) for value in values
+    )
+    decoded = list(impl.loads_sequence(data))
+    assert decoded == values
+    assert decoded[0][0] is decoded[0][1]
+
+
+def test_dump_sequence(impl):
+    fp = WriteRecorder()
+    impl.dump_sequence(iter([1, 2, 3]), fp, canonical=True)
+    assert b"".join(fp.chunks) == unhexlify("010203")
+    fp = WriteRecorder()
+    impl.dump_sequence(objs=[{"b": 1, "a": 2}], fp=fp, canonical=True)
+    assert b"".join(fp.chunks) == unhexlify("a2616102616201")
+
+
+def test_encoder_reset(impl):
+    value = [1, 2]
+    encoder = impl.CBOREncoder(BytesIO(), value_sharing=True)
+    assert encoder.encode_to_bytes(value) == unhexlify("d81c820102")
+    assert encoder.encode_to_bytes(value) == unhexlify("d81d00")
+    encoder.reset()
+    assert encoder.encode_to_bytes(value) == unhexlify("d81c820102")
+
+
+def test_encoder_reset_stringrefs(impl):
+    encoder = impl.CBOREncoder(BytesIO(), string_referencing=True)
+    expected = unhexlify("d901008263616263d81900")
+    assert encoder.encode_to_bytes(["abc", "abc"]) == expected
+    # Without a reset the strings refer back to the previous value
+    assert encoder.encode_to_bytes(["abc", "abc"]) != expected
+    encoder.reset()
+    assert encoder.encode_to_bytes(["abc", "abc"]) == expected
+
+
+def test_encoder_reset_fp(impl):
+    first, second = BytesIO(), BytesIO()
+    encoder = impl.CBOREncoder(first)
+    encoder.encode(1)
+    encoder.reset(second)
+    assert encoder.fp is second
+    encoder.encode(2)
+    assert first.getvalue() == b"\x01"
+    assert second.getvalue() == b"\x02"
+
+
+def test_encode_sequence_error(impl):
+    fp = WriteRecorder()
+    encoder = impl.CBOREncoder(fp)
+    with pytest.raises(impl.CBOREncodeTypeError):
+        encoder.encode_sequence([1, object()])
+
+
+def test_encode_generator(impl):
+    assert impl.dumps(x * 2 for x in range(3)) == unhexlify("9f000204ff")
+    assert impl.dumps([(x for x in "ab"), []]) == unhexlify("829f61616162ff80")
+    assert impl.loads(impl.dumps({"rows": ([x] for x in range(100))})) == {
+        "rows": [[x] for x in range(100)]
+    }
+
+
+def test_encode_generator_error(impl):
+    def rows():
+        yield 1
+        raise ValueError("no more rows")
+
+    with pytest.raises(ValueError, match="no more rows"):
+        impl.dumps(rows())
+
+
+def test_begin_end(impl):
+    fp = WriteRecorder()
+    encoder = impl.CBOREncoder(fp)
+    encoder.begin_array()
+    encoder.encode(1)
+    encoder.begin_map()
+    encoder.encode("a")
+    encoder.encode([2])
+    encoder.end()
+    encoder.begin_string()
+    encoder.encode("ab")
+    encoder.encode("c")
+    encoder.end()
+    encoder.begin_bytestring()
+    encoder.encode(b"\x01")
+    encoder.end()
+    encoder.end()
+    data = b"".join(fp.chunks)
+    assert data == unhexlify("9f01bf61618102ff7f6261626163ff5f4101ffff")
+    assert impl.loads(data) == [1, {"a": [2]}, "abc", b"\x01"]
+    if hasattr(encoder, "flush_threshold"):
+        # The C extension buffers the output until the outermost item is ended
+        assert len(fp.chunks) == 1
+
+
+def test_begin_string_stringrefs(impl):
+    fp = BytesIO()
+    encoder = impl.CBOREncoder(fp, string_referencing=True)
+    encoder.begin_string()
+    encoder.encode("abc")
+    encoder.encode("abc")
+    encoder.end()
+    assert fp.getvalue() == unhexlify("7f6361626363616263ff")
+    # String referencing is back on after the string has ended
+    encoder.reset()
+    assert encoder.encode_to_bytes(["abc", "abc"]) == unhexlify("d901008263616263d81900")
+
+
+def test_begin_array_stringrefs(impl):
+    fp = BytesIO()
+    encoder = impl.CBOREncoder(fp, string_referencing=True)
+    encoder.begin_array()
+    encoder.encode("abcdef")
+    encoder.encode("abcdef")
+    encoder.begin_map()
+    encoder.encode("abcdef")
+    encoder.encode(["abcdef"])
+    encoder.end()
+    encoder.end()
+    # Only the outermost item starts a namespace, just like encode() would
+    assert fp.getvalue() == unhexlify("d901009f66616263646566d81900bfd8190081d81900ffff")
+    assert impl.loads(fp.getvalue()) == ["abcdef", "abcdef", {"abcdef": ["abcdef"]}]
+    # The next value starts a namespace of its own again
+    encoder.reset()
+    encoder.begin_map()
+    encoder.end()
+    assert fp.getvalue().endswith(unhexlify("d90100bfff"))
+
+
+def test_begin_in_string(impl):
+    encoder = impl.CBOREncoder(BytesIO())
+    encoder.begin_string()
+    with pytest.raises(
+        impl.CBOREncodeValueError,
+        match="an indefinite length string can only contain definite length strings",
+    ):
+        encoder.begin_array()
+
+
+@pytest.mark.parametrize(
+    "begin, chunk, message",
+    [
+        pytest.param("begin_string", 1, "string must be str, not int", id="string_int"),
+        pytest.param("begin_string", b"ab", "string must be str, not bytes", id="string_bytes"),
+        pytest.param(
+            "begin_bytestring", "ab", "bytestring must be bytes or bytearray, not str", id="bytes"
+        ),
+    ],
+)
+def test_begin_string_wrong_chunk(impl, begin, chunk, message):
+    fp = BytesIO()
+    encoder = impl.CBOREncoder(fp)
+    getattr(encoder, begin)()
+    with pytest.raises(impl.CBOREncodeValueError, match=f"indefinite length {message}"):
+        encoder.encode(chunk)
+
+
+def test_begin_string_chunks(impl):
+    fp = BytesIO()
+    encoder = impl.CBOREncoder(fp)
+    encoder.begin_string()
+    encoder.encode("ab")
+    with pytest.raises(impl.CBOREncodeValueError, match="must be str, not int"):
+        encoder.encode(1)
+    encoder.end()
+    encoder.begin_bytestring()
+    encoder.encode(bytearray(b"\x01"))
+    encoder.end()
+    assert fp.getvalue() == unhexlify("7f626162ff5f4101ff")
+    assert impl.loads(fp.getvalue()) == "ab"
+
+
+def test_begin_map_odd_items(impl):
+    fp = BytesIO()
+    encoder = impl.CBOREncoder(fp)
+    encoder.begin_map()
+    encoder.encode("k")
+    with pytest.raises(
+        impl.CBOREncodeValueError,
+        match="an indefinite length map can't end with a key that has no value",
+    ):
+        encoder.end()
+    # Nested items and the values inside them count as one value of the map
+    encoder.begin_array()
+    encoder.encode([1, {"a": 2}])
+    encoder.end()
+    encoder.begin_map()
+    encoder.end()
+    with pytest.raises(impl.CBOREncodeValueError, match="a key that has no value"):
+        encoder.end()
+    encoder.encode(None)
+    encoder.end()
+    assert impl.loads(fp.getvalue()) == {"k": [[1, {"a": 2}]], FrozenDict(): None}
+
+
+def test_end_without_begin(impl):
+    encoder = impl.CBOREncoder(BytesIO())
+    with pytest.raises(
+        impl.CBOREncodeValueError, match="there is no indefinite length item to end"
+    ):
+        encoder.end()
+
+    encoder.begin_array()
+    encoder.reset(BytesIO())
+    with pytest.raises(
+        impl.CBOREncodeValueError, match="there is no indefinite length item to end"
+    ):
+        encoder.end()
+
+
 @pytest.mark.parametrize(
     "value, expected",
     [
@@ -271,6 +586,62 @@ def test_datetime(impl, value, as_timestamp, expected):
     assert impl.dumps(value, datetime_as_timestamp=as_timestamp, timezone=timezone.utc) == expected
 
 
+@pytest.mark.parametrize(
+    "value, expected",
+    [
+        (datetime(1, 1, 1, tzinfo=timezone.utc), "0001-01-01T00:00:00Z"),
+        (
+            datetime(9999, 12, 31, 23, 59, 59, 999999, tzinfo=timezone.utc),
+            "9999-12-31T23:59:59.999999Z",
+        ),
+        (datetime(2013, 3, 21, 20, 4, 0, 5, tzinfo=timezone.utc), "2013-03-21T20:04:00.000005Z"),
+        (
+            datetime(2013, 3, 21, 20, 4, tzinfo=timezone(timedelta(hours=-9, minutes=-30))),
+            "2013-03-21T20:04:00-09:30",
+        ),
+        (
+            datetime(2013, 3, 21, 20, 4, tzinfo=timezone(timedelta(hours=1, seconds=5))),
+            "2013-03-21T20:04:00+01:00:05",
+        ),
+        (
+            datetime(2013, 3, 21, 20, 4, tzinfo=timezone(timedelta(0), "UTC0")),
+            "2013-03-21T20:04:00Z",
+        ),
+    ],
+    ids=["min", "max", "micro", "negative_offset", "offset_seconds", "named_utc"],
+)
+def test_datetime_string(impl, value, expected):
+    assert impl.dumps(value) == impl.dumps(impl.CBORTag(0, expected))
+
+
+@pytest.mark.parametrize(
+    "value",
+    [
+        datetime(1, 1, 1, tzinfo=timezone.utc),
+        datetime(1969, 12, 31, 23, 59, 59, tzinfo=timezone.utc),
+        datetime(1969, 12, 31, 23, 59, 59, 500000, tzinfo=timezone.utc),
+        datetime(2013, 3, 21, 20, 4, 0, 250000, tzinfo=timezone(timedelta(hours=-5))),
+        datetime(9999, 12, 31, 23, 59, 59, tzinfo=timezone.utc),
+    ],
+    ids=["min", "before_epoch", "before_epoch+micro", "offset+micro", "max"],
+)
+def test_datetime_timestamp(impl, value):
+    timestamp = value.timestamp()
+    if timestamp.is_integer():
+        timestamp = int(timestamp)
+    expected = impl.dumps(impl.CBORTag(1, timestamp))
+    assert impl.dumps(value, datetime_as_timestamp=True) == expected
+
+
+def test_datetime_subclass(impl):
+    class MyDatetime(datetime):
+        def isoformat(self, *args, **kwargs):
+            return "custom"
+
+    value = MyDatetime(2013, 3, 21, tzinfo=timezone.utc)
+    assert impl.dumps(value) == impl.dumps(impl.CBORTag(0, "custom"))
+
+
 @pytest.mark.parametrize(
     "value, as_timestamp, expected",
     [
@@ -387,6 +758,64 @@ def test_ipnetwork(impl, value, expected):
     assert impl.dumps(value) == expected
 
 
+@pytest.mark.parametrize(
+    "typecode, tag",
+    [
+        ("b", 72),
+        ("B", 64),
+        ("h", 73),
+        ("H", 65),
+        ("i", 74),
+        ("I", 66),
+        ("q", 75),
+        ("Q", 67),
+        ("f", 81),
+        ("d", 82),
+    ],
+)
+def test_typed_array(impl, typecode, tag):
+    value = array(typecode, [1, 2, 3])
+    if value.itemsize > 1 and sys.byteorder == "little":
+        tag |= 4
+
+    expected = impl.dumps(impl.CBORTag(tag, value.tobytes()))
+    assert impl.dumps(value) == expected
+    if value.itemsize > 1:
+        assert impl.dumps(memoryview(value)) == expected
+    assert impl.dumps(array(typecode)) == impl.dumps(impl.CBORTag(tag, b""))
+
+
+@pytest.mark.skipif(sys.byteorder != "little", reason="native byte order is big-endian")
+def test_typed_array_little_endian(impl):
+    assert impl.dumps(array("f", [1.5, -2])) == unhexlify("d855480000c03f000000c0")
+    assert impl.dumps(memoryview(b"ab").cast("H")) == unhexlify("d845426162")
+
+
+@pytest.mark.parametrize(
+    "value, message",
+    [
+        pytest.param(memoryview(bytes(4)).cast("B", (2, 2)), "one-dimensional", id="2d"),
+        pytest.param(memoryview(bytes(4))[::2], "contiguous", id="strided"),
+        pytest.param(memoryview(bytes(4)).cast("?"), "'?' elements", id="bool"),
+        pytest.param(memoryview(bytes(4)).cast("c", (2, 2)), "one-dimensional", id="2d_char"),
+    ],
+)
+def test_typed_array_invalid(impl, value, message):
+    with pytest.raises(impl.CBOREncodeValueError, match=message):
+        impl.dumps(value)
+
+
+@pytest.mark.parametrize("typecode", ["B", "b", "c"])
+def test_memoryview_bytes(impl, typecode):
+    # Views of single bytes are bytestrings, so that those decoded with memoryview_size
+    # survive a round trip
+    view = memoryview(b"abcdef").cast(typecode)
+    assert impl.dumps(view) == impl.dumps(b"abcdef")
+    assert impl.dumps(memoryview(bytearray(b"abc"))[1:]) == unhexlify("426263")
+    expected = unhexlify("d901008246616263646566d81900")
+    assert impl.dumps([view, view], string_referencing=True) == expected
+
+
 def test_custom_tag(impl):
     expected = unhexlify("d917706548656c6c6f")
     assert impl.dumps(impl.CBORTag(6000, "Hello")) == expected
@@ -428,6 +857,30 @@ def test_cyclic_map_nosharing(impl):
         assert isinstance(exc, ValueError)
 
 
+def test_value_sharing_many(impl):
+    items = [[i] for i in range(100)]
+    value = items + items
+    # The outer list is shared value 0 and the items follow it
+    equivalent = impl.CBORTag(
+        28,
+        [impl.CBORTag(28, item) for item in items]
+        + [impl.CBORTag(29, i + 1) for i in range(len(items))],
+    )
+    assert impl.dumps(value, value_sharing=True) == impl.dumps(equivalent)
+
+
+def test_deep_nesting_nosharing(impl):
+    value = inner = []
+    for _ in range(50):
+        inner.append([])
+        inner = inner[0]
+
+    assert impl.dumps(value) == b"\x81" * 50 + b"\x80"
+    inner.append(value)
+    with pytest.raises(impl.CBOREncodeValueError, match="cyclic data structure detected"):
+        impl.dumps(value)
+
+
 @pytest.mark.parametrize(
     "value_sharing, expected",
     [(False, "828080"), (True, "d81c82d81c80d81d01")],
@@ -448,6 +901,89 @@ def test_unsupported_type(impl):
         assert isinstance(exc, TypeError)
 
 
+@dataclass
+class Point:
+    y: int
+    x: int
+    label: str = "p"
+    hidden: list = field(default_factory=list, repr=False)
+
+
+PointTuple = namedtuple("PointTuple", "y x")
+
+
+class Color(Enum):
+    RED = "red"
+
+
+class Level(IntEnum):
+    HIGH = 2
+
+
+@pytest.mark.parametrize(
+    "value, record_format, expected",
+    [
+        pytest.param(
+            Point(1, 2),
+            "map",
+            "a4617901617802656c6162656c61706668696464656e80",
+            id="dataclass_map",
+        ),
+        pytest.param(Point(1, 2), "array", "840102617080", id="dataclass_array"),
+        pytest.param(PointTuple(1, 2), "map", "a2617901617802", id="namedtuple_map"),
+        pytest.param(PointTuple(1, 2), "array", "820102", id="namedtuple_array"),
+        pytest.param(Color.RED, "map", "63726564", id="enum"),
+        pytest.param(Level.HIGH, "array", "02", id="intenum"),
+        pytest.param([Color.RED, Color.RED], "array", "826372656463726564", id="enum_repeated"),
+    ],
+)
+def test_record_format(impl, value, record_format, expected):
+    assert impl.dumps(value, record_format=record_format) == unhexlify(expected)
+
+
+def test_record_format_canonical(impl):
+    # Keys are sorted by length first, then bytewise
+    assert impl.dumps(Point(1, 2), record_format="map", canonical=True) == unhexlify(
+        "a4617802617901656c6162656c61706668696464656e80"
+    )
+
+
+def test_record_format_disabled(impl):
+    assert impl.CBOREncoder(BytesIO()).record_format is None
+    assert impl.dumps(PointTuple(1, 2)) == unhexlify("820102")
+    with pytest.raises(impl.CBOREncodeTypeError):
+        impl.dumps(Point(1, 2))
+
+
+def test_record_format_invalid(impl):
+    with pytest.raises(ValueError, match="invalid record_format value 'dict'"):
+        impl.CBOREncoder(BytesIO(), record_format="dict")
+
+
+def test_record_format_registered_encoder(impl):
+    encoder = impl.CBOREncoder(BytesIO(), record_format="map")
+    assert encoder.record_format == "map"
+    encoder._encoders[Point] = lambda encoder, value: encoder.encode(value.x)
+    assert encoder.encode_to_bytes(Point(1, 2)) == b"\x02"
+    assert encoder.encode_to_bytes(PointTuple(1, 2)) == unhexlify("a2617901617802")
+
+
+def test_record_format_cyclic(impl):
+    point = Point(1, 2)
+    point.hidden.append(point)
+    with pytest.raises(impl.CBOREncodeValueError, match="cyclic data structure"):
+        impl.dumps(point, record_format="array")
+    assert impl.dumps(point, record_format="array", value_sharing=True) == unhexlify(
+        "d81c8401026170d81c81d81d00"
+    )
+
+
+def test_record_format_string_referencing(impl):
+    points = [PointTuple(1, 2), PointTuple(3, 4)]
+    data = impl.dumps(points, record_format="map", string_referencing=True)
+    assert impl.loads(data) == [{"y": 1, "x": 2}, {"y": 3, "x": 4}]
+
+
 def test_default(impl):
     class DummyType:
         def __init__(self, state):
@@ -516,6 +1052,39 @@ def test_ordered_map(impl, value, expected):
     assert impl.dumps(value, canonical=True) == expected
 
 
+def test_ordered_map_many_keys(impl):
+    keys = [*range(-300, 300, 7), *(f"k{i}" for i in range(100)), b"", b"\xff" * 30, None]
+    value = {key: {str(key): key} for key in reversed(keys)}
+
+    def sort_key(key):
+        encoded = impl.dumps(key)
+        return len(encoded), encoded
+
+    expected = impl.dumps(
+        OrderedDict((key, OrderedDict([(str(key), key)])) for key in sorted(keys, key=sort_key))
+    )
+    assert impl.dumps(value, canonical=True) == expected
+
+
+def test_ordered_map_same_encoding(impl):
+    # Keys that encode identically are left in their original order
+    class Key:
+        pass
+
+    def default(encoder, value):
+        encoder.encode("a")
+
+    key = Key()
+    expected = unhexlify("a2616101616102")
+    value = FrozenDict([("a", 1), (key, 2)])
+    assert impl.dumps(value, canonical=True, default=default) == expected
+
+
+def test_ordered_map_unserializable_key(impl):
+    with pytest.raises(impl.CBOREncodeTypeError, match="cannot serialize type"):
+        impl.dumps({"a": 1, object(): 2}, canonical=True)
+
+
 @pytest.mark.parametrize(
     "value, expected",
     [
@@ -529,6 +1098,9 @@ def test_ordered_map(impl, value, expected):
         (float.fromhex("0x1.4p-24"), "fa33a00000"),
         (float.fromhex("0x1.ff8p-63"), "fa207fc000"),
         (1e300, "fb7e37e43c8800759c"),
+        (32768.0, "f97800"),
+        (-65504.0, "f9fbff"),
+        (65520.0, "fa477ff000"),
     ],
     ids=[
         "float 16",
@@ -541,6 +1113,9 @@ def test_ordered_map(impl, value, expected):
         "mantissa o/f to 32",
         "exponent o/f to 32",
         "oversize float",
+        "float 16 top exponent",
+        "float 16 maximum negative",
+        "float 16 overflow",
     ],
 )
 def test_minimal_floats(impl, value, expected):
@@ -548,6 +1123,14 @@ def test_minimal_floats(impl, value, expected):
     assert impl.dumps(value, canonical=True) == expected
 
 
+def test_minimal_float_array(impl):
+    # runs of floats in an array are sized up together
+    values = [3.5, 100000.0, 3.8, float("nan"), -0.0, float("-inf"), 32768.0, 1e300] * 100
+    values.insert(300, "a")
+    expected = b"".join(impl.dumps(value, canonical=True) for value in values)
+    assert impl.dumps(values, canonical=True) == unhexlify("990321") + expected
+
+
 def test_tuple_key(impl):
     assert impl.dumps({(2, 1): ""}) == unhexlify("a182020160")
 
@@ -619,6 +1202,16 @@ def test_encode_stringrefs_array(impl):
     assert impl.dumps(value, string_referencing=True) == b"\xd9\x01\x00" + impl.dumps(equivalent)
 
 
+def test_encode_stringrefs_many(impl):
+    # Beyond 255 strings, 4 character strings are no longer worth referencing
+    strings = [f"s{i:03}" for i in range(300)]
+    equivalent = strings + [
+        impl.CBORTag(25, i) if i < 256 else string for i, string in enumerate(strings)
+    ]
+    expected = b"\xd9\x01\x00" + impl.dumps(equivalent)
+    assert impl.dumps(strings + strings, string_referencing=True) == expected
+
+
 def test_encode_stringrefs_dict(impl):
     value = {"aaaa": "mmmm", "bbbb": "bbbb", "cccc": "aaaa", "mmmm": "aaaa"}
     expected = unhexlify(
@@ -654,3 +1247,29 @@ def test_invariant_encode_decode(impl, val):
     undergoing an encode and decode)
     """
     assert impl.loads(impl.dumps(val)) == val
+
+
+def test_encoder_stats(impl):
+    def default(encoder, value):
+        encoder.encode([1, 2])
+
+    fp = BytesIO()
+    encoder = impl.CBOREncoder(fp, default=default, collect_stats=True)
+    encoder.encode([1, {"a": [2.5, "x"]}, object(), b"y"])
+    stats = encoder.stats
+    assert stats["bytes_written"] == len(fp.getvalue())
+    assert stats["write_calls"] >= 1
+    assert stats["default_calls"] == 1
+    assert stats["lookup_misses"] >= 1
+    assert stats["max_depth"] == 3
+
+    encoder.collect_stats = True
+    assert encoder.stats["bytes_written"] == 0
+    encoder.collect_stats = False
+    assert encoder.stats is None
+
+
+def test_encoder_stats_disabled(impl):
+    encoder = impl.CBOREncoder(BytesIO())
+    assert not encoder.collect_stats
+    assert encoder.stats is None